@@ -8,6 +8,7 @@
 
 */
 
+#include "../../Source/Core/Audio/BuiltIn/BuiltInSampler.cpp"
 #include "../../Source/Core/Audio/BuiltIn/BuiltInSynthAudioPlugin.cpp"
 #include "../../Source/Core/Audio/BuiltIn/BuiltInSynthFormat.cpp"
 #include "../../Source/Core/Audio/BuiltIn/BuiltInSynthPiano.cpp"
@@ -18,10 +19,12 @@
 #include "../../Source/Core/Audio/Instruments/SerializablePluginDescription.cpp"
 #include "../../Source/Core/Audio/Monitoring/AudioMonitor.cpp"
 #include "../../Source/Core/Audio/Monitoring/SpectrumAnalyzer.cpp"
+#include "../../Source/Core/Audio/Transport/NoteIntervalIndex.cpp"
 #include "../../Source/Core/Audio/Transport/PlayerThread.cpp"
 #include "../../Source/Core/Audio/Transport/RendererThread.cpp"
 #include "../../Source/Core/Audio/Transport/Transport.cpp"
 #include "../../Source/Core/Audio/AudioCore.cpp"
+#include "../../Source/Core/Audio/RealtimeMode.cpp"
 #include "../../Source/Core/Configuration/Models/Arpeggiator.cpp"
 #include "../../Source/Core/Configuration/Models/Chord.cpp"
 #include "../../Source/Core/Configuration/Models/ColourScheme.cpp"
@@ -50,14 +53,19 @@
 #include "../../Source/Core/Midi/Sequences/Events/AutomationEvent.cpp"
 #include "../../Source/Core/Midi/Sequences/Events/KeySignatureEvent.cpp"
 #include "../../Source/Core/Midi/Sequences/Events/MidiEvent.cpp"
+#include "../../Source/Core/Midi/Sequences/Events/MidiEventAllocator.cpp"
 #include "../../Source/Core/Midi/Sequences/Events/Note.cpp"
 #include "../../Source/Core/Midi/Sequences/Events/TimeSignatureEvent.cpp"
 #include "../../Source/Core/Midi/Sequences/AnnotationsSequence.cpp"
 #include "../../Source/Core/Midi/Sequences/AutomationSequence.cpp"
 #include "../../Source/Core/Midi/Sequences/KeySignaturesSequence.cpp"
+#include "../../Source/Core/Midi/Sequences/MidiExportBuffer.cpp"
 #include "../../Source/Core/Midi/Sequences/MidiSequence.cpp"
+#include "../../Source/Core/Midi/Sequences/MidiSequenceSnapshot.cpp"
+#include "../../Source/Core/Midi/Sequences/NoteColumns.cpp"
 #include "../../Source/Core/Midi/Sequences/PianoSequence.cpp"
 #include "../../Source/Core/Midi/Sequences/TimeSignaturesSequence.cpp"
+#include "../../Source/Core/Midi/IdGenerator.cpp"
 #include "../../Source/Core/Midi/MidiTrack.cpp"
 #include "../../Source/Core/Network/Requests/BackendRequest.cpp"
 #include "../../Source/Core/Network/Requests/UserConfigSyncThread.cpp"
@@ -83,12 +91,15 @@
 #include "../../Source/Core/Tree/OrchestraPitNode.cpp"
 #include "../../Source/Core/Tree/PatternEditorNode.cpp"
 #include "../../Source/Core/Tree/PianoTrackNode.cpp"
+#include "../../Source/Core/Tree/ProjectChangeSet.cpp"
 #include "../../Source/Core/Tree/ProjectMetadata.cpp"
 #include "../../Source/Core/Tree/ProjectTimeline.cpp"
 #include "../../Source/Core/Tree/ProjectNode.cpp"
 #include "../../Source/Core/Tree/RootNode.cpp"
 #include "../../Source/Core/Tree/SettingsNode.cpp"
 #include "../../Source/Core/Tree/TrackGroupNode.cpp"
+#include "../../Source/Core/Tree/TracksBeatRangeIndex.cpp"
+#include "../../Source/Core/Tree/TracksRegistry.cpp"
 #include "../../Source/Core/Tree/TreeNode.cpp"
 #include "../../Source/Core/Tree/TreeNodeSerializer.cpp"
 #include "../../Source/Core/Tree/VersionControlNode.cpp"
@@ -101,6 +112,7 @@
 #include "../../Source/Core/Undo/Actions/PatternActions.cpp"
 #include "../../Source/Core/Undo/Actions/PianoTrackActions.cpp"
 #include "../../Source/Core/Undo/Actions/TimeSignatureEventActions.cpp"
+#include "../../Source/Core/Undo/UndoJournal.cpp"
 #include "../../Source/Core/Undo/UndoStack.cpp"
 #include "../../Source/Core/VCS/DiffLogic/AutomationTrackDiffLogic.cpp"
 #include "../../Source/Core/VCS/DiffLogic/DiffLogic.cpp"
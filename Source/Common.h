@@ -43,6 +43,7 @@
 #include <limits.h>
 #include <float.h>
 #include <math.h>
+#include <set>
 
 //===----------------------------------------------------------------------===//
 // A better hash map
@@ -36,14 +36,21 @@ AudioCore::AudioCore()
 {
     this->audioMonitor = makeUnique<AudioMonitor>();
     this->deviceManager.addAudioCallback(this->audioMonitor.get());
+#if JUCE_LINUX
+    this->deviceManager.addAudioCallback(&this->realtimeCallback);
+#endif
     AudioCore::initAudioFormats(this->formatManager);
 }
 
 AudioCore::~AudioCore()
 {
+#if JUCE_LINUX
+    this->deviceManager.removeAudioCallback(&this->realtimeCallback);
+#endif
     this->deviceManager.removeAudioCallback(this->audioMonitor.get());
     this->audioMonitor = nullptr;
     this->deviceManager.closeAudioDevice();
+    RealtimeMode::setEnabled(false);
 }
 
 bool AudioCore::canSleepNow() noexcept
@@ -72,6 +79,9 @@ void AudioCore::disconnectAllAudioCallbacks()
 
         // Audio monitor is especially CPU-hungry, as it does FFT all the time:
         this->deviceManager.removeAudioCallback(this->audioMonitor.get());
+#if JUCE_LINUX
+        this->deviceManager.removeAudioCallback(&this->realtimeCallback);
+#endif
 
         for (auto *instrument : this->instruments)
         {
@@ -90,6 +100,9 @@ void AudioCore::reconnectAllAudioCallbacks()
         }
 
         this->deviceManager.addAudioCallback(this->audioMonitor.get());
+#if JUCE_LINUX
+        this->deviceManager.addAudioCallback(&this->realtimeCallback);
+#endif
 
         this->isMuted = false;
     }
@@ -304,6 +317,13 @@ SerializedData AudioCore::serializeDeviceManager() const
         tree.setProperty(Audio::defaultMidiOutput, defaultMidiOutput);
     }
 
+    if (RealtimeMode::isEnabled())
+    {
+        tree.setProperty(Audio::realtimeMode, true);
+        tree.setProperty(Audio::realtimePlayerPriority, RealtimeMode::getPlayerPriority());
+        tree.setProperty(Audio::realtimeAudioPriority, RealtimeMode::getAudioPriority());
+    }
+
     return tree;
 }
 
@@ -380,6 +400,11 @@ void AudioCore::deserializeDeviceManager(const SerializedData &tree)
     }
 
     this->deviceManager.setDefaultMidiOutput(root.getProperty(Audio::defaultMidiOutput));
+
+    // Opt-in, there's no UI for it so far, only the config file
+    RealtimeMode::setEnabled(root.getProperty(Audio::realtimeMode, false),
+        root.getProperty(Audio::realtimePlayerPriority, REALTIME_MODE_DEFAULT_PLAYER_PRIORITY),
+        root.getProperty(Audio::realtimeAudioPriority, REALTIME_MODE_DEFAULT_AUDIO_PRIORITY));
 }
 
 //===----------------------------------------------------------------------===//
@@ -21,6 +21,7 @@ class AudioMonitor;
 
 #include "Instrument.h"
 #include "OrchestraPit.h"
+#include "RealtimeMode.h"
 
 class SleepTimer : private Timer
 {
@@ -174,6 +175,9 @@ private:
 
     OwnedArray<Instrument> instruments;
     UniquePointer<AudioMonitor> audioMonitor;
+#if JUCE_LINUX
+    RealtimeAudioCallback realtimeCallback;
+#endif
 
     AudioPluginFormatManager formatManager;
     AudioDeviceManager deviceManager;
@@ -0,0 +1,450 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BuiltInSampler.h"
+
+#if defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define BUILTIN_SAMPLER_USE_SSE 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+#   include <arm_neon.h>
+#   define BUILTIN_SAMPLER_USE_NEON 1
+#endif
+
+// The envelope is updated once per this many samples, and ramped in between
+#define BUILTIN_SAMPLER_CONTROL_BLOCK_SIZE 64
+
+// The resolution of the sample's peak levels table, used to cull the voices
+#define BUILTIN_SAMPLER_PEAK_CHUNK_SIZE 256
+
+// Voices quieter than that (about -96 dB) are stopped
+#define BUILTIN_SAMPLER_SILENCE_LEVEL 0.000016f
+
+// Zeroes after the end of sample, so that the interpolation never reads beyond it
+#define BUILTIN_SAMPLER_PADDING 4
+
+//===----------------------------------------------------------------------===//
+// Rendering
+//===----------------------------------------------------------------------===//
+
+// Adds the linearly interpolated source to the output, applying the gain ramp;
+// for the mono output, outR is the same as outL, and for the mono source,
+// inR is the same as inL; the caller ensures that the position never
+// reaches beyond the source length (plus one padding sample)
+static void renderBuiltInSamplerBlock(float *outL, float *outR,
+    const float *inL, const float *inR, double &position, double step,
+    int numSamples, float gain, float gainStep) noexcept
+{
+    int i = 0;
+
+#if BUILTIN_SAMPLER_USE_SSE || BUILTIN_SAMPLER_USE_NEON
+
+    // the fetches are scalar anyway, since the positions are fractional,
+    // but everything else is done for 4 samples at once:
+    alignas(16) float l0[4], l1[4], r0[4], r1[4], alpha[4];
+    alignas(16) const float gains[4] = { gain, gain + gainStep, gain + gainStep * 2.f, gain + gainStep * 3.f };
+
+#if BUILTIN_SAMPLER_USE_SSE
+    __m128 g = _mm_load_ps(gains);
+    const __m128 gs = _mm_set1_ps(gainStep * 4.f);
+#else
+    float32x4_t g = vld1q_f32(gains);
+    const float32x4_t gs = vdupq_n_f32(gainStep * 4.f);
+#endif
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const auto index = int(position);
+            alpha[lane] = float(position - double(index));
+            l0[lane] = inL[index];
+            l1[lane] = inL[index + 1];
+            r0[lane] = inR[index];
+            r1[lane] = inR[index + 1];
+            position += step;
+        }
+
+#if BUILTIN_SAMPLER_USE_SSE
+        const __m128 a = _mm_load_ps(alpha);
+        const __m128 sl = _mm_load_ps(l0);
+        const __m128 sr = _mm_load_ps(r0);
+        const __m128 left = _mm_mul_ps(_mm_add_ps(sl, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(l1), sl), a)), g);
+        const __m128 right = _mm_mul_ps(_mm_add_ps(sr, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(r1), sr), a)), g);
+        _mm_storeu_ps(outL + i, _mm_add_ps(_mm_loadu_ps(outL + i), left));
+        _mm_storeu_ps(outR + i, _mm_add_ps(_mm_loadu_ps(outR + i), right));
+        g = _mm_add_ps(g, gs);
+#else
+        const float32x4_t a = vld1q_f32(alpha);
+        const float32x4_t sl = vld1q_f32(l0);
+        const float32x4_t sr = vld1q_f32(r0);
+        const float32x4_t left = vmulq_f32(vmlaq_f32(sl, vsubq_f32(vld1q_f32(l1), sl), a), g);
+        const float32x4_t right = vmulq_f32(vmlaq_f32(sr, vsubq_f32(vld1q_f32(r1), sr), a), g);
+        vst1q_f32(outL + i, vaddq_f32(vld1q_f32(outL + i), left));
+        vst1q_f32(outR + i, vaddq_f32(vld1q_f32(outR + i), right));
+        g = vaddq_f32(g, gs);
+#endif
+    }
+
+    gain += gainStep * float(i);
+
+#endif
+
+    for (; i < numSamples; ++i)
+    {
+        const auto index = int(position);
+        const float a = float(position - double(index));
+        const float l = inL[index] + (inL[index + 1] - inL[index]) * a;
+        const float r = inR[index] + (inR[index + 1] - inR[index]) * a;
+        outL[i] += l * gain;
+        outR[i] += r * gain;
+        gain += gainStep;
+        position += step;
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// BuiltInSamplerSound
+//===----------------------------------------------------------------------===//
+
+BuiltInSamplerSound::BuiltInSamplerSound(AudioFormatReader &source,
+    const BigInteger &midiNotes, int midiNoteForNormalPitch,
+    double attackTimeSecs, double releaseTimeSecs,
+    double maxSampleLengthSeconds) :
+    midiNotes(midiNotes),
+    sourceSampleRate(source.sampleRate),
+    midiRootNote(midiNoteForNormalPitch),
+    attackTimeSecs(attackTimeSecs),
+    releaseTimeSecs(releaseTimeSecs)
+{
+    if (this->sourceSampleRate <= 0.0 || source.lengthInSamples <= 0)
+    {
+        jassertfalse;
+        return;
+    }
+
+    this->length = int(jmin(int64(maxSampleLengthSeconds * this->sourceSampleRate),
+        source.lengthInSamples));
+
+    this->data.setSize(jmin(2, int(source.numChannels)), this->length + BUILTIN_SAMPLER_PADDING);
+    this->data.clear();
+    source.read(&this->data, 0, this->length, 0, true, true);
+
+    // each chunk's peak is the maximum level from that chunk to the end,
+    // so that the voice can tell when the rest of the sample is inaudible;
+    // the extra zero is for the position at the very end
+    const int numChunks = (this->length + BUILTIN_SAMPLER_PEAK_CHUNK_SIZE - 1) / BUILTIN_SAMPLER_PEAK_CHUNK_SIZE;
+    this->remainingPeaks.insertMultiple(0, 0.f, numChunks + 1);
+
+    float peak = 0.f;
+    for (int i = numChunks; --i >= 0;)
+    {
+        const int start = i * BUILTIN_SAMPLER_PEAK_CHUNK_SIZE;
+        const int num = jmin(BUILTIN_SAMPLER_PEAK_CHUNK_SIZE, this->length - start);
+        for (int c = 0; c < this->data.getNumChannels(); ++c)
+        {
+            peak = jmax(peak, this->data.getMagnitude(c, start, num));
+        }
+
+        this->remainingPeaks.set(i, peak);
+    }
+}
+
+bool BuiltInSamplerSound::appliesToNote(int midiNoteNumber)
+{
+    return this->midiNotes[midiNoteNumber];
+}
+
+bool BuiltInSamplerSound::appliesToChannel(int midiChannel)
+{
+    return true;
+}
+
+float BuiltInSamplerSound::getRemainingPeak(double sourcePosition) const noexcept
+{
+    return this->remainingPeaks[int(sourcePosition) / BUILTIN_SAMPLER_PEAK_CHUNK_SIZE];
+}
+
+//===----------------------------------------------------------------------===//
+// BuiltInSamplerVoice
+//===----------------------------------------------------------------------===//
+
+bool BuiltInSamplerVoice::canPlaySound(SynthesiserSound *sound)
+{
+    return dynamic_cast<const BuiltInSamplerSound *>(sound) != nullptr;
+}
+
+void BuiltInSamplerVoice::startNote(int midiNoteNumber, float velocity,
+    SynthesiserSound *s, int pitchWheel)
+{
+    const auto *sound = dynamic_cast<const BuiltInSamplerSound *>(s);
+    if (sound == nullptr)
+    {
+        jassertfalse;
+        return;
+    }
+
+    const double sampleRate = this->getSampleRate();
+
+    this->pitchRatio = std::pow(2.0, (midiNoteNumber - sound->midiRootNote) / 12.0) *
+        sound->sourceSampleRate / sampleRate;
+
+    this->sourcePosition = 0.0;
+    this->velocityGain = velocity;
+
+    this->attackDelta = sound->attackTimeSecs > 0.0 ?
+        float(1.0 / (sound->attackTimeSecs * sampleRate)) : 0.f;
+
+    this->releaseDelta = sound->releaseTimeSecs > 0.0 ?
+        float(1.0 / (sound->releaseTimeSecs * sampleRate)) : 0.f;
+
+    if (this->attackDelta > 0.f)
+    {
+        this->stage = Stage::Attack;
+        this->envelopeLevel = 0.f;
+    }
+    else
+    {
+        this->stage = Stage::Sustain;
+        this->envelopeLevel = 1.f;
+    }
+}
+
+void BuiltInSamplerVoice::stopNote(float velocity, bool allowTailOff)
+{
+    if (allowTailOff && this->releaseDelta > 0.f)
+    {
+        this->stage = Stage::Release;
+    }
+    else
+    {
+        this->clearCurrentNote();
+    }
+}
+
+void BuiltInSamplerVoice::pitchWheelMoved(int newValue) {}
+
+void BuiltInSamplerVoice::controllerMoved(int controllerNumber, int newValue) {}
+
+void BuiltInSamplerVoice::renderNextBlock(AudioBuffer<float> &outputBuffer,
+    int startSample, int numSamples)
+{
+    const auto *sound = static_cast<const BuiltInSamplerSound *>(this->getCurrentlyPlayingSound().get());
+    if (sound == nullptr)
+    {
+        return;
+    }
+
+    const float *inL = sound->data.getReadPointer(0);
+    const float *inR = sound->data.getNumChannels() > 1 ? sound->data.getReadPointer(1) : inL;
+
+    const bool isStereoOutput = outputBuffer.getNumChannels() > 1;
+    float *outL = outputBuffer.getWritePointer(0, startSample);
+    float *outR = isStereoOutput ? outputBuffer.getWritePointer(1, startSample) : outL;
+
+    // the mono output gets the sum of both channels
+    const float channelGain = isStereoOutput ? 1.f : 0.5f;
+
+    while (numSamples > 0)
+    {
+        const double framesLeft = (sound->length - this->sourcePosition) / this->pitchRatio;
+        const float maxLevel = this->velocityGain *
+            (this->stage == Stage::Attack ? 1.f : this->envelopeLevel);
+
+        // silent voice culling: the sample has ended, or the rest is inaudible
+        if (framesLeft <= 0.0 ||
+            maxLevel * sound->getRemainingPeak(this->sourcePosition) < BUILTIN_SAMPLER_SILENCE_LEVEL)
+        {
+            this->clearCurrentNote();
+            return;
+        }
+
+        int numToRender = jmin(numSamples, BUILTIN_SAMPLER_CONTROL_BLOCK_SIZE,
+            int(std::ceil(framesLeft)));
+
+        float levelAtEnd = this->envelopeLevel;
+        switch (this->stage)
+        {
+        case Stage::Attack:
+            levelAtEnd += this->attackDelta * float(numToRender);
+            if (levelAtEnd >= 1.f)
+            {
+                levelAtEnd = 1.f;
+                this->stage = Stage::Sustain;
+            }
+            break;
+        case Stage::Release:
+            numToRender = jmax(1, jmin(numToRender,
+                int(std::ceil(this->envelopeLevel / this->releaseDelta))));
+            levelAtEnd = jmax(0.f, levelAtEnd - this->releaseDelta * float(numToRender));
+            break;
+        case Stage::Sustain:
+        default:
+            break;
+        }
+
+        const float gainAtStart = this->velocityGain * this->envelopeLevel * channelGain;
+        const float gainAtEnd = this->velocityGain * levelAtEnd * channelGain;
+
+        renderBuiltInSamplerBlock(outL, outR, inL, inR,
+            this->sourcePosition, this->pitchRatio, numToRender,
+            gainAtStart, (gainAtEnd - gainAtStart) / float(numToRender));
+
+        this->envelopeLevel = levelAtEnd;
+
+        outL += numToRender;
+        outR += numToRender;
+        numSamples -= numToRender;
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#include "BinaryData.h"
+
+#define BUILTIN_SAMPLER_TEST_SAMPLE_RATE 44100.0
+#define BUILTIN_SAMPLER_TEST_BLOCK_SIZE 512
+#define BUILTIN_SAMPLER_TEST_NUM_VOICES 64
+#define BUILTIN_SAMPLER_TEST_MIN_SPEEDUP 1.0
+
+// Compares the CPU time per voice with the stock JUCE sampler,
+// rendering a sustained chord, as if played with the pedal down
+
+class BuiltInSamplerBenchmark final : public UnitTest
+{
+public:
+
+    BuiltInSamplerBenchmark() :
+        UnitTest("Built-in sampler voice benchmark", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        BigInteger allNotes;
+        allNotes.setRange(0, 128, true);
+
+        Synthesiser stockSynth;
+        Synthesiser builtInSynth;
+
+        {
+            FlacAudioFormat flac;
+            UniquePointer<AudioFormatReader> reader(flac.createReaderFor(new MemoryInputStream(BinaryData::C4v9_flac,
+                BinaryData::C4v9_flacSize, false), true));
+
+            expect(reader != nullptr);
+            if (reader == nullptr)
+            {
+                return;
+            }
+
+            stockSynth.addSound(new SamplerSound({}, *reader, allNotes, 60, 0.0, 0.5, 4.5));
+            builtInSynth.addSound(new BuiltInSamplerSound(*reader, allNotes, 60, 0.0, 0.5, 4.5));
+        }
+
+        for (int i = 0; i < BUILTIN_SAMPLER_TEST_NUM_VOICES; ++i)
+        {
+            stockSynth.addVoice(new SamplerVoice());
+            builtInSynth.addVoice(new BuiltInSamplerVoice());
+        }
+
+        beginTest("Sustained chord rendering");
+
+        const double renderedSeconds = 2.0;
+        float stockPeak = 0.f;
+        float builtInPeak = 0.f;
+        const double stockTime = renderChord(stockSynth, renderedSeconds, stockPeak);
+        const double builtInTime = renderChord(builtInSynth, renderedSeconds, builtInPeak);
+
+        expect(builtInPeak > 0.f, "Built-in sampler should produce sound");
+
+        // microseconds of CPU time per voice per second of audio:
+        const auto perVoice = [renderedSeconds](double seconds)
+        {
+            return seconds * 1000000.0 / (BUILTIN_SAMPLER_TEST_NUM_VOICES * renderedSeconds);
+        };
+
+        logMessage("Stock sampler: " + String(perVoice(stockTime), 2) + " us per voice-second, peak " +
+            String(Decibels::gainToDecibels(stockPeak), 1) + " dB");
+        logMessage("Built-in sampler: " + String(perVoice(builtInTime), 2) + " us per voice-second, peak " +
+            String(Decibels::gainToDecibels(builtInPeak), 1) + " dB");
+        const auto speedup = stockTime / jmax(builtInTime, 0.000001);
+        logMessage("Speedup: " + String(speedup, 2) + "x");
+        expectGreaterThan(speedup, BUILTIN_SAMPLER_TEST_MIN_SPEEDUP);
+
+        beginTest("Released voices are culled");
+
+        AudioBuffer<float> buffer(2, BUILTIN_SAMPLER_TEST_BLOCK_SIZE);
+        const MidiBuffer noEvents;
+        MidiBuffer noteOffs;
+        for (int i = 0; i < BUILTIN_SAMPLER_TEST_NUM_VOICES; ++i)
+        {
+            noteOffs.addEvent(MidiMessage::noteOff(1, 36 + i), 0);
+        }
+
+        // the release time is 0.5 seconds, let's render a bit more
+        const int numBlocks = int(BUILTIN_SAMPLER_TEST_SAMPLE_RATE * 0.6) / BUILTIN_SAMPLER_TEST_BLOCK_SIZE;
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            buffer.clear();
+            builtInSynth.renderNextBlock(buffer, block == 0 ? noteOffs : noEvents,
+                0, BUILTIN_SAMPLER_TEST_BLOCK_SIZE);
+        }
+
+        for (int i = 0; i < builtInSynth.getNumVoices(); ++i)
+        {
+            expect(!builtInSynth.getVoice(i)->isVoiceActive(), "Released voices should stop");
+        }
+    }
+
+private:
+
+    static double renderChord(Synthesiser &synth, double seconds, float &outPeak)
+    {
+        synth.setCurrentPlaybackSampleRate(BUILTIN_SAMPLER_TEST_SAMPLE_RATE);
+
+        MidiBuffer noteOns;
+        for (int i = 0; i < BUILTIN_SAMPLER_TEST_NUM_VOICES; ++i)
+        {
+            noteOns.addEvent(MidiMessage::noteOn(1, 36 + i, 0.8f), 0);
+        }
+
+        AudioBuffer<float> buffer(2, BUILTIN_SAMPLER_TEST_BLOCK_SIZE);
+        const MidiBuffer noEvents;
+
+        const int numBlocks = int(BUILTIN_SAMPLER_TEST_SAMPLE_RATE * seconds) / BUILTIN_SAMPLER_TEST_BLOCK_SIZE;
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            buffer.clear();
+            synth.renderNextBlock(buffer, block == 0 ? noteOns : noEvents,
+                0, BUILTIN_SAMPLER_TEST_BLOCK_SIZE);
+
+            outPeak = jmax(outPeak, buffer.getMagnitude(0, BUILTIN_SAMPLER_TEST_BLOCK_SIZE));
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+};
+
+static BuiltInSamplerBenchmark builtInSamplerBenchmark;
+
+#endif
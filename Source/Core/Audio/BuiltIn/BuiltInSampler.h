@@ -0,0 +1,100 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A replacement for juce::SamplerSound and juce::SamplerVoice,
+// tailored for the built-in instruments, where lots of voices are sustained
+// at once (e.g. piano chords with pedal):
+// the voice renders 4 samples at a time with SSE or NEON, when available,
+// updates the envelope once per each short block and ramps the gain in between,
+// and stops as soon as the rest of its sample would be inaudible anyway.
+
+class BuiltInSamplerSound final : public SynthesiserSound
+{
+public:
+
+    BuiltInSamplerSound(AudioFormatReader &source,
+        const BigInteger &midiNotes,
+        int midiNoteForNormalPitch,
+        double attackTimeSecs,
+        double releaseTimeSecs,
+        double maxSampleLengthSeconds);
+
+    bool appliesToNote(int midiNoteNumber) override;
+    bool appliesToChannel(int midiChannel) override;
+
+private:
+
+    // The peak level of the sample from the given position to its end
+    float getRemainingPeak(double sourcePosition) const noexcept;
+
+    AudioBuffer<float> data;
+    Array<float> remainingPeaks;
+
+    BigInteger midiNotes;
+    double sourceSampleRate = 0.0;
+    int length = 0;
+    int midiRootNote = 0;
+
+    double attackTimeSecs = 0.0;
+    double releaseTimeSecs = 0.0;
+
+    friend class BuiltInSamplerVoice;
+
+    JUCE_LEAK_DETECTOR(BuiltInSamplerSound)
+};
+
+class BuiltInSamplerVoice final : public SynthesiserVoice
+{
+public:
+
+    BuiltInSamplerVoice() = default;
+
+    bool canPlaySound(SynthesiserSound *sound) override;
+
+    void startNote(int midiNoteNumber, float velocity,
+        SynthesiserSound *sound, int pitchWheel) override;
+    void stopNote(float velocity, bool allowTailOff) override;
+
+    void pitchWheelMoved(int newValue) override;
+    void controllerMoved(int controllerNumber, int newValue) override;
+
+    void renderNextBlock(AudioBuffer<float> &outputBuffer,
+        int startSample, int numSamples) override;
+
+private:
+
+    enum class Stage : int8
+    {
+        Attack,
+        Sustain,
+        Release
+    };
+
+    Stage stage = Stage::Sustain;
+
+    double sourcePosition = 0.0;
+    double pitchRatio = 0.0;
+
+    float velocityGain = 0.f;
+    float envelopeLevel = 0.f;
+    float attackDelta = 0.f;
+    float releaseDelta = 0.f;
+
+    JUCE_LEAK_DETECTOR(BuiltInSamplerVoice)
+};
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#define BUILTIN_SYNTH_NUM_VOICES 32
+#define BUILTIN_SYNTH_NUM_VOICES 64
 
 class BuiltInSynthAudioPlugin : public AudioPluginInstance
 {
@@ -17,6 +17,7 @@
 
 #include "Common.h"
 #include "BuiltInSynthPiano.h"
+#include "BuiltInSampler.h"
 #include "BinaryData.h"
 
 #define ATTACK_TIME (0.0)
@@ -73,7 +74,7 @@ void BuiltInSynthPiano::initVoices()
 {
     for (int i = BUILTIN_SYNTH_NUM_VOICES; --i >= 0;)
     {
-        this->synth.addVoice(new SamplerVoice());
+        this->synth.addVoice(new BuiltInSamplerVoice());
     }
 }
 
@@ -120,7 +121,7 @@ void BuiltInSynthPiano::initSampler()
     for (auto &s : samples)
     {
         UniquePointer<AudioFormatReader> reader(s.createReader());
-        this->synth.addSound(new SamplerSound({}, *reader,
+        this->synth.addSound(new BuiltInSamplerSound(*reader,
             s.midiNotes, s.midiNoteForNormalPitch,
             ATTACK_TIME, RELEASE_TIME, MAX_PLAY_TIME));
     }
@@ -0,0 +1,252 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "RealtimeMode.h"
+
+#if JUCE_LINUX
+#   include <sched.h>
+#   include <pthread.h>
+#   include <errno.h>
+#   include <sys/mman.h>
+#   include <sys/resource.h>
+#endif
+
+Atomic<bool> RealtimeMode::enabled = false;
+Atomic<bool> RealtimeMode::memoryLocked = false;
+Atomic<bool> RealtimeMode::threadErrorReported = false;
+Atomic<int> RealtimeMode::playerPriority = REALTIME_MODE_DEFAULT_PLAYER_PRIORITY;
+Atomic<int> RealtimeMode::audioPriority = REALTIME_MODE_DEFAULT_AUDIO_PRIORITY;
+
+#if JUCE_LINUX
+static String describeRealtimeError(int errorCode)
+{
+    String description(strerror(errorCode));
+    if (errorCode == EPERM || errorCode == ENOMEM)
+    {
+        description << " (check the rtprio and memlock limits for this user)";
+    }
+
+    return description;
+}
+#endif
+
+bool RealtimeMode::isSupported() noexcept
+{
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool RealtimeMode::isEnabled() noexcept
+{
+    return RealtimeMode::enabled.get();
+}
+
+int RealtimeMode::getPlayerPriority() noexcept
+{
+    return RealtimeMode::playerPriority.get();
+}
+
+int RealtimeMode::getAudioPriority() noexcept
+{
+    return RealtimeMode::audioPriority.get();
+}
+
+String RealtimeMode::setEnabled(bool shouldBeEnabled, int newPlayerPriority, int newAudioPriority)
+{
+    if (!RealtimeMode::isSupported())
+    {
+        return shouldBeEnabled ? "Realtime mode is not supported on this platform" : String();
+    }
+
+    RealtimeMode::playerPriority = newPlayerPriority;
+    RealtimeMode::audioPriority = newAudioPriority;
+
+    if (RealtimeMode::enabled.get() == shouldBeEnabled)
+    {
+        return {};
+    }
+
+    if (!shouldBeEnabled)
+    {
+        RealtimeMode::enabled = false;
+        RealtimeMode::unlockMemory();
+        return {};
+    }
+
+    // only enable the mode once the memory is locked, so that
+    // the threads are not promoted when the setup has failed:
+    const auto error = RealtimeMode::lockMemory();
+    if (error.isNotEmpty())
+    {
+        Logger::writeToLog("Realtime mode: " + error);
+        return error;
+    }
+
+    RealtimeMode::threadErrorReported = false;
+    RealtimeMode::enabled = true;
+    return {};
+}
+
+bool RealtimeMode::promotePlayerThread()
+{
+    if (!RealtimeMode::isEnabled())
+    {
+        return false;
+    }
+
+    return RealtimeMode::promoteCurrentThread("player", RealtimeMode::getPlayerPriority());
+}
+
+bool RealtimeMode::promoteAudioThread()
+{
+    if (!RealtimeMode::isEnabled())
+    {
+        return false;
+    }
+
+    return RealtimeMode::promoteCurrentThread("audio", RealtimeMode::getAudioPriority());
+}
+
+bool RealtimeMode::promoteCurrentThread(const char *threadName, int priority)
+{
+#if JUCE_LINUX
+    const int minPriority = sched_get_priority_min(SCHED_FIFO);
+    const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+
+    struct sched_param param;
+    param.sched_priority = jlimit(minPriority, maxPriority, priority);
+
+    const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+        // only report once, instead of each time the playback starts
+        if (RealtimeMode::threadErrorReported.exchange(true))
+        {
+            return false;
+        }
+
+        // pthread_setschedparam returns the error code instead of setting errno
+        Logger::writeToLog("Realtime mode: failed to set SCHED_FIFO priority " +
+            String(param.sched_priority) + " for the " + threadName + " thread: " +
+            describeRealtimeError(result));
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+String RealtimeMode::lockMemory()
+{
+#if JUCE_LINUX
+    if (RealtimeMode::memoryLocked.get())
+    {
+        return {};
+    }
+
+    // Locking the future allocations too is only safe when the limit
+    // is not set, otherwise allocations beyond it would start to fail;
+    // in that case, only the pages mapped so far are locked,
+    // which covers the engine's preallocated buffers, and the
+    // playback cache is prefaulted separately before each playback:
+    struct rlimit limit;
+    const bool isUnlimited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+        limit.rlim_cur == RLIM_INFINITY;
+
+    const int flags = isUnlimited ? (MCL_CURRENT | MCL_FUTURE) : MCL_CURRENT;
+    if (mlockall(flags) != 0)
+    {
+        return "failed to lock the memory: " + describeRealtimeError(errno);
+    }
+
+    RealtimeMode::memoryLocked = true;
+    return {};
+#else
+    return {};
+#endif
+}
+
+void RealtimeMode::unlockMemory()
+{
+#if JUCE_LINUX
+    if (RealtimeMode::memoryLocked.get())
+    {
+        munlockall();
+        RealtimeMode::memoryLocked = false;
+    }
+#endif
+}
+
+void RealtimeMode::prefault(const void *data, size_t numBytes) noexcept
+{
+    if (data == nullptr || numBytes == 0)
+    {
+        return;
+    }
+
+    static const size_t pageSize = 4096;
+    const auto *bytes = static_cast<const volatile char *>(data);
+
+    char checksum = bytes[numBytes - 1];
+    for (size_t i = 0; i < numBytes; i += pageSize)
+    {
+        checksum ^= bytes[i];
+    }
+
+    ignoreUnused(checksum);
+}
+
+#if JUCE_LINUX
+
+//===----------------------------------------------------------------------===//
+// RealtimeAudioCallback
+//===----------------------------------------------------------------------===//
+
+void RealtimeAudioCallback::audioDeviceAboutToStart(AudioIODevice *)
+{
+    // the device might have re-created its thread
+    this->needsPromotion = true;
+}
+
+void RealtimeAudioCallback::audioDeviceIOCallback(const float **, int,
+    float **outputChannelData, int numOutputChannels, int numSamples)
+{
+    if (this->needsPromotion.get() && RealtimeMode::isEnabled())
+    {
+        this->needsPromotion = false;
+        RealtimeMode::promoteAudioThread();
+    }
+
+    // the device manager mixes the output of all callbacks:
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        if (outputChannelData[i] != nullptr)
+        {
+            FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        }
+    }
+}
+
+void RealtimeAudioCallback::audioDeviceStopped() {}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#define REALTIME_MODE_DEFAULT_PLAYER_PRIORITY 70
+#define REALTIME_MODE_DEFAULT_AUDIO_PRIORITY 80
+
+// An opt-in mode for busy Linux boxes, which promotes the player
+// and the audio device threads to SCHED_FIFO, and locks the engine's
+// memory, so that it is never paged out during the playback.
+// On other platforms, and when disabled, all methods do nothing.
+
+// None of that is permitted by default on most distros: the user
+// should be a member of a group with rtprio and memlock limits set,
+// (e.g. the `audio` group, see /etc/security/limits.d/), so whenever
+// the system refuses, it is reported in the log, and the app
+// keeps working at default priorities.
+
+class RealtimeMode final
+{
+public:
+
+    static bool isSupported() noexcept;
+    static bool isEnabled() noexcept;
+
+    // Sets up the priorities, and locks or unlocks the memory;
+    // returns an empty string on success, or the error description
+    static String setEnabled(bool shouldBeEnabled,
+        int playerPriority = REALTIME_MODE_DEFAULT_PLAYER_PRIORITY,
+        int audioPriority = REALTIME_MODE_DEFAULT_AUDIO_PRIORITY);
+
+    static int getPlayerPriority() noexcept;
+    static int getAudioPriority() noexcept;
+
+    // Promote the calling thread, if the mode is enabled:
+    static bool promotePlayerThread();
+    static bool promoteAudioThread();
+
+    // Touches all pages of the given memory block,
+    // so that the realtime threads don't hit the page faults:
+    static void prefault(const void *data, size_t numBytes) noexcept;
+
+private:
+
+    static bool promoteCurrentThread(const char *threadName, int priority);
+    static String lockMemory();
+    static void unlockMemory();
+
+    static Atomic<bool> enabled;
+    static Atomic<bool> memoryLocked;
+    static Atomic<bool> threadErrorReported;
+    static Atomic<int> playerPriority;
+    static Atomic<int> audioPriority;
+
+};
+
+#if JUCE_LINUX
+
+// Promotes the audio device thread once after each device start:
+// register it in the device manager alongside the other callbacks;
+// only needed on Linux, where the mode is supported at all
+class RealtimeAudioCallback final : public AudioIODeviceCallback
+{
+public:
+
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+    void audioDeviceIOCallback(const float **inputChannelData, int numInputChannels,
+        float **outputChannelData, int numOutputChannels, int numSamples) override;
+    void audioDeviceStopped() override;
+
+private:
+
+    Atomic<bool> needsPromotion = true;
+
+};
+
+#endif
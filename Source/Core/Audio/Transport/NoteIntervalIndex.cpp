@@ -0,0 +1,197 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteIntervalIndex.h"
+
+void NoteIntervalIndex::build(const MidiMessageSequence &sequence)
+{
+    this->clear();
+
+    Array<Note> notes;
+    notes.ensureStorageAllocated(sequence.getNumEvents() / 2);
+
+    for (int i = 0; i < sequence.getNumEvents(); ++i)
+    {
+        const auto *noteOnHolder = sequence.getEventPointer(i);
+        if (const auto *noteOffHolder = noteOnHolder->noteOffObject)
+        {
+            const double start = noteOnHolder->message.getTimeStamp();
+            const double end = noteOffHolder->message.getTimeStamp();
+
+            // zero-length notes never sound at any time,
+            // and skipping them guarantees that each node takes
+            // at least one interval, so that the build terminates
+            if (end > start)
+            {
+                notes.add({ start, end, noteOnHolder });
+            }
+        }
+    }
+
+    // the sequence is sorted already, so this is mostly a check
+    std::stable_sort(notes.begin(), notes.end(),
+        [](const Note &a, const Note &b) { return a.start < b.start; });
+
+    this->byStart.ensureStorageAllocated(notes.size());
+    this->byEnd.ensureStorageAllocated(notes.size());
+
+    this->root = this->buildNode(notes);
+    this->built = true;
+}
+
+void NoteIntervalIndex::clear()
+{
+    this->nodes.clearQuick();
+    this->byStart.clearQuick();
+    this->byEnd.clearQuick();
+    this->root = -1;
+    this->built = false;
+}
+
+int NoteIntervalIndex::buildNode(const Array<Note> &notes)
+{
+    if (notes.isEmpty())
+    {
+        return -1;
+    }
+
+    // the median start is the center, so the median note itself
+    // (which has a non-zero length) always stays at this node
+    const double center = notes.getReference(notes.size() / 2).start;
+
+    Array<Note> left;
+    Array<Note> right;
+
+    const int begin = this->byStart.size();
+    for (const auto &note : notes)
+    {
+        if (note.end <= center)
+        {
+            left.add(note);
+        }
+        else if (note.start > center)
+        {
+            right.add(note);
+        }
+        else
+        {
+            // the input is sorted by start, so is this range
+            this->byStart.add(note);
+            this->byEnd.add(note);
+        }
+    }
+
+    const int end = this->byStart.size();
+    std::sort(this->byEnd.begin() + begin, this->byEnd.begin() + end,
+        [](const Note &a, const Note &b) { return a.end > b.end; });
+
+    const int nodeIndex = this->nodes.size();
+    this->nodes.add({ center, -1, -1, begin, end });
+
+    // don't keep the references to nodes here, the array may reallocate
+    const int leftIndex = this->buildNode(left);
+    const int rightIndex = this->buildNode(right);
+    this->nodes.getReference(nodeIndex).left = leftIndex;
+    this->nodes.getReference(nodeIndex).right = rightIndex;
+
+    return nodeIndex;
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class NoteIntervalIndexTests final : public UnitTest
+{
+public:
+
+    NoteIntervalIndexTests() :
+        UnitTest("Note interval index tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        beginTest("Finds the same notes as the linear scan");
+
+        Random random(42);
+        MidiMessageSequence sequence;
+        for (int i = 0; i < 2000; ++i)
+        {
+            const double start = double(random.nextInt(1000)) / 4.0;
+            const double length = double(random.nextInt(32)) / 8.0; // some are zero-length
+            const int key = random.nextInt(128);
+            sequence.addEvent(MidiMessage::noteOn(1, key, 0.5f).withTimeStamp(start));
+            sequence.addEvent(MidiMessage::noteOff(1, key).withTimeStamp(start + length));
+        }
+
+        sequence.updateMatchedPairs();
+
+        NoteIntervalIndex index;
+        index.build(sequence);
+        expect(index.isBuilt());
+
+        for (int i = 0; i < 500; ++i)
+        {
+            // probe at exact note boundaries as well
+            const double time = (i % 2 == 0) ?
+                double(random.nextInt(1100)) / 4.0 :
+                random.nextDouble() * 260.0;
+
+            Array<const MidiMessage *> expected;
+            for (int j = 0; j < sequence.getNumEvents(); ++j)
+            {
+                const auto *holder = sequence.getEventPointer(j);
+                if (holder->noteOffObject != nullptr &&
+                    holder->message.getTimeStamp() <= time &&
+                    holder->noteOffObject->message.getTimeStamp() > time)
+                {
+                    expected.add(&holder->message);
+                }
+            }
+
+            Array<const MidiMessage *> found;
+            index.findNotesAt(time, [&found](const MidiMessage &message)
+            {
+                found.add(&message);
+            });
+
+            expectEquals(found.size(), expected.size());
+
+            for (const auto *message : expected)
+            {
+                expect(found.contains(message));
+            }
+        }
+
+        beginTest("Empty sequence");
+
+        MidiMessageSequence emptySequence;
+        NoteIntervalIndex emptyIndex;
+        emptyIndex.build(emptySequence);
+        expect(emptyIndex.isBuilt());
+
+        int numFound = 0;
+        emptyIndex.findNotesAt(0.0, [&numFound](const MidiMessage &) { numFound++; });
+        expectEquals(numFound, 0);
+    }
+};
+
+static NoteIntervalIndexTests noteIntervalIndexTests;
+
+#endif
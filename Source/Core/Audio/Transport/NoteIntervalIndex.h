@@ -0,0 +1,121 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A centered interval tree over the matched note-on/note-off pairs
+// of a cached sequence, which answers "what is sounding at time t"
+// in O(log n + k), so that scrubbing doesn't depend on the project size.
+
+// It is built once from the sequence, and is never updated:
+// the playback cache is rebuilt from scratch after any changes anyway.
+
+class NoteIntervalIndex final
+{
+public:
+
+    NoteIntervalIndex() = default;
+
+    // Expects the sequence to have its note pairs matched
+    void build(const MidiMessageSequence &sequence);
+    void clear();
+
+    inline bool isBuilt() const noexcept
+    {
+        return this->built;
+    }
+
+    // Calls back with the note-on message of each note sounding at
+    // the given time, i.e. started at or before it and not stopped yet
+    template <typename Callback>
+    void findNotesAt(double time, Callback &&callback) const
+    {
+        int nodeIndex = this->root;
+        while (nodeIndex >= 0)
+        {
+            const auto &node = this->nodes.getReference(nodeIndex);
+
+            if (time < node.center)
+            {
+                // all intervals at the node end after the center,
+                // so only the start matters, and they are sorted by start
+                for (int i = node.begin; i < node.end; ++i)
+                {
+                    const auto &note = this->byStart.getReference(i);
+                    if (note.start > time) { break; }
+                    callback(note.noteOn->message);
+                }
+
+                nodeIndex = node.left;
+            }
+            else if (time > node.center)
+            {
+                // all intervals at the node start before the center,
+                // so only the end matters, and they are sorted by end descending
+                for (int i = node.begin; i < node.end; ++i)
+                {
+                    const auto &note = this->byEnd.getReference(i);
+                    if (note.end <= time) { break; }
+                    callback(note.noteOn->message);
+                }
+
+                nodeIndex = node.right;
+            }
+            else
+            {
+                for (int i = node.begin; i < node.end; ++i)
+                {
+                    callback(this->byStart.getReference(i).noteOn->message);
+                }
+
+                break;
+            }
+        }
+    }
+
+private:
+
+    struct Note final
+    {
+        double start;
+        double end;
+        const MidiMessageSequence::MidiEventHolder *noteOn;
+    };
+
+    struct Node final
+    {
+        double center;
+        int left;
+        int right;
+        // the range of the notes containing the center,
+        // both in byStart and in byEnd arrays
+        int begin;
+        int end;
+    };
+
+    // Takes the notes sorted by start, returns the node index or -1
+    int buildNode(const Array<Note> &notes);
+
+    Array<Node> nodes;
+    Array<Note> byStart;
+    Array<Note> byEnd;
+
+    int root = -1;
+    bool built = false;
+
+    JUCE_DECLARE_NON_COPYABLE(NoteIntervalIndex)
+};
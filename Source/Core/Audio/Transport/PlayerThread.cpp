@@ -20,6 +20,7 @@
 #include "PlayerThread.h"
 #include "Instrument.h"
 #include "MidiSequence.h"
+#include "RealtimeMode.h"
 
 #define MINIMUM_STOP_CHECK_TIME_MS 1000
 
@@ -48,6 +49,8 @@ void PlayerThread::startPlayback(double start, double end,
 
 void PlayerThread::run()
 {
+    RealtimeMode::promotePlayerThread();
+
     auto &sequences = this->transport.getPlaybackCache();
     Array<Instrument *> uniqueInstruments(sequences.getUniqueInstruments());
     
@@ -77,16 +80,8 @@ void PlayerThread::run()
         this->transport.broadcastSeek(prevTimeStamp / totalTime, currentTimeMs, totalTimeMs);
     }
 
-    // This hack is here to keep track of still playing events
-    // to be able to send noteOff's when playback interrupts.
-    struct HoldingNote final
-    {
-        int key;
-        int channel;
-        MidiMessageCollector *listener;
-    };
-    // (some plugins just don't understand allNotesOff message)
-    Array<HoldingNote> holdingNotes;
+    // Notes still sounding at each listener, see SoundingNotes:
+    FlatHashMap<MidiMessageCollector *, SoundingNotes> soundingNotes;
     
     // Some shorthands:
     auto sendMidiStart = [&uniqueInstruments]()
@@ -99,15 +94,19 @@ void PlayerThread::run()
         }
     };
 
-    auto sendHoldingNotesOffAndMidiStop = [&holdingNotes, &uniqueInstruments]()
+    auto sendHoldingNotesOff = [&soundingNotes]()
     {
-        for (const auto &holding : holdingNotes)
+        const double timeStamp = Time::getMillisecondCounterHiRes() * 0.001;
+        for (auto it = soundingNotes.begin(); it != soundingNotes.end(); ++it)
         {
-            MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
-            noteOff.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
-            holding.listener->addMessageToQueue(noteOff);
+            it.value().sendNoteOffs(*it->first, timeStamp);
         }
-        
+    };
+
+    auto sendHoldingNotesOffAndMidiStop = [&sendHoldingNotesOff, &uniqueInstruments]()
+    {
+        sendHoldingNotesOff();
+
         MidiMessage stopPlayback(MidiMessage::midiStop());
         stopPlayback.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
         
@@ -157,6 +156,7 @@ void PlayerThread::run()
 
             if (this->loopedMode)
             {
+                sendHoldingNotesOff();
                 sequences.seekToTime(startPositionInTime);
                 prevTimeStamp = startPositionInTime;
                 if (this->broadcastMode)
@@ -221,6 +221,8 @@ void PlayerThread::run()
         
         if (shouldRewind)
         {
+            // notes crossing the loop end would never get their note-offs
+            sendHoldingNotesOff();
             sequences.seekToTime(startPositionInTime);
             prevTimeStamp = startPositionInTime;
             if (this->broadcastMode)
@@ -250,28 +252,295 @@ void PlayerThread::run()
             else
             {
                 wrapper.listener->addMessageToQueue(wrapper.message);
+
+#if JUCE_UNIT_TESTS
+                if (this->probe != nullptr)
+                {
+                    this->probe->onMessageSent(wrapper.message);
+                }
+#endif
             }
             
             if (wrapper.message.isNoteOn())
             {
-                holdingNotes.add({ key, channel, wrapper.listener });
+                soundingNotes[wrapper.listener].noteOn(channel, key);
             }
-            
-            if (wrapper.message.isNoteOff())
+            else if (wrapper.message.isNoteOff())
             {
-                for (int i = 0; i < holdingNotes.size(); ++i)
-                {
-                    if (holdingNotes[i].key == key &&
-                        holdingNotes[i].channel == channel &&
-                        holdingNotes[i].listener == wrapper.listener)
-                    {
-                        holdingNotes.remove(i);
-                        break;
-                    }
-                }
+                soundingNotes[wrapper.listener].noteOff(channel, key);
             }
         }
     }
     
     jassertfalse;
 }
+
+void PlayerThread::SoundingNotes::sendNoteOffs(MidiMessageCollector &listener, double timeStamp)
+{
+    for (int i = 0; i < numElementsInArray(this->bits); ++i)
+    {
+        auto word = this->bits[i];
+        this->bits[i] = 0;
+
+        for (int bit = 0; word != 0; ++bit, word >>= 1)
+        {
+            if ((word & 1) != 0)
+            {
+                const int index = i * 64 + bit;
+                MidiMessage noteOff(MidiMessage::noteOff(index / 128 + 1, index % 128, 0.f));
+                noteOff.setTimeStamp(timeStamp);
+                listener.addMessageToQueue(noteOff);
+            }
+        }
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#include "AudioCore.h"
+
+// Timing tests run in real time on whatever machine, so the jitter
+// is only reported, and what's checked is that all events are delivered
+
+class PlaybackJitterTests final : public UnitTest
+{
+public:
+
+    PlaybackJitterTests() : UnitTest("Playback timing jitter tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        HeadlessOrchestra orchestra;
+        HeadlessSleepTimer sleepTimer;
+        Transport transport(orchestra, sleepTimer);
+
+        beginTest("Dense chords");
+
+        MidiMessageSequence chords;
+        addTempo(chords, 0.0, 120.0);
+        for (int i = 0; i < 8; ++i)
+        {
+            for (int key = 48; key < 72; key += 4)
+            {
+                addNote(chords, key, i * 0.5, 0.5);
+            }
+        }
+
+        testPlayback(transport, orchestra, chords);
+
+        beginTest("32nd notes runs");
+
+        MidiMessageSequence runs;
+        addTempo(runs, 0.0, 120.0);
+        for (int i = 0; i < 32; ++i)
+        {
+            addNote(runs, 60 + (i % 12), i * 0.125, 0.125);
+        }
+
+        testPlayback(transport, orchestra, runs);
+
+        beginTest("Tempo ramps");
+
+        MidiMessageSequence ramps;
+        for (int beat = 0; beat < 8; ++beat)
+        {
+            addTempo(ramps, beat, 120.0 + beat * 15.0);
+        }
+        for (int i = 0; i < 32; ++i)
+        {
+            addNote(ramps, 60 + (i % 7), i * 0.25, 0.25);
+        }
+
+        testPlayback(transport, orchestra, ramps);
+    }
+
+private:
+
+    // Records the actual delivery time of every message,
+    // which is stamped by the player right before sending it
+    class PlaybackProbe final : public PlayerThread::Probe
+    {
+    public:
+
+        void onMessageSent(const MidiMessage &message) override
+        {
+            const SpinLock::ScopedLockType lock(this->deliveredLock);
+            this->delivered.add(message);
+        }
+
+        Array<MidiMessage> getDeliveredMessages() const
+        {
+            const SpinLock::ScopedLockType lock(this->deliveredLock);
+            return this->delivered;
+        }
+
+    private:
+
+        SpinLock deliveredLock;
+        Array<MidiMessage> delivered;
+    };
+
+    class HeadlessOrchestra final : public OrchestraPit
+    {
+    public:
+
+        HeadlessOrchestra()
+        {
+            this->instrument = makeUnique<Instrument>(this->formatManager, "Headless");
+            // there's no audio device to call reset() for us:
+            this->instrument->getProcessorPlayer().getMidiMessageCollector().reset(44100.0);
+        }
+
+        Array<Instrument *> getInstruments() const override
+        {
+            return { this->instrument.get() };
+        }
+
+        Instrument *findInstrumentById(const String &id) const override
+        {
+            return this->instrument.get();
+        }
+
+    private:
+
+        AudioPluginFormatManager formatManager;
+        UniquePointer<Instrument> instrument;
+    };
+
+    class HeadlessSleepTimer final : public SleepTimer
+    {
+    protected:
+        bool canSleepNow() override { return false; }
+        void sleepNow() override {}
+        void awakeNow() override {}
+    };
+
+    static void addTempo(MidiMessageSequence &sequence, double beat, double bpm)
+    {
+        MidiMessage tempo(MidiMessage::tempoMetaEvent(int(60000000.0 / bpm)));
+        tempo.setTimeStamp(beat);
+        sequence.addEvent(tempo);
+    }
+
+    static void addNote(MidiMessageSequence &sequence, int key, double beat, double length)
+    {
+        MidiMessage noteOn(MidiMessage::noteOn(1, key, 0.5f));
+        noteOn.setTimeStamp(beat);
+        sequence.addEvent(noteOn);
+
+        MidiMessage noteOff(MidiMessage::noteOff(1, key));
+        noteOff.setTimeStamp(beat + length);
+        sequence.addEvent(noteOff);
+    }
+
+    void testPlayback(Transport &transport, HeadlessOrchestra &orchestra,
+        const MidiMessageSequence &sequence)
+    {
+        MidiMessageCollector collector;
+        collector.reset(44100.0);
+
+        auto cached = CachedMidiSequence::createFrom(orchestra.getInstruments().getFirst());
+        cached->midiMessages = sequence;
+        cached->listener = &collector;
+
+        transport.getPlaybackCache().clear();
+        transport.getPlaybackCache().addWrapper(cached);
+        transport.sequencesAreOutdated = false;
+        transport.setTotalTime(sequence.getEndTime());
+
+        // the expected delivery times, computed from the tempo map
+        // the same way the player does, i.e. the tempo changes
+        // are applied starting from the next event after them:
+        Array<double> expectedTimesMs;
+        double msPerQuarter = transport.findFirstTempoEvent().getTempoSecondsPerQuarterNote() * 1000.0;
+        double expectedTimeMs = 0.0;
+        double prevBeat = 0.0;
+        for (int i = 0; i < sequence.getNumEvents(); ++i)
+        {
+            const auto &message = sequence.getEventPointer(i)->message;
+            expectedTimeMs += msPerQuarter * (message.getTimeStamp() - prevBeat);
+            prevBeat = message.getTimeStamp();
+
+            if (message.isTempoMetaEvent())
+            {
+                msPerQuarter = message.getTempoSecondsPerQuarterNote() * 1000.0;
+            }
+            else
+            {
+                expectedTimesMs.add(expectedTimeMs);
+            }
+        }
+
+        PlaybackProbe probe;
+        PlayerThread player(transport);
+        player.setProbe(&probe);
+        player.startPlayback(0.0, 1.0, false, false);
+        const int timeoutMs = int(expectedTimeMs) + 5000;
+        expect(player.waitForThreadToExit(timeoutMs), "Playback has not finished in time");
+
+        const auto delivered = probe.getDeliveredMessages();
+        expectEquals(delivered.size(), expectedTimesMs.size(), "Some events were not delivered");
+        if (delivered.size() != expectedTimesMs.size() || delivered.isEmpty())
+        {
+            return;
+        }
+
+        // the first delivered event is the reference point:
+        const double startTimeMs = delivered.getFirst().getTimeStamp() * 1000.0;
+
+        Array<double> absoluteJitter;
+        Array<double> stepJitter;
+        for (int i = 0; i < delivered.size(); ++i)
+        {
+            const double actualTimeMs = delivered.getReference(i).getTimeStamp() * 1000.0 - startTimeMs;
+            absoluteJitter.add(std::abs(actualTimeMs - expectedTimesMs.getUnchecked(i)));
+
+            if (i > 0)
+            {
+                const double actualDeltaMs = actualTimeMs -
+                    (delivered.getReference(i - 1).getTimeStamp() * 1000.0 - startTimeMs);
+                const double expectedDeltaMs = expectedTimesMs.getUnchecked(i) -
+                    expectedTimesMs.getUnchecked(i - 1);
+                stepJitter.add(std::abs(actualDeltaMs - expectedDeltaMs));
+            }
+        }
+
+        logMessage(formatStats("Absolute jitter", absoluteJitter));
+        logMessage(formatStats("Step jitter", stepJitter));
+    }
+
+    static double getPercentile(Array<double> values, double percentile)
+    {
+        if (values.isEmpty())
+        {
+            return 0.0;
+        }
+
+        values.sort();
+        const int index = jlimit(0, values.size() - 1,
+            int(std::ceil(percentile * values.size())) - 1);
+        return values.getUnchecked(index);
+    }
+
+    static String formatStats(const String &name, const Array<double> &values)
+    {
+        double sum = 0.0;
+        for (const auto value : values)
+        {
+            sum += value;
+        }
+
+        const double mean = values.isEmpty() ? 0.0 : sum / values.size();
+        return name + ", ms: mean " + String(mean, 3) +
+            ", p99 " + String(getPercentile(values, 0.99), 3) +
+            ", max " + String(getPercentile(values, 1.0), 3);
+    }
+};
+
+static PlaybackJitterTests playbackJitterTests;
+
+#endif
@@ -29,10 +29,70 @@ public:
     void startPlayback(double start, double end, bool shouldLoop,
         bool shouldBroadcastTransportEvents = true);
 
+#if JUCE_UNIT_TESTS
+
+    // Lets the timing tests see each message right after it's sent;
+    // should be set before the playback starts
+    class Probe
+    {
+    public:
+        virtual ~Probe() = default;
+        virtual void onMessageSent(const MidiMessage &message) = 0;
+    };
+
+    void setProbe(Probe *newProbe) noexcept
+    {
+        this->probe = newProbe;
+    }
+
+#endif
+
 private:
 
     void run() override;
 
+    // Keeps track of the notes still sounding at one instrument,
+    // to be able to send note-offs when playback interrupts
+    // (some plugins just don't understand allNotesOff message);
+    // one bit per each channel and key, so updates are O(1):
+    class SoundingNotes final
+    {
+    public:
+
+        inline void noteOn(int channel, int key) noexcept
+        {
+            const int index = getIndex(channel, key);
+            if (index >= 0)
+            {
+                this->bits[index / 64] |= (uint64(1) << (index % 64));
+            }
+        }
+
+        inline void noteOff(int channel, int key) noexcept
+        {
+            const int index = getIndex(channel, key);
+            if (index >= 0)
+            {
+                this->bits[index / 64] &= ~(uint64(1) << (index % 64));
+            }
+        }
+
+        // Sends note-offs only for the keys that are still on, and forgets them
+        void sendNoteOffs(MidiMessageCollector &listener, double timeStamp);
+
+    private:
+
+        // channels are 1-based, as in MidiMessage
+        static inline int getIndex(int channel, int key) noexcept
+        {
+            return (isPositiveAndBelow(channel - 1, 16) && isPositiveAndBelow(key, 128)) ?
+                ((channel - 1) * 128 + key) : -1;
+        }
+
+        uint64 bits[16 * 128 / 64] = {};
+
+    };
+
     Transport &transport;
 
     bool broadcastMode = false;
@@ -41,5 +101,9 @@ private:
     double absStartPosition = 0.0;
     double absEndPosition = 1.0;
 
+#if JUCE_UNIT_TESTS
+    Probe *probe = nullptr;
+#endif
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlayerThread)
 };
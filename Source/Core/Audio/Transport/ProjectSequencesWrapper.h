@@ -18,6 +18,8 @@
 #pragma once
 
 #include "Instrument.h"
+#include "RealtimeMode.h"
+#include "NoteIntervalIndex.h"
 
 class MidiSequence;
 
@@ -29,6 +31,9 @@ struct CachedMidiSequence final : public ReferenceCountedObject
     Instrument *instrument;
     const MidiSequence *track;
 
+    // Built lazily on the first probeSoundAt, not needed for the playback
+    NoteIntervalIndex notesIndex;
+
     using Ptr = ReferenceCountedObjectPtr<CachedMidiSequence>;
 
     static Ptr createFrom(Instrument *instrument, const MidiSequence *track = nullptr)
@@ -157,6 +162,22 @@ public:
         }
     }
     
+    // Makes sure the whole cache is resident before the playback starts,
+    // so that the realtime player thread doesn't hit page faults
+    void prefault() const
+    {
+        const SpinLock::ScopedLockType lock(this->sequencesLock);
+
+        for (const auto *wrapper : this->sequences)
+        {
+            for (int i = 0; i < wrapper->midiMessages.getNumEvents(); ++i)
+            {
+                RealtimeMode::prefault(wrapper->midiMessages.getEventPointer(i),
+                    sizeof(MidiMessageSequence::MidiEventHolder));
+            }
+        }
+    }
+
     void seekToZeroIndexes()
     {
         const SpinLock::ScopedLockType lock(this->sequencesLock);
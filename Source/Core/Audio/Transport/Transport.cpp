@@ -25,6 +25,7 @@
 #include "MidiTrack.h"
 #include "Clip.h"
 #include "Pattern.h"
+#include "ProjectChangeSet.h"
 #include "Workspace.h"
 #include "AudioCore.h"
 #include "HybridRoll.h"
@@ -148,23 +149,18 @@ void Transport::probeSoundAt(double absTrackPosition, const MidiSequence *limitT
     
     for (const auto &seq : sequencesToProbe)
     {
-        for (int j = 0; j < seq->midiMessages.getNumEvents(); ++j)
+        if (!seq->notesIndex.isBuilt())
         {
-            auto *noteOnHolder = seq->midiMessages.getEventPointer(j);
-            
-            if (auto *noteOffHolder = noteOnHolder->noteOffObject)
-            {
-                const double noteOn(noteOnHolder->message.getTimeStamp());
-                const double noteOff(noteOffHolder->message.getTimeStamp());
-                
-                if (noteOn <= targetFlatTime && noteOff > targetFlatTime)
-                {
-                    MidiMessage messageTimestampedAsNow(noteOnHolder->message);
-                    messageTimestampedAsNow.setTimeStamp(TIME_NOW);
-                    seq->listener->addMessageToQueue(messageTimestampedAsNow);
-                }
-            }
+            seq->notesIndex.build(seq->midiMessages);
         }
+
+        auto *listener = seq->listener;
+        seq->notesIndex.findNotesAt(targetFlatTime, [listener](const MidiMessage &noteOn)
+        {
+            MidiMessage messageTimestampedAsNow(noteOn);
+            messageTimestampedAsNow.setTimeStamp(TIME_NOW);
+            listener->addMessageToQueue(messageTimestampedAsNow);
+        });
     }
 
     this->sleepTimer.setCanSleepAfter(SOUND_SLEEP_DELAY_MS);
@@ -341,12 +337,23 @@ void Transport::previewMidiMessage(const String &trackId, const MidiMessage &mes
     this->sleepTimer.setCanSleepAfter(SOUND_SLEEP_DELAY_MS);
 }
 
+// The fallback panic: the player thread sends note-offs for the notes
+// it knows are sounding, but the imported tracks may use any channels,
+// and previews and plugins may leave something hanging anyway
+static void sendPanicToCollector(MidiMessageCollector &collector)
+{
+    const double timeStamp = TIME_NOW;
+    for (int c = 1; c <= 16; ++c)
+    {
+        collector.addMessageToQueue(MidiMessage::allNotesOff(c).withTimeStamp(timeStamp));
+        collector.addMessageToQueue(MidiMessage::allControllersOff(c).withTimeStamp(timeStamp));
+        collector.addMessageToQueue(MidiMessage::allSoundOff(c).withTimeStamp(timeStamp));
+    }
+}
+
 static void stopSoundForInstrument(Instrument *instrument)
 {
-    auto &collector = instrument->getProcessorPlayer().getMidiMessageCollector();
-    collector.addMessageToQueue(MidiMessage::allControllersOff(1).withTimeStamp(TIME_NOW));
-    collector.addMessageToQueue(MidiMessage::allNotesOff(1).withTimeStamp(TIME_NOW));
-    collector.addMessageToQueue(MidiMessage::allSoundOff(1).withTimeStamp(TIME_NOW));
+    sendPanicToCollector(instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
 void Transport::stopSound(const String &trackId) const
@@ -377,27 +384,17 @@ void Transport::allNotesControllersAndSoundOff() const
     this->sleepTimer.setAwake();
     this->messagePreviewQueue.cancelPendingPreview();
 
-    static const int c = 1;
-    //for (int c = 1; c <= 16; ++c)
+    Array<MidiMessageCollector *> duplicateCollectors;
+
+    for (int l = 0; l < this->tracksCache.size(); ++l)
     {
-        const MidiMessage notesOff(MidiMessage::allNotesOff(c).withTimeStamp(TIME_NOW));
-        const MidiMessage soundOff(MidiMessage::allSoundOff(c).withTimeStamp(TIME_NOW));
-        const MidiMessage controllersOff(MidiMessage::allControllersOff(c).withTimeStamp(TIME_NOW));
-        
-        Array<const MidiMessageCollector *> duplicateCollectors;
-        
-        for (int l = 0; l < this->tracksCache.size(); ++l)
+        const auto &trackId = this->tracksCache.getUnchecked(l)->getTrackId();
+        auto *collector = &this->linksCache[trackId]->getProcessorPlayer().getMidiMessageCollector();
+
+        if (! duplicateCollectors.contains(collector))
         {
-            const auto &trackId = this->tracksCache.getUnchecked(l)->getTrackId();
-            auto *collector = &this->linksCache[trackId]->getProcessorPlayer().getMidiMessageCollector();
-            
-            if (! duplicateCollectors.contains(collector))
-            {
-                collector->addMessageToQueue(notesOff);
-                collector->addMessageToQueue(controllersOff);
-                collector->addMessageToQueue(soundOff);
-                duplicateCollectors.add(collector);
-            }
+            sendPanicToCollector(*collector);
+            duplicateCollectors.add(collector);
         }
     }
 
@@ -443,59 +440,96 @@ void Transport::instrumentRemovedPostAction()
 // ProjectListener
 //===----------------------------------------------------------------------===//
 
-// FIXME: need to do something more reasonable than this workaround:
-#define updateLengthAndTimeIfNeeded(event) \
-    if (event->getTrackControllerNumber() == MidiTrack::tempoController) \
-    { \
-        this->seekToPosition(this->getSeekPosition()); \
-    }
+// The per-event callbacks invalidate the playback cache right away,
+// and re-seeking after the tempo track changes is done once per change set:
 
-void Transport::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+void Transport::invalidatePlaybackCache()
 {
-    // todo stop playback only if the event is in future
-    // and getTrackControllerNumber == 0 (not an automation)
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&newEvent));
     this->sequencesAreOutdated = true;
+
+    // the player keeps playing the outdated cache until stopped,
+    // so it may send the note-ons of the events already changed or removed,
+    // whose note-offs won't come; and waiting for the change set to be
+    // committed would mean waiting for the next message loop tick,
+    // so the playback is stopped here, which is a no-op when not playing
+    this->stopPlayback();
+}
+
+void Transport::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+{
+    this->invalidatePlaybackCache();
 }
 
 void Transport::onAddMidiEvent(const MidiEvent &event)
 {
-    // todo stop playback only if the event is in future
-    // and getTrackControllerNumber == 0 (not an automation)
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&event));
-    this->sequencesAreOutdated = true;
+    this->invalidatePlaybackCache();
 }
 
 void Transport::onRemoveMidiEvent(const MidiEvent &event) {}
 void Transport::onPostRemoveMidiEvent(MidiSequence *const sequence)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded(sequence->getTrack());
-    this->sequencesAreOutdated = true;
+    this->invalidatePlaybackCache();
+}
+
+void Transport::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    this->invalidatePlaybackCache();
+}
+
+void Transport::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    this->invalidatePlaybackCache();
 }
 
+void Transport::onRemoveMidiEvents(const Array<const MidiEvent *> &events) {}
+
 void Transport::onAddClip(const Clip &clip)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&clip));
-    this->sequencesAreOutdated = true;
+    this->invalidatePlaybackCache();
 }
 
 void Transport::onChangeClip(const Clip &oldClip, const Clip &newClip)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded((&newClip));
-    this->sequencesAreOutdated = true;
+    this->invalidatePlaybackCache();
 }
 
 void Transport::onRemoveClip(const Clip &clip) {}
 void Transport::onPostRemoveClip(Pattern *const pattern)
 {
-    this->stopPlayback();
-    updateLengthAndTimeIfNeeded(pattern->getTrack());
-    this->sequencesAreOutdated = true;
+    this->invalidatePlaybackCache();
+}
+
+void Transport::onCommitChangeSet(const ProjectChangeSet &changes)
+{
+    bool hasTempoChanges = false;
+
+    for (const auto &it : changes.getTrackChanges())
+    {
+        const auto &trackChanges = it.second;
+        if (trackChanges.events.isEmpty() && trackChanges.clips.isEmpty())
+        {
+            continue; // only the properties changed, see onChangeTrackProperties
+        }
+
+        if (it.first->getTrackControllerNumber() == MidiTrack::tempoController)
+        {
+            hasTempoChanges = true;
+            break;
+        }
+    }
+
+    // the playback is already stopped by the per-event callbacks,
+    // but the tempo track changes also affect the total length and the time;
+    // group edits, pastes, undo/redo and checkouts commit their change sets
+    // synchronously, and outside of those, it's fine to re-seek on the next
+    // message loop tick: it only updates the displayed time and length,
+    // while starting the playback or seeking before that re-caches
+    // the sequences anyway, since they are marked as outdated
+    if (hasTempoChanges)
+    {
+        this->seekToPosition(this->getSeekPosition());
+    }
 }
 
 void Transport::onChangeTrackProperties(MidiTrack *const track)
@@ -512,16 +546,30 @@ void Transport::onChangeTrackProperties(MidiTrack *const track)
 }
 
 void Transport::onReloadProjectContent(const Array<MidiTrack *> &tracks)
+{
+    // no version to compare to, so all links are looked up again
+    this->onReloadProjectContent(tracks, 0);
+}
+
+void Transport::onReloadProjectContent(const Array<MidiTrack *> &tracks, uint32 tracksVersion)
 {
     this->sequencesAreOutdated = true;
 
     this->tracksCache.clearQuick();
-    this->linksCache.clear();
-
     this->tracksCache.addArray(tracks);
-    for (const auto &track : tracks)
+
+    // most reloads keep the tracks and their instruments (e.g. the checkouts
+    // which only change the notes), and then the registry's version is the same,
+    // since any added, removed or re-linked track bumps it:
+    if (tracksVersion == 0 || tracksVersion != this->linksCacheTracksVersion)
     {
-        this->updateLinkForTrack(track);
+        this->linksCache.clear();
+        for (const auto &track : tracks)
+        {
+            this->updateLinkForTrack(track);
+        }
+
+        this->linksCacheTracksVersion = tracksVersion;
     }
 
     this->stopPlayback();
@@ -686,6 +734,11 @@ void Transport::recacheIfNeeded()
 
             this->playbackCache.addWrapper(cached);
         }
+
+        if (RealtimeMode::isEnabled())
+        {
+            this->playbackCache.prefault();
+        }
         
         this->sequencesAreOutdated = false;
     }
@@ -103,6 +103,11 @@ public:
     void onRemoveMidiEvent(const MidiEvent &event) override;
     void onPostRemoveMidiEvent(MidiSequence *const layer) override;
 
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
     void onAddClip(const Clip &clip) override;
     void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
     void onRemoveClip(const Clip &clip) override;
@@ -115,6 +120,11 @@ public:
     void onChangeProjectBeatRange(float firstBeat, float lastBeat) override;
     void onChangeViewBeatRange(float firstBeat, float lastBeat) override {}
     void onReloadProjectContent(const Array<MidiTrack *> &tracks) override;
+    void onCommitChangeSet(const ProjectChangeSet &changes) override;
+
+    // Called by the project instead of the above, see TracksRegistry:
+    // the links are only looked up again if the tracks have changed
+    void onReloadProjectContent(const Array<MidiTrack *> &tracks, uint32 tracksVersion);
 
     //===------------------------------------------------------------------===//
     // Listeners management
@@ -154,10 +164,15 @@ private:
     friend class RendererThread;
     friend class PlayerThread;
 
+#if JUCE_UNIT_TESTS
+    friend class PlaybackJitterTests;
+#endif
+
 private:
 
     ProjectSequences &getPlaybackCache();
     void recacheIfNeeded();
+    void invalidatePlaybackCache();
     
     SpinLock sequencesLock;
     ProjectSequences playbackCache;
@@ -166,6 +181,8 @@ private:
     // linksCache is <track id : instrument>
     mutable Array<const MidiTrack *> tracksCache;
     mutable FlatHashMap<String, WeakReference<Instrument>, StringHash> linksCache;
+    // the version of the project's tracks the links were built for
+    uint32 linksCacheTracksVersion = 0;
 
     void updateLinkForTrack(const MidiTrack *track);
     void removeLinkForTrack(const MidiTrack *track);
@@ -0,0 +1,232 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "IdGenerator.h"
+
+#define ID_NUM_DIGITS 62
+
+// Longer ids wouldn't fit into 64 bits in all cases;
+// collisions among 10-character ids are next to impossible anyway
+#define ID_MAX_GENERATED_CHARS 10
+
+static const char idChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+// Not something this app has ever generated, but still should be loaded
+// and saved back unchanged: such ids are hashed into the range beyond any
+// 10-character id, and their original strings are kept here to serialize
+// them back; ids are parsed and printed on the loading and saving threads
+struct ForeignIds final
+{
+    SpinLock lock;
+    FlatHashMap<uint64, String, IdHash> strings;
+};
+
+static ForeignIds &getForeignIds()
+{
+    static ForeignIds foreignIds;
+    return foreignIds;
+}
+
+static inline int getIdDigit(juce_wchar c) noexcept
+{
+    if (c >= '0' && c <= '9') { return int(c - '0'); }
+    if (c >= 'A' && c <= 'Z') { return int(c - 'A') + 10; }
+    if (c >= 'a' && c <= 'z') { return int(c - 'a') + 36; }
+    return -1;
+}
+
+IdGenerator::IdGenerator() noexcept :
+    state(uint64(Random::getSystemRandom().nextInt64()) ^
+        uint64(Time::getHighResolutionTicks())) {}
+
+uint64 IdGenerator::generate(int numChars) noexcept
+{
+    // splitmix64, fast and good enough for this purpose
+    this->state += 0x9e3779b97f4a7c15ULL;
+    uint64 random = this->state;
+    random = (random ^ (random >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    random = (random ^ (random >> 27)) * 0x94d049bb133111ebULL;
+    random = random ^ (random >> 31);
+
+    // in bijective base-62, all n-character numbers
+    // follow all the shorter ones, taking 62^n values:
+    numChars = jlimit(1, ID_MAX_GENERATED_CHARS, numChars);
+    uint64 offset = 0;
+    uint64 count = ID_NUM_DIGITS;
+    for (int i = 1; i < numChars; ++i)
+    {
+        offset += count;
+        count *= ID_NUM_DIGITS;
+    }
+
+    return offset + 1 + random % count;
+}
+
+String IdGenerator::toString(uint64 id)
+{
+    if (id == 0)
+    {
+        return {};
+    }
+
+    if ((id >> 63) != 0)
+    {
+        auto &foreignIds = getForeignIds();
+        const SpinLock::ScopedLockType lock(foreignIds.lock);
+        const auto found = foreignIds.strings.find(id);
+        if (found != foreignIds.strings.end())
+        {
+            return found->second;
+        }
+    }
+
+    char buffer[16];
+    int i = numElementsInArray(buffer) - 1;
+    buffer[i] = 0;
+
+    while (id > 0)
+    {
+        id -= 1;
+        buffer[--i] = idChars[id % ID_NUM_DIGITS];
+        id /= ID_NUM_DIGITS;
+    }
+
+    return String(buffer + i);
+}
+
+uint64 IdGenerator::fromString(const String &string)
+{
+    if (string.isEmpty())
+    {
+        return 0;
+    }
+
+    uint64 result = 0;
+    bool isValid = true;
+
+    for (auto ptr = string.getCharPointer(); !ptr.isEmpty(); ++ptr)
+    {
+        const int digit = getIdDigit(*ptr);
+        if (digit < 0 ||
+            result > (std::numeric_limits<uint64>::max() - uint64(digit + 1)) / ID_NUM_DIGITS)
+        {
+            isValid = false;
+            break;
+        }
+
+        result = result * ID_NUM_DIGITS + uint64(digit + 1);
+    }
+
+    if (isValid)
+    {
+        return result;
+    }
+
+    // see ForeignIds; the colliding hashes are probed linearly
+    auto &foreignIds = getForeignIds();
+    const SpinLock::ScopedLockType lock(foreignIds.lock);
+
+    auto id = uint64(string.hashCode64()) | (uint64(1) << 63);
+    while (true)
+    {
+        const auto found = foreignIds.strings.find(id);
+        if (found == foreignIds.strings.end())
+        {
+            foreignIds.strings[id] = string;
+            return id;
+        }
+
+        if (found->second == string)
+        {
+            return id;
+        }
+
+        id = (id + 1) | (uint64(1) << 63);
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class IdGeneratorTests final : public UnitTest
+{
+public:
+
+    IdGeneratorTests() : UnitTest("Id generator tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        beginTest("Legacy string ids round-trip");
+
+        // the ids generated by earlier versions
+        const StringArray legacyIds({ "0", "z", "00", "0A", "A", "zz", "Zq3", "zzzzzzzzzz" });
+        for (const auto &legacyId : legacyIds)
+        {
+            const auto id = IdGenerator::fromString(legacyId);
+            expect(id != 0);
+            expectEquals(IdGenerator::toString(id), legacyId);
+        }
+
+        expect(IdGenerator::fromString("0A") != IdGenerator::fromString("A"));
+
+        beginTest("Foreign string ids round-trip unchanged");
+
+        // not base-62, or too long to fit into 64 bits
+        const StringArray foreignIds({ "note-1", "_", "0A.1", "zzzzzzzzzzzzzzzzzzzz" });
+        for (const auto &foreignId : foreignIds)
+        {
+            const auto id = IdGenerator::fromString(foreignId);
+            expect(id != 0);
+            expectEquals(IdGenerator::fromString(foreignId), id);
+            expectEquals(IdGenerator::toString(id), foreignId);
+        }
+
+        expect(IdGenerator::fromString("note-1") != IdGenerator::fromString("note-2"));
+        expectEquals(IdGenerator::fromString({}), uint64(0));
+        expectEquals(IdGenerator::toString(0), String());
+
+        beginTest("Generated ids have the requested length");
+
+        IdGenerator generator;
+        for (int numChars = 1; numChars <= 10; ++numChars)
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                const auto id = generator.generate(numChars);
+                const auto idString = IdGenerator::toString(id);
+                expectEquals(idString.length(), numChars);
+                expectEquals(IdGenerator::fromString(idString), id);
+            }
+        }
+
+        beginTest("Large ids round-trip");
+
+        const uint64 largeIds[] = { std::numeric_limits<uint64>::max(), uint64(1) << 63 };
+        for (const auto id : largeIds)
+        {
+            expectEquals(IdGenerator::fromString(IdGenerator::toString(id)), id);
+        }
+    }
+};
+
+static IdGeneratorTests idGeneratorTests;
+
+#endif
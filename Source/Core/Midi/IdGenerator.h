@@ -0,0 +1,65 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Event and clip ids are 64-bit integers, unique within a sequence or
+// a pattern, and zero is never a valid id. In the serialized data, ids are
+// written as short alphanumeric strings, exactly the ones that earlier
+// versions used as the ids themselves (bijective base-62 numbers), so that
+// the existing projects and version control histories load transparently.
+
+// Random ids, and not counters, are here because of version control:
+// two users adding notes to the same track in different branches should
+// not end up with the same ids when merging their changes.
+
+class IdGenerator final
+{
+public:
+
+    IdGenerator() noexcept;
+
+    // A random id, which takes the given number of characters when serialized
+    // (the caller grows the length in case of collisions)
+    uint64 generate(int numChars) noexcept;
+
+    static String toString(uint64 id);
+    // The strings which are not base-62 numbers, or don't fit into 64 bits,
+    // are still mapped to unique ids, which are serialized back unchanged
+    static uint64 fromString(const String &string);
+
+private:
+
+    uint64 state;
+
+    JUCE_DECLARE_NON_COPYABLE(IdGenerator)
+};
+
+struct IdHash
+{
+    // The murmur3 finalizer, because the ids are often
+    // too close to each other for the identity hash
+    inline HashCode operator()(uint64 id) const noexcept
+    {
+        id ^= id >> 33;
+        id *= 0xff51afd7ed558ccdULL;
+        id ^= id >> 33;
+        id *= 0xc4ceb9fe1a85ec53ULL;
+        id ^= id >> 33;
+        return static_cast<HashCode>(id);
+    }
+};
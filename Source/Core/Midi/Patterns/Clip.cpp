@@ -69,7 +69,7 @@ float Clip::getVelocity() const noexcept
     return this->velocity;
 }
 
-const String &Clip::getId() const noexcept
+Clip::Id Clip::getId() const noexcept
 {
     return this->id;
 }
@@ -81,7 +81,7 @@ const String &Clip::getKeyString() const noexcept
 
 bool Clip::isValid() const noexcept
 {
-    return this->pattern != nullptr && this->id.isNotEmpty();
+    return this->pattern != nullptr && this->id != 0;
 }
 
 bool Clip::isMuted() const noexcept
@@ -210,7 +210,7 @@ SerializedData Clip::serialize() const
     tree.setProperty(Midi::key, this->key);
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
     tree.setProperty(Midi::volume, int(this->velocity * VELOCITY_SAVE_ACCURACY));
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
 
     if (this->mute)
     {
@@ -230,7 +230,7 @@ void Clip::deserialize(const SerializedData &data)
     using namespace Serialization;
     this->key = data.getProperty(Midi::key, 0);
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
-    this->id = data.getProperty(Midi::id, this->id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id, IdGenerator::toString(this->id)));
     const auto vol = float(data.getProperty(Midi::volume, VELOCITY_SAVE_ACCURACY)) / VELOCITY_SAVE_ACCURACY;
     this->velocity = jmax(jmin(vol, 1.f), 0.f);
     this->mute = bool(data.getProperty(Midi::mute, 0));
@@ -258,7 +258,7 @@ int Clip::compareElements(const Clip &first, const Clip &second)
     const int diffResult = (diff > 0.f) - (diff < 0.f);
     if (diffResult != 0) { return diffResult; }
 
-    return first.id.compare(second.id);
+    return (first.id > second.id) - (first.id < second.id);
 }
 
 int Clip::compareElements(const Clip *const first, const Clip *const second)
@@ -284,7 +284,7 @@ Clip::Id Clip::createId() const noexcept
         return this->pattern->createUniqueClipId();
     }
 
-    return {};
+    return 0;
 }
 
 void Clip::updateCaches() const
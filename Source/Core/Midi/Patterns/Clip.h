@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "IdGenerator.h"
+
 class Pattern;
 
 // Just an instance of a midi sequence on a certain position,
@@ -28,7 +30,7 @@ class Clip final : public Serializable
 {
 public:
 
-    using Id = String;
+    using Id = uint64;
 
     Clip();
     Clip(WeakReference<Pattern> owner, const Clip &parametersToCopy);
@@ -44,7 +46,7 @@ public:
     int getKey() const noexcept;
     float getBeat() const noexcept;
     float getVelocity() const noexcept;
-    const String &getId() const noexcept;
+    Id getId() const noexcept;
     const String &getKeyString() const noexcept;
     
     bool isMuted() const noexcept;
@@ -101,13 +103,14 @@ private:
     bool mute = false;
     bool solo = false;
 
-    String id;
+    Id id = 0;
     Id createId() const noexcept;
 
     mutable String keyString;
     void updateCaches() const;
 
     friend struct ClipHash;
+    friend class Pattern;
 
     JUCE_LEAK_DETECTOR(Clip);
 };
@@ -116,9 +119,6 @@ struct ClipHash
 {
     inline HashCode operator()(const Clip &key) const noexcept
     {
-        // Note: see the comment for MidiEventHash in MidiEvent.h
-        const auto *ptr = key.id.getCharPointer().getAddress();
-        return 64 * static_cast<HashCode>(ptr[0]) + static_cast<HashCode>(ptr[1]);
-        //return static_cast<HashCode>(key.beat) + static_cast<HashCode>(key.getId().hashCode());
+        return IdHash{}(key.id);
     }
 };
@@ -24,22 +24,6 @@
 #include "SerializationKeys.h"
 #include "MidiTrack.h"
 
-struct ClipIdGenerator final
-{
-    static String generateId(uint8 length = 2)
-    {
-        String id;
-        static Random r;
-        r.setSeedRandomly();
-        static const char idChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-        for (size_t i = 0; i < length; ++i)
-        {
-            id += idChars[r.nextInt(62)];
-        }
-        return id;
-    }
-};
-
 Pattern::Pattern(MidiTrack &parentTrack,
     ProjectEventDispatcher &dispatcher) :
     track(parentTrack),
@@ -426,7 +410,7 @@ void Pattern::deserialize(const SerializedData &data)
         auto clip = new Clip(this);
         clip->deserialize(e);
         this->clips.add(clip); // sorted later
-        this->usedClipIds.insert(clip->getId());
+        this->registerDeserializedClipId(*clip);
     }
 
     // Fallback to single clip at zero bar, if no clips found
@@ -445,20 +429,28 @@ void Pattern::reset()
     this->usedClipIds.clear();
 }
 
-String Pattern::createUniqueClipId() const noexcept
+Clip::Id Pattern::createUniqueClipId() const noexcept
 {
-    uint8 length = 2;
-    String clipId = ClipIdGenerator::generateId(length);
+    int length = 2;
+    auto clipId = this->idGenerator.generate(length);
     while (this->usedClipIds.contains(clipId))
     {
         length++;
-        clipId = ClipIdGenerator::generateId(length);
+        clipId = this->idGenerator.generate(length);
     }
-    
-    this->usedClipIds.insert({clipId});
+
+    this->usedClipIds.insert(clipId);
     return clipId;
 }
 
+void Pattern::registerDeserializedClipId(Clip &clip)
+{
+    if (clip.id == 0 || !this->usedClipIds.insert(clip.id).second)
+    {
+        clip.id = this->createUniqueClipId();
+    }
+}
+
 //===----------------------------------------------------------------------===//
 // Helpers
 //===----------------------------------------------------------------------===//
@@ -67,6 +67,7 @@ MidiEvent *AnnotationsSequence::insert(const AnnotationEvent &eventParams, bool
     {
         auto* ownedEvent = new AnnotationEvent(this, eventParams);
         this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+        this->invalidateSnapshot(*ownedEvent);
         this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         this->updateBeatRange(true);
         return ownedEvent;
@@ -91,6 +92,7 @@ bool AnnotationsSequence::remove(const AnnotationEvent &eventParams, bool undoab
             MidiEvent *const removedEvent = this->midiEvents[index];
             jassert(removedEvent->isValid());
             this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+            this->invalidateSnapshot(*removedEvent);
             this->midiEvents.remove(index, true);
             this->updateBeatRange(true);
             this->eventDispatcher.dispatchPostRemoveEvent(this);
@@ -118,9 +120,11 @@ bool AnnotationsSequence::change(const AnnotationEvent &oldParams,
         if (index >= 0)
         {
             auto *changedEvent = static_cast<AnnotationEvent *>(this->midiEvents.getUnchecked(index));
+            this->invalidateSnapshot(oldParams);
             changedEvent->applyChanges(newParams);
             this->midiEvents.remove(index, false);
             this->midiEvents.addSorted(*changedEvent, changedEvent);
+            this->invalidateSnapshot(*changedEvent);
             this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             this->updateBeatRange(true);
             return true;
@@ -148,6 +152,7 @@ bool AnnotationsSequence::insertGroup(Array<AnnotationEvent> &group, bool undoab
             auto *ownedEvent = new AnnotationEvent(this, eventParams);
             jassert(ownedEvent->isValid());
             this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+            this->invalidateSnapshot(*ownedEvent);
             this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         }
         
@@ -175,6 +180,7 @@ bool AnnotationsSequence::removeGroup(Array<AnnotationEvent> &group, bool undoab
             {
                 auto *removedEvent = this->midiEvents.getUnchecked(index);
                 this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+                this->invalidateSnapshot(*removedEvent);
                 this->midiEvents.remove(index, true);
             }
         }
@@ -207,9 +213,11 @@ bool AnnotationsSequence::changeGroup(Array<AnnotationEvent> &groupBefore,
             if (index >= 0)
             {
                 auto *changedEvent = static_cast<AnnotationEvent *>(this->midiEvents.getUnchecked(index));
+                this->invalidateSnapshot(oldParams);
                 changedEvent->applyChanges(newParams);
                 this->midiEvents.remove(index, false);
                 this->midiEvents.addSorted(*changedEvent, changedEvent);
+                this->invalidateSnapshot(*changedEvent);
                 this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             }
         }
@@ -276,15 +284,17 @@ void AnnotationsSequence::deserialize(const SerializedData &data)
         lastBeat = jmax(lastBeat, annotation->getBeat());
         firstBeat = jmin(firstBeat, annotation->getBeat());
 
-        this->usedEventIds.insert(annotation->getId());
+        this->registerDeserializedEventId(*annotation);
     }
 
     this->sort();
     this->updateBeatRange(false);
+    this->updateSnapshot();
 }
 
 void AnnotationsSequence::reset()
 {
     this->midiEvents.clear();
+    this->invalidateSnapshot();
     this->usedEventIds.clear();
 }
@@ -37,6 +37,7 @@ void AutomationSequence::importMidi(const MidiMessageSequence &sequence, short t
     this->clearUndoHistory();
     this->checkpoint();
     
+    Array<MidiEvent *> importedEvents;
     for (int i = 0; i < sequence.getNumEvents(); ++i)
     {
         const MidiMessage &message = sequence.getEventPointer(i)->message;
@@ -44,20 +45,44 @@ void AutomationSequence::importMidi(const MidiMessageSequence &sequence, short t
         if (message.isController())
         {
             const int controllerValue = message.getControllerValue();
-            const AutomationEvent event(this, startBeat, float(controllerValue) / 127.f);
-            this->importMidiEvent<AutomationEvent>(event);
+            importedEvents.add(new AutomationEvent(this, startBeat, float(controllerValue) / 127.f));
         }
         else if (message.isTempoMetaEvent())
         {
             const float controllerValue = Transport::getControllerValueByTempo(message.getTempoSecondsPerQuarterNote());
-            const AutomationEvent event(this, startBeat, controllerValue);
-            this->importMidiEvent<AutomationEvent>(event);
+            importedEvents.add(new AutomationEvent(this, startBeat, controllerValue));
         }
     }
+
+    this->addSortedEvents(importedEvents);
     
     this->updateBeatRange(false);
 }
 
+void AutomationSequence::exportMidi(MidiMessageSequence &outSequence, const Clip &clip,
+    bool soloPlaybackMode, double timeAdjustment, double timeFactor) const
+{
+    if (clip.isMuted())
+    {
+        return;
+    }
+
+    MidiExportBuffer buffer;
+    buffer.ensureStorageAllocated(this->midiEvents.size());
+
+    // each event interpolates the curve up to the next one:
+    for (int i = 0; i < this->midiEvents.size(); ++i)
+    {
+        const auto *event = static_cast<const AutomationEvent *>(this->midiEvents.getUnchecked(i));
+        const auto *nextEvent = (i < this->midiEvents.size() - 1) ?
+            static_cast<const AutomationEvent *>(this->midiEvents.getUnchecked(i + 1)) : nullptr;
+
+        event->exportMessages(buffer, clip, nextEvent, timeAdjustment, timeFactor);
+    }
+
+    buffer.flushTo(outSequence);
+}
+
 //===----------------------------------------------------------------------===//
 // Undoable track editing
 //===----------------------------------------------------------------------===//
@@ -74,6 +99,7 @@ MidiEvent *AutomationSequence::insert(const AutomationEvent &eventParams, bool u
     {
         auto *ownedEvent = new AutomationEvent(this, eventParams);
         this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+        this->invalidateSnapshot(*ownedEvent);
         this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         this->updateBeatRange(true);
         return ownedEvent;
@@ -97,6 +123,7 @@ bool AutomationSequence::remove(const AutomationEvent &eventParams, bool undoabl
         {
             MidiEvent *const removedEvent = this->midiEvents[index];
             this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+            this->invalidateSnapshot(*removedEvent);
             this->midiEvents.remove(index, true);
             this->updateBeatRange(true);
             this->eventDispatcher.dispatchPostRemoveEvent(this);
@@ -124,9 +151,11 @@ bool AutomationSequence::change(const AutomationEvent &oldParams,
         if (index >= 0)
         {
             const auto changedEvent = static_cast<AutomationEvent *>(this->midiEvents[index]);
+            this->invalidateSnapshot(oldParams);
             changedEvent->applyChanges(newParams);
             this->midiEvents.remove(index, false);
             this->midiEvents.addSorted(*changedEvent, changedEvent);
+            this->invalidateSnapshot(*changedEvent);
             this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             this->updateBeatRange(true);
             return true;
@@ -153,6 +182,7 @@ bool AutomationSequence::insertGroup(Array<AutomationEvent> &group, bool undoabl
             const auto &eventParams = group.getUnchecked(i);
             auto *ownedEvent = new AutomationEvent(this, eventParams);
             this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+            this->invalidateSnapshot(*ownedEvent);
             this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         }
         
@@ -180,6 +210,7 @@ bool AutomationSequence::removeGroup(Array<AutomationEvent> &group, bool undoabl
             {
                 const auto removedEvent = this->midiEvents[index];
                 this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+                this->invalidateSnapshot(*removedEvent);
                 this->midiEvents.remove(index, true);
             }
         }
@@ -212,9 +243,11 @@ bool AutomationSequence::changeGroup(const Array<AutomationEvent> groupBefore,
             if (index >= 0)
             {
                 const auto changedEvent = static_cast<AutomationEvent *>(this->midiEvents[index]);
+                this->invalidateSnapshot(oldParams);
                 changedEvent->applyChanges(newParams);
                 this->midiEvents.remove(index, false);
                 this->midiEvents.addSorted(*changedEvent, changedEvent);
+                this->invalidateSnapshot(*changedEvent);
                 this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             }
         }
@@ -266,15 +299,17 @@ void AutomationSequence::deserialize(const SerializedData &data)
         lastBeat = jmax(lastBeat, event->getBeat());
         firstBeat = jmin(firstBeat, event->getBeat());
 
-        this->usedEventIds.insert(event->getId());
+        this->registerDeserializedEventId(*event);
     }
 
     this->sort();
     this->updateBeatRange(false);
+    this->updateSnapshot();
 }
 
 void AutomationSequence::reset()
 {
     this->midiEvents.clear();
+    this->invalidateSnapshot();
     this->usedEventIds.clear();
 }
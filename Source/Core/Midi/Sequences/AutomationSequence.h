@@ -48,6 +48,8 @@ public:
     //===------------------------------------------------------------------===//
 
     void importMidi(const MidiMessageSequence &sequence, short timeFormat) override;
+    void exportMidi(MidiMessageSequence &outSequence, const Clip &clip,
+        bool soloPlaybackMode, double timeAdjustment, double timeFactor) const override;
 
     //===------------------------------------------------------------------===//
     // Serializable
@@ -42,12 +42,12 @@ AnnotationEvent::AnnotationEvent(WeakReference<MidiSequence> owner,
     description(parametersToCopy.description),
     colour(parametersToCopy.colour) {}
 
-void AnnotationEvent::exportMessages(MidiMessageSequence &outSequence,
+void AnnotationEvent::exportMessages(MidiExportBuffer &outMessages,
     const Clip &clip, double timeOffset, double timeFactor) const noexcept
 {
     MidiMessage event(MidiMessage::textMetaEvent(1, this->getDescription()));
     event.setTimeStamp((this->beat + clip.getBeat()) * timeFactor);
-    outSequence.addEvent(event, timeOffset);
+    outMessages.add(event, timeOffset);
 }
 
 AnnotationEvent AnnotationEvent::withDeltaBeat(float beatOffset) const noexcept
@@ -116,7 +116,7 @@ SerializedData AnnotationEvent::serialize() const
 {
     using namespace Serialization;
     SerializedData tree(Midi::annotation);
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
     tree.setProperty(Midi::text, this->description);
     tree.setProperty(Midi::colour, this->colour.toString());
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
@@ -130,7 +130,7 @@ void AnnotationEvent::deserialize(const SerializedData &data)
     this->description = data.getProperty(Midi::text);
     this->colour = Colour::fromString(data.getProperty(Midi::colour).toString());
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
-    this->id = data.getProperty(Midi::id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id));
 }
 
 void AnnotationEvent::reset() noexcept {}
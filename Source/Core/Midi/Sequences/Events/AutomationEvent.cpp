@@ -85,8 +85,18 @@ float AutomationEvent::interpolateEvents(float cv1, float cv2, float factor, flo
     return cv1 + (easeIn + easeOut);
 }
 
-void AutomationEvent::exportMessages(MidiMessageSequence &outSequence,
+void AutomationEvent::exportMessages(MidiExportBuffer &outMessages,
     const Clip &clip, double timeOffset, double timeFactor) const noexcept
+{
+    const int indexOfThis = this->getSequence()->indexOfSorted(this);
+    const auto *nextEvent = (indexOfThis >= 0 && indexOfThis < (this->getSequence()->size() - 1)) ?
+        static_cast<AutomationEvent *>(this->getSequence()->getUnchecked(indexOfThis + 1)) : nullptr;
+
+    this->exportMessages(outMessages, clip, nextEvent, timeOffset, timeFactor);
+}
+
+void AutomationEvent::exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
+    const AutomationEvent *nextEvent, double timeOffset, double timeFactor) const noexcept
 {
     MidiMessage cc;
     const bool isTempoTrack = this->getSequence()->getTrack()->isTempoTrack();
@@ -103,14 +113,12 @@ void AutomationEvent::exportMessages(MidiMessageSequence &outSequence,
 
     const double startTime = (this->beat + clip.getBeat()) * timeFactor;
     cc.setTimeStamp(startTime);
-    outSequence.addEvent(cc, timeOffset);
+    outMessages.add(cc, timeOffset);
 
     // add interpolated events, if needed
-    const int indexOfThis = this->getSequence()->indexOfSorted(this);
     const bool isPedalOrSwitchEvent = this->getSequence()->getTrack()->isOnOffAutomationTrack();
-    if (!isPedalOrSwitchEvent && indexOfThis >= 0 && indexOfThis < (this->getSequence()->size() - 1))
+    if (!isPedalOrSwitchEvent && nextEvent != nullptr)
     {
-        const auto *nextEvent = static_cast<AutomationEvent *>(this->getSequence()->getUnchecked(indexOfThis + 1));
         float interpolatedBeat = this->beat + CURVE_INTERPOLATION_STEP_BEAT;
         float lastAppliedValue = this->controllerValue;
 
@@ -130,14 +138,14 @@ void AutomationEvent::exportMessages(MidiMessageSequence &outSequence,
                 {
                     MidiMessage ci(MidiMessage::tempoMetaEvent(Transport::getTempoByControllerValue(interpolatedValue)));
                     ci.setTimeStamp(interpolatedTs);
-                    outSequence.addEvent(ci, timeOffset);
+                    outMessages.add(ci, timeOffset);
                 }
                 else
                 {
                     MidiMessage ci(MidiMessage::controllerEvent(this->getTrackChannel(),
                         this->getTrackControllerNumber(), int(interpolatedValue * 127)));
                     ci.setTimeStamp(interpolatedTs);
-                    outSequence.addEvent(ci, timeOffset);
+                    outMessages.add(ci, timeOffset);
                 }
 
                 lastAppliedValue = interpolatedValue;
@@ -258,7 +266,7 @@ SerializedData AutomationEvent::serialize() const
 {
     using namespace Serialization;
     SerializedData tree(Midi::automationEvent);
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
     tree.setProperty(Midi::value, this->controllerValue);
     tree.setProperty(Midi::curve, this->curvature);
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
@@ -272,7 +280,7 @@ void AutomationEvent::deserialize(const SerializedData &data)
     this->controllerValue = float(data.getProperty(Midi::value));
     this->curvature = float(data.getProperty(Midi::curve, AUTOEVENT_DEFAULT_CURVATURE));
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
-    this->id = data.getProperty(Midi::id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id));
 }
 
 void AutomationEvent::reset() noexcept {}
@@ -35,9 +35,14 @@ public:
         float beatVal = 0.f,
         float controllerValue = 0.f) noexcept;
 
-    void exportMessages(MidiMessageSequence &outSequence, const Clip &clip,
+    void exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
         double timeOffset, double timeFactor) const noexcept override;
 
+    // The same as above, but takes the next event in the sequence,
+    // so that the sequence doesn't have to look it up for each event
+    void exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
+        const AutomationEvent *nextEvent, double timeOffset, double timeFactor) const noexcept;
+
     static float interpolateEvents(float cv1, float cv2, float factor, float easing);
 
     AutomationEvent copyWithNewId(WeakReference<MidiSequence> owner = nullptr) const noexcept;
@@ -54,7 +54,7 @@ String KeySignatureEvent::toString() const
     return keyName + ", " + this->scale->getLocalizedName();
 }
 
-void KeySignatureEvent::exportMessages(MidiMessageSequence &outSequence,
+void KeySignatureEvent::exportMessages(MidiExportBuffer &outMessages,
     const Clip &clip, double timeOffset, double timeFactor) const noexcept
 {
     // Basically, we can have any non-standard scale here:
@@ -78,7 +78,7 @@ void KeySignatureEvent::exportMessages(MidiMessageSequence &outSequence,
 
     MidiMessage event(MidiMessage::keySignatureMetaEvent(flatsOrSharps, isMinor));
     event.setTimeStamp((this->beat + clip.getBeat()) * timeFactor);
-    outSequence.addEvent(event, timeOffset);
+    outMessages.add(event, timeOffset);
 }
 
 KeySignatureEvent KeySignatureEvent::withDeltaBeat(float beatOffset) const noexcept
@@ -145,7 +145,7 @@ SerializedData KeySignatureEvent::serialize() const
 {
     using namespace Serialization;
     SerializedData tree(Midi::keySignature);
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
     tree.setProperty(Midi::key, this->rootKey);
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
     tree.appendChild(this->scale->serialize());
@@ -158,7 +158,7 @@ void KeySignatureEvent::deserialize(const SerializedData &data)
     using namespace Serialization;
     this->rootKey = data.getProperty(Midi::key, 0);
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
-    this->id = data.getProperty(Midi::id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id));
 
     this->scale = new Scale();
     this->scale->deserialize(data);
@@ -36,7 +36,7 @@ MidiEvent::MidiEvent(WeakReference<MidiSequence> owner, Type type, float beatVal
 
 bool MidiEvent::isValid() const noexcept
 {
-    return this->sequence != nullptr && this->id.isNotEmpty();
+    return this->sequence != nullptr && this->id != 0;
 }
 
 MidiSequence *MidiEvent::getSequence() const noexcept
@@ -63,7 +63,7 @@ Colour MidiEvent::getTrackColour() const noexcept
     return this->sequence->getTrack()->getTrackColour();
 }
 
-const MidiEvent::Id &MidiEvent::getId() const noexcept
+MidiEvent::Id MidiEvent::getId() const noexcept
 {
     return this->id;
 }
@@ -81,7 +81,9 @@ int MidiEvent::compareElements(const MidiEvent *const first, const MidiEvent *co
     const int diffResult = (diff > 0.f) - (diff < 0.f);
     if (diffResult != 0) { return diffResult; }
 
-    return first->getId().compare(second->getId());
+    const auto firstId = first->getId();
+    const auto secondId = second->getId();
+    return (firstId > secondId) - (firstId < secondId);
 }
 
 MidiEvent::Id MidiEvent::createId() const noexcept
@@ -91,5 +93,5 @@ MidiEvent::Id MidiEvent::createId() const noexcept
         return this->sequence->createUniqueEventId();
     }
 
-    return {};
+    return 0;
 }
@@ -17,14 +17,18 @@
 
 #pragma once
 
+#include "IdGenerator.h"
+#include "MidiEventAllocator.h"
+
 class Clip;
 class MidiSequence;
+class MidiExportBuffer;
 
 class MidiEvent : public Serializable
 {
 public:
 
-    using Id = String;
+    using Id = uint64;
 
     // Non-serialized field to be used instead of expensive dynamic casts:
     enum class Type : uint8 
@@ -52,9 +56,37 @@ public:
     // with custom parameters (assumes the id is already valid and unique)
     MidiEvent(WeakReference<MidiSequence> owner, const MidiEvent &parameters) noexcept;
 
-    virtual void exportMessages(MidiMessageSequence &outSequence,
+    virtual void exportMessages(MidiExportBuffer &outMessages,
         const Clip &clip, double timeOffset, double timeFactor) const noexcept = 0;
 
+    // All kinds of events are allocated from a pool, which recycles
+    // the storage of the deleted ones: the shared one by default,
+    // or the one given by the sequence, see MidiEventAllocator
+    static void *operator new(size_t size)
+    {
+        return MidiEventAllocator::getDefault().allocate(size);
+    }
+
+    static void *operator new(size_t size, MidiEventAllocator &allocator)
+    {
+        return allocator.allocate(size);
+    }
+
+    static void operator delete(void *ptr) noexcept
+    {
+        MidiEventAllocator::deallocate(ptr);
+    }
+
+    static void operator delete(void *ptr, MidiEventAllocator &) noexcept
+    {
+        MidiEventAllocator::deallocate(ptr);
+    }
+
+    // the class-specific operators hide the global placement new,
+    // which the containers of events stored by value still need
+    static void *operator new(size_t, void *ptr) noexcept { return ptr; }
+    static void operator delete(void *, void *) noexcept {}
+
     //===------------------------------------------------------------------===//
     // Accessors
     //===------------------------------------------------------------------===//
@@ -67,7 +99,7 @@ public:
     int getTrackChannel() const noexcept;
     Colour getTrackColour() const noexcept;
 
-    const Id &getId() const noexcept;
+    Id getId() const noexcept;
     float getBeat() const noexcept;
 
     friend inline bool operator==(const MidiEvent &l, const MidiEvent &r)
@@ -87,13 +119,14 @@ protected:
 
     WeakReference<MidiSequence> sequence;
 
-    Id id;
+    Id id = 0;
     Type type;
     float beat;
 
     Id createId() const noexcept;
 
     friend struct MidiEventHash;
+    friend class MidiSequence;
 
 };
 
@@ -101,13 +134,6 @@ struct MidiEventHash
 {
     inline HashCode operator()(const MidiEvent &key) const noexcept
     {
-        // Earlier, this function looked like this:
-        // return static_cast<HashCode>(key.beat) + static_cast<HashCode>(key.getId().hashCode());
-
-        // For speed and simplicity's sake we assume that id is not empty,
-        // and is at least of 2 characters (which it should be in all cases).
-        // There are no safety checks and all, but it should work:
-        const auto *ptr = key.id.getCharPointer().getAddress();
-        return 64 * static_cast<HashCode>(ptr[0]) + static_cast<HashCode>(ptr[1]);
+        return IdHash{}(key.id);
     }
 };
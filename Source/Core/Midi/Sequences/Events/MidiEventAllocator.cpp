@@ -0,0 +1,338 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiEventAllocator.h"
+
+MidiEventAllocator::MidiEventAllocator(bool shouldUsePool) noexcept :
+    usesPool(shouldUsePool) {}
+
+MidiEventAllocator::~MidiEventAllocator()
+{
+    // all events must be deleted before their allocator
+    for (const auto *slab : this->slabs)
+    {
+        jassert(slab->numSlotsInUse == 0);
+        ignoreUnused(slab);
+    }
+}
+
+MidiEventAllocator &MidiEventAllocator::getDefault()
+{
+    static auto *instance = new MidiEventAllocator();
+    return *instance;
+}
+
+int MidiEventAllocator::getNumSlabs() const noexcept
+{
+    const SpinLock::ScopedLockType lock(this->lock);
+    return this->slabs.size();
+}
+
+inline size_t MidiEventAllocator::getSlotSize(size_t size) noexcept
+{
+    const auto slotSize = size + slotHeaderSize;
+    if (slotSize <= 32)
+    {
+        return 32;
+    }
+
+    return (slotSize + slabAlignment - 1) & ~(slabAlignment - 1);
+}
+
+inline int MidiEventAllocator::getSizeClassIndex(size_t slotSize) noexcept
+{
+    // 32, 64, 128, 192, 256
+    return int(slotSize <= 64 ? slotSize / 32 - 1 : slotSize / 64);
+}
+
+static inline void *&getSlotHeader(char *slot) noexcept
+{
+    return *reinterpret_cast<void **>(slot);
+}
+
+void *MidiEventAllocator::allocate(size_t size)
+{
+    const auto slotSize = getSlotSize(size);
+    if (!this->usesPool || slotSize > maxSlotSize)
+    {
+        auto *block = static_cast<char *>(::operator new(size + slotHeaderSize));
+        getSlotHeader(block) = nullptr;
+        return block + slotHeaderSize;
+    }
+
+    const auto sizeClassIndex = getSizeClassIndex(slotSize);
+    auto &sizeClass = this->sizeClasses[sizeClassIndex];
+
+    const SpinLock::ScopedLockType lock(this->lock);
+
+    if (sizeClass.availableSlabs.isEmpty())
+    {
+        auto *newSlab = this->createSlab(slotSize, sizeClassIndex);
+        newSlab->isAvailable = true;
+        sizeClass.availableSlabs.add(newSlab);
+    }
+
+    auto *slab = sizeClass.availableSlabs.getLast();
+
+    char *slot = nullptr;
+    if (auto *freeSlot = slab->freeList)
+    {
+        slab->freeList = freeSlot->next;
+        slot = reinterpret_cast<char *>(freeSlot);
+    }
+    else
+    {
+        slot = slab->cursor;
+        slab->cursor += slotSize;
+    }
+
+    slab->numSlotsInUse++;
+
+    if (slab->freeList == nullptr &&
+        size_t(slab->end - slab->cursor) < slotSize)
+    {
+        slab->isAvailable = false;
+        sizeClass.availableSlabs.removeLast();
+    }
+
+    getSlotHeader(slot) = slab;
+    return slot + slotHeaderSize;
+}
+
+void MidiEventAllocator::deallocate(void *ptr) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    auto *slot = static_cast<char *>(ptr) - slotHeaderSize;
+    auto *slab = static_cast<Slab *>(getSlotHeader(slot));
+    if (slab == nullptr)
+    {
+        ::operator delete(slot);
+        return;
+    }
+
+    slab->owner->release(slab, slot);
+}
+
+MidiEventAllocator::Slab *MidiEventAllocator::createSlab(size_t slotSize, int sizeClassIndex)
+{
+    auto *slab = this->slabs.add(new Slab());
+    slab->owner = this;
+    slab->slotSize = slotSize;
+    slab->sizeClassIndex = sizeClassIndex;
+    slab->storage.malloc(slabSize + slabAlignment);
+
+    const auto address = reinterpret_cast<pointer_sized_uint>(slab->storage.get());
+    const auto alignedAddress = (address + slabAlignment - 1) & ~pointer_sized_uint(slabAlignment - 1);
+    slab->cursor = reinterpret_cast<char *>(alignedAddress);
+    slab->end = slab->cursor + slabSize;
+    return slab;
+}
+
+void MidiEventAllocator::release(Slab *slab, char *slot) noexcept
+{
+    const SpinLock::ScopedLockType lock(this->lock);
+
+    auto *freeSlot = reinterpret_cast<FreeSlot *>(slot);
+    freeSlot->next = slab->freeList;
+    slab->freeList = freeSlot;
+    slab->numSlotsInUse--;
+
+    auto &sizeClass = this->sizeClasses[slab->sizeClassIndex];
+    if (!slab->isAvailable)
+    {
+        slab->isAvailable = true;
+        sizeClass.availableSlabs.add(slab);
+    }
+
+    // the pool doesn't hold on to the peak number of events, but one empty
+    // slab per size class is kept, so that creating and deleting a single
+    // event over and over doesn't allocate a new slab each time
+    if (slab->numSlotsInUse == 0 && sizeClass.availableSlabs.size() > 1)
+    {
+        sizeClass.availableSlabs.removeFirstMatchingValue(slab);
+        this->slabs.removeObject(slab);
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#include "Note.h"
+
+#define EVENT_ALLOCATOR_TEST_NUM_NOTES 100000
+#define EVENT_ALLOCATOR_TEST_NUM_ROUNDS 10
+#define EVENT_ALLOCATOR_TEST_MIN_SPEEDUP 1.0
+
+// Compares the pooled allocation with the default heap, creating and deleting
+// lots of notes the way the import, undo/redo and paste do it: that is,
+// a whole batch of notes created at once and then deleted at once
+
+class MidiEventAllocatorBenchmark final : public UnitTest
+{
+public:
+
+    MidiEventAllocatorBenchmark() :
+        UnitTest("Midi event allocator benchmark", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        beginTest("Pooled storage is recycled");
+
+        {
+            MidiEventAllocator allocator;
+            auto *note = new (allocator) Note(nullptr, 60, 1.f);
+            void *address = note;
+            delete note;
+
+            auto *anotherNote = new (allocator) Note(nullptr, 61, 2.f);
+            expect(address == static_cast<void *>(anotherNote));
+            delete anotherNote;
+        }
+
+        beginTest("Pooled slots are aligned");
+
+        {
+            MidiEventAllocator allocator;
+            OwnedArray<Note> notes;
+            for (int i = 0; i < 100; ++i)
+            {
+                notes.add(new (allocator) Note(nullptr, 60, float(i)));
+            }
+
+            for (int i = 1; i < notes.size(); ++i)
+            {
+                const auto address = reinterpret_cast<pointer_sized_uint>(notes.getUnchecked(i));
+                const auto previousAddress = reinterpret_cast<pointer_sized_uint>(notes.getUnchecked(i - 1));
+                expect(address % MidiEventAllocator::slotHeaderSize == 0);
+
+                // the slots are either 32 bytes, or a whole number of cache lines
+                const auto slotSize = address - previousAddress;
+                expect(slotSize == 32 || slotSize % MidiEventAllocator::slabAlignment == 0);
+            }
+        }
+
+        beginTest("Free slabs are released");
+
+        {
+            MidiEventAllocator allocator;
+            OwnedArray<Note> notes;
+            const int numNotes = int(MidiEventAllocator::slabSize / sizeof(Note)) * 10;
+            for (int i = 0; i < numNotes; ++i)
+            {
+                notes.add(new (allocator) Note(nullptr, 60, float(i)));
+            }
+
+            expectGreaterThan(allocator.getNumSlabs(), 9);
+
+            notes.clear(true);
+            expectEquals(allocator.getNumSlabs(), 1);
+        }
+
+        beginTest("Events are deleted by the allocator they came from");
+
+        {
+            MidiEventAllocator pool;
+            MidiEventAllocator defaultHeap(false);
+            auto *pooledNote = new (pool) Note(nullptr, 60, 1.f);
+            auto *heapNote = new (defaultHeap) Note(nullptr, 60, 1.f);
+            auto *sharedPoolNote = new Note(nullptr, 60, 1.f);
+            expectEquals(pool.getNumSlabs(), 1);
+            expectEquals(defaultHeap.getNumSlabs(), 0);
+
+            delete heapNote;
+            delete sharedPoolNote;
+            delete pooledNote;
+        }
+
+        beginTest("Batch create and delete of 100k notes");
+
+        MidiEventAllocator pool;
+
+        // warm-up, so that both compare the steady state
+        this->runPooled(pool);
+        this->runDefaultHeap();
+
+        // the best of the rounds, which is the least affected by the noise
+        double pooledTime = DBL_MAX;
+        double defaultTime = DBL_MAX;
+        for (int round = 0; round < EVENT_ALLOCATOR_TEST_NUM_ROUNDS; ++round)
+        {
+            pooledTime = jmin(pooledTime, this->runPooled(pool));
+            defaultTime = jmin(defaultTime, this->runDefaultHeap());
+        }
+
+        const auto speedup = defaultTime / jmax(pooledTime, 0.000001);
+        logMessage("Default heap: " + String(defaultTime * 1000.0, 2) + " ms per round");
+        logMessage("Pooled allocator: " + String(pooledTime * 1000.0, 2) + " ms per round");
+        logMessage("Speedup: " + String(speedup, 2) + "x");
+
+        expectGreaterThan(speedup, EVENT_ALLOCATOR_TEST_MIN_SPEEDUP);
+    }
+
+private:
+
+    double runPooled(MidiEventAllocator &allocator)
+    {
+        OwnedArray<Note> notes;
+        notes.ensureStorageAllocated(EVENT_ALLOCATOR_TEST_NUM_NOTES);
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < EVENT_ALLOCATOR_TEST_NUM_NOTES; ++i)
+        {
+            notes.add(new (allocator) Note(nullptr, i % 128, float(i / 4)));
+        }
+
+        notes.clearQuick(true);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+
+    double runDefaultHeap()
+    {
+        Array<Note *> notes;
+        notes.ensureStorageAllocated(EVENT_ALLOCATOR_TEST_NUM_NOTES);
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < EVENT_ALLOCATOR_TEST_NUM_NOTES; ++i)
+        {
+            auto *storage = ::operator new(sizeof(Note));
+            notes.add(::new (storage) Note(nullptr, i % 128, float(i / 4)));
+        }
+
+        for (auto *note : notes)
+        {
+            note->~Note();
+            ::operator delete(static_cast<void *>(note));
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+};
+
+static MidiEventAllocatorBenchmark midiEventAllocatorBenchmark;
+
+#endif
@@ -0,0 +1,105 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A slab allocator for the heap-allocated events: sequences create and
+// delete events by the thousands on paste, undo/redo and import, and for
+// the general-purpose heap, that's a lot of tiny allocations scattered around.
+
+// Instead, the events are carved out of large cache-line-aligned slabs,
+// one set of slabs per size class; the slot sizes are rounded up to 32
+// or 64 bytes, or to a multiple of 64, so that each slot is aligned and
+// no slot straddles a cache line more than it has to. Each slab keeps its own free list and the number
+// of its slots in use, and once all of them are freed, the slab is
+// returned to the system, except for the last one of its size class.
+
+// Each slot starts with a header pointing to its slab, or to nothing,
+// if the event was allocated on the default heap, so that an event
+// is deleted by the allocator it was created with: the sequences
+// are given an allocator to create their events with (the shared
+// default one, unless injected), but the events are deleted through
+// OwnedArray, with no way to tell which sequence they came from.
+
+// The allocator is guarded by a spin lock, as the events are mostly
+// created on the message thread, but sometimes also on the VCS threads.
+
+class MidiEventAllocator final
+{
+public:
+
+    // Without the pool, all events go to the default heap,
+    // which is only useful as a baseline for the benchmarks
+    explicit MidiEventAllocator(bool shouldUsePool = true) noexcept;
+    ~MidiEventAllocator();
+
+    // The one used by all sequences, unless given another one;
+    // never destroyed, as some events may outlive the other statics
+    // (e.g. the ones owned by the app singletons at shutdown)
+    static MidiEventAllocator &getDefault();
+
+    void *allocate(size_t size);
+    static void deallocate(void *ptr) noexcept;
+
+    int getNumSlabs() const noexcept;
+
+    static constexpr size_t slotHeaderSize = 16;
+    static constexpr size_t maxSlotSize = 256;
+    static constexpr size_t slabAlignment = 64;
+    static constexpr size_t slabSize = 64 * 1024;
+
+private:
+
+    struct FreeSlot final
+    {
+        FreeSlot *next;
+    };
+
+    struct Slab final
+    {
+        MidiEventAllocator *owner = nullptr;
+        HeapBlock<char> storage;
+        char *cursor = nullptr;
+        char *end = nullptr;
+        FreeSlot *freeList = nullptr;
+        size_t slotSize = 0;
+        int sizeClassIndex = 0;
+        int numSlotsInUse = 0;
+        bool isAvailable = false;
+    };
+
+    struct SizeClass final
+    {
+        // the slabs with at least one free slot
+        Array<Slab *> availableSlabs;
+    };
+
+    static size_t getSlotSize(size_t size) noexcept;
+    static int getSizeClassIndex(size_t slotSize) noexcept;
+
+    Slab *createSlab(size_t slotSize, int sizeClassIndex);
+    void release(Slab *slab, char *slot) noexcept;
+
+    static constexpr int numSizeClasses = 5;
+    SizeClass sizeClasses[numSizeClasses];
+    OwnedArray<Slab> slabs;
+    mutable SpinLock lock;
+
+    const bool usesPool;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiEventAllocator)
+};
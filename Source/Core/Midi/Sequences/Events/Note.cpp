@@ -37,16 +37,25 @@ Note::Note(WeakReference<MidiSequence> owner, const Note &parametersToCopy) noex
     velocity(parametersToCopy.velocity),
     tuplet(parametersToCopy.tuplet) {}
 
-void Note::exportMessages(MidiMessageSequence &outSequence, const Clip &clip,
+void Note::exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
     double timeOffset, double timeFactor) const noexcept
 {
-    const auto finalKey = this->key + clip.getKey();
-    const auto finalVolume = this->velocity * clip.getVelocity();
-    const auto tupletLength = this->length / float(this->tuplet);
+    Note::exportMessages(outMessages, clip, this->getTrackChannel(),
+        this->key, this->beat, this->length, this->velocity, this->tuplet,
+        timeOffset, timeFactor);
+}
+
+void Note::exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
+    int channel, Key key, float beat, float length, float velocity, Tuplet tuplet,
+    double timeOffset, double timeFactor) noexcept
+{
+    const auto finalKey = key + clip.getKey();
+    const auto finalVolume = velocity * clip.getVelocity();
+    const auto tupletLength = length / float(tuplet);
 
-    for (int i = 0; i < this->tuplet; ++i)
+    for (int i = 0; i < tuplet; ++i)
     {
-        const float tupletStart = this->beat + tupletLength * float(i);
+        const float tupletStart = beat + tupletLength * float(i);
 
         // slightly adjust volume for tuplet sequence: factor fading from 1 to 0.9;
         // this should sound anyway better than the same volume for all tuplets,
@@ -54,10 +63,10 @@ void Note::exportMessages(MidiMessageSequence &outSequence, const Clip &clip,
         // (like implement auto curves for individual notes?)
         const float tupletVolume = finalVolume * (1.f - float(i) / 100.f);
 
-        MidiMessage eventNoteOn(MidiMessage::noteOn(this->getTrackChannel(), finalKey, tupletVolume));
+        MidiMessage eventNoteOn(MidiMessage::noteOn(channel, finalKey, tupletVolume));
         const double startTime = (tupletStart + clip.getBeat()) * timeFactor;
         eventNoteOn.setTimeStamp(startTime);
-        outSequence.addEvent(eventNoteOn, timeOffset);
+        outMessages.add(eventNoteOn, timeOffset);
 
         // here, when having odd tuplet, note-off event time might end up
         // being slightly after next event's start time, due to rounding errors,
@@ -71,10 +80,10 @@ void Note::exportMessages(MidiMessageSequence &outSequence, const Clip &clip,
         // to make sure end/start times of neighbor notes never overlap:
         const double oddTupletFix = double(i % 2) / 1000;
 
-        MidiMessage eventNoteOff(MidiMessage::noteOff(this->getTrackChannel(), finalKey));
+        MidiMessage eventNoteOff(MidiMessage::noteOff(channel, finalKey));
         const double endTime = (tupletStart + tupletLength + clip.getBeat()) * timeFactor - oddTupletFix;
         eventNoteOff.setTimeStamp(endTime);
-        outSequence.addEvent(eventNoteOff, timeOffset);
+        outMessages.add(eventNoteOff, timeOffset);
     }
 }
 
@@ -204,7 +213,7 @@ SerializedData Note::serialize() const
 {
     using namespace Serialization;
     SerializedData tree(Midi::note);
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
     tree.setProperty(Midi::key, this->key);
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
     tree.setProperty(Midi::length, int(this->length * TICKS_PER_BEAT));
@@ -220,7 +229,7 @@ void Note::deserialize(const SerializedData &data)
 {
     this->reset();
     using namespace Serialization;
-    this->id = data.getProperty(Midi::id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id));
     this->key = data.getProperty(Midi::key);
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
     this->length = float(data.getProperty(Midi::length)) / TICKS_PER_BEAT;
@@ -257,5 +266,5 @@ int Note::compareElements(const Note *const first, const Note *const second) noe
     const int keyResult = (keyDiff > 0) - (keyDiff < 0);
     if (keyResult != 0) { return keyResult; }
 
-    return first->getId().compare(second->getId());
+    return (first->id > second->id) - (first->id < second->id);
 }
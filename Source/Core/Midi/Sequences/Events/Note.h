@@ -41,8 +41,14 @@ public:
          int keyVal = MIDDLE_C, float beatVal = 0.f,
          float lengthVal = 1.f, float velocityVal = 1.f) noexcept;
 
-    void exportMessages(MidiMessageSequence &outSequence, const Clip &clip,
+    void exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
         double timeOffset, double timeFactor) const noexcept override;
+
+    // The same as above, but takes the note parameters explicitly,
+    // so that the sequence can export its packed notes data directly
+    static void exportMessages(MidiExportBuffer &outMessages, const Clip &clip,
+        int channel, Key key, float beat, float length, float velocity, Tuplet tuplet,
+        double timeOffset, double timeFactor) noexcept;
     
     Note copyWithNewId(WeakReference<MidiSequence> owner = nullptr) const noexcept;
     Note withKey(Key newKey) const noexcept;
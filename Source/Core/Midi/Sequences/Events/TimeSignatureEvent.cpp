@@ -62,12 +62,12 @@ void TimeSignatureEvent::parseString(const String &data, int &numerator, int &de
     }
 }
 
-void TimeSignatureEvent::exportMessages(MidiMessageSequence &outSequence,
+void TimeSignatureEvent::exportMessages(MidiExportBuffer &outMessages,
     const Clip &clip, double timeOffset, double timeFactor) const noexcept
 {
     MidiMessage event(MidiMessage::timeSignatureMetaEvent(this->numerator, this->denominator));
     event.setTimeStamp((this->beat + clip.getBeat()) * timeFactor);
-    outSequence.addEvent(event, timeOffset);
+    outMessages.add(event, timeOffset);
 }
 
 TimeSignatureEvent TimeSignatureEvent::withDeltaBeat(float beatOffset) const noexcept
@@ -141,7 +141,7 @@ SerializedData TimeSignatureEvent::serialize() const
 {
     using namespace Serialization;
     SerializedData tree(Midi::timeSignature);
-    tree.setProperty(Midi::id, this->id);
+    tree.setProperty(Midi::id, IdGenerator::toString(this->id));
     tree.setProperty(Midi::numerator, this->numerator);
     tree.setProperty(Midi::denominator, this->denominator);
     tree.setProperty(Midi::timestamp, int(this->beat * TICKS_PER_BEAT));
@@ -155,7 +155,7 @@ void TimeSignatureEvent::deserialize(const SerializedData &data)
     this->numerator = data.getProperty(Midi::numerator, TIME_SIGNATURE_DEFAULT_NUMERATOR);
     this->denominator = data.getProperty(Midi::denominator, TIME_SIGNATURE_DEFAULT_DENOMINATOR);
     this->beat = float(data.getProperty(Midi::timestamp)) / TICKS_PER_BEAT;
-    this->id = data.getProperty(Midi::id);
+    this->id = IdGenerator::fromString(data.getProperty(Midi::id));
 }
 
 void TimeSignatureEvent::reset() noexcept {}
@@ -85,6 +85,7 @@ MidiEvent *KeySignaturesSequence::insert(const KeySignatureEvent &eventParams, b
     {
         auto *ownedSignature = new KeySignatureEvent(this, eventParams);
         this->midiEvents.addSorted(*ownedSignature, ownedSignature);
+        this->invalidateSnapshot(*ownedSignature);
         this->eventDispatcher.dispatchAddEvent(*ownedSignature);
         this->updateBeatRange(true);
         return ownedSignature;
@@ -108,6 +109,7 @@ bool KeySignaturesSequence::remove(const KeySignatureEvent &signature, bool undo
         {
             auto *removedEvent = this->midiEvents.getUnchecked(index);
             this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+            this->invalidateSnapshot(*removedEvent);
             this->midiEvents.remove(index, true);
             this->updateBeatRange(true);
             this->eventDispatcher.dispatchPostRemoveEvent(this);
@@ -135,9 +137,11 @@ bool KeySignaturesSequence::change(const KeySignatureEvent &oldParams,
         if (index >= 0)
         {
             auto *changedEvent = static_cast<KeySignatureEvent *>(this->midiEvents.getUnchecked(index));
+            this->invalidateSnapshot(oldParams);
             changedEvent->applyChanges(newParams);
             this->midiEvents.remove(index, false);
             this->midiEvents.addSorted(*changedEvent, changedEvent);
+            this->invalidateSnapshot(*changedEvent);
             this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             this->updateBeatRange(true);
             return true;
@@ -164,6 +168,7 @@ bool KeySignaturesSequence::insertGroup(Array<KeySignatureEvent> &group, bool un
             const KeySignatureEvent &eventParams = group.getReference(i);
             auto *ownedEvent = new KeySignatureEvent(this, eventParams);
             this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+            this->invalidateSnapshot(*ownedEvent);
             this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         }
         
@@ -191,6 +196,7 @@ bool KeySignaturesSequence::removeGroup(Array<KeySignatureEvent> &group, bool un
             {
                 auto *removedEvent = this->midiEvents.getUnchecked(index);
                 this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+                this->invalidateSnapshot(*removedEvent);
                 this->midiEvents.remove(index, true);
             }
         }
@@ -223,9 +229,11 @@ bool KeySignaturesSequence::changeGroup(Array<KeySignatureEvent> &groupBefore,
             if (index >= 0)
             {
                 auto *changedEvent = static_cast<KeySignatureEvent *>(this->midiEvents.getUnchecked(index));
+                this->invalidateSnapshot(oldParams);
                 changedEvent->applyChanges(newParams);
                 this->midiEvents.remove(index, false);
                 this->midiEvents.addSorted(*changedEvent, changedEvent);
+                this->invalidateSnapshot(*changedEvent);
                 this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             }
         }
@@ -279,15 +287,17 @@ void KeySignaturesSequence::deserialize(const SerializedData &data)
         lastBeat = jmax(lastBeat, signature->getBeat());
         firstBeat = jmin(firstBeat, signature->getBeat());
 
-        this->usedEventIds.insert(signature->getId());
+        this->registerDeserializedEventId(*signature);
     }
 
     this->sort();
     this->updateBeatRange(false);
+    this->updateSnapshot();
 }
 
 void KeySignaturesSequence::reset()
 {
     this->midiEvents.clear();
+    this->invalidateSnapshot();
     this->usedEventIds.clear();
 }
@@ -0,0 +1,189 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiExportBuffer.h"
+
+void MidiExportBuffer::ensureStorageAllocated(int numMessages)
+{
+    this->messages.ensureStorageAllocated(numMessages);
+}
+
+void MidiExportBuffer::flushTo(MidiMessageSequence &outSequence)
+{
+    if (this->messages.isEmpty())
+    {
+        return;
+    }
+
+    // stable, so that the messages with the same timestamp
+    // keep the order they were added in, just like addEvent does:
+    const auto isEarlier = [](const MidiMessage &a, const MidiMessage &b)
+    {
+        return a.getTimeStamp() < b.getTimeStamp();
+    };
+
+    std::stable_sort(this->messages.begin(), this->messages.end(), isEarlier);
+
+    // the sequences are normally exported clip by clip, each one after
+    // the previous ones, so the sorted messages are simply appended;
+    // but if the clips overlap, all messages have to be merged and re-matched
+    if (outSequence.getNumEvents() > 0 &&
+        outSequence.getEndTime() > this->messages.getReference(0).getTimeStamp())
+    {
+        Array<MidiMessage> merged;
+        merged.ensureStorageAllocated(outSequence.getNumEvents() + this->messages.size());
+        for (int i = 0; i < outSequence.getNumEvents(); ++i)
+        {
+            merged.add(outSequence.getEventPointer(i)->message);
+        }
+
+        const int numExisting = merged.size();
+        merged.addArray(this->messages);
+        std::inplace_merge(merged.begin(), merged.begin() + numExisting, merged.end(), isEarlier);
+
+        outSequence.clear();
+        this->messages.swapWith(merged);
+    }
+
+    // like updateMatchedPairs, each note-on is matched with the next
+    // note-off of the same channel and key, but if another note-on
+    // comes first, a note-off is inserted right before it
+    struct NotePair final
+    {
+        int noteOnIndex;
+        int noteOffIndex;
+    };
+
+    static constexpr auto numKeys = 128;
+    HeapBlock<int> pendingNoteOns(16 * numKeys);
+    for (int i = 0; i < 16 * numKeys; ++i)
+    {
+        pendingNoteOns[i] = -1;
+    }
+
+    Array<MidiMessage> matched;
+    matched.ensureStorageAllocated(this->messages.size());
+
+    Array<NotePair> pairs;
+    pairs.ensureStorageAllocated(this->messages.size() / 2);
+
+    for (const auto &message : this->messages)
+    {
+        if (message.isNoteOnOrOff())
+        {
+            const int key = message.getNoteNumber();
+            const int channel = jlimit(1, 16, message.getChannel());
+            auto &pendingNoteOn = pendingNoteOns[(channel - 1) * numKeys + key];
+
+            if (message.isNoteOn())
+            {
+                if (pendingNoteOn >= 0)
+                {
+                    pairs.add({ pendingNoteOn, matched.size() });
+                    matched.add(MidiMessage::noteOff(channel, key).withTimeStamp(message.getTimeStamp()));
+                }
+
+                pendingNoteOn = matched.size();
+            }
+            else if (pendingNoteOn >= 0)
+            {
+                pairs.add({ pendingNoteOn, matched.size() });
+                pendingNoteOn = -1;
+            }
+        }
+
+        matched.add(message);
+    }
+
+    const int firstIndex = outSequence.getNumEvents();
+    for (const auto &message : matched)
+    {
+        // appended at the end, because the messages are sorted,
+        // and none of them is earlier than the sequence's end time
+        outSequence.addEvent(message);
+    }
+
+    for (const auto &pair : pairs)
+    {
+        outSequence.getEventPointer(firstIndex + pair.noteOnIndex)->noteOffObject =
+            outSequence.getEventPointer(firstIndex + pair.noteOffIndex);
+    }
+
+    this->messages.clearQuick();
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class MidiExportBufferTests final : public UnitTest
+{
+public:
+
+    MidiExportBufferTests() : UnitTest("Midi export buffer tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        beginTest("Matches the sorted insert and updateMatchedPairs");
+
+        Random random(42);
+        MidiExportBuffer buffer;
+        MidiMessageSequence exported;
+        MidiMessageSequence expected;
+
+        // the second round overlaps the first one, like two clips would,
+        // and the notes often overlap each other on the same key
+        for (int round = 0; round < 2; ++round)
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                const int key = random.nextInt(8);
+                const double start = double(random.nextInt(400)) / 4.0;
+                const double end = start + double(1 + random.nextInt(16)) / 4.0;
+                const auto noteOn = MidiMessage::noteOn(1, key, 0.5f).withTimeStamp(start);
+                const auto noteOff = MidiMessage::noteOff(1, key).withTimeStamp(end);
+
+                buffer.add(noteOn, 1.0);
+                buffer.add(noteOff, 1.0);
+                expected.addEvent(noteOn, 1.0);
+                expected.addEvent(noteOff, 1.0);
+            }
+
+            buffer.flushTo(exported);
+            expected.updateMatchedPairs();
+        }
+
+        expectEquals(exported.getNumEvents(), expected.getNumEvents());
+
+        for (int i = 0; i < jmin(exported.getNumEvents(), expected.getNumEvents()); ++i)
+        {
+            const auto *a = exported.getEventPointer(i);
+            const auto *b = expected.getEventPointer(i);
+            expect(a->message.getTimeStamp() == b->message.getTimeStamp());
+            expect(a->message.isNoteOn() == b->message.isNoteOn());
+            expectEquals(a->message.getNoteNumber(), b->message.getNoteNumber());
+            expectEquals(exported.getIndexOf(a->noteOffObject), expected.getIndexOf(b->noteOffObject));
+        }
+    }
+};
+
+static MidiExportBufferTests midiExportBufferTests;
+
+#endif
@@ -0,0 +1,49 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Collects the messages exported by a sequence without keeping them sorted,
+// and then moves them into the target sequence at once: instead of a sorted
+// insert per message and the quadratic updateMatchedPairs, this sorts them
+// once and matches the note-on/note-off pairs in one linear pass.
+
+class MidiExportBuffer final
+{
+public:
+
+    MidiExportBuffer() = default;
+
+    void ensureStorageAllocated(int numMessages);
+
+    inline void add(const MidiMessage &message, double timeOffset)
+    {
+        this->messages.add(message);
+        this->messages.getReference(this->messages.size() - 1).addToTimeStamp(timeOffset);
+    }
+
+    // Moves all collected messages into the sequence, with note pairs
+    // matched the same way as MidiMessageSequence::updateMatchedPairs does,
+    // and leaves the buffer empty, so that it can be reused
+    void flushTo(MidiMessageSequence &outSequence);
+
+private:
+
+    Array<MidiMessage> messages;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiExportBuffer)
+};
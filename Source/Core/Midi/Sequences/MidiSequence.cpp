@@ -22,34 +22,23 @@
 #include "UndoStack.h"
 #include "MidiTrack.h"
 
-struct EventIdGenerator final
-{
-    static String generateId(uint8 length = 2)
-    {
-        String id;
-        static Random r;
-        r.setSeedRandomly();
-        static const char idChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-        for (size_t i = 0; i < length; ++i)
-        {
-            id += idChars[r.nextInt(62)];
-        }
-        return id;
-    }
-};
-
 MidiSequence::MidiSequence(MidiTrack &parentTrack,
-    ProjectEventDispatcher &dispatcher) noexcept :
+    ProjectEventDispatcher &dispatcher,
+    MidiEventAllocator &allocator) noexcept :
     track(parentTrack),
     eventDispatcher(dispatcher),
+    eventAllocator(allocator),
     lastStartBeat(0.f),
-    lastEndBeat(0.f) {}
+    lastEndBeat(0.f),
+    snapshot(new MidiSequenceSnapshot()) {}
 
 void MidiSequence::sort()
 {
     if (this->midiEvents.size() > 0)
     {
         this->midiEvents.sort(*this->midiEvents.getFirst());
+        this->invalidateSnapshot();
+        this->onEventsChangedInBulk();
     }
 }
 
@@ -113,12 +102,15 @@ void MidiSequence::exportMidi(MidiMessageSequence &outSequence, const Clip &clip
     // Moreover, for now, only PianoSequence will override this method
     // and make sure it skips a no-solo clip, when soloPlaybackMode is true.
 
+    MidiExportBuffer buffer;
+    buffer.ensureStorageAllocated(this->midiEvents.size());
+
     for (const auto *event : this->midiEvents)
     {
-        event->exportMessages(outSequence, clip, timeAdjustment, timeFactor);
+        event->exportMessages(buffer, clip, timeAdjustment, timeFactor);
     }
 
-    outSequence.updateMatchedPairs();
+    buffer.flushTo(outSequence);
 }
 
 float MidiSequence::midiTicksToBeats(double ticks, int timeFormat) noexcept
@@ -208,20 +200,250 @@ void MidiSequence::updateBeatRange(bool shouldNotifyIfChanged)
     }
 }
 
-String MidiSequence::createUniqueEventId() const noexcept
+void MidiSequence::addSortedEvents(Array<MidiEvent *> &newOwnedEvents)
+{
+    if (newOwnedEvents.isEmpty())
+    {
+        return;
+    }
+
+    const auto isSortedBefore = [](const MidiEvent *a, const MidiEvent *b)
+    {
+        return MidiEvent::compareElements(a, b) < 0;
+    };
+
+    std::sort(newOwnedEvents.begin(), newOwnedEvents.end(), isSortedBefore);
+
+    const int numOldEvents = this->midiEvents.size();
+    this->midiEvents.ensureStorageAllocated(numOldEvents + newOwnedEvents.size());
+    this->usedEventIds.reserve(this->usedEventIds.size() + newOwnedEvents.size());
+
+    for (auto *event : newOwnedEvents)
+    {
+        this->usedEventIds.insert(event->getId());
+        this->invalidateSnapshot(*event);
+        this->midiEvents.add(event);
+    }
+
+    std::inplace_merge(this->midiEvents.begin(),
+        this->midiEvents.begin() + numOldEvents,
+        this->midiEvents.end(), isSortedBefore);
+
+    this->onEventsChangedInBulk();
+}
+
+void MidiSequence::removeEvents(const FlatHashSet<const MidiEvent *> &eventsToDelete)
 {
-    uint8 length = 2;
-    String eventId = EventIdGenerator::generateId(length);
+    if (eventsToDelete.empty())
+    {
+        return;
+    }
+
+    // the partition only reorders the pointers, so the array
+    // still owns all of them until they are removed at the end:
+    auto *const firstRemoved = std::stable_partition(this->midiEvents.begin(),
+        this->midiEvents.end(), [&eventsToDelete](const MidiEvent *event)
+        {
+            return !eventsToDelete.contains(event);
+        });
+
+    const int numRemoved = int(this->midiEvents.end() - firstRemoved);
+    jassert(numRemoved == int(eventsToDelete.size()));
+
+    for (auto *it = firstRemoved; it != this->midiEvents.end(); ++it)
+    {
+        this->invalidateSnapshot(**it);
+    }
+
+    this->midiEvents.removeLast(numRemoved, true);
+
+    this->onEventsChangedInBulk();
+}
+
+void MidiSequence::resortChangedEvents(const FlatHashSet<const MidiEvent *> &changedEvents)
+{
+    if (changedEvents.empty())
+    {
+        return;
+    }
+
+    const auto isSortedBefore = [](const MidiEvent *a, const MidiEvent *b)
+    {
+        return MidiEvent::compareElements(a, b) < 0;
+    };
+
+    // the unchanged events are still sorted relative to each other,
+    // so move the changed ones to the end, sort them, and merge back:
+    auto *const firstChanged = std::stable_partition(this->midiEvents.begin(),
+        this->midiEvents.end(), [&changedEvents](const MidiEvent *event)
+        {
+            return !changedEvents.contains(event);
+        });
+
+    // (the callers invalidate the old positions before changing the events)
+    for (auto *it = firstChanged; it != this->midiEvents.end(); ++it)
+    {
+        this->invalidateSnapshot(**it);
+    }
+
+    std::sort(firstChanged, this->midiEvents.end(), isSortedBefore);
+    std::inplace_merge(this->midiEvents.begin(), firstChanged,
+        this->midiEvents.end(), isSortedBefore);
+
+    this->onEventsChangedInBulk();
+}
+
+//===----------------------------------------------------------------------===//
+// Snapshots
+//===----------------------------------------------------------------------===//
+
+MidiSequenceSnapshot::Ptr MidiSequence::getSnapshot() const
+{
+    if (MessageManager::getInstance()->isThisTheMessageThread())
+    {
+        this->updateSnapshot();
+    }
+
+    const SpinLock::ScopedLockType lock(this->snapshotLock);
+    return this->snapshot;
+}
+
+SerializedData MidiSequence::serializeSnapshot(const Identifier &type,
+    const NamedValueSet &summary) const
+{
+    const auto snapshot = this->getSnapshot();
+    return SerializedData::createDeferred(type, [snapshot, type]()
+    {
+        SerializedData tree(type);
+        snapshot->forEachEvent([&tree](const MidiEvent &event)
+        {
+            tree.appendChild(event.serialize());
+        });
+
+        return tree;
+    }, snapshot.get(), summary);
+}
+
+void MidiSequence::updateSnapshot() const
+{
+    if (!this->isSnapshotOutdated && this->outdatedSnapshotChunks.empty())
+    {
+        return;
+    }
+
+    const auto findChunkStart = [this](int chunkIndex)
+    {
+        return std::lower_bound(this->midiEvents.begin(), this->midiEvents.end(),
+            MidiSequenceSnapshot::getChunkStartBeat(chunkIndex),
+            [](const MidiEvent *event, float beat) { return event->getBeat() < beat; });
+    };
+
+    MidiSequenceSnapshot::Ptr newSnapshot(new MidiSequenceSnapshot());
+
+    if (this->isSnapshotOutdated)
+    {
+        for (auto *it = this->midiEvents.begin(); it != this->midiEvents.end();)
+        {
+            const int chunkIndex = MidiSequenceSnapshot::getChunkIndex((*it)->getBeat());
+            auto *const chunkEnd = findChunkStart(chunkIndex + 1);
+            newSnapshot->addChunk(new MidiSequenceSnapshot::Chunk(chunkIndex, it, chunkEnd));
+            it = chunkEnd;
+        }
+    }
+    else
+    {
+        Array<int> outdatedChunks;
+        outdatedChunks.ensureStorageAllocated(int(this->outdatedSnapshotChunks.size()));
+        for (const auto chunkIndex : this->outdatedSnapshotChunks)
+        {
+            outdatedChunks.add(chunkIndex);
+        }
+
+        outdatedChunks.sort();
+
+        // merge the untouched chunks of the previous snapshot
+        // with the freshly copied ones, skipping the emptied ones
+        const auto &oldChunks = this->snapshot->getChunks();
+        const int noChunk = std::numeric_limits<int>::max();
+        int i = 0;
+        int j = 0;
+        while (i < oldChunks.size() || j < outdatedChunks.size())
+        {
+            const int oldIndex = i < oldChunks.size() ? oldChunks.getUnchecked(i)->getIndex() : noChunk;
+            const int outdatedIndex = j < outdatedChunks.size() ? outdatedChunks.getUnchecked(j) : noChunk;
+
+            if (oldIndex < outdatedIndex)
+            {
+                newSnapshot->addChunk(oldChunks.getUnchecked(i));
+                ++i;
+                continue;
+            }
+
+            if (oldIndex == outdatedIndex)
+            {
+                ++i;
+            }
+
+            auto *const chunkStart = findChunkStart(outdatedIndex);
+            auto *const chunkEnd = findChunkStart(outdatedIndex + 1);
+            if (chunkStart != chunkEnd)
+            {
+                newSnapshot->addChunk(new MidiSequenceSnapshot::Chunk(outdatedIndex, chunkStart, chunkEnd));
+            }
+
+            ++j;
+        }
+    }
+
+    jassert(newSnapshot->size() == this->midiEvents.size());
+
+    this->isSnapshotOutdated = false;
+    this->outdatedSnapshotChunks.clear();
+
+    {
+        const SpinLock::ScopedLockType lock(this->snapshotLock);
+        std::swap(this->snapshot, newSnapshot);
+    }
+
+    // the previous snapshot, if no one else holds it, is deleted here, out of the lock
+}
+
+void MidiSequence::invalidateSnapshot(const MidiEvent &event)
+{
+    if (!this->isSnapshotOutdated)
+    {
+        this->outdatedSnapshotChunks.insert(MidiSequenceSnapshot::getChunkIndex(event.getBeat()));
+    }
+}
+
+void MidiSequence::invalidateSnapshot() noexcept
+{
+    this->isSnapshotOutdated = true;
+    this->outdatedSnapshotChunks.clear();
+}
+
+MidiEvent::Id MidiSequence::createUniqueEventId() const noexcept
+{
+    int length = 2;
+    auto eventId = this->idGenerator.generate(length);
     while (this->usedEventIds.contains(eventId))
     {
         length++;
-        eventId = EventIdGenerator::generateId(length);
+        eventId = this->idGenerator.generate(length);
     }
-    
-    this->usedEventIds.insert({eventId});
+
+    this->usedEventIds.insert(eventId);
     return eventId;
 }
 
+void MidiSequence::registerDeserializedEventId(MidiEvent &event)
+{
+    if (event.id == 0 || !this->usedEventIds.insert(event.id).second)
+    {
+        event.id = this->createUniqueEventId();
+    }
+}
+
 //===----------------------------------------------------------------------===//
 // Helpers
 //===----------------------------------------------------------------------===//
@@ -19,6 +19,8 @@
 
 #include "Clip.h"
 #include "MidiEvent.h"
+#include "MidiExportBuffer.h"
+#include "MidiSequenceSnapshot.h"
 #include "ProjectEventDispatcher.h"
 #include "UndoActionIDs.h"
 
@@ -31,7 +33,8 @@ class MidiSequence : public Serializable
 public:
 
     explicit MidiSequence(MidiTrack &track,
-        ProjectEventDispatcher &eventDispatcher) noexcept;
+        ProjectEventDispatcher &eventDispatcher,
+        MidiEventAllocator &eventAllocator = MidiEventAllocator::getDefault()) noexcept;
     
     //===------------------------------------------------------------------===//
     // Undoing
@@ -76,6 +79,8 @@ public:
 
         static T comparator;
         this->midiEvents.addSorted(comparator, new T(this, event));
+        this->invalidateSnapshot(event);
+        this->onEventsChangedInBulk();
     }
 
     template<typename T>
@@ -93,7 +98,9 @@ public:
 
         static T comparator;
         this->usedEventIds.insert(event->getId());
+        this->invalidateSnapshot(*event);
         this->midiEvents.addSorted(comparator, event.release());
+        this->onEventsChangedInBulk();
     }
 
     //===------------------------------------------------------------------===//
@@ -129,13 +136,37 @@ public:
         return this->midiEvents.indexOfSorted(*event, event);
     }
 
+    //===------------------------------------------------------------------===//
+    // Snapshots
+    //===------------------------------------------------------------------===//
+
+    // Returns the immutable copy of the events, which can be passed to
+    // and read on any thread, while the sequence keeps changing;
+    // on the message thread, brings the snapshot up to date first,
+    // on other threads, returns the one last updated
+    MidiSequenceSnapshot::Ptr getSnapshot() const;
+
+    // Copies the chunks changed since the last update into a new snapshot,
+    // sharing all the others with the previous one; message thread only;
+    // the subclasses also call it at the end of deserialize(), so that
+    // the background readers never get an empty snapshot of a loaded sequence
+    void updateSnapshot() const;
+
+    // Returns a deferred node of the given type, which only serializes
+    // the events of the current snapshot when accessed, on whatever thread,
+    // so that saving can capture the sequence now and write it later;
+    // the snapshot is its content key, as it only changes with the events;
+    // the summary is passed to the node as is, see SerializedData::createDeferred
+    SerializedData serializeSnapshot(const Identifier &type,
+        const NamedValueSet &summary = {}) const;
+
     //===------------------------------------------------------------------===//
     // Helpers
     //===------------------------------------------------------------------===//
 
     void updateBeatRange(bool shouldNotifyIfChanged);
 
-    String createUniqueEventId() const noexcept;
+    MidiEvent::Id createUniqueEventId() const noexcept;
     const String &getTrackId() const noexcept;
     int getChannel() const noexcept;
 
@@ -155,13 +186,48 @@ protected:
 
     ProjectEventDispatcher &eventDispatcher;
     ProjectNode *getProject() const noexcept;
+
+    // the subclasses create their events with it
+    MidiEventAllocator &eventAllocator;
     UndoStack *getUndoStack() const noexcept;
 
     OwnedArray<MidiEvent> midiEvents;
-    mutable FlatHashSet<MidiEvent::Id, StringHash> usedEventIds;
-    
+    mutable FlatHashSet<MidiEvent::Id, IdHash> usedEventIds;
+    mutable IdGenerator idGenerator;
+
+    // Helpers for the group operations: instead of shifting the array
+    // for each event, these sort the group once and merge it into
+    // the array, or compact the array in one pass, and then call
+    // onEventsChangedInBulk() once; all take O(n + k log k)
+    void addSortedEvents(Array<MidiEvent *> &newOwnedEvents);
+    void removeEvents(const FlatHashSet<const MidiEvent *> &eventsToDelete);
+    void resortChangedEvents(const FlatHashSet<const MidiEvent *> &changedEvents);
+
+    // Called whenever the events array is changed bypassing
+    // the subclass' own editing methods (see importMidiEvent,
+    // checkoutEvent and sort), so that the subclass can
+    // invalidate whatever it caches about the events
+    virtual void onEventsChangedInBulk() noexcept {}
+
+    // Called by all the editing methods before and after changing
+    // the events, so that the next snapshot update only copies
+    // the chunks containing them; or the whole sequence
+    void invalidateSnapshot(const MidiEvent &event);
+    void invalidateSnapshot() noexcept;
+
+    // Called by deserialize() for each event read: the legacy ids that
+    // failed to parse are hashed (see IdGenerator::fromString), so they
+    // might collide, and any event with a duplicate or a missing id
+    // gets a fresh one here instead of being lost on the next checkout
+    void registerDeserializedEventId(MidiEvent &event);
+
 private:
 
+    mutable MidiSequenceSnapshot::Ptr snapshot;
+    mutable SpinLock snapshotLock;
+    mutable FlatHashSet<int> outdatedSnapshotChunks;
+    mutable bool isSnapshotOutdated = true;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiSequence)
     JUCE_DECLARE_WEAK_REFERENCEABLE(MidiSequence)
 };
@@ -0,0 +1,56 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiSequenceSnapshot.h"
+#include "Note.h"
+#include "AutomationEvent.h"
+#include "AnnotationEvent.h"
+#include "TimeSignatureEvent.h"
+#include "KeySignatureEvent.h"
+
+MidiSequenceSnapshot::Chunk::Chunk(int index,
+    MidiEvent *const *begin, MidiEvent *const *end) :
+    index(index)
+{
+    this->events.ensureStorageAllocated(int(end - begin));
+    for (auto *it = begin; it != end; ++it)
+    {
+        jassert(MidiSequenceSnapshot::getChunkIndex((*it)->getBeat()) == index);
+        this->events.add(MidiSequenceSnapshot::copyEvent(**it));
+    }
+}
+
+MidiEvent *MidiSequenceSnapshot::copyEvent(const MidiEvent &event)
+{
+    switch (event.getType())
+    {
+    case MidiEvent::Type::Note:
+        return new Note(nullptr, static_cast<const Note &>(event));
+    case MidiEvent::Type::Auto:
+        return new AutomationEvent(nullptr, static_cast<const AutomationEvent &>(event));
+    case MidiEvent::Type::Annotation:
+        return new AnnotationEvent(nullptr, static_cast<const AnnotationEvent &>(event));
+    case MidiEvent::Type::TimeSignature:
+        return new TimeSignatureEvent(nullptr, static_cast<const TimeSignatureEvent &>(event));
+    case MidiEvent::Type::KeySignature:
+        return new KeySignatureEvent(nullptr, static_cast<const KeySignatureEvent &>(event));
+    }
+
+    jassertfalse;
+    return nullptr;
+}
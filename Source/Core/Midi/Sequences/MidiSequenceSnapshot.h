@@ -0,0 +1,119 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MidiEvent.h"
+
+// An immutable copy of the sequence's events, which can be read on any thread
+// without locking, while the sequence itself keeps changing on the message thread.
+
+// The copies are grouped into chunks by beat ranges, and each new snapshot
+// shares all the chunks which have not changed since the previous one with it,
+// so that taking a snapshot after an edit only copies the chunks that edit
+// has touched; the chunks are ref-counted, and the last snapshot holding
+// a chunk deletes it, on whatever thread it happens to be released.
+
+// A snapshot is also the content key of the sequence's serialized data,
+// see MidiSequence::serializeSnapshot, as it never changes once taken
+class MidiSequenceSnapshot final : public SerializedData::ContentKey
+{
+public:
+
+    using Ptr = ReferenceCountedObjectPtr<MidiSequenceSnapshot>;
+
+    class Chunk final : public ReferenceCountedObject
+    {
+    public:
+
+        using Ptr = ReferenceCountedObjectPtr<Chunk>;
+
+        // Copies the events in the given range, which are all expected
+        // to fall into the chunk, keeping them sorted as they are
+        Chunk(int index, MidiEvent *const *begin, MidiEvent *const *end);
+
+        inline int getIndex() const noexcept
+        { return this->index; }
+
+        inline const OwnedArray<MidiEvent> &getEvents() const noexcept
+        { return this->events; }
+
+    private:
+
+        const int index;
+
+        // the copies don't belong to any sequence
+        OwnedArray<MidiEvent> events;
+
+        JUCE_DECLARE_NON_COPYABLE(Chunk)
+    };
+
+    MidiSequenceSnapshot() = default;
+
+    inline int size() const noexcept
+    { return this->numEvents; }
+
+    inline bool isEmpty() const noexcept
+    { return this->numEvents == 0; }
+
+    inline const Array<Chunk::Ptr> &getChunks() const noexcept
+    { return this->chunks; }
+
+    // Iterates all the events in the sequence order
+    template<typename Callback>
+    void forEachEvent(Callback callback) const
+    {
+        for (const auto &chunk : this->chunks)
+        {
+            for (const auto *event : chunk->getEvents())
+            {
+                callback(*event);
+            }
+        }
+    }
+
+    static constexpr float beatsPerChunk = 16.f;
+
+    static inline int getChunkIndex(float beat) noexcept
+    {
+        return int(std::floor(beat / beatsPerChunk));
+    }
+
+    static inline float getChunkStartBeat(int chunkIndex) noexcept
+    {
+        return float(chunkIndex) * beatsPerChunk;
+    }
+
+    static MidiEvent *copyEvent(const MidiEvent &event);
+
+private:
+
+    // the chunks are sorted by index, and only the
+    // sequence which takes the snapshot fills them in
+    Array<Chunk::Ptr> chunks;
+    int numEvents = 0;
+
+    inline void addChunk(Chunk::Ptr chunk)
+    {
+        this->numEvents += chunk->getEvents().size();
+        this->chunks.add(chunk);
+    }
+
+    friend class MidiSequence;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiSequenceSnapshot)
+};
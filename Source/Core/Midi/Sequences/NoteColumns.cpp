@@ -0,0 +1,389 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteColumns.h"
+
+void NoteColumns::clear() noexcept
+{
+    this->beats.clearQuick();
+    this->lengths.clearQuick();
+    this->velocities.clearQuick();
+    this->keys.clearQuick();
+    this->tuplets.clearQuick();
+    this->notes.clearQuick();
+
+    this->endsTree.clearQuick();
+    this->numLeaves = 0;
+    this->endsTreeOutdated = false;
+    this->firstShiftedLeaf = std::numeric_limits<int>::max();
+    this->maxEndBeat = -FLT_MAX;
+    this->maxEndOutdated = false;
+}
+
+void NoteColumns::rebuild(const OwnedArray<MidiEvent> &events)
+{
+    this->clear();
+
+    const int numEvents = events.size();
+    this->beats.ensureStorageAllocated(numEvents);
+    this->lengths.ensureStorageAllocated(numEvents);
+    this->velocities.ensureStorageAllocated(numEvents);
+    this->keys.ensureStorageAllocated(numEvents);
+    this->tuplets.ensureStorageAllocated(numEvents);
+    this->notes.ensureStorageAllocated(numEvents);
+
+    for (const auto *event : events)
+    {
+        jassert(event->isTypeOf(MidiEvent::Type::Note));
+        const auto *note = static_cast<const Note *>(event);
+        this->beats.add(note->getBeat());
+        this->lengths.add(note->getLength());
+        this->velocities.add(note->getVelocity());
+        this->keys.add(note->getKey());
+        this->tuplets.add(note->getTuplet());
+        this->notes.add(note);
+    }
+
+    this->endsTreeOutdated = true;
+    this->maxEndOutdated = true;
+}
+
+void NoteColumns::insert(int index, const Note &note)
+{
+    jassert(isPositiveAndNotGreaterThan(index, this->size()));
+    this->beats.insert(index, note.getBeat());
+    this->lengths.insert(index, note.getLength());
+    this->velocities.insert(index, note.getVelocity());
+    this->keys.insert(index, note.getKey());
+    this->tuplets.insert(index, note.getTuplet());
+    this->notes.insert(index, &note);
+
+    this->markLeavesShiftedFrom(index);
+    if (!this->maxEndOutdated)
+    {
+        this->maxEndBeat = jmax(this->maxEndBeat, this->getEndBeat(index));
+    }
+}
+
+void NoteColumns::remove(int index)
+{
+    jassert(isPositiveAndBelow(index, this->size()));
+
+    this->markLeavesShiftedFrom(index);
+    if (this->getEndBeat(index) >= this->maxEndBeat)
+    {
+        this->maxEndOutdated = true;
+    }
+
+    this->beats.remove(index);
+    this->lengths.remove(index);
+    this->velocities.remove(index);
+    this->keys.remove(index);
+    this->tuplets.remove(index);
+    this->notes.remove(index);
+}
+
+void NoteColumns::update(int index, const Note &note)
+{
+    jassert(isPositiveAndBelow(index, this->size()));
+
+    const float oldEndBeat = this->getEndBeat(index);
+
+    this->beats.setUnchecked(index, note.getBeat());
+    this->lengths.setUnchecked(index, note.getLength());
+    this->velocities.setUnchecked(index, note.getVelocity());
+    this->keys.setUnchecked(index, note.getKey());
+    this->tuplets.setUnchecked(index, note.getTuplet());
+    this->notes.setUnchecked(index, &note);
+
+    if (!this->endsTreeOutdated && index < this->firstShiftedLeaf)
+    {
+        this->updateEndsTreeLeaf(index);
+        if (this->firstShiftedLeaf == std::numeric_limits<int>::max())
+        {
+            this->maxEndBeat = this->endsTree.getUnchecked(1);
+            this->maxEndOutdated = false;
+            return;
+        }
+    }
+
+    // the tree is to be updated anyway, just keep the max end if possible
+    const float newEndBeat = this->getEndBeat(index);
+    if (oldEndBeat >= this->maxEndBeat && newEndBeat < oldEndBeat)
+    {
+        this->maxEndOutdated = true;
+    }
+    else if (!this->maxEndOutdated)
+    {
+        this->maxEndBeat = jmax(this->maxEndBeat, newEndBeat);
+    }
+}
+
+int NoteColumns::indexOfFirstNoteAtOrAfter(float beat) const noexcept
+{
+    return int(std::lower_bound(this->beats.begin(), this->beats.end(), beat) - this->beats.begin());
+}
+
+Range<int> NoteColumns::findNotesStartingWithin(float startBeat, float endBeat) const noexcept
+{
+    const int start = this->indexOfFirstNoteAtOrAfter(startBeat);
+    const int end = jmax(start, this->indexOfFirstNoteAtOrAfter(endBeat));
+    return { start, end };
+}
+
+float NoteColumns::getMaxEndBeat() const noexcept
+{
+    if (this->maxEndOutdated)
+    {
+        this->updateEndsTreeIfNeeded();
+    }
+
+    return this->maxEndBeat;
+}
+
+void NoteColumns::markLeavesShiftedFrom(int index) noexcept
+{
+    this->firstShiftedLeaf = jmin(this->firstShiftedLeaf, index);
+
+    // the tree only grows when rebuilt
+    if (this->size() > this->numLeaves)
+    {
+        this->endsTreeOutdated = true;
+    }
+}
+
+void NoteColumns::updateEndsTreeLeaf(int index) const noexcept
+{
+    auto *tree = this->endsTree.getRawDataPointer();
+
+    int node = this->numLeaves + index;
+    tree[node] = this->getEndBeat(index);
+
+    for (node /= 2; node > 0; node /= 2)
+    {
+        tree[node] = jmax(tree[node * 2], tree[node * 2 + 1]);
+    }
+}
+
+void NoteColumns::updateEndsTreeIfNeeded() const
+{
+    const int numNotes = this->size();
+
+    if (!this->endsTreeOutdated)
+    {
+        if (this->firstShiftedLeaf == std::numeric_limits<int>::max())
+        {
+            jassert(!this->maxEndOutdated);
+            return;
+        }
+
+        // the leaves before the first shifted one are still valid,
+        // so only refresh the rest, and their ancestors level by level;
+        // the removes leave the padding leaves at the end
+        jassert(numNotes <= this->numLeaves);
+        auto *tree = this->endsTree.getRawDataPointer();
+        for (int i = this->firstShiftedLeaf; i < this->numLeaves; ++i)
+        {
+            tree[this->numLeaves + i] = (i < numNotes) ? this->getEndBeat(i) : -FLT_MAX;
+        }
+
+        for (int begin = (this->numLeaves + this->firstShiftedLeaf) / 2,
+            end = this->numLeaves - 1; begin > 0; begin /= 2, end /= 2)
+        {
+            for (int i = begin; i <= end; ++i)
+            {
+                tree[i] = jmax(tree[i * 2], tree[i * 2 + 1]);
+            }
+        }
+
+        this->maxEndBeat = (numNotes > 0) ? tree[1] : -FLT_MAX;
+        this->firstShiftedLeaf = std::numeric_limits<int>::max();
+        this->maxEndOutdated = false;
+        return;
+    }
+
+    this->numLeaves = 1;
+    while (this->numLeaves < numNotes)
+    {
+        this->numLeaves *= 2;
+    }
+
+    // the padding leaves never overlap anything
+    this->endsTree.clearQuick();
+    this->endsTree.insertMultiple(0, -FLT_MAX, this->numLeaves * 2);
+
+    auto *tree = this->endsTree.getRawDataPointer();
+    for (int i = 0; i < numNotes; ++i)
+    {
+        tree[this->numLeaves + i] = this->getEndBeat(i);
+    }
+
+    for (int i = this->numLeaves - 1; i > 0; --i)
+    {
+        tree[i] = jmax(tree[i * 2], tree[i * 2 + 1]);
+    }
+
+    this->maxEndBeat = (numNotes > 0) ? tree[1] : -FLT_MAX;
+    this->endsTreeOutdated = false;
+    this->firstShiftedLeaf = std::numeric_limits<int>::max();
+    this->maxEndOutdated = false;
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class NoteColumnsTests final : public UnitTest
+{
+public:
+
+    NoteColumnsTests() : UnitTest("Note columns tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        Random random(42);
+        OwnedArray<MidiEvent> notes;
+        for (int i = 0; i < 1000; ++i)
+        {
+            const float beat = float(random.nextInt(4000)) / 4.f;
+            const float length = float(1 + random.nextInt(64)) / 4.f;
+            notes.add(new Note(nullptr, random.nextInt(128), beat, length));
+        }
+
+        std::stable_sort(notes.begin(), notes.end(), [](const MidiEvent *a, const MidiEvent *b)
+        {
+            return a->getBeat() < b->getBeat();
+        });
+
+        NoteColumns columns;
+        columns.rebuild(notes);
+
+        beginTest("Max end beat");
+
+        this->expectMatchesLinearScan(columns, random);
+
+        beginTest("Max end beat after removing the last-ending note");
+
+        int lastEndingIndex = 0;
+        for (int i = 0; i < columns.size(); ++i)
+        {
+            if (columns.getBeat(i) + columns.getLength(i) >= columns.getMaxEndBeat())
+            {
+                lastEndingIndex = i;
+            }
+        }
+
+        columns.remove(lastEndingIndex);
+        this->expectMatchesLinearScan(columns, random);
+
+        beginTest("Overlapping notes after inserts");
+
+        for (int i = 0; i < 100; ++i)
+        {
+            auto *note = new Note(nullptr, 0, float(random.nextInt(4000)) / 4.f, 100.f);
+            notes.add(note);
+            columns.insert(columns.indexOfFirstNoteAtOrAfter(note->getBeat()), *note);
+        }
+
+        this->expectMatchesLinearScan(columns, random);
+
+        beginTest("Overlapping notes after in-place changes");
+
+        for (int i = 0; i < 100; ++i)
+        {
+            // shortening the notes which end last exercises
+            // the max end beat going down through the tree
+            const int index = random.nextInt(columns.size());
+            const float length = (i % 2 == 0) ? 0.25f : float(1 + random.nextInt(400)) / 4.f;
+            auto *note = new Note(columns.getNote(index).withLength(length));
+            notes.add(note);
+            columns.update(index, *note);
+            expectEquals(columns.getLength(index), length);
+
+            if (i % 10 == 0)
+            {
+                this->expectMatchesLinearScan(columns, random);
+            }
+        }
+
+        beginTest("Overlapping notes after removes, inserts and changes");
+
+        for (int i = 0; i < 100; ++i)
+        {
+            columns.remove(random.nextInt(columns.size()));
+
+            auto *note = new Note(nullptr, 0, float(random.nextInt(4000)) / 4.f, 1.f);
+            notes.add(note);
+            columns.insert(columns.indexOfFirstNoteAtOrAfter(note->getBeat()), *note);
+
+            // changes both before and after the first shifted leaf
+            const int index = random.nextInt(columns.size());
+            auto *changedNote = new Note(columns.getNote(index).withLength(50.f));
+            notes.add(changedNote);
+            columns.update(index, *changedNote);
+
+            if (i % 10 == 0)
+            {
+                this->expectMatchesLinearScan(columns, random);
+            }
+        }
+
+        this->expectMatchesLinearScan(columns, random);
+    }
+
+private:
+
+    void expectMatchesLinearScan(const NoteColumns &columns, Random &random)
+    {
+        float maxEndBeat = -FLT_MAX;
+        for (int i = 0; i < columns.size(); ++i)
+        {
+            maxEndBeat = jmax(maxEndBeat, columns.getBeat(i) + columns.getLength(i));
+        }
+
+        expectEquals(columns.getMaxEndBeat(), maxEndBeat);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            const float startBeat = float(random.nextInt(4200)) / 4.f;
+            const float endBeat = startBeat + float(random.nextInt(32)) / 4.f;
+
+            Array<int> expected;
+            for (int j = 0; j < columns.size(); ++j)
+            {
+                if (columns.getBeat(j) < endBeat &&
+                    columns.getBeat(j) + columns.getLength(j) > startBeat)
+                {
+                    expected.add(j);
+                }
+            }
+
+            Array<int> found;
+            columns.findNotesOverlapping(startBeat, endBeat,
+                [&found](int index) { found.add(index); });
+
+            expect(found == expected);
+        }
+    }
+};
+
+static NoteColumnsTests noteColumnsTests;
+
+#endif
@@ -0,0 +1,151 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Note.h"
+
+// A packed copy of the piano sequence's notes, one contiguous array per
+// each parameter, kept in the same order as the sequence's own events:
+// the loops over all notes (export, range queries, etc.) read these
+// arrays instead of chasing the pointers to notes all over the heap.
+
+// The notes themselves still own the data and are what the rest of the app
+// deals with; the column index is a lightweight handle to a note, and
+// getNote() gets the note itself by that handle.
+
+// Since the notes are sorted by start beat only, a long note starting early
+// can end after all the others, so the columns also keep a max-end segment
+// tree on top of the sorted beats: it answers where the sequence really ends,
+// and finds all notes overlapping a range in O(log n + k). A note changed
+// in place only updates its leaf and the leaf's ancestors, in O(log n);
+// the inserts and removes shift the indices, so the leaves after the first
+// shifted one are refreshed lazily, once per any number of edits, on the
+// next query; only the bulk edits and the growth rebuild the whole tree.
+
+class NoteColumns final
+{
+public:
+
+    NoteColumns() = default;
+
+    void clear() noexcept;
+    void rebuild(const OwnedArray<MidiEvent> &notes);
+
+    void insert(int index, const Note &note);
+    void remove(int index);
+
+    // The note has changed, but is still sorted at the same index
+    void update(int index, const Note &note);
+
+    inline int size() const noexcept { return this->notes.size(); }
+
+    inline float getBeat(int index) const noexcept
+    { return this->beats.getUnchecked(index); }
+
+    inline float getLength(int index) const noexcept
+    { return this->lengths.getUnchecked(index); }
+
+    inline float getVelocity(int index) const noexcept
+    { return this->velocities.getUnchecked(index); }
+
+    inline Note::Key getKey(int index) const noexcept
+    { return this->keys.getUnchecked(index); }
+
+    inline Note::Tuplet getTuplet(int index) const noexcept
+    { return this->tuplets.getUnchecked(index); }
+
+    inline const Note &getNote(int index) const noexcept
+    { return *this->notes.getUnchecked(index); }
+
+    // Binary search over the packed beats:
+    // the index of the first note starting at or after the given beat
+    int indexOfFirstNoteAtOrAfter(float beat) const noexcept;
+
+    // The indices of the notes starting within [startBeat, endBeat)
+    Range<int> findNotesStartingWithin(float startBeat, float endBeat) const noexcept;
+
+    // The end beat of the note that ends last, or -FLT_MAX if empty
+    float getMaxEndBeat() const noexcept;
+
+    // Calls back with the indices of all notes which start before endBeat
+    // and end after startBeat, in ascending order; note that for
+    // startBeat == endBeat, these are the notes sounding at that beat,
+    // excluding the ones that start exactly there
+    template<typename Callback>
+    void findNotesOverlapping(float startBeat, float endBeat, Callback callback) const
+    {
+        const int end = this->indexOfFirstNoteAtOrAfter(endBeat);
+        if (end == 0)
+        {
+            return;
+        }
+
+        this->updateEndsTreeIfNeeded();
+        this->findNotesOverlapping(1, 0, this->numLeaves, end, startBeat, callback);
+    }
+
+private:
+
+    template<typename Callback>
+    void findNotesOverlapping(int node, int nodeBegin, int nodeEnd,
+        int end, float startBeat, Callback &callback) const
+    {
+        if (nodeBegin >= end || this->endsTree.getUnchecked(node) <= startBeat)
+        {
+            return;
+        }
+
+        if (nodeEnd - nodeBegin == 1)
+        {
+            callback(nodeBegin);
+            return;
+        }
+
+        const int middle = (nodeBegin + nodeEnd) / 2;
+        this->findNotesOverlapping(node * 2, nodeBegin, middle, end, startBeat, callback);
+        this->findNotesOverlapping(node * 2 + 1, middle, nodeEnd, end, startBeat, callback);
+    }
+
+    Array<float> beats;
+    Array<float> lengths;
+    Array<float> velocities;
+    Array<Note::Key> keys;
+    Array<Note::Tuplet> tuplets;
+    Array<const Note *> notes;
+
+    // the implicit binary tree of max end beats, the root is at 1,
+    // and the leaves are at [numLeaves, numLeaves * 2)
+    mutable Array<float> endsTree;
+    mutable int numLeaves = 0;
+    mutable bool endsTreeOutdated = false;
+    mutable int firstShiftedLeaf = std::numeric_limits<int>::max();
+
+    // kept up to date on inserts, and only needs
+    // the tree update when the last-ending note is removed
+    mutable float maxEndBeat = -FLT_MAX;
+    mutable bool maxEndOutdated = false;
+
+    inline float getEndBeat(int index) const noexcept
+    { return this->beats.getUnchecked(index) + this->lengths.getUnchecked(index); }
+
+    void updateEndsTreeIfNeeded() const;
+    void updateEndsTreeLeaf(int index) const noexcept;
+    void markLeavesShiftedFrom(int index) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE(NoteColumns)
+};
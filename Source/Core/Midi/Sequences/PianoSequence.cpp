@@ -26,41 +26,81 @@
 #include "UndoStack.h"
 
 PianoSequence::PianoSequence(MidiTrack &track,
-    ProjectEventDispatcher &dispatcher) noexcept :
-    MidiSequence(track, dispatcher) {}
+    ProjectEventDispatcher &dispatcher, MidiEventAllocator &allocator) noexcept :
+    MidiSequence(track, dispatcher, allocator) {}
 
 //===----------------------------------------------------------------------===//
 // Import/export
 //===----------------------------------------------------------------------===//
 
-void PianoSequence::importMidi(const MidiMessageSequence &sequence, short timeFormat)
+// Pairs the note-ons and note-offs in a single pass, keeping the pending
+// note-on for each channel and key, instead of looking up the matching
+// key-up for each note-on; just like MidiMessageSequence::updateMatchedPairs,
+// a repeated note-on for the same channel and key ends the pending note
+static void collectImportedNotes(const MidiMessageSequence &sequence, short timeFormat,
+    WeakReference<MidiSequence> owner, MidiEventAllocator &allocator, Array<MidiEvent *> &outNotes)
 {
-    this->clearUndoHistory();
-    this->checkpoint();
+    struct PendingNote final
+    {
+        float beat;
+        float velocity;
+        bool isPending;
+    };
+
+    static constexpr auto numKeys = 128;
+    HeapBlock<PendingNote> pendingNotes(16 * numKeys, true);
+
+    const auto endPendingNote = [&outNotes, &owner, &allocator](PendingNote &pending, int key, float endBeat)
+    {
+        pending.isPending = false;
+        if (endBeat > pending.beat)
+        {
+            outNotes.add(new (allocator) Note(owner, key,
+                pending.beat, endBeat - pending.beat, pending.velocity));
+        }
+    };
+
+    outNotes.ensureStorageAllocated(outNotes.size() + sequence.getNumEvents() / 2);
 
     for (int i = 0; i < sequence.getNumEvents(); ++i)
     {
-        const auto &messageOn = sequence.getEventPointer(i)->message;
-        if (messageOn.isNoteOn())
+        const auto &message = sequence.getEventPointer(i)->message;
+        if (!message.isNoteOnOrOff())
         {
-            const int key = messageOn.getNoteNumber();
-            const float velocity = messageOn.getVelocity() / 128.f;
-            const float startBeat = MidiSequence::midiTicksToBeats(messageOn.getTimeStamp(), timeFormat);
-            const int noteOffIndex = sequence.getIndexOfMatchingKeyUp(i);
-            if (noteOffIndex > 0)
-            {
-                const MidiMessage &messageOff = sequence.getEventPointer(noteOffIndex)->message;
-                const float endBeat = MidiSequence::midiTicksToBeats(messageOff.getTimeStamp(), timeFormat);
-                if (endBeat > startBeat)
-                {
-                    const float length = float(endBeat - startBeat);
-                    const Note note(this, key, startBeat, length, velocity);
-                    this->importMidiEvent<Note>(note);
-                }
-            }
+            continue;
+        }
+
+        const int key = message.getNoteNumber();
+        const int channel = jlimit(1, 16, message.getChannel());
+        const float beat = MidiSequence::midiTicksToBeats(message.getTimeStamp(), timeFormat);
+        auto &pending = pendingNotes[(channel - 1) * numKeys + key];
+
+        if (pending.isPending)
+        {
+            endPendingNote(pending, key, beat);
+        }
+
+        if (message.isNoteOn())
+        {
+            pending.beat = beat;
+            pending.velocity = message.getVelocity() / 128.f;
+            pending.isPending = true;
         }
     }
 
+    // the notes still pending have no key-up, and are skipped
+}
+
+void PianoSequence::importMidi(const MidiMessageSequence &sequence, short timeFormat)
+{
+    this->clearUndoHistory();
+    this->checkpoint();
+
+    Array<MidiEvent *> importedNotes;
+    collectImportedNotes(sequence, timeFormat, this, this->eventAllocator, importedNotes);
+
+    // sorts all notes once, and merges them in:
+    this->addSortedEvents(importedNotes);
     this->updateBeatRange(false);
 }
 
@@ -73,12 +113,22 @@ void PianoSequence::exportMidi(MidiMessageSequence &outSequence, const Clip &cli
         return;
     }
 
-    for (const auto *event : this->midiEvents)
+    // Go through the packed data instead of the notes themselves:
+    const auto &notes = this->getColumns();
+    const int channel = this->getChannel();
+
+    MidiExportBuffer buffer;
+    buffer.ensureStorageAllocated(notes.size() * 2);
+
+    for (int i = 0; i < notes.size(); ++i)
     {
-        event->exportMessages(outSequence, clip, timeAdjustment, timeFactor);
+        Note::exportMessages(buffer, clip, channel,
+            notes.getKey(i), notes.getBeat(i), notes.getLength(i),
+            notes.getVelocity(i), notes.getTuplet(i),
+            timeAdjustment, timeFactor);
     }
 
-    outSequence.updateMatchedPairs();
+    buffer.flushTo(outSequence);
 }
 
 //===----------------------------------------------------------------------===//
@@ -95,8 +145,9 @@ MidiEvent *PianoSequence::insert(const Note &eventParams, const bool undoable)
     }
     else
     {
-        auto *ownedNote = new Note(this, eventParams);
-        this->midiEvents.addSorted(*ownedNote, ownedNote);
+        auto *ownedNote = new (this->eventAllocator) Note(this, eventParams);
+        this->addSortedNote(ownedNote);
+        this->invalidateSnapshot(*ownedNote);
         this->eventDispatcher.dispatchAddEvent(*ownedNote);
         this->updateBeatRange(true);
         return ownedNote;
@@ -122,7 +173,8 @@ bool PianoSequence::remove(const Note &eventParams, const bool undoable)
             auto *removedNote = this->midiEvents.getUnchecked(index);
             jassert(removedNote->isValid());
             this->eventDispatcher.dispatchRemoveEvent(*removedNote);
-            this->midiEvents.remove(index, true);
+            this->invalidateSnapshot(*removedNote);
+            this->removeNoteAt(index, true);
             this->updateBeatRange(true);
             this->eventDispatcher.dispatchPostRemoveEvent(this);
             return true;
@@ -150,9 +202,19 @@ bool PianoSequence::change(const Note &oldParams,
         if (index >= 0)
         {
             auto *changedNote = static_cast<Note *>(this->midiEvents.getUnchecked(index));
+            this->invalidateSnapshot(oldParams);
             changedNote->applyChanges(newParams);
-            this->midiEvents.remove(index, false);
-            this->midiEvents.addSorted(*changedNote, changedNote);
+            if (keepsSortOrder(oldParams, newParams))
+            {
+                this->updateNoteAt(index);
+            }
+            else
+            {
+                this->removeNoteAt(index, false);
+                this->addSortedNote(changedNote);
+                this->invalidateSnapshot(*changedNote);
+            }
+
             this->eventDispatcher.dispatchChangeEvent(oldParams, *changedNote);
             this->updateBeatRange(true);
             return true;
@@ -174,14 +236,19 @@ bool PianoSequence::insertGroup(Array<Note> &group, bool undoable)
     }
     else
     {
-        for (int i = 0; i < group.size(); ++i)
+        Array<MidiEvent *> insertedNotes;
+        insertedNotes.ensureStorageAllocated(group.size());
+        for (const auto &eventParams : group)
         {
-            const Note &eventParams = group.getUnchecked(i);
-            auto *ownedNote = new Note(this, eventParams);
-            this->midiEvents.addSorted(*ownedNote, ownedNote);
-            this->eventDispatcher.dispatchAddEvent(*ownedNote);
+            insertedNotes.add(new (this->eventAllocator) Note(this, eventParams));
         }
 
+        this->addSortedEvents(insertedNotes);
+
+        Array<const MidiEvent *> notifications;
+        notifications.addArray(insertedNotes);
+        this->eventDispatcher.dispatchAddEvents(notifications);
+
         this->updateBeatRange(true);
     }
 
@@ -198,9 +265,13 @@ bool PianoSequence::removeGroup(Array<Note> &group, bool undoable)
     }
     else
     {
-        for (int i = 0; i < group.size(); ++i)
+        FlatHashSet<const MidiEvent *> removedNotes;
+        Array<const MidiEvent *> notifications;
+        removedNotes.reserve(group.size());
+        notifications.ensureStorageAllocated(group.size());
+
+        for (const auto &note : group)
         {
-            const Note &note = group.getUnchecked(i);
             const int index = this->midiEvents.indexOfSorted(note, &note);
             // Hitting this assertion almost likely means that target note array
             // contains more than one instance of the same note, but from different clips.
@@ -209,12 +280,18 @@ bool PianoSequence::removeGroup(Array<Note> &group, bool undoable)
             jassert(index >= 0);
             if (index >= 0)
             {
-                auto *removedNote = this->midiEvents.getUnchecked(index);
-                this->eventDispatcher.dispatchRemoveEvent(*removedNote);
-                this->midiEvents.remove(index, true);
+                const auto *removedNote = this->midiEvents.getUnchecked(index);
+                if (removedNotes.insert(removedNote).second)
+                {
+                    notifications.add(removedNote);
+                }
             }
         }
 
+        // notify before removing, while the notes are still valid
+        this->eventDispatcher.dispatchRemoveEvents(notifications);
+        this->removeEvents(removedNotes);
+
         this->updateBeatRange(true);
         this->eventDispatcher.dispatchPostRemoveEvent(this);
     }
@@ -235,10 +312,22 @@ bool PianoSequence::changeGroup(Array<Note> &groupBefore,
     }
     else
     {
+        FlatHashSet<const MidiEvent *> changedNotes;
+        Array<Note *> targetNotes;
+        Array<int> targetIndices;
+        Array<const Note *> targetParams;
+        Array<const MidiEvent *> oldNotifications;
+        bool allKeepSortOrder = true;
+        changedNotes.reserve(groupBefore.size());
+        targetNotes.ensureStorageAllocated(groupBefore.size());
+        targetIndices.ensureStorageAllocated(groupBefore.size());
+        targetParams.ensureStorageAllocated(groupBefore.size());
+        oldNotifications.ensureStorageAllocated(groupBefore.size());
+
+        // find all the notes first, while the array is still sorted
         for (int i = 0; i < groupBefore.size(); ++i)
         {
             const Note &oldParams = groupBefore.getReference(i);
-            const Note &newParams = groupAfter.getReference(i);
             const int index = this->midiEvents.indexOfSorted(oldParams, &oldParams);
             // if you're hitting this assertion, one of the reasons might be
             // allowing user to somehow select notes of different clips simultaneously,
@@ -249,13 +338,46 @@ bool PianoSequence::changeGroup(Array<Note> &groupBefore,
             if (index >= 0)
             {
                 auto *changedNote = static_cast<Note *>(this->midiEvents.getUnchecked(index));
-                changedNote->applyChanges(newParams);
-                this->midiEvents.remove(index, false);
-                this->midiEvents.addSorted(*changedNote, changedNote);
-                this->eventDispatcher.dispatchChangeEvent(oldParams, *changedNote);
+                const bool isUnique = changedNotes.insert(changedNote).second;
+                jassert(isUnique);
+                if (isUnique)
+                {
+                    targetNotes.add(changedNote);
+                    targetIndices.add(index);
+                    targetParams.add(&groupAfter.getReference(i));
+                    oldNotifications.add(&oldParams);
+                    allKeepSortOrder = allKeepSortOrder &&
+                        keepsSortOrder(oldParams, groupAfter.getReference(i));
+                }
             }
         }
 
+        Array<const MidiEvent *> newNotifications;
+        newNotifications.ensureStorageAllocated(targetNotes.size());
+        for (int i = 0; i < targetNotes.size(); ++i)
+        {
+            // the new positions are invalidated when resorting,
+            // or are the same as the old ones, if nothing moves
+            this->invalidateSnapshot(*oldNotifications.getUnchecked(i));
+            targetNotes.getUnchecked(i)->applyChanges(*targetParams.getUnchecked(i));
+            newNotifications.add(targetNotes.getUnchecked(i));
+        }
+
+        // the most common group edits, like changing the velocities
+        // or the lengths, keep all notes in place, so the columns
+        // are updated in place too, instead of being rebuilt
+        if (allKeepSortOrder)
+        {
+            for (const auto index : targetIndices)
+            {
+                this->updateNoteAt(index);
+            }
+        }
+        else
+        {
+            this->resortChangedEvents(changedNotes);
+        }
+        this->eventDispatcher.dispatchChangeEvents(oldNotifications, newNotifications);
         this->updateBeatRange(true);
     }
 
@@ -268,26 +390,66 @@ bool PianoSequence::changeGroup(Array<Note> &groupBefore,
 
 float PianoSequence::getLastBeat() const noexcept
 {
-    float lastBeat = -FLT_MAX;
-    if (this->midiEvents.size() == 0)
+    // the events are sorted by start beat, not by end beat,
+    // so the last event is not necessarily the one that ends last:
+    return this->getColumns().getMaxEndBeat();
+}
+
+const NoteColumns &PianoSequence::getColumns() const
+{
+    if (this->columnsOutdated)
+    {
+        // there's no lock here, so only rebuild on the message thread;
+        // other threads should make sure the columns are built beforehand
+        // (see ProjectNode's export), or read the sequence snapshot instead
+        jassert(MessageManager::existsAndIsCurrentThread());
+        this->columns.rebuild(this->midiEvents);
+        this->columnsOutdated = false;
+    }
+
+    return this->columns;
+}
+
+void PianoSequence::onEventsChangedInBulk() noexcept
+{
+    // will rebuild on the next access, instead of updating after each change
+    this->columnsOutdated = true;
+}
+
+void PianoSequence::addSortedNote(Note *note)
+{
+    const int index = this->midiEvents.addSorted(*note, note);
+    if (!this->columnsOutdated)
+    {
+        this->columns.insert(index, *note);
+    }
+}
+
+void PianoSequence::updateNoteAt(int index)
+{
+    if (!this->columnsOutdated)
     {
-        return lastBeat;
+        this->columns.update(index,
+            *static_cast<const Note *>(this->midiEvents.getUnchecked(index)));
     }
+}
+
+bool PianoSequence::keepsSortOrder(const Note &oldParams, const Note &newParams) noexcept
+{
+    // the notes are sorted by beat, then by key, then by id
+    return oldParams.getBeat() == newParams.getBeat() &&
+        oldParams.getKey() == newParams.getKey();
+}
 
-    // FIXME:
-    // sometimes the last event is not the one that lasts longer
-    // (as events *must* be sorted by start beat, not by end beat),
-    // so here we have to iterate through a number of last events
-    // to guess where the sequence really ends, with still no guarantee
-    // we'll end up with right event (not sure how to fix it at the moment):
-    const int checkStart = jmax(0, this->midiEvents.size() - 5);
-    for (int i = checkStart; i < this->midiEvents.size(); ++i)
-    {
-        const auto *n = static_cast<const Note *>(this->midiEvents.getUnchecked(i));
-        lastBeat = jmax(lastBeat, n->getBeat() + n->getLength());
+void PianoSequence::removeNoteAt(int index, bool deleteNote)
+{
+    // the columns only keep a pointer, so remove them first
+    if (!this->columnsOutdated)
+    {
+        this->columns.remove(index);
     }
 
-    return lastBeat;
+    this->midiEvents.remove(index, deleteNote);
 }
 
 //===----------------------------------------------------------------------===//
@@ -322,19 +484,364 @@ void PianoSequence::deserialize(const SerializedData &data)
 
     forEachChildWithType(root, e, Serialization::Midi::note)
     {
-        auto *note = new Note(this);
+        auto *note = new (this->eventAllocator) Note(this);
         note->deserialize(e);
 
         this->midiEvents.add(note); // sorted later
-        this->usedEventIds.insert(note->getId());
+        this->registerDeserializedEventId(*note);
     }
 
     this->sort();
     this->updateBeatRange(false);
+    this->updateSnapshot();
 }
 
 void PianoSequence::reset()
 {
     this->midiEvents.clear();
+    this->invalidateSnapshot();
     this->usedEventIds.clear();
+    this->columns.clear();
+    this->columnsOutdated = false;
 }
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#define PIANO_IMPORT_TEST_NUM_NOTES 20000
+#define PIANO_IMPORT_TEST_TIME_FORMAT 960
+#define PIANO_IMPORT_TEST_MIN_SPEEDUP 2.0
+
+// Compares the single-pass import with the previous one, which looked up
+// the matching key-up for each note-on, and then inserted the notes
+// one by one into the sorted array, both being linear for each note
+
+class PianoSequenceImportBenchmark final : public UnitTest
+{
+public:
+
+    PianoSequenceImportBenchmark() :
+        UnitTest("Piano sequence import benchmark", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        Random random(42);
+        MidiMessageSequence sequence;
+        for (int i = 0; i < PIANO_IMPORT_TEST_NUM_NOTES; ++i)
+        {
+            const int channel = 1 + random.nextInt(2);
+            const int key = random.nextInt(128);
+            const double start = double(random.nextInt(PIANO_IMPORT_TEST_NUM_NOTES * 4)) * 240.0;
+            const double length = double(1 + random.nextInt(16)) * 240.0;
+            sequence.addEvent(MidiMessage::noteOn(channel, key, 0.5f), start);
+            sequence.addEvent(MidiMessage::noteOff(channel, key), start + length);
+        }
+
+        sequence.sort();
+        sequence.updateMatchedPairs(); // as MidiFile::readFrom does
+
+        beginTest("Import of 20k notes");
+
+        OwnedArray<MidiEvent> importedNotes;
+        OwnedArray<MidiEvent> previouslyImportedNotes;
+
+        const auto importTime = this->runImport(sequence, importedNotes);
+        const auto previousImportTime = this->runPreviousImport(sequence, previouslyImportedNotes);
+
+        expectEquals(importedNotes.size(), previouslyImportedNotes.size());
+
+        const auto isSortedBefore = [](const MidiEvent *a, const MidiEvent *b)
+        {
+            const auto *na = static_cast<const Note *>(a);
+            const auto *nb = static_cast<const Note *>(b);
+            if (na->getBeat() != nb->getBeat()) { return na->getBeat() < nb->getBeat(); }
+            if (na->getKey() != nb->getKey()) { return na->getKey() < nb->getKey(); }
+            return na->getLength() < nb->getLength();
+        };
+
+        std::sort(importedNotes.begin(), importedNotes.end(), isSortedBefore);
+        std::sort(previouslyImportedNotes.begin(), previouslyImportedNotes.end(), isSortedBefore);
+
+        bool allNotesMatch = importedNotes.size() == previouslyImportedNotes.size();
+        for (int i = 0; allNotesMatch && i < importedNotes.size(); ++i)
+        {
+            const auto *a = static_cast<const Note *>(importedNotes.getUnchecked(i));
+            const auto *b = static_cast<const Note *>(previouslyImportedNotes.getUnchecked(i));
+            allNotesMatch = a->getBeat() == b->getBeat() && a->getKey() == b->getKey() &&
+                a->getLength() == b->getLength() && a->getVelocity() == b->getVelocity();
+        }
+
+        expect(allNotesMatch);
+
+        const auto speedup = previousImportTime / jmax(importTime, 0.000001);
+        logMessage("Previous import: " + String(previousImportTime * 1000.0, 2) + " ms");
+        logMessage("Single-pass import: " + String(importTime * 1000.0, 2) + " ms");
+        logMessage("Speedup: " + String(speedup, 2) + "x");
+
+        // the previous import is quadratic, so even
+        // on a busy machine, the margin should be large
+        expectGreaterThan(speedup, PIANO_IMPORT_TEST_MIN_SPEEDUP);
+    }
+
+private:
+
+    double runImport(const MidiMessageSequence &sequence, OwnedArray<MidiEvent> &outNotes)
+    {
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        Array<MidiEvent *> notes;
+        collectImportedNotes(sequence, PIANO_IMPORT_TEST_TIME_FORMAT,
+            nullptr, MidiEventAllocator::getDefault(), notes);
+
+        std::sort(notes.begin(), notes.end(), [](const MidiEvent *a, const MidiEvent *b)
+        {
+            return MidiEvent::compareElements(a, b) < 0;
+        });
+
+        outNotes.addArray(notes);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+
+    double runPreviousImport(const MidiMessageSequence &sequence, OwnedArray<MidiEvent> &outNotes)
+    {
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        static Note comparator;
+        for (int i = 0; i < sequence.getNumEvents(); ++i)
+        {
+            const auto &messageOn = sequence.getEventPointer(i)->message;
+            if (messageOn.isNoteOn())
+            {
+                const float startBeat = MidiSequence::midiTicksToBeats(messageOn.getTimeStamp(),
+                    PIANO_IMPORT_TEST_TIME_FORMAT);
+                const int noteOffIndex = sequence.getIndexOfMatchingKeyUp(i);
+                if (noteOffIndex > 0)
+                {
+                    const auto &messageOff = sequence.getEventPointer(noteOffIndex)->message;
+                    const float endBeat = MidiSequence::midiTicksToBeats(messageOff.getTimeStamp(),
+                        PIANO_IMPORT_TEST_TIME_FORMAT);
+                    if (endBeat > startBeat)
+                    {
+                        outNotes.addSorted(comparator, new Note(nullptr, messageOn.getNoteNumber(),
+                            startBeat, endBeat - startBeat, messageOn.getVelocity() / 128.f));
+                    }
+                }
+            }
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+};
+
+static PianoSequenceImportBenchmark pianoSequenceImportBenchmark;
+
+#define PIANO_ALLOCATION_TEST_NUM_NOTES 100000
+#define PIANO_ALLOCATION_TEST_NUM_ROUNDS 5
+#define PIANO_ALLOCATION_TEST_MIN_SPEEDUP 0.9
+
+// Compares the pooled event allocation with the default heap on the paths
+// that create and delete notes in bulk: paste, as inserting a group of notes,
+// its undo, as removing that group, and import; the allocator benchmark only
+// measures the raw allocations, and this one also includes all the work
+// these operations do besides allocating (sorting, hashing, notifying)
+
+class PianoSequenceAllocationBenchmark final : public UnitTest
+{
+public:
+
+    PianoSequenceAllocationBenchmark() :
+        UnitTest("Piano sequence allocation benchmark", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        Random random(42);
+        MidiMessageSequence midiSequence;
+        for (int i = 0; i < PIANO_ALLOCATION_TEST_NUM_NOTES; ++i)
+        {
+            const int key = random.nextInt(128);
+            const double start = double(random.nextInt(PIANO_ALLOCATION_TEST_NUM_NOTES)) * 240.0;
+            const double length = double(1 + random.nextInt(16)) * 240.0;
+            midiSequence.addEvent(MidiMessage::noteOn(1, key, 0.5f), start);
+            midiSequence.addEvent(MidiMessage::noteOff(1, key), start + length);
+        }
+
+        midiSequence.sort();
+
+        beginTest("Paste, undo and import of 100k notes");
+
+        // the sequences are given their own allocators,
+        // one with the pool and one using the default heap
+        MidiEventAllocator pool;
+        MidiEventAllocator defaultHeap(false);
+
+        // warm-up, so that both compare the steady state
+        Timings pooledTimings, defaultHeapTimings;
+        this->runRounds(midiSequence, 1, pool, pooledTimings);
+        this->runRounds(midiSequence, 1, defaultHeap, defaultHeapTimings);
+
+        defaultHeapTimings = {};
+        this->runRounds(midiSequence, PIANO_ALLOCATION_TEST_NUM_ROUNDS, defaultHeap, defaultHeapTimings);
+
+        pooledTimings = {};
+        this->runRounds(midiSequence, PIANO_ALLOCATION_TEST_NUM_ROUNDS, pool, pooledTimings);
+
+        this->expectSpeedup("Paste", defaultHeapTimings.paste, pooledTimings.paste);
+        this->expectSpeedup("Undo", defaultHeapTimings.undo, pooledTimings.undo);
+        this->expectSpeedup("Import", defaultHeapTimings.import, pooledTimings.import);
+    }
+
+private:
+
+    struct Timings final
+    {
+        double paste = 0.0;
+        double undo = 0.0;
+        double import = 0.0;
+    };
+
+    // all the events created here are also deleted here,
+    // before the allocator they were created with
+    void runRounds(const MidiMessageSequence &midiSequence, int numRounds,
+        MidiEventAllocator &allocator, Timings &timings)
+    {
+        TestPianoTrack track(allocator);
+        auto &sequence = track.sequence;
+
+        // the notes parameters are stored by value, as the undo actions do
+        Random random(42);
+        Array<Note> group;
+        group.ensureStorageAllocated(PIANO_ALLOCATION_TEST_NUM_NOTES);
+        for (int i = 0; i < PIANO_ALLOCATION_TEST_NUM_NOTES; ++i)
+        {
+            group.add(Note(&sequence, random.nextInt(128),
+                float(random.nextInt(PIANO_ALLOCATION_TEST_NUM_NOTES)) / 4.f,
+                float(1 + random.nextInt(16)) / 4.f));
+        }
+
+        for (int round = 0; round < numRounds; ++round)
+        {
+            auto startTicks = Time::getHighResolutionTicks();
+            sequence.insertGroup(group, false);
+            timings.paste += this->getSecondsSince(startTicks);
+            expectEquals(sequence.size(), PIANO_ALLOCATION_TEST_NUM_NOTES);
+
+            startTicks = Time::getHighResolutionTicks();
+            sequence.removeGroup(group, false);
+            timings.undo += this->getSecondsSince(startTicks);
+            expectEquals(sequence.size(), 0);
+
+            startTicks = Time::getHighResolutionTicks();
+            {
+                Array<MidiEvent *> notes;
+                collectImportedNotes(midiSequence, PIANO_IMPORT_TEST_TIME_FORMAT,
+                    &sequence, allocator, notes);
+
+                std::sort(notes.begin(), notes.end(), [](const MidiEvent *a, const MidiEvent *b)
+                {
+                    return MidiEvent::compareElements(a, b) < 0;
+                });
+
+                OwnedArray<MidiEvent> importedNotes;
+                importedNotes.addArray(notes);
+            }
+            timings.import += this->getSecondsSince(startTicks);
+        }
+
+        timings.paste /= numRounds;
+        timings.undo /= numRounds;
+        timings.import /= numRounds;
+    }
+
+    double getSecondsSince(int64 startTicks) const
+    {
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+
+    // these operations do a lot more than allocating, so the pool
+    // is only expected not to make any of them noticeably slower
+    void expectSpeedup(const String &operation, double defaultTime, double pooledTime)
+    {
+        const auto speedup = defaultTime / jmax(pooledTime, 0.000001);
+        logMessage(operation + ": default heap " + String(defaultTime * 1000.0, 2) +
+            " ms, pooled " + String(pooledTime * 1000.0, 2) + " ms, speedup " +
+            String(speedup, 2) + "x");
+
+        expectGreaterThan(speedup, PIANO_ALLOCATION_TEST_MIN_SPEEDUP, operation);
+    }
+};
+
+static PianoSequenceAllocationBenchmark pianoSequenceAllocationBenchmark;
+
+class PianoSequenceIdsTests final : public UnitTest
+{
+public:
+
+    PianoSequenceIdsTests() :
+        UnitTest("Piano sequence ids tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        beginTest("Colliding legacy ids are replaced on load");
+
+        using namespace Serialization;
+        SerializedData tree(Midi::track);
+
+        // two notes with the same legacy id, as if their ids had
+        // collided, and one without an id at all
+        const String idStrings[] = { "Zq3", "Zq3", {} };
+        for (int i = 0; i < numElementsInArray(idStrings); ++i)
+        {
+            SerializedData note(Midi::note);
+            if (idStrings[i].isNotEmpty())
+            {
+                note.setProperty(Midi::id, idStrings[i]);
+            }
+
+            note.setProperty(Midi::key, 60 + i);
+            note.setProperty(Midi::timestamp, i * TICKS_PER_BEAT);
+            note.setProperty(Midi::length, TICKS_PER_BEAT);
+            note.setProperty(Midi::volume, VELOCITY_SAVE_ACCURACY);
+            tree.appendChild(note);
+        }
+
+        TestPianoTrack track;
+        auto &sequence = track.sequence;
+        sequence.deserialize(tree);
+
+        expectEquals(sequence.size(), 3);
+
+        // the first note keeps its id, so that the version control
+        // deltas made before still apply to it
+        const auto *firstNote = sequence.getUnchecked(0);
+        expectEquals(firstNote->getId(), IdGenerator::fromString("Zq3"));
+
+        FlatHashSet<MidiEvent::Id, IdHash> ids;
+        for (int i = 0; i < sequence.size(); ++i)
+        {
+            const auto id = sequence.getUnchecked(i)->getId();
+            expect(id != 0);
+            expect(ids.insert(id).second);
+        }
+
+        beginTest("Replaced ids are saved and loaded back as is");
+
+        TestPianoTrack reloadedTrack;
+        auto &reloadedSequence = reloadedTrack.sequence;
+        reloadedSequence.deserialize(sequence.serialize());
+
+        expectEquals(reloadedSequence.size(), 3);
+        for (int i = 0; i < reloadedSequence.size(); ++i)
+        {
+            expectEquals(reloadedSequence.getUnchecked(i)->getId(),
+                sequence.getUnchecked(i)->getId());
+        }
+    }
+};
+
+static PianoSequenceIdsTests pianoSequenceIdsTests;
+
+#endif
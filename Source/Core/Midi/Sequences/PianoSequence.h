@@ -19,6 +19,7 @@
 
 #include "MidiSequence.h"
 #include "Note.h"
+#include "NoteColumns.h"
 
 class PianoRoll;
 
@@ -26,7 +27,8 @@ class PianoSequence final : public MidiSequence
 {
 public:
 
-    PianoSequence(MidiTrack &track, ProjectEventDispatcher &dispatcher) noexcept;
+    PianoSequence(MidiTrack &track, ProjectEventDispatcher &dispatcher,
+        MidiEventAllocator &allocator = MidiEventAllocator::getDefault()) noexcept;
 
     //===------------------------------------------------------------------===//
     // Import/export
@@ -57,6 +59,10 @@ public:
     //===------------------------------------------------------------------===//
     
     float getLastBeat() const noexcept override;
+
+    // The packed notes data, in the same order as the events;
+    // rebuilt lazily after bulk changes, on the message thread only
+    const NoteColumns &getColumns() const;
     
     //===------------------------------------------------------------------===//
     // Serializable
@@ -66,8 +72,48 @@ public:
     void deserialize(const SerializedData &data) override;
     void reset() override;
 
+protected:
+
+    void onEventsChangedInBulk() noexcept override;
+
 private:
 
+    // Keep the columns in sync with the events array
+    void addSortedNote(Note *note);
+    void updateNoteAt(int index);
+    void removeNoteAt(int index, bool deleteNote);
+    static bool keepsSortOrder(const Note &oldParams, const Note &newParams) noexcept;
+
+    mutable NoteColumns columns;
+    mutable bool columnsOutdated = false;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PianoSequence);
     JUCE_DECLARE_WEAK_REFERENCEABLE(PianoSequence);
 };
+
+#if JUCE_UNIT_TESTS
+
+#include "MidiTrack.h"
+
+// A standalone piano track for the tests, with no project around it:
+// the sequence's events are created with the given allocator,
+// and all the notifications go nowhere
+class TestPianoTrack final : public EmptyMidiTrack
+{
+public:
+
+    explicit TestPianoTrack(MidiEventAllocator &allocator = MidiEventAllocator::getDefault()) :
+        sequence(*this, dispatcher, allocator) {}
+
+    MidiSequence *getSequence() const noexcept override
+    {
+        return &this->sequence;
+    }
+
+    EmptyEventDispatcher dispatcher;
+    mutable PianoSequence sequence;
+
+    JUCE_DECLARE_NON_COPYABLE(TestPianoTrack)
+};
+
+#endif
@@ -69,6 +69,7 @@ MidiEvent *TimeSignaturesSequence::insert(const TimeSignatureEvent &eventParams,
     {
         auto *ownedEvent = new TimeSignatureEvent(this, eventParams);
         this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+        this->invalidateSnapshot(*ownedEvent);
         this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         this->updateBeatRange(true);
         return ownedEvent;
@@ -92,6 +93,7 @@ bool TimeSignaturesSequence::remove(const TimeSignatureEvent &signature, bool un
         {
             auto *removedEvent = this->midiEvents.getUnchecked(index);
             this->eventDispatcher.dispatchRemoveEvent(*removedEvent);
+            this->invalidateSnapshot(*removedEvent);
             this->midiEvents.remove(index, true);
             this->updateBeatRange(true);
             this->eventDispatcher.dispatchPostRemoveEvent(this);
@@ -119,9 +121,11 @@ bool TimeSignaturesSequence::change(const TimeSignatureEvent &oldParams,
         if (index >= 0)
         {
             auto *changedEvent = static_cast<TimeSignatureEvent *>(this->midiEvents.getUnchecked(index));
+            this->invalidateSnapshot(oldParams);
             changedEvent->applyChanges(newParams);
             this->midiEvents.remove(index, false);
             this->midiEvents.addSorted(*changedEvent, changedEvent);
+            this->invalidateSnapshot(*changedEvent);
             this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             this->updateBeatRange(true);
             return true;
@@ -148,6 +152,7 @@ bool TimeSignaturesSequence::insertGroup(Array<TimeSignatureEvent> &signatures,
             const TimeSignatureEvent &eventParams = signatures.getReference(i);
             auto *ownedEvent = new TimeSignatureEvent(this, eventParams);
             this->midiEvents.addSorted(*ownedEvent, ownedEvent);
+            this->invalidateSnapshot(*ownedEvent);
             this->eventDispatcher.dispatchAddEvent(*ownedEvent);
         }
         
@@ -175,6 +180,7 @@ bool TimeSignaturesSequence::removeGroup(Array<TimeSignatureEvent> &signatures,
             {
                 auto *removedSignature = this->midiEvents.getUnchecked(index);
                 this->eventDispatcher.dispatchRemoveEvent(*removedSignature);
+                this->invalidateSnapshot(*removedSignature);
                 this->midiEvents.remove(index, true);
             }
         }
@@ -207,9 +213,11 @@ bool TimeSignaturesSequence::changeGroup(Array<TimeSignatureEvent> &groupBefore,
             if (index >= 0)
             {
                 auto *changedEvent = static_cast<TimeSignatureEvent *>(this->midiEvents.getUnchecked(index));
+                this->invalidateSnapshot(oldParams);
                 changedEvent->applyChanges(newParams);
                 this->midiEvents.remove(index, false);
                 this->midiEvents.addSorted(*changedEvent, changedEvent);
+                this->invalidateSnapshot(*changedEvent);
                 this->eventDispatcher.dispatchChangeEvent(oldParams, *changedEvent);
             }
         }
@@ -281,15 +289,17 @@ void TimeSignaturesSequence::deserialize(const SerializedData &data)
         lastBeat = jmax(lastBeat, signature->getBeat());
         firstBeat = jmin(firstBeat, signature->getBeat());
 
-        this->usedEventIds.insert(signature->getId());
+        this->registerDeserializedEventId(*signature);
     }
 
     this->sort();
     this->updateBeatRange(false);
+    this->updateSnapshot();
 }
 
 void TimeSignaturesSequence::reset()
 {
     this->midiEvents.clear();
+    this->invalidateSnapshot();
     this->usedEventIds.clear();
 }
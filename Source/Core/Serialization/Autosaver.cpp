@@ -44,5 +44,11 @@ void Autosaver::changeListenerCallback(ChangeBroadcaster *source)
 void Autosaver::timerCallback()
 {
     this->stopTimer();
-    this->documentOwner.getDocument()->save();
+
+    // the project is serialized and written on a background thread;
+    // if the previous save is still running, just try again later
+    if (!this->documentOwner.getDocument()->saveInBackground())
+    {
+        this->startTimer(this->delay);
+    }
 }
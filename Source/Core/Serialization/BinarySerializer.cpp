@@ -21,15 +21,962 @@
 static const char *kHelioHeaderV2String = "Helio2::";
 static const uint64 kHelioHeaderV2 = ByteOrder::littleEndianInt64(kHelioHeaderV2String);
 
+static const char *kHelioHeaderV3String = "Helio3::";
+static const uint64 kHelioHeaderV3 = ByteOrder::littleEndianInt64(kHelioHeaderV3String);
+
+//===----------------------------------------------------------------------===//
+// Packed format
+//===----------------------------------------------------------------------===//
+
+// The v3 file is the header, the flags byte, and the payload,
+// gzipped if the compression flag is set; the payload is the table
+// of all identifiers used, followed by the root node, where each node is:
+//   type index, properties count, [ name index, value ]..., children.
+// The children are written as a count and a sequence of runs, each either
+// a single node, or a block of at least a few similar leaf nodes, i.e.
+// of the same type, with no children, and with the same properties of the
+// same types in the same order; such a block is written column by column,
+// with integers as zigzag varints of the deltas between the rows, so that
+// a note costs a few bytes, and reading it is just a tight loop per column.
+//
+// If the sections flag is set, the identifiers are followed by the table
+// of contents, listing the offsets and sizes of the sections placed after
+// the root node: each large list of leaves, like the events of a track,
+// is written as a section, and only referenced from its parent by index;
+// such subtrees are read as deferred nodes, decoded when first accessed.
+// Each section has its own identifiers table, followed by its node, so that
+// its bytes can be copied into the next saved file as is, if unchanged.
+// If the summaries flag is set, each entry of the table of contents is also
+// followed by the section's summary, written as the node's properties are,
+// i.e. a few values the owners may need before decoding the section.
+
+#define PACKED_FORMAT_MIN_COLUMNAR_RUN 4
+#define PACKED_FORMAT_MIN_SECTION_CHILDREN 64
+#define PACKED_FORMAT_COMPRESSION_FLAG 1
+#define PACKED_FORMAT_SECTIONS_FLAG 2
+#define PACKED_FORMAT_SECTION_SUMMARIES_FLAG 4
+
+class PackedTreeFormat
+{
+protected:
+
+    enum ValueType : uint8
+    {
+        voidValue = 0,
+        intValue = 1,
+        int64Value = 2,
+        doubleValue = 3,
+        falseValue = 4,
+        trueValue = 5,
+        stringValue = 6,
+        binaryValue = 7,
+        // anything else is written as var::writeToStream does
+        otherValue = 8,
+        // in columns, only the type is written, and then the values
+        boolValue = 9
+    };
+
+    enum RunType : uint8
+    {
+        singleNode = 0,
+        columnarNodes = 1,
+        sectionNode = 2
+    };
+
+    static ValueType getColumnType(const var &value) noexcept
+    {
+        if (value.isInt()) { return intValue; }
+        if (value.isInt64()) { return int64Value; }
+        if (value.isDouble()) { return doubleValue; }
+        if (value.isBool()) { return boolValue; }
+        if (value.isString()) { return stringValue; }
+        return voidValue;
+    }
+
+    static inline uint64 zigzagEncode(int64 value) noexcept
+    {
+        return (uint64(value) << 1) ^ uint64(value >> 63);
+    }
+
+    static inline int64 zigzagDecode(uint64 value) noexcept
+    {
+        return int64(value >> 1) ^ -int64(value & 1);
+    }
+
+};
+
+// The decoded payload of one file, along with its sections,
+// which is kept in memory as long as any of its deferred nodes is alive
+class PackedTreeSource final : public ReferenceCountedObject
+{
+public:
+
+    using Ptr = ReferenceCountedObjectPtr<PackedTreeSource>;
+
+    MemoryBlock payload;
+    Array<Range<size_t>> sections;
+
+};
+
+// The content key of the deferred nodes read from sections:
+// unless modified, they are saved by copying the section's bytes
+class PackedSectionKey final : public SerializedData::ContentKey
+{
+public:
+
+    PackedSectionKey(PackedTreeSource::Ptr source, int index) noexcept :
+        source(source), index(index) {}
+
+    const void *getData() const noexcept
+    {
+        return static_cast<const char *>(this->source->payload.getData()) +
+            this->source->sections.getReference(this->index).getStart();
+    }
+
+    size_t getSize() const noexcept
+    {
+        return this->source->sections.getReference(this->index).getLength();
+    }
+
+private:
+
+    const PackedTreeSource::Ptr source;
+    const int index;
+
+};
+
+class PackedTreeWriter final : private PackedTreeFormat
+{
+public:
+
+    PackedTreeWriter(MemoryOutputStream &output, PackedSectionsCache *cache) :
+        output(output), cache(cache) {}
+
+    void write(const SerializedData &tree)
+    {
+        this->canWriteSections = true;
+        this->writeTree(tree);
+
+        this->writeVarInt(this->numSections);
+        this->output.write(this->contents.getData(), this->contents.getDataSize());
+        this->output.write(this->nodes.getData(), this->nodes.getDataSize());
+        this->output.write(this->sections.getData(), this->sections.getDataSize());
+
+        // only keep the sections of this save for the next one
+        if (this->cache != nullptr)
+        {
+            this->cache->sections.swap(this->usedSections);
+        }
+    }
+
+    void writeSectionContent(const SerializedData &tree)
+    {
+        this->canWriteSections = false;
+        this->writeTree(tree);
+        this->output.write(this->nodes.getData(), this->nodes.getDataSize());
+    }
+
+private:
+
+    MemoryOutputStream &output;
+    OutputStream *body = nullptr;
+
+    // the nodes are written first to find out all the identifiers
+    MemoryOutputStream nodes;
+
+    bool canWriteSections = false;
+    MemoryOutputStream sections;
+    int numSections = 0;
+
+    // the table of contents is also written along with the nodes,
+    // so that the summaries' names get into the identifiers table
+    MemoryOutputStream contents;
+
+    PackedSectionsCache *cache;
+    FlatHashMap<const SerializedData::ContentKey *, PackedSectionsCache::Section> usedSections;
+
+    void writeTree(const SerializedData &tree)
+    {
+        this->body = &this->nodes;
+        this->writeNode(tree);
+
+        this->body = &this->output;
+        this->writeVarInt(this->names.size());
+        for (const auto &name : this->names)
+        {
+            this->writeString(name.toString());
+        }
+    }
+
+    Array<Identifier> names;
+    FlatHashMap<const char *, int> nameIndices;
+
+    void writeName(const Identifier &name)
+    {
+        const auto *text = name.getCharPointer().getAddress();
+        const auto found = this->nameIndices.find(text);
+        if (found != this->nameIndices.end())
+        {
+            this->writeVarInt(found->second);
+            return;
+        }
+
+        const auto index = this->names.size();
+        this->names.add(name);
+        this->nameIndices[text] = index;
+        this->writeVarInt(index);
+    }
+
+    void writeNode(const SerializedData &node)
+    {
+        this->writeName(node.getType());
+
+        const auto numProperties = node.getNumProperties();
+        this->writeVarInt(numProperties);
+        for (int i = 0; i < numProperties; ++i)
+        {
+            this->writeName(node.getPropertyName(i));
+            this->writeValue(node.getPropertyValue(i));
+        }
+
+        const auto numChildren = node.getNumChildren();
+        this->writeVarInt(numChildren);
+
+        Array<SerializedData> run;
+        for (int i = 0; i < numChildren;)
+        {
+            // check this first, as the checks below would load the node
+            const auto encodedSection = this->findEncodedSection(node.getChild(i));
+            if (encodedSection.data != nullptr)
+            {
+                this->body->writeByte(char(sectionNode));
+                this->writeSection(node.getChild(i), encodedSection);
+                ++i;
+                continue;
+            }
+
+            this->collectColumnarRun(node, i, run);
+            if (run.size() >= PACKED_FORMAT_MIN_COLUMNAR_RUN)
+            {
+                this->body->writeByte(char(columnarNodes));
+                this->writeColumns(run);
+                i += run.size();
+            }
+            else if (this->canWriteSections && isSectionCandidate(node.getChild(i)))
+            {
+                this->body->writeByte(char(sectionNode));
+                this->writeSection(node.getChild(i), {});
+                ++i;
+            }
+            else
+            {
+                this->body->writeByte(char(singleNode));
+                this->writeNode(node.getChild(i));
+                ++i;
+            }
+        }
+    }
+
+    // Only the flat lists of leaves are worth a section: any deeper
+    // subtree would have to be decoded anyway to deserialize its parent
+    static bool isSectionCandidate(const SerializedData &node)
+    {
+        const auto numChildren = node.getNumChildren();
+        if (numChildren < PACKED_FORMAT_MIN_SECTION_CHILDREN)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < numChildren; ++i)
+        {
+            if (node.getChild(i).getNumChildren() > 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    struct EncodedSection final
+    {
+        const void *data = nullptr;
+        size_t size = 0;
+    };
+
+    // The previous encoding of the node, if it's known to be the same,
+    // i.e. it's an unmodified section read from a file, or it was
+    // written on the previous save with the same content key
+    EncodedSection findEncodedSection(const SerializedData &node) const
+    {
+        const auto *key = this->canWriteSections ? node.getContentKey() : nullptr;
+        if (key == nullptr)
+        {
+            return {};
+        }
+
+        if (const auto *sectionKey = dynamic_cast<const PackedSectionKey *>(key))
+        {
+            return { sectionKey->getData(), sectionKey->getSize() };
+        }
+
+        const auto used = this->usedSections.find(key);
+        if (used != this->usedSections.end())
+        {
+            return { used->second.data.getData(), used->second.data.getSize() };
+        }
+
+        if (this->cache != nullptr)
+        {
+            const auto cached = this->cache->sections.find(key);
+            if (cached != this->cache->sections.end())
+            {
+                return { cached->second.data.getData(), cached->second.data.getSize() };
+            }
+        }
+
+        return {};
+    }
+
+    void writeSection(const SerializedData &node, const EncodedSection &encoded)
+    {
+        this->writeName(node.getType());
+        this->writeVarInt(this->numSections++);
+
+        const auto start = this->sections.getPosition();
+        auto *key = node.getContentKey();
+
+        if (encoded.data != nullptr)
+        {
+            this->sections.write(encoded.data, encoded.size);
+        }
+        else
+        {
+            MemoryOutputStream content;
+            PackedTreeWriter(content, nullptr).writeSectionContent(node);
+            this->sections.write(content.getData(), content.getDataSize());
+        }
+
+        this->writeSectionContentsEntry(start, this->sections.getPosition() - start,
+            node.getDeferredSummary());
+
+        if (this->cache != nullptr && key != nullptr &&
+            dynamic_cast<PackedSectionKey *>(key) == nullptr &&
+            this->usedSections.find(key) == this->usedSections.end())
+        {
+            const auto *data = static_cast<const char *>(this->sections.getData()) + start;
+            this->usedSections[key] = { key, MemoryBlock(data, size_t(this->sections.getPosition() - start)) };
+        }
+    }
+
+    void writeSectionContentsEntry(int64 start, int64 length, const NamedValueSet &summary)
+    {
+        auto *nodesBody = this->body;
+        this->body = &this->contents;
+
+        this->writeVarInt(uint64(start));
+        this->writeVarInt(uint64(length));
+        this->writeVarInt(summary.size());
+        for (const auto &value : summary)
+        {
+            this->writeName(value.name);
+            this->writeValue(value.value);
+        }
+
+        this->body = nodesBody;
+    }
+
+    void collectColumnarRun(const SerializedData &parent, int start, Array<SerializedData> &run) const
+    {
+        run.clearQuick();
+
+        const auto first = parent.getChild(start);
+        const auto numProperties = first.getNumProperties();
+        if (first.getNumChildren() > 0 || numProperties == 0)
+        {
+            return;
+        }
+
+        for (int i = 0; i < numProperties; ++i)
+        {
+            if (getColumnType(first.getPropertyValue(i)) == voidValue)
+            {
+                return;
+            }
+        }
+
+        run.add(first);
+
+        for (int i = start + 1; i < parent.getNumChildren(); ++i)
+        {
+            const auto next = parent.getChild(i);
+            if (next.isDeferred() ||
+                next.getType() != first.getType() ||
+                next.getNumChildren() > 0 ||
+                next.getNumProperties() != numProperties)
+            {
+                return;
+            }
+
+            for (int j = 0; j < numProperties; ++j)
+            {
+                if (next.getPropertyName(j) != first.getPropertyName(j) ||
+                    getColumnType(next.getPropertyValue(j)) !=
+                        getColumnType(first.getPropertyValue(j)))
+                {
+                    return;
+                }
+            }
+
+            run.add(next);
+        }
+    }
+
+    void writeColumns(const Array<SerializedData> &rows)
+    {
+        const auto &first = rows.getReference(0);
+        const auto numColumns = first.getNumProperties();
+
+        this->writeName(first.getType());
+        this->writeVarInt(rows.size());
+        this->writeVarInt(numColumns);
+
+        for (int column = 0; column < numColumns; ++column)
+        {
+            const auto columnType = getColumnType(first.getPropertyValue(column));
+            this->writeName(first.getPropertyName(column));
+            this->body->writeByte(char(columnType));
+
+            switch (columnType)
+            {
+            case intValue:
+            case int64Value:
+            {
+                uint64 previous = 0;
+                for (const auto &row : rows)
+                {
+                    const auto value = uint64(int64(row.getPropertyValue(column)));
+                    this->writeVarInt(zigzagEncode(int64(value - previous)));
+                    previous = value;
+                }
+                break;
+            }
+            case doubleValue:
+                for (const auto &row : rows)
+                {
+                    this->body->writeDouble(row.getPropertyValue(column));
+                }
+                break;
+            case boolValue:
+                for (const auto &row : rows)
+                {
+                    this->body->writeBool(row.getPropertyValue(column));
+                }
+                break;
+            case stringValue:
+                for (const auto &row : rows)
+                {
+                    this->writeString(row.getPropertyValue(column).toString());
+                }
+                break;
+            default:
+                jassertfalse;
+                break;
+            }
+        }
+    }
+
+    void writeValue(const var &value)
+    {
+        if (value.isVoid())
+        {
+            this->body->writeByte(char(voidValue));
+        }
+        else if (value.isInt())
+        {
+            this->body->writeByte(char(intValue));
+            this->writeVarInt(zigzagEncode(int(value)));
+        }
+        else if (value.isInt64())
+        {
+            this->body->writeByte(char(int64Value));
+            this->writeVarInt(zigzagEncode(int64(value)));
+        }
+        else if (value.isDouble())
+        {
+            this->body->writeByte(char(doubleValue));
+            this->body->writeDouble(value);
+        }
+        else if (value.isBool())
+        {
+            this->body->writeByte(char(bool(value) ? trueValue : falseValue));
+        }
+        else if (value.isString())
+        {
+            this->body->writeByte(char(stringValue));
+            this->writeString(value.toString());
+        }
+        else if (const auto *binary = value.getBinaryData())
+        {
+            this->body->writeByte(char(binaryValue));
+            this->writeVarInt(binary->getSize());
+            this->body->write(binary->getData(), binary->getSize());
+        }
+        else
+        {
+            MemoryOutputStream other;
+            value.writeToStream(other);
+            this->body->writeByte(char(otherValue));
+            this->writeVarInt(other.getDataSize());
+            this->body->write(other.getData(), other.getDataSize());
+        }
+    }
+
+    void writeString(const String &string)
+    {
+        const auto numBytes = string.getNumBytesAsUTF8();
+        this->writeVarInt(numBytes);
+        this->body->write(string.toRawUTF8(), numBytes);
+    }
+
+    void writeVarInt(uint64 value)
+    {
+        uint8 bytes[10];
+        int numBytes = 0;
+
+        while (value >= 0x80)
+        {
+            bytes[numBytes++] = uint8(value | 0x80);
+            value >>= 7;
+        }
+
+        bytes[numBytes++] = uint8(value);
+        this->body->write(bytes, size_t(numBytes));
+    }
+
+};
+
+class PackedTreeReader final : private PackedTreeFormat
+{
+public:
+
+    explicit PackedTreeReader(PackedTreeSource::Ptr source) noexcept :
+        source(source),
+        position(static_cast<const uint8 *>(source->payload.getData())),
+        end(this->position + source->payload.getSize()) {}
+
+    SerializedData read(bool hasSections, bool hasSummaries)
+    {
+        if (!this->readNames())
+        {
+            return {};
+        }
+
+        Array<Range<uint64>> sectionRanges;
+        const auto numSections = hasSections ? this->readVarInt() : 0;
+        if (numSections > this->getNumBytesLeft())
+        {
+            return {};
+        }
+
+        for (uint64 i = 0; i < numSections && !this->failed; ++i)
+        {
+            const auto start = this->readVarInt();
+            const auto length = this->readVarInt();
+            sectionRanges.add(Range<uint64>::withStartAndLength(start, length));
+
+            NamedValueSet summary;
+            const auto numValues = hasSummaries ? this->readVarInt() : 0;
+            for (uint64 j = 0; j < numValues && !this->failed; ++j)
+            {
+                const auto &name = this->readName();
+                const auto value = this->readValue();
+                if (!this->failed && name.isValid())
+                {
+                    summary.set(name, value);
+                }
+            }
+
+            this->sectionSummaries.add(std::move(summary));
+        }
+
+        this->numSections = sectionRanges.size();
+        const auto root = this->readNode();
+        if (this->failed)
+        {
+            return {};
+        }
+
+        // the sections follow the root node, and must all fit in the payload
+        const auto sectionsStart = size_t(this->position -
+            static_cast<const uint8 *>(this->source->payload.getData()));
+
+        for (const auto &range : sectionRanges)
+        {
+            if (range.getEnd() < range.getStart() ||
+                range.getEnd() > uint64(this->getNumBytesLeft()))
+            {
+                return {};
+            }
+
+            this->source->sections.add(Range<size_t>::withStartAndLength(
+                sectionsStart + size_t(range.getStart()), size_t(range.getLength())));
+        }
+
+        return root;
+    }
+
+    SerializedData readSection(int index)
+    {
+        const auto range = this->source->sections[index];
+        const auto *payload = static_cast<const uint8 *>(this->source->payload.getData());
+        this->position = payload + range.getStart();
+        this->end = payload + range.getEnd();
+        this->numSections = 0;
+
+        if (!this->readNames())
+        {
+            return {};
+        }
+
+        const auto node = this->readNode();
+        return this->failed ? SerializedData() : node;
+    }
+
+private:
+
+    PackedTreeSource::Ptr source;
+
+    const uint8 *position;
+    const uint8 *end;
+    bool failed = false;
+
+    int numSections = 0;
+    Array<NamedValueSet> sectionSummaries;
+
+    Array<Identifier> names;
+
+    bool readNames()
+    {
+        const auto numNames = this->readVarInt();
+        if (numNames > this->getNumBytesLeft())
+        {
+            return false;
+        }
+
+        this->names.ensureStorageAllocated(int(numNames));
+        for (uint64 i = 0; i < numNames && !this->failed; ++i)
+        {
+            this->names.add(Identifier(this->readString()));
+        }
+
+        return !this->failed;
+    }
+
+    inline size_t getNumBytesLeft() const noexcept
+    {
+        return size_t(this->end - this->position);
+    }
+
+    const Identifier &readName() noexcept
+    {
+        static const Identifier invalid;
+        const auto index = this->readVarInt();
+        if (index >= uint64(this->names.size()))
+        {
+            this->failed = true;
+            return invalid;
+        }
+
+        return this->names.getReference(int(index));
+    }
+
+    SerializedData readNode()
+    {
+        const auto &type = this->readName();
+        if (this->failed || !type.isValid())
+        {
+            this->failed = true;
+            return {};
+        }
+
+        SerializedData node(type);
+
+        const auto numProperties = this->readVarInt();
+        for (uint64 i = 0; i < numProperties && !this->failed; ++i)
+        {
+            const auto &name = this->readName();
+            const auto value = this->readValue();
+            if (!this->failed)
+            {
+                node.setProperty(name, value);
+            }
+        }
+
+        const auto numChildren = this->readVarInt();
+        for (uint64 i = 0; i < numChildren && !this->failed;)
+        {
+            const auto runType = this->readByte();
+            if (runType == singleNode)
+            {
+                node.appendChild(this->readNode());
+                ++i;
+            }
+            else if (runType == columnarNodes)
+            {
+                i += this->readColumns(node, numChildren - i);
+            }
+            else if (runType == sectionNode)
+            {
+                node.appendChild(this->readSectionReference());
+                ++i;
+            }
+            else
+            {
+                this->failed = true;
+            }
+        }
+
+        return node;
+    }
+
+    SerializedData readSectionReference()
+    {
+        const auto &type = this->readName();
+        const auto index = this->readVarInt();
+        if (this->failed || !type.isValid() || index >= uint64(this->numSections))
+        {
+            this->failed = true;
+            return {};
+        }
+
+        const auto sectionIndex = int(index);
+        const auto source = this->source;
+        return SerializedData::createDeferred(type, [source, sectionIndex]()
+        {
+            return PackedTreeReader(source).readSection(sectionIndex);
+        }, new PackedSectionKey(source, sectionIndex),
+            this->sectionSummaries.getReference(sectionIndex));
+    }
+
+    uint64 readColumns(SerializedData &parent, uint64 maxRows)
+    {
+        const auto &type = this->readName();
+        const auto numRows = this->readVarInt();
+        const auto numColumns = this->readVarInt();
+
+        // each value takes at least one byte
+        const auto numBytesLeft = this->getNumBytesLeft();
+        if (this->failed || !type.isValid() ||
+            numRows == 0 || numRows > maxRows || numRows > numBytesLeft ||
+            numColumns == 0 || numColumns > numBytesLeft ||
+            numRows * numColumns > numBytesLeft)
+        {
+            this->failed = true;
+            return 0;
+        }
+
+        Array<SerializedData> rows;
+        rows.ensureStorageAllocated(int(numRows));
+        for (uint64 i = 0; i < numRows; ++i)
+        {
+            rows.add(SerializedData(type));
+        }
+
+        for (uint64 column = 0; column < numColumns && !this->failed; ++column)
+        {
+            const auto &name = this->readName();
+            const auto columnType = this->readByte();
+
+            switch (columnType)
+            {
+            case intValue:
+            case int64Value:
+            {
+                uint64 value = 0;
+                for (auto &row : rows)
+                {
+                    value += uint64(zigzagDecode(this->readVarInt()));
+                    if (columnType == intValue)
+                    {
+                        row.setProperty(name, int(int64(value)));
+                    }
+                    else
+                    {
+                        row.setProperty(name, int64(value));
+                    }
+                }
+                break;
+            }
+            case doubleValue:
+                for (auto &row : rows)
+                {
+                    row.setProperty(name, this->readDouble());
+                }
+                break;
+            case boolValue:
+                for (auto &row : rows)
+                {
+                    row.setProperty(name, this->readByte() != 0);
+                }
+                break;
+            case stringValue:
+                for (auto &row : rows)
+                {
+                    row.setProperty(name, this->readString());
+                }
+                break;
+            default:
+                this->failed = true;
+                break;
+            }
+        }
+
+        for (const auto &row : rows)
+        {
+            parent.appendChild(row);
+        }
+
+        return numRows;
+    }
+
+    var readValue()
+    {
+        switch (this->readByte())
+        {
+        case voidValue: return {};
+        case intValue: return int(zigzagDecode(this->readVarInt()));
+        case int64Value: return zigzagDecode(this->readVarInt());
+        case doubleValue: return this->readDouble();
+        case falseValue: return false;
+        case trueValue: return true;
+        case stringValue: return this->readString();
+        case binaryValue:
+        {
+            const auto numBytes = this->readVarInt();
+            if (numBytes > this->getNumBytesLeft())
+            {
+                this->failed = true;
+                return {};
+            }
+
+            MemoryBlock binary(this->position, size_t(numBytes));
+            this->position += numBytes;
+            return binary;
+        }
+        case otherValue:
+        {
+            const auto numBytes = this->readVarInt();
+            if (numBytes > this->getNumBytesLeft())
+            {
+                this->failed = true;
+                return {};
+            }
+
+            MemoryInputStream input(this->position, size_t(numBytes), false);
+            this->position += numBytes;
+            return var::readFromStream(input);
+        }
+        default:
+            this->failed = true;
+            return {};
+        }
+    }
+
+    String readString()
+    {
+        const auto numBytes = this->readVarInt();
+        if (numBytes > this->getNumBytesLeft())
+        {
+            this->failed = true;
+            return {};
+        }
+
+        const auto *text = reinterpret_cast<const char *>(this->position);
+        this->position += numBytes;
+        return String::fromUTF8(text, int(numBytes));
+    }
+
+    double readDouble() noexcept
+    {
+        if (this->getNumBytesLeft() < sizeof(double))
+        {
+            this->failed = true;
+            return 0.0;
+        }
+
+        const auto bits = ByteOrder::littleEndianInt64(this->position);
+        this->position += sizeof(double);
+
+        double result;
+        memcpy(&result, &bits, sizeof(double));
+        return result;
+    }
+
+    inline uint8 readByte() noexcept
+    {
+        if (this->position >= this->end)
+        {
+            this->failed = true;
+            return 0;
+        }
+
+        return *this->position++;
+    }
+
+    inline uint64 readVarInt() noexcept
+    {
+        uint64 result = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const auto byte = this->readByte();
+            result |= uint64(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return result;
+            }
+        }
+
+        this->failed = true;
+        return 0;
+    }
+
+};
+
+//===----------------------------------------------------------------------===//
+// BinarySerializer
+//===----------------------------------------------------------------------===//
+
+BinarySerializer::BinarySerializer(bool compressed,
+    PackedSectionsCache::Ptr sectionsCache) noexcept :
+    compressed(compressed),
+    sectionsCache(sectionsCache) {}
+
 Result BinarySerializer::saveToFile(File file, const SerializedData &tree) const
 {
+    MemoryOutputStream payload;
+    PackedTreeWriter(payload, this->sectionsCache.get()).write(tree);
+
+    MemoryOutputStream compressedPayload;
+    if (this->compressed)
+    {
+        GZIPCompressorOutputStream compressor(compressedPayload, 1);
+        compressor.write(payload.getData(), payload.getDataSize());
+        compressor.flush();
+    }
+
+    const auto &data = this->compressed ? compressedPayload : payload;
+
     FileOutputStream fileStream(file);
     if (fileStream.openedOk())
     {
         fileStream.setPosition(0);
         fileStream.truncate();
-        fileStream.writeInt64(kHelioHeaderV2);
-        tree.writeToStream(fileStream);
+        fileStream.writeInt64(kHelioHeaderV3);
+        fileStream.writeByte(char(PACKED_FORMAT_SECTIONS_FLAG |
+            PACKED_FORMAT_SECTION_SUMMARIES_FLAG |
+            (this->compressed ? PACKED_FORMAT_COMPRESSION_FLAG : 0)));
+        fileStream.write(data.getData(), data.getDataSize());
         return Result::ok();
     }
 
@@ -45,6 +992,9 @@ SerializedData BinarySerializer::loadFromFile(const File &file) const
 
     // so instead we'll just read the whole file into memory and deserialize from it;
     // somewhat ugly, but works, and saved files should never be really large anyway.
+    // (the v3 payload stays in memory, while the deferred sections refer to it;
+    // it is not mapped, because saving replaces the project file, or falls back
+    // to overwriting it, see TempDocument, which a live mapping wouldn't survive)
     MemoryBlock mb;
     if (file.loadFileAsData(mb))
     {
@@ -54,6 +1004,26 @@ SerializedData BinarySerializer::loadFromFile(const File &file) const
         {
             return SerializedData::readFromStream(inputStream);
         }
+        else if (magicNumber == kHelioHeaderV3)
+        {
+            const auto flags = uint8(inputStream.readByte());
+            const auto headerSize = size_t(inputStream.getPosition());
+
+            PackedTreeSource::Ptr source(new PackedTreeSource());
+            if ((flags & PACKED_FORMAT_COMPRESSION_FLAG) == 0)
+            {
+                mb.removeSection(0, headerSize);
+                source->payload.swapWith(mb);
+            }
+            else
+            {
+                GZIPDecompressorInputStream decompressor(inputStream);
+                decompressor.readIntoMemoryBlock(source->payload);
+            }
+
+            return PackedTreeReader(source).read((flags & PACKED_FORMAT_SECTIONS_FLAG) != 0,
+                (flags & PACKED_FORMAT_SECTION_SUMMARIES_FLAG) != 0);
+        }
     }
 
     return {};
@@ -86,5 +1056,209 @@ bool BinarySerializer::supportsFileWithExtension(const String &extension) const
 
 bool BinarySerializer::supportsFileWithHeader(const String &header) const
 {
-    return header.startsWith(kHelioHeaderV2String);
+    return header.startsWith(kHelioHeaderV3String) ||
+        header.startsWith(kHelioHeaderV2String);
 }
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class BinarySerializerTests final : public UnitTest
+{
+public:
+
+    BinarySerializerTests() : UnitTest("Binary serializer tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        const auto tree = createProject();
+
+        beginTest("Packed format round-trips");
+
+        for (const auto compressed : { false, true })
+        {
+            const TemporaryFile file(".helio");
+            BinarySerializer serializer(compressed);
+            expect(serializer.saveToFile(file.getFile(), tree).wasOk());
+            expect(serializer.loadFromFile(file.getFile()).isEquivalentTo(tree));
+        }
+
+        beginTest("Large lists of leaves are decoded on demand");
+
+        const TemporaryFile sectionsFile(".helio");
+        BinarySerializer().saveToFile(sectionsFile.getFile(), tree);
+        const auto loaded = BinarySerializer().loadFromFile(sectionsFile.getFile());
+        expectEquals(loaded.getNumChildren(), tree.getNumChildren());
+        for (const auto track : loaded)
+        {
+            expect(track.isDeferred());
+            expect(track.hasType("track"));
+        }
+
+        expect(loaded.getChild(1).isEquivalentTo(tree.getChild(1)));
+        expect(!loaded.getChild(1).isDeferred());
+        expect(loaded.getChild(0).isDeferred());
+
+        beginTest("Unchanged sections are saved without encoding");
+
+        // the sections read from a file are copied as is
+        const TemporaryFile resavedFile(".helio");
+        BinarySerializer().saveToFile(resavedFile.getFile(), loaded);
+        expect(loaded.getChild(0).isDeferred());
+        expect(BinarySerializer().loadFromFile(resavedFile.getFile()).isEquivalentTo(tree));
+
+        // the sections with known content keys are taken from the cache
+        int numLoads = 0;
+        ReferenceCountedArray<SerializedData::ContentKey> keys;
+        const auto createDeferredProject = [&]()
+        {
+            SerializedData project("project");
+            for (int i = 0; i < tree.getNumChildren(); ++i)
+            {
+                const auto track = tree.getChild(i);
+                project.appendChild(SerializedData::createDeferred(track.getType(),
+                    [&numLoads, track]() { ++numLoads; return track.createCopy(); },
+                    keys[i].get()));
+            }
+
+            return project;
+        };
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            keys.add(new TestContentKey());
+        }
+
+        PackedSectionsCache::Ptr cache(new PackedSectionsCache());
+        const TemporaryFile cachedFile(".helio");
+        BinarySerializer(false, cache).saveToFile(cachedFile.getFile(), createDeferredProject());
+        expectEquals(numLoads, tree.getNumChildren());
+
+        keys.set(1, new TestContentKey());
+        numLoads = 0;
+        BinarySerializer(false, cache).saveToFile(cachedFile.getFile(), createDeferredProject());
+        expectEquals(numLoads, 1);
+
+        SerializedData expectedProject("project");
+        for (const auto track : tree)
+        {
+            expectedProject.appendChild(track.createCopy());
+        }
+
+        expect(BinarySerializer().loadFromFile(cachedFile.getFile()).isEquivalentTo(expectedProject));
+
+        beginTest("Section summaries are read without decoding");
+
+        SerializedData summarizedProject("project");
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+        {
+            const auto track = tree.getChild(i);
+            summarizedProject.appendChild(SerializedData::createDeferred(track.getType(),
+                [track]() { return track.createCopy(); }, nullptr, createSummary(i)));
+        }
+
+        const TemporaryFile summariesFile(".helio");
+        BinarySerializer().saveToFile(summariesFile.getFile(), summarizedProject);
+        const auto summarized = BinarySerializer().loadFromFile(summariesFile.getFile());
+        expectEquals(summarized.getNumChildren(), tree.getNumChildren());
+        for (int i = 0; i < summarized.getNumChildren(); ++i)
+        {
+            expect(summarized.getChild(i).getDeferredSummary() == createSummary(i));
+            expect(summarized.getChild(i).isDeferred());
+        }
+
+        // the copied sections keep their summaries too
+        const TemporaryFile resummarizedFile(".helio");
+        BinarySerializer().saveToFile(resummarizedFile.getFile(), summarized);
+        const auto resummarized = BinarySerializer().loadFromFile(resummarizedFile.getFile());
+        expect(resummarized.getChild(2).getDeferredSummary() == createSummary(2));
+        expect(resummarized.isEquivalentTo(expectedProject));
+
+        beginTest("Legacy format still loads");
+
+        const TemporaryFile legacyFile(".helio");
+        {
+            FileOutputStream output(legacyFile.getFile());
+            output.writeInt64(kHelioHeaderV2);
+            tree.writeToStream(output);
+        }
+
+        BinarySerializer serializer;
+        expect(serializer.loadFromFile(legacyFile.getFile()).isEquivalentTo(tree));
+
+        beginTest("Packed format is smaller");
+
+        const TemporaryFile packedFile(".helio");
+        serializer.saveToFile(packedFile.getFile(), tree);
+        const auto packedSize = packedFile.getFile().getSize();
+        const auto legacySize = legacyFile.getFile().getSize();
+        logMessage("Legacy size: " + String(legacySize) + ", packed size: " + String(packedSize));
+        expect(packedSize * 3 < legacySize);
+
+        beginTest("Corrupted files fail to load");
+
+        MemoryBlock data;
+        packedFile.getFile().loadFileAsData(data);
+        data.setSize(data.getSize() / 2);
+        packedFile.getFile().replaceWithData(data.getData(), data.getSize());
+        expect(!serializer.loadFromFile(packedFile.getFile()).isValid());
+    }
+
+private:
+
+    struct TestContentKey final : public SerializedData::ContentKey {};
+
+    static NamedValueSet createSummary(int index)
+    {
+        NamedValueSet summary;
+        summary.set("firstBeat", index * 0.5);
+        summary.set("lastBeat", index * 16.0);
+        summary.set("name", "Track " + String(index));
+        return summary;
+    }
+
+    static SerializedData createProject()
+    {
+        SerializedData project("project");
+        project.setProperty("name", "Test");
+        project.setProperty("binary", var(MemoryBlock("abc", 3)));
+        project.setProperty("large", int64(1) << 40);
+
+        Random random(1);
+        for (int t = 0; t < 3; ++t)
+        {
+            SerializedData track("track");
+            track.setProperty("volume", 0.5);
+            track.setProperty("muted", t == 1);
+
+            for (int i = 0; i < 1000; ++i)
+            {
+                SerializedData note("note");
+                note.setProperty("id", String::toHexString(random.nextInt()));
+                note.setProperty("key", 40 + random.nextInt(40));
+                note.setProperty("timestamp", i * 16 + random.nextInt(8));
+                note.setProperty("length", 16 * (1 + random.nextInt(4)));
+                note.setProperty("volume", random.nextInt(1024));
+
+                // these break the runs of similar notes
+                if (i % 100 == 0)
+                {
+                    note.setProperty("tuplet", 3);
+                }
+
+                track.appendChild(note);
+            }
+
+            project.appendChild(track);
+        }
+
+        return project;
+    }
+};
+
+static BinarySerializerTests binarySerializerTests;
+
+#endif
@@ -19,10 +19,42 @@
 
 #include "Serializer.h"
 
+// The encoded sections of the last saved document (see BinarySerializer),
+// so that saving it again only encodes the sections with new content keys,
+// i.e. the tracks changed since then, and copies all the others as is
+class PackedSectionsCache final : public ReferenceCountedObject
+{
+public:
+
+    using Ptr = ReferenceCountedObjectPtr<PackedSectionsCache>;
+
+private:
+
+    struct Section final
+    {
+        SerializedData::ContentKey::Ptr key;
+        MemoryBlock data;
+    };
+
+    FlatHashMap<const SerializedData::ContentKey *, Section> sections;
+
+    friend class PackedTreeWriter;
+
+};
+
+// Saves the documents in the packed format (v3), where runs of similar
+// leaf nodes, like the notes of a track, are stored as typed columns
+// of delta-encoded varints, optionally compressed; loads both v3 and v2;
+// large lists of leaves are stored as self-contained sections, and loaded
+// as deferred nodes, only decoded when accessed (see isDeferred), while
+// the sections with the known content keys are saved without re-encoding
 class BinarySerializer final : public Serializer
 {
 public:
 
+    explicit BinarySerializer(bool compressed = false,
+        PackedSectionsCache::Ptr sectionsCache = nullptr) noexcept;
+
     Result saveToFile(File file, const SerializedData &tree) const override;
     SerializedData loadFromFile(const File &file) const override;
 
@@ -32,4 +64,9 @@ public:
     bool supportsFileWithExtension(const String &extension) const override;
     bool supportsFileWithHeader(const String &header) const override;
 
+private:
+
+    bool compressed;
+    PackedSectionsCache::Ptr sectionsCache;
+
 };
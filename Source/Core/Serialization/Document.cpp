@@ -21,6 +21,36 @@
 #include "DocumentHelpers.h"
 #include "MainLayout.h"
 
+class Document::BackgroundSaveThread final : public Thread
+{
+public:
+
+    BackgroundSaveThread(Document &document, const File &file, Function<bool()> job) :
+        Thread("Background save"),
+        document(document),
+        file(file),
+        job(std::move(job)) {}
+
+    void run() override
+    {
+        this->savedOk = this->job();
+        // the captured state is released here as well
+        this->job = nullptr;
+        this->document.triggerAsyncUpdate();
+    }
+
+    const File &getFile() const noexcept { return this->file; }
+    bool hasSavedOk() const noexcept { return this->savedOk; }
+
+private:
+
+    Document &document;
+    const File file;
+    Function<bool()> job;
+    bool savedOk = false;
+
+};
+
 Document::Document(DocumentOwner &documentOwner,
     const String &defaultName,
     const String &defaultExtension) :
@@ -51,6 +81,11 @@ Document::Document(DocumentOwner &documentOwner, const File &existingFile) :
 
 Document::~Document()
 {
+    if (this->backgroundSaveThread != nullptr)
+    {
+        this->backgroundSaveThread->waitForThreadToExit(-1);
+    }
+
     this->owner.removeChangeListener(this);
 }
 
@@ -76,6 +111,8 @@ void Document::renameFile(const String &newName)
         return;
     }
 
+    this->waitForBackgroundSave();
+
     const auto safeNewName = File::createLegalFileName(newName).trimCharactersAtEnd(".");
 
     File newFile(this->workingFile.getSiblingFile(safeNewName + "." + this->extension));
@@ -98,14 +135,45 @@ void Document::renameFile(const String &newName)
 
 void Document::save()
 {
+    this->waitForBackgroundSave();
+
     if (this->hasChanges && this->workingFile.getFullPathName().isNotEmpty())
     {
         this->internalSave(this->workingFile);
     }
 }
 
+bool Document::saveInBackground()
+{
+    if (this->backgroundSaveThread != nullptr)
+    {
+        return false;
+    }
+
+    if (!this->hasChanges || this->workingFile.getFullPathName().isEmpty())
+    {
+        return true;
+    }
+
+    auto job = this->owner.onDocumentSnapshot(this->workingFile);
+    if (job == nullptr)
+    {
+        this->internalSave(this->workingFile);
+        return true;
+    }
+
+    // any changes made after the snapshot will be saved next time
+    this->hasChanges = false;
+    this->backgroundSaveThread = makeUnique<BackgroundSaveThread>(*this,
+        this->workingFile, std::move(job));
+    this->backgroundSaveThread->startThread();
+    return true;
+}
+
 void Document::saveAs()
 {
+    this->waitForBackgroundSave();
+
 #if HELIO_DESKTOP
 
         FileChooser fc(TRANS(I18n::Dialog::documentSave),
@@ -272,6 +340,40 @@ bool Document::internalSave(File result)
     return false;
 }
 
+void Document::handleAsyncUpdate()
+{
+    if (this->backgroundSaveThread == nullptr)
+    {
+        return;
+    }
+
+    this->backgroundSaveThread->waitForThreadToExit(-1);
+    auto file = this->backgroundSaveThread->getFile();
+    const auto savedOk = this->backgroundSaveThread->hasSavedOk();
+    this->backgroundSaveThread = nullptr;
+
+    if (savedOk)
+    {
+        this->owner.onDocumentDidSave(file);
+        DBG("Document saved in background: " + file.getFullPathName());
+    }
+    else
+    {
+        this->hasChanges = true;
+        DBG("Document background save failed: " + file.getFullPathName());
+    }
+}
+
+void Document::waitForBackgroundSave()
+{
+    if (this->backgroundSaveThread != nullptr)
+    {
+        this->backgroundSaveThread->waitForThreadToExit(-1);
+        this->cancelPendingUpdate();
+        this->handleAsyncUpdate();
+    }
+}
+
 bool Document::internalLoad(File result)
 {
     const bool loadedOk = this->owner.onDocumentLoad(result);
@@ -287,3 +389,136 @@ bool Document::internalLoad(File result)
     DBG("Document load failed: " + result.getFullPathName());
     return false;
 }
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+// Keeps its state in a string, and writes the snapshots slowly,
+// so that the document has to wait for them
+class DocumentTestOwner final : public DocumentOwner
+{
+public:
+
+    DocumentTestOwner(const File &file, Atomic<int> &numBackgroundWrites) :
+        DocumentOwner(file),
+        numBackgroundWrites(numBackgroundWrites) {}
+
+    void edit(const String &newState)
+    {
+        this->state = newState;
+        this->getDocument()->changeListenerCallback(this);
+    }
+
+protected:
+
+    bool onDocumentLoad(File &file) override
+    {
+        this->state = file.loadFileAsString();
+        return true;
+    }
+
+    bool onDocumentSave(File &file) override
+    {
+        return file.replaceWithText(this->state);
+    }
+
+    Function<bool()> onDocumentSnapshot(const File &file) override
+    {
+        const auto snapshot = this->state;
+        auto &numWrites = this->numBackgroundWrites;
+        return [file, snapshot, &numWrites]()
+        {
+            Thread::sleep(100);
+            const auto savedOk = file.replaceWithText(snapshot);
+            ++numWrites;
+            return savedOk;
+        };
+    }
+
+    void onDocumentImport(File &file) override {}
+    bool onDocumentExport(File &file) override { return false; }
+
+private:
+
+    String state;
+    Atomic<int> &numBackgroundWrites;
+
+};
+
+class DocumentTests final : public UnitTest
+{
+public:
+
+    DocumentTests() : UnitTest("Document tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        const auto file = File::createTempFile("document");
+        Atomic<int> numWrites;
+
+        {
+            DocumentTestOwner owner(file, numWrites);
+            auto *document = owner.getDocument();
+
+            beginTest("Background save writes the snapshot taken before further edits");
+
+            owner.edit("first");
+            expect(document->saveInBackground());
+            owner.edit("second");
+            expect(!document->saveInBackground());
+
+            for (int i = 0; i < 100 && numWrites.get() == 0; ++i)
+            {
+                Thread::sleep(10);
+            }
+
+            expectEquals(numWrites.get(), 1);
+            expectEquals(file.loadFileAsString(), String("first"));
+            expect(document->hasUnsavedChanges());
+
+            document->save();
+            expectEquals(file.loadFileAsString(), String("second"));
+            expect(!document->hasUnsavedChanges());
+
+            beginTest("Saving waits for the background save");
+
+            owner.edit("third");
+            expect(document->saveInBackground());
+            document->save();
+            expectEquals(numWrites.get(), 2);
+            expectEquals(file.loadFileAsString(), String("third"));
+
+            beginTest("Renaming waits for the background save");
+
+            owner.edit("fourth");
+            expect(document->saveInBackground());
+            document->renameFile(file.getFileNameWithoutExtension() + "-renamed");
+            expectEquals(numWrites.get(), 3);
+            expect(document->getFile() != file);
+            expect(!file.existsAsFile());
+            expectEquals(document->getFile().loadFileAsString(), String("fourth"));
+
+            document->getFile().moveFileTo(file);
+        }
+
+        beginTest("Destruction waits for the background save");
+
+        {
+            DocumentTestOwner owner(file, numWrites);
+            owner.edit("fifth");
+            expect(owner.getDocument()->saveInBackground());
+        }
+
+        expectEquals(numWrites.get(), 4);
+        expectEquals(file.loadFileAsString(), String("fifth"));
+
+        file.deleteFile();
+    }
+};
+
+static DocumentTests documentTests;
+
+#endif
@@ -21,7 +21,7 @@
 
 class DocumentOwner;
 
-class Document : public ChangeListener
+class Document : public ChangeListener, private AsyncUpdater
 {
 public:
 
@@ -47,6 +47,12 @@ public:
 
     void save();
     void saveAs();
+
+    // Takes the owner's snapshot and writes it on a background thread,
+    // or saves right away, if the owner doesn't support snapshots;
+    // returns false if the previous background save is still running
+    bool saveInBackground();
+
     void exportAs(const String &exportExtension,
         const String &defaultFilename = "");
 
@@ -70,6 +76,9 @@ protected:
     int64 calculateStreamHashCode(InputStream &in) const;
     int64 calculateFileHashCode(const File &file) const;
 
+    void handleAsyncUpdate() override;
+    void waitForBackgroundSave();
+
 protected:
 
     DocumentOwner &owner;
@@ -83,5 +92,8 @@ protected:
 
 private:
 
+    class BackgroundSaveThread;
+    UniquePointer<BackgroundSaveThread> backgroundSaveThread;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Document)
 };
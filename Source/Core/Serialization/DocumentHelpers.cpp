@@ -241,6 +241,18 @@ SerializedData DocumentHelpers::load(const String &string)
     return DocumentHelpers::load<XmlSerializer>(string);
 }
 
+bool DocumentHelpers::save(const File &file, const SerializedData &tree,
+    const Serializer &serializer)
+{
+    TempDocument tempDoc(file);
+    if (serializer.saveToFile(tempDoc.getFile(), tree).wasOk())
+    {
+        return tempDoc.overwriteTargetFileWithTemporary();
+    }
+
+    return false;
+}
+
 static File createTempFileForSaving(const File &parentDirectory, String name, const String& suffix)
 {
     return parentDirectory.getNonexistentChildFile(name, suffix, false);
@@ -17,6 +17,8 @@
 
 #pragma once
 
+class Serializer;
+
 class DocumentHelpers final
 {
 public:
@@ -49,15 +51,13 @@ public:
     static bool save(const File &file, const SerializedData &tree)
     {
         static T serializer;
-        TempDocument tempDoc(file);
-        if (serializer.saveToFile(tempDoc.getFile(), tree).wasOk())
-        {
-            return tempDoc.overwriteTargetFileWithTemporary();
-        }
-
-        return false;
+        return DocumentHelpers::save(file, tree, serializer);
     }
 
+    // For the serializers which keep some state between saves
+    static bool save(const File &file, const SerializedData &tree,
+        const Serializer &serializer);
+
     template<typename T>
     static bool save(const File &file, const Serializable &serializable)
     {
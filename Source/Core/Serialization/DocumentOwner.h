@@ -44,6 +44,11 @@ protected:
     virtual void onDocumentDidLoad(File &file) {}
     virtual bool onDocumentSave(File &file) = 0;
     virtual void onDocumentDidSave(File &file) {}
+
+    // Captures the document's state on the message thread, and returns
+    // the function writing it into the file, which can run on any thread;
+    // the owners which can't save that way just return an empty one
+    virtual Function<bool()> onDocumentSnapshot(const File &file) { return {}; }
     virtual void onDocumentImport(File &file) = 0;
     virtual bool onDocumentExport(File &file) = 0;
 
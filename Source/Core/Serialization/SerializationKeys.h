@@ -84,6 +84,10 @@ namespace Serialization
         static const Identifier timeSignatures = "timeSignatures";
         static const Identifier keySignatures = "keySignatures";
 
+        // Sequences' summaries, known before their events are read
+        static const Identifier firstBeat = "firstBeat";
+        static const Identifier lastBeat = "lastBeat";
+
         // Events
         static const Identifier note = "note";
         static const Identifier automationEvent = "event";
@@ -170,6 +174,10 @@ namespace Serialization
         static const Identifier audioDeviceBufferSize = "bufferSize";
         static const Identifier audioDeviceInputChannels = "inputChannels";
         static const Identifier audioDeviceOutputChannels = "outputChannels";
+
+        static const Identifier realtimeMode = "realtimeMode";
+        static const Identifier realtimePlayerPriority = "realtimePlayerPriority";
+        static const Identifier realtimeAudioPriority = "realtimeAudioPriority";
     } // namespace Audio
 
     namespace Config
@@ -624,6 +632,15 @@ namespace Serialization
         static const Identifier undoStack = "undoStack";
         static const Identifier transaction = "transaction";
 
+        static const Identifier journalIndex = "journalIndex";
+        static const Identifier journalIndexPosition = "index";
+        static const Identifier journalGeneration = "generation";
+        static const Identifier journalRecords = "records";
+        static const Identifier journalPreviousIndexPosition = "previous";
+        static const Identifier numTransactions = "size";
+        static const Identifier currentTransaction = "current";
+        static const Identifier projectId = "projectId";
+
         static const Identifier name = "name";
         static const Identifier xPath = "path";
         static const Identifier trackId = "trackId";
@@ -18,6 +18,69 @@
 #include "Common.h"
 #include "SerializedData.h"
 
+//===----------------------------------------------------------------------===//
+// Arena
+//===----------------------------------------------------------------------===//
+
+// A bump allocator for the trees read from streams: all the nodes
+// of one document, their property arrays and string payloads are placed
+// in a few large blocks, which are freed at once when the last node dies;
+// the arena also keeps the identifiers its nodes refer to by index,
+// so that nothing read from a document outlives it
+class SerializedDataArena final : public ReferenceCountedObject
+{
+public:
+
+    using Ptr = ReferenceCountedObjectPtr<SerializedDataArena>;
+
+    SerializedDataArena() noexcept { ++getNumAliveArenas(); }
+    ~SerializedDataArena() override { --getNumAliveArenas(); }
+
+    void *allocate(size_t numBytes)
+    {
+        numBytes = (numBytes + 15) & ~size_t(15);
+
+        if (this->blocks.isEmpty() || this->lastBlockUsed + numBytes > this->lastBlockSize)
+        {
+            const auto nextBlockSize = jlimit(minBlockSize, maxBlockSize, this->lastBlockSize * 2);
+            this->lastBlockSize = jmax(numBytes, nextBlockSize);
+            this->lastBlockUsed = 0;
+            this->blocks.add(new HeapBlock<char>(this->lastBlockSize));
+        }
+
+        auto *result = this->blocks.getLast()->get() + this->lastBlockUsed;
+        this->lastBlockUsed += numBytes;
+        return result;
+    }
+
+    // only added to while the document is read, and then only read
+    Array<Identifier> identifiers;
+
+    // guards the conversion of the arena's strings on first access
+    SpinLock conversionLock;
+
+    // the tests check that the arenas are released along with the trees
+    static Atomic<int> &getNumAliveArenas() noexcept
+    {
+        static Atomic<int> numAliveArenas;
+        return numAliveArenas;
+    }
+
+private:
+
+    static constexpr size_t minBlockSize = 64 * 1024;
+    static constexpr size_t maxBlockSize = 4 * 1024 * 1024;
+
+    OwnedArray<HeapBlock<char>> blocks;
+    size_t lastBlockSize = 0;
+    size_t lastBlockUsed = 0;
+
+};
+
+//===----------------------------------------------------------------------===//
+// Shared data
+//===----------------------------------------------------------------------===//
+
 class SerializedData::SharedData final : public ReferenceCountedObject
 {
 public:
@@ -28,12 +91,16 @@ public:
 
     SharedData(const SharedData &other) :
         ReferenceCountedObject(),
-        type(other.type),
-        properties(other.properties)
+        type(other.type)
     {
-        for (auto *c : other.children)
+        for (int i = 0; i < other.getNumProperties(); ++i)
+        {
+            this->properties.set(other.getPropertyName(i), other.getPropertyValue(i));
+        }
+
+        for (int i = 0; i < other.getNumChildren(); ++i)
         {
-            auto *child = new SharedData(*c);
+            auto *child = new SharedData(*other.getChild(i));
             child->parent = this;
             this->children.add(child);
         }
@@ -50,12 +117,140 @@ public:
             c->parent = nullptr;
             this->children.remove(i);
         }
+
+        this->releaseArenaStorage();
     }
-    
+
+    //===------------------------------------------------------------------===//
+    // Allocation
+    //===------------------------------------------------------------------===//
+
+    // Each node is prefixed with the arena it lives in, or nullptr,
+    // so that deleting it either releases the arena or frees the memory
+
+    static void *operator new(size_t size)
+    {
+        auto *block = static_cast<char *>(::operator new(size + headerSize));
+        *reinterpret_cast<SerializedDataArena **>(block) = nullptr;
+        return block + headerSize;
+    }
+
+    static void *operator new(size_t size, SerializedDataArena &arena)
+    {
+        auto *block = static_cast<char *>(arena.allocate(size + headerSize));
+        *reinterpret_cast<SerializedDataArena **>(block) = &arena;
+        arena.incReferenceCount();
+        return block + headerSize;
+    }
+
+    static void operator delete(void *ptr)
+    {
+        auto *block = static_cast<char *>(ptr) - headerSize;
+        if (auto *arena = *reinterpret_cast<SerializedDataArena **>(block))
+        {
+            arena->decReferenceCount();
+        }
+        else
+        {
+            ::operator delete(block);
+        }
+    }
+
+    static void operator delete(void *ptr, SerializedDataArena &)
+    {
+        SharedData::operator delete(ptr);
+    }
+
+    //===------------------------------------------------------------------===//
+    // Properties and children
+    //===------------------------------------------------------------------===//
+
+    // Both are stored either in the arena, as read, or in the usual
+    // containers, if the node was created or modified afterwards
+
+    int getNumProperties() const noexcept
+    {
+        this->loadIfDeferred();
+        return this->hasArenaStorage ? this->numArenaProperties : this->properties.size();
+    }
+
+    Identifier getPropertyName(int index) const noexcept
+    {
+        this->loadIfDeferred();
+        if (this->hasArenaStorage)
+        {
+            return this->getArena()->identifiers
+                .getReference(this->arenaProperties[index].nameIndex);
+        }
+
+        return this->properties.getName(index);
+    }
+
+    const var &getPropertyValue(int index) const noexcept
+    {
+        this->loadIfDeferred();
+        if (this->hasArenaStorage)
+        {
+            return this->getArenaValue(this->arenaProperties[index]);
+        }
+
+        return this->properties.getValueAt(index);
+    }
+
+    const var *findProperty(const Identifier &name) const noexcept
+    {
+        this->loadIfDeferred();
+        if (this->hasArenaStorage)
+        {
+            const auto *text = name.getCharPointer().getAddress();
+            for (int i = 0; i < this->numArenaProperties; ++i)
+            {
+                if (this->arenaProperties[i].name == text)
+                {
+                    return &this->getArenaValue(this->arenaProperties[i]);
+                }
+            }
+
+            return nullptr;
+        }
+
+        return this->properties.getVarPointer(name);
+    }
+
+    void setProperty(const Identifier &name, const var &newValue)
+    {
+        this->detachFromArena();
+        this->dropContentKey();
+        this->properties.set(name, newValue);
+    }
+
+    int getNumChildren() const noexcept
+    {
+        this->loadIfDeferred();
+        return this->hasArenaStorage ? this->numArenaChildren : this->children.size();
+    }
+
+    SharedData *getChild(int index) const noexcept
+    {
+        if (isPositiveAndBelow(index, this->getNumChildren()))
+        {
+            return this->getChildren()[index];
+        }
+
+        return nullptr;
+    }
+
+    SharedData **getChildren() const noexcept
+    {
+        this->loadIfDeferred();
+        return this->hasArenaStorage ? this->arenaChildren : this->children.begin();
+    }
+
     SerializedData getChildWithName(const Identifier &typeToMatch) const
     {
-        for (auto *s : this->children)
+        for (int i = 0; i < this->getNumChildren(); ++i)
         {
+            auto *s = this->getChildren()[i];
             if (s->type == typeToMatch)
             {
                 return SerializedData(*s);
@@ -65,6 +260,49 @@ public:
         return {};
     }
     
+    //===------------------------------------------------------------------===//
+    // Deferred loading
+    //===------------------------------------------------------------------===//
+
+    using Loader = Function<SerializedData()>;
+
+    void setDeferredLoader(Loader loader, ContentKey *key, const NamedValueSet &summary)
+    {
+        jassert(this->getNumProperties() == 0 && this->getNumChildren() == 0);
+        this->deferredContent = makeUnique<DeferredContent>();
+        this->deferredContent->loader = std::move(loader);
+        this->deferredContent->summary = summary;
+        this->contentKey = key;
+        this->hasDeferredContent = true;
+    }
+
+    bool isDeferred() const noexcept
+    {
+        return this->hasDeferredContent.get();
+    }
+
+    bool hasFailedToLoad() const noexcept
+    {
+        return !this->hasDeferredContent.get() &&
+            this->deferredContent != nullptr &&
+            this->deferredContent->hasFailedToLoad;
+    }
+
+    inline void loadIfDeferred() const
+    {
+        if (this->hasDeferredContent.get())
+        {
+            const_cast<SharedData *>(this)->loadDeferredContent();
+        }
+    }
+
+    const NamedValueSet &getDeferredSummary() const noexcept
+    {
+        static const NamedValueSet noSummary;
+        return this->deferredContent != nullptr ?
+            this->deferredContent->summary : noSummary;
+    }
+
     bool isAChildOf(const SharedData *possibleParent) const noexcept
     {
         for (auto *p = parent; p != nullptr; p = p->parent)
@@ -84,6 +322,8 @@ public:
         {
             jassert(child != this && !this->isAChildOf(child));
             jassert(child->parent == nullptr);
+            this->detachFromArena();
+            this->dropContentKey();
             this->children.insert(index, child);
             child->parent = this;
         }
@@ -95,6 +335,8 @@ public:
         {
             jassert(child != this && !this->isAChildOf(child));
             jassert(child->parent == nullptr);
+            this->detachFromArena();
+            this->dropContentKey();
             this->children.add(child);
             child->parent = this;
         }
@@ -103,16 +345,24 @@ public:
     bool isEquivalentTo(const SharedData &other) const noexcept
     {
         if (this->type != other.type
-            || this->properties.size() != other.properties.size()
-            || this->children.size() != other.children.size()
-            || this->properties != other.properties)
+            || this->getNumProperties() != other.getNumProperties()
+            || this->getNumChildren() != other.getNumChildren())
         {
             return false;
         }
 
-        for (int i = 0; i < children.size(); ++i)
+        for (int i = 0; i < this->getNumProperties(); ++i)
+        {
+            const auto *otherValue = other.findProperty(this->getPropertyName(i));
+            if (otherValue == nullptr || *otherValue != this->getPropertyValue(i))
+            {
+                return false;
+            }
+        }
+
+        for (int i = 0; i < this->getNumChildren(); ++i)
         {
-            if (!children.getObjectPointerUnchecked(i)->isEquivalentTo(*other.children.getObjectPointerUnchecked(i)))
+            if (!this->getChild(i)->isEquivalentTo(*other.getChild(i)))
             {
                 return false;
             }
@@ -124,32 +374,48 @@ public:
     XmlElement *createXml() const
     {
         auto *xml = new XmlElement(this->type);
-        this->properties.copyToXmlAttributes(*xml);
 
-        for (auto i = this->children.size(); --i >= 0;)
+        for (int i = 0; i < this->getNumProperties(); ++i)
         {
-            xml->prependChildElement(this->children.getObjectPointerUnchecked(i)->createXml());
+            const auto &value = this->getPropertyValue(i);
+            if (auto *mb = value.getBinaryData())
+            {
+                xml->setAttribute(this->getPropertyName(i), mb->toBase64Encoding());
+            }
+            else
+            {
+                xml->setAttribute(this->getPropertyName(i), value.toString());
+            }
+        }
+
+        for (auto i = this->getNumChildren(); --i >= 0;)
+        {
+            xml->prependChildElement(this->getChild(i)->createXml());
         }
 
         return xml;
     }
 
+    //===------------------------------------------------------------------===//
+    // Streams
+    //===------------------------------------------------------------------===//
+
     void writeToStream(OutputStream &output) const
     {
         output.writeString(this->type.toString());
-        output.writeCompressedInt(this->properties.size());
+        output.writeCompressedInt(this->getNumProperties());
 
-        for (int j = 0; j < this->properties.size(); ++j)
+        for (int j = 0; j < this->getNumProperties(); ++j)
         {
-            output.writeString(this->properties.getName(j).toString());
-            this->properties.getValueAt(j).writeToStream(output);
+            output.writeString(this->getPropertyName(j).toString());
+            this->getPropertyValue(j).writeToStream(output);
         }
 
-        output.writeCompressedInt(this->children.size());
+        output.writeCompressedInt(this->getNumChildren());
 
-        for (auto *c : this->children)
+        for (int i = 0; i < this->getNumChildren(); ++i)
         {
-            writeObjectToStream(output, c);
+            writeObjectToStream(output, this->getChild(i));
         }
     }
 
@@ -167,14 +433,388 @@ public:
         }
     }
 
+    // The state of reading one document: the arena to put it in,
+    // and the identifiers met so far, so that each distinct one
+    // is only looked up in the string pool and added to the arena once
+    struct Reader final
+    {
+        explicit Reader(SerializedDataArena &arena) : arena(arena) {}
+
+        struct Name final
+        {
+            Identifier identifier;
+            const char *text;
+        };
+
+        // Returns the index in the names array, which is also
+        // the index in the arena's identifiers, or -1 if empty
+        int readName(InputStream &input)
+        {
+            this->buffer.reset();
+
+            uint32 hash = 2166136261u;
+            for (;;)
+            {
+                const auto c = input.readByte();
+                this->buffer.writeByte(c);
+
+                if (c == 0)
+                {
+                    break;
+                }
+
+                hash = (hash ^ uint8(c)) * 16777619u;
+            }
+
+            if (this->buffer.getDataSize() <= 1)
+            {
+                return -1;
+            }
+
+            const auto *data = static_cast<const char *>(this->buffer.getData());
+            const auto found = this->namesByHash.find(hash);
+            if (found != this->namesByHash.end() &&
+                strcmp(this->names.getReference(found->second).text, data) == 0)
+            {
+                return found->second;
+            }
+
+            // a new name, or a hash collision, which is hardly ever the case
+            const Identifier identifier(String::fromUTF8(data));
+            for (int i = 0; i < this->names.size(); ++i)
+            {
+                if (this->names.getReference(i).identifier == identifier)
+                {
+                    return i;
+                }
+            }
+
+            this->arena.identifiers.add(identifier);
+            this->names.add({ identifier, identifier.getCharPointer().getAddress() });
+            if (found == this->namesByHash.end())
+            {
+                this->namesByHash[hash] = this->names.size() - 1;
+            }
+
+            return this->names.size() - 1;
+        }
+
+        SerializedDataArena &arena;
+        MemoryOutputStream buffer { 32 };
+        Array<Name> names;
+        FlatHashMap<uint32, int> namesByHash;
+    };
+
+    static SharedData *readFromStream(InputStream &input, Reader &reader)
+    {
+        const auto typeIndex = reader.readName(input);
+        if (typeIndex < 0)
+        {
+            return nullptr;
+        }
+
+        auto &arena = reader.arena;
+        auto *node = new (arena) SharedData(reader.names.getReference(typeIndex).identifier);
+        node->hasArenaStorage = true;
+
+        const auto numProps = input.readCompressedInt();
+        if (numProps > 0)
+        {
+            node->arenaProperties = static_cast<ArenaProperty *>
+                (arena.allocate(sizeof(ArenaProperty) * size_t(numProps)));
+
+            for (int i = 0; i < numProps; ++i)
+            {
+                const auto nameIndex = reader.readName(input);
+                if (nameIndex < 0)
+                {
+                    jassertfalse;
+                    var::readFromStream(input);
+                    continue;
+                }
+
+                const auto &name = reader.names.getReference(nameIndex);
+                auto *property = new (node->arenaProperties + node->numArenaProperties) ArenaProperty();
+                property->name = name.text;
+                property->nameIndex = nameIndex;
+                readValue(input, *property, arena);
+                ++node->numArenaProperties;
+            }
+        }
+
+        const auto numChildren = input.readCompressedInt();
+        if (numChildren > 0)
+        {
+            node->arenaChildren = static_cast<SharedData **>
+                (arena.allocate(sizeof(SharedData *) * size_t(numChildren)));
+
+            for (int i = 0; i < numChildren; ++i)
+            {
+                auto *child = readFromStream(input, reader);
+                if (child == nullptr)
+                {
+                    break;
+                }
+
+                child->incReferenceCount();
+                child->parent = node;
+                node->arenaChildren[node->numArenaChildren++] = child;
+            }
+        }
+
+        return node;
+    }
+
     const Identifier type;
     NamedValueSet properties;
     ReferenceCountedArray<SharedData> children;
     SharedData *parent = nullptr;
 
+    // see SerializedData::getContentKey
+    ContentKey::Ptr contentKey;
+
+private:
+
+    static constexpr size_t headerSize = 16;
+
+    struct ArenaProperty final
+    {
+        // the identifier's pooled text, and its index in the arena
+        const char *name = nullptr;
+        int nameIndex = 0;
+
+        // strings are kept in the arena as read, and only
+        // converted into the value when accessed for the first time
+        Atomic<const char *> text;
+        var value;
+    };
+
+    bool hasArenaStorage = false;
+    ArenaProperty *arenaProperties = nullptr;
+    int numArenaProperties = 0;
+    SharedData **arenaChildren = nullptr;
+    int numArenaChildren = 0;
+
+    // Kept until the node is deleted, so that the threads waiting
+    // for the node's contents can still hold its lock when they are loaded
+    struct DeferredContent final
+    {
+        Loader loader;
+        NamedValueSet summary;
+        CriticalSection loadingLock;
+        bool hasFailedToLoad = false;
+    };
+
+    UniquePointer<DeferredContent> deferredContent;
+    Atomic<bool> hasDeferredContent;
+
+    // The key and the summary describe the contents as they were created,
+    // so they are both dropped as soon as the node is modified
+    void dropContentKey()
+    {
+        this->contentKey = nullptr;
+        if (this->deferredContent != nullptr)
+        {
+            this->deferredContent->summary.clear();
+        }
+    }
+
+    SerializedDataArena *getArena() const noexcept
+    {
+        jassert(this->hasArenaStorage);
+        const auto *block = reinterpret_cast<const char *>(this) - headerSize;
+        return *reinterpret_cast<SerializedDataArena *const *>(block);
+    }
+
+    const var &getArenaValue(ArenaProperty &property) const noexcept
+    {
+        if (property.text.get() != nullptr)
+        {
+            const SpinLock::ScopedLockType lock(this->getArena()->conversionLock);
+            if (const auto *text = property.text.get())
+            {
+                property.value = String::fromUTF8(text);
+                property.text = nullptr;
+            }
+        }
+
+        return property.value;
+    }
+
+    // the same format as in var::readFromStream,
+    // except for strings, which go into the arena
+    static void readValue(InputStream &input, ArenaProperty &property, SerializedDataArena &arena)
+    {
+        enum VarStreamMarkers
+        {
+            varMarkerInt = 1,
+            varMarkerBoolTrue = 2,
+            varMarkerBoolFalse = 3,
+            varMarkerDouble = 4,
+            varMarkerString = 5,
+            varMarkerInt64 = 6,
+            varMarkerArray = 7,
+            varMarkerBinary = 8,
+            varMarkerUndefined = 9
+        };
+
+        const auto numBytes = input.readCompressedInt();
+        if (numBytes <= 0)
+        {
+            return;
+        }
+
+        switch (input.readByte())
+        {
+        case varMarkerInt:
+            property.value = input.readInt();
+            break;
+        case varMarkerBoolTrue:
+            property.value = true;
+            break;
+        case varMarkerBoolFalse:
+            property.value = false;
+            break;
+        case varMarkerDouble:
+            property.value = input.readDouble();
+            break;
+        case varMarkerString:
+        {
+            auto *text = static_cast<char *>(arena.allocate(size_t(numBytes)));
+            const auto numRead = input.read(text, numBytes - 1);
+            text[jmax(0, numRead)] = 0;
+            property.text = text;
+            break;
+        }
+        case varMarkerInt64:
+            property.value = input.readInt64();
+            break;
+        case varMarkerArray:
+        {
+            var array;
+            auto *destArray = array.convertToArray();
+            for (int i = input.readCompressedInt(); --i >= 0;)
+            {
+                destArray->add(var::readFromStream(input));
+            }
+            property.value = array;
+            break;
+        }
+        case varMarkerBinary:
+        {
+            MemoryBlock mb(size_t(numBytes - 1));
+            if (numBytes > 1)
+            {
+                const auto numRead = input.read(mb.getData(), numBytes - 1);
+                mb.setSize(size_t(jmax(0, numRead)));
+            }
+            property.value = var(mb);
+            break;
+        }
+        case varMarkerUndefined:
+            property.value = var::undefined();
+            break;
+        default:
+            input.skipNextBytes(numBytes - 1);
+            break;
+        }
+    }
+
+    // Each node has its own lock, so that loading one section doesn't
+    // block the others; the node stays deferred until the contents are
+    // adopted, so that other threads accessing it wait for them
+    void loadDeferredContent()
+    {
+        const ScopedLock lock(this->deferredContent->loadingLock);
+        if (!this->hasDeferredContent.get())
+        {
+            return; // just loaded by another thread
+        }
+
+        const auto loaded = this->deferredContent->loader();
+        if (loaded.data != nullptr && loaded.data->type == this->type)
+        {
+            auto &source = *loaded.data;
+            source.loadIfDeferred();
+            source.detachFromArena();
+
+            this->properties = std::move(source.properties);
+
+            for (auto *child : source.children)
+            {
+                child->parent = this;
+                this->children.add(child);
+            }
+
+            source.children.clear();
+        }
+        else
+        {
+            // the node will stay empty, it's up to the owner to check
+            // hasFailedToLoad() and to decide what to do with the contents
+            DBG("Failed to load the deferred contents of " + this->type.toString());
+            this->deferredContent->hasFailedToLoad = true;
+        }
+
+        // releases whatever the loader has captured
+        this->deferredContent->loader = nullptr;
+        this->hasDeferredContent = false;
+    }
+
+    // Moves the properties and children into the usual containers
+    // before the node is modified; the node itself stays in the arena
+    void detachFromArena()
+    {
+        this->loadIfDeferred();
+
+        if (!this->hasArenaStorage)
+        {
+            return;
+        }
+
+        for (int i = 0; i < this->numArenaProperties; ++i)
+        {
+            this->properties.set(this->getPropertyName(i), this->getArenaValue(this->arenaProperties[i]));
+        }
+
+        for (int i = 0; i < this->numArenaChildren; ++i)
+        {
+            this->children.add(this->arenaChildren[i]);
+            this->arenaChildren[i]->decReferenceCount();
+        }
+
+        this->numArenaChildren = 0;
+        this->releaseArenaStorage();
+    }
+
+    void releaseArenaStorage()
+    {
+        for (auto i = this->numArenaChildren; --i >= 0;)
+        {
+            auto *c = this->arenaChildren[i];
+            c->parent = nullptr;
+            c->decReferenceCount();
+        }
+
+        for (int i = 0; i < this->numArenaProperties; ++i)
+        {
+            this->arenaProperties[i].~ArenaProperty();
+        }
+
+        this->arenaChildren = nullptr;
+        this->numArenaChildren = 0;
+        this->arenaProperties = nullptr;
+        this->numArenaProperties = 0;
+        this->hasArenaStorage = false;
+    }
+
     JUCE_LEAK_DETECTOR(SharedData)
 };
 
+//===----------------------------------------------------------------------===//
+// SerializedData
+//===----------------------------------------------------------------------===//
+
 SerializedData::SerializedData() noexcept {}
 
 SerializedData::SerializedData(const Identifier &type) :
@@ -229,6 +869,36 @@ SerializedData SerializedData::createCopy() const
     return SerializedData(*new SharedData(*this->data));
 }
 
+SerializedData SerializedData::createDeferred(const Identifier &type,
+    Function<SerializedData()> loader, ContentKey *contentKey,
+    const NamedValueSet &summary)
+{
+    SerializedData result(type);
+    result.data->setDeferredLoader(std::move(loader), contentKey, summary);
+    return result;
+}
+
+bool SerializedData::isDeferred() const noexcept
+{
+    return this->data != nullptr && this->data->isDeferred();
+}
+
+bool SerializedData::hasFailedToLoad() const noexcept
+{
+    return this->data != nullptr && this->data->hasFailedToLoad();
+}
+
+const NamedValueSet &SerializedData::getDeferredSummary() const noexcept
+{
+    static const NamedValueSet noSummary;
+    return this->data != nullptr ? this->data->getDeferredSummary() : noSummary;
+}
+
+SerializedData::ContentKey *SerializedData::getContentKey() const noexcept
+{
+    return this->data != nullptr ? this->data->contentKey.get() : nullptr;
+}
+
 bool SerializedData::hasType(const Identifier &typeName) const noexcept
 {
     return this->data != nullptr && this->data->type == typeName;
@@ -254,48 +924,65 @@ SerializedData SerializedData::getParent() const noexcept
 const var &SerializedData::getProperty(const Identifier &name) const noexcept
 {
     jassert(this->data != nullptr);
-    return this->data->properties[name];
+    if (const auto *value = this->data->findProperty(name))
+    {
+        return *value;
+    }
+
+    static const var nullValue;
+    return nullValue;
 }
 
 var SerializedData::getProperty(const Identifier &name, const var &defaultValue) const
 {
     jassert(this->data != nullptr);
-    return this->data->properties.getWithDefault(name, defaultValue);
+    if (const auto *value = this->data->findProperty(name))
+    {
+        return *value;
+    }
+
+    return defaultValue;
 }
 
 SerializedData &SerializedData::setProperty(const Identifier &name, const var &newValue)
 {
     jassert(this->data != nullptr);
     jassert(name.toString().isNotEmpty());
-    this->data->properties.set(name, newValue);
+    this->data->setProperty(name, newValue);
     return *this;
 }
 
 bool SerializedData::hasProperty(const Identifier &name) const noexcept
 {
-    return this->data != nullptr && this->data->properties.contains(name);
+    return this->data != nullptr && this->data->findProperty(name) != nullptr;
 }
 
 int SerializedData::getNumProperties() const noexcept
 {
-    return this->data == nullptr ? 0 : this->data->properties.size();
+    return this->data == nullptr ? 0 : this->data->getNumProperties();
 }
 
 Identifier SerializedData::getPropertyName(int index) const noexcept
 {
     jassert(this->data != nullptr);
-    return this->data->properties.getName(index);
+    return this->data->getPropertyName(index);
+}
+
+const var &SerializedData::getPropertyValue(int index) const noexcept
+{
+    jassert(this->data != nullptr);
+    return this->data->getPropertyValue(index);
 }
 
 int SerializedData::getNumChildren() const noexcept
 {
-    return this->data == nullptr ? 0 : this->data->children.size();
+    return this->data == nullptr ? 0 : this->data->getNumChildren();
 }
 
 SerializedData SerializedData::getChild(int index) const
 {
     jassert(this->data != nullptr);
-    if (auto *c = this->data->children.getObjectPointer(index))
+    if (auto *c = this->data->getChild(index))
     {
         return SerializedData(*c);
     }
@@ -322,7 +1009,7 @@ void SerializedData::appendChild(const SerializedData &child)
 }
 
 SerializedData::Iterator::Iterator(const SerializedData &v, bool isEnd)
-    : internal(v.data != nullptr ? (isEnd ? v.data->children.end() : v.data->children.begin()) : nullptr) {}
+    : internal(v.data != nullptr ? (v.data->getChildren() + (isEnd ? v.data->getNumChildren() : 0)) : nullptr) {}
 
 SerializedData::Iterator &SerializedData::Iterator::operator++()
 {
@@ -384,75 +1071,219 @@ void SerializedData::writeToStream(OutputStream &output) const
     SharedData::writeObjectToStream(output, this->data.get());
 }
 
-inline static Identifier readIdentifier(InputStream &input)
+SerializedData SerializedData::readFromStream(InputStream &input)
 {
-    // avoid re-allocating a buffer *every* time we read an object or property type
-    // (using JUCE's readString() on deserialization sucks really hard);
-    // also preallocated size of 32 should be enough for all identifiers I ever use,
-    // and for all string values var::readFromStream() will be called, but far less frequently 
-    static MemoryOutputStream buffer(32);
-    buffer.reset();
+    // the arena is kept alive by the nodes read into it
+    SerializedDataArena::Ptr arena(new SerializedDataArena());
+    SharedData::Reader reader(*arena);
 
-    for (;;)
+    if (auto *root = SharedData::readFromStream(input, reader))
     {
-        auto c = input.readByte();
-        buffer.writeByte(c);
-
-        if (c == 0)
-        {
-            return buffer.toUTF8();
-        }
+        return SerializedData(*root);
     }
+
+    return {};
 }
 
-SerializedData SerializedData::readFromStream(InputStream &input)
+SerializedData SerializedData::readFromData(const void *data, size_t numBytes)
 {
-    const auto type = readIdentifier(input);
+    MemoryInputStream in(data, numBytes, false);
+    return readFromStream(in);
+}
 
-    if (!type.isValid())
-    {
-        return {};
-    }
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
 
-    SerializedData v(type);
+#if JUCE_UNIT_TESTS
 
-    const auto numProps = input.readCompressedInt();
+class SerializedDataTests final : public UnitTest
+{
+public:
 
-    for (int i = 0; i < numProps; ++i)
-    {
-        const auto propertyType = readIdentifier(input);
+    SerializedDataTests() : UnitTest("Serialized data tests", UnitTestCategories::helio) {}
 
-        if (propertyType.isValid())
+    void runTest() override
+    {
+        beginTest("Trees read from streams are equivalent to the written ones");
+
+        SerializedData tree("root");
+        tree.setProperty("name", "Some name");
+        tree.setProperty("empty", String());
+        tree.setProperty("int", 42);
+        tree.setProperty("int64", int64(1) << 40);
+        tree.setProperty("double", 0.25);
+        tree.setProperty("bool", true);
+        tree.setProperty("binary", var(MemoryBlock("abc", 3)));
+
+        for (int i = 0; i < 100; ++i)
         {
-            v.data->properties.set(propertyType, var::readFromStream(input));
+            SerializedData child("child");
+            child.setProperty("id", String(i));
+            child.setProperty("key", i);
+            tree.appendChild(child);
         }
-        else
+
+        auto loaded = readBack(tree);
+        expect(loaded.isEquivalentTo(tree));
+        expect(loaded.hasType("root"));
+        expectEquals(loaded.getProperty("name").toString(), String("Some name"));
+        expect(loaded.getProperty("empty").isString());
+        expectEquals(int(loaded.getProperty("int")), 42);
+        expectEquals(int64(loaded.getProperty("int64")), int64(1) << 40);
+        expectEquals(double(loaded.getProperty("double")), 0.25);
+        expect(bool(loaded.getProperty("bool")));
+        expectEquals(loaded.getProperty("binary").getBinaryData()->getSize(), size_t(3));
+        expect(loaded.getProperty("missing").isVoid());
+        expectEquals(int(loaded.getProperty("missing", 7)), 7);
+
+        int i = 0;
+        for (const auto &child : loaded)
         {
-            jassertfalse;
+            expectEquals(child.getProperty("id").toString(), String(i));
+            expect(child.getParent() == loaded);
+            ++i;
         }
+
+        expectEquals(i, 100);
+
+        beginTest("Trees read from streams can be modified");
+
+        auto firstChild = loaded.getChild(0);
+        firstChild.setProperty("key", 100);
+        firstChild.appendChild(SerializedData("grandChild"));
+        loaded.setProperty("name", "Other name");
+        loaded.appendChild(SerializedData("lastChild"));
+
+        expectEquals(int(firstChild.getProperty("key")), 100);
+        expectEquals(firstChild.getProperty("id").toString(), String("0"));
+        expectEquals(firstChild.getNumChildren(), 1);
+        expectEquals(loaded.getProperty("name").toString(), String("Other name"));
+        expectEquals(int(loaded.getProperty("int")), 42);
+        expectEquals(loaded.getNumChildren(), 101);
+        expect(loaded.getChild(0) == firstChild);
+        expect(loaded.getChildWithName("lastChild").isValid());
+        expect(readBack(loaded).isEquivalentTo(loaded));
+
+        beginTest("Copied subtrees don't keep the trees read from streams");
+
+        const auto numArenas = SerializedDataArena::getNumAliveArenas().get();
+        auto lastChild = readBack(tree).getChild(99);
+        expect(!lastChild.getParent().isValid());
+        expectEquals(lastChild.getProperty("id").toString(), String("99"));
+
+        // any subtree keeps the whole arena it was read into,
+        // so the ones kept for long have to be copied out of it
+        expectEquals(SerializedDataArena::getNumAliveArenas().get(), numArenas + 1);
+        const auto lastChildCopy = lastChild.createCopy();
+        expect(lastChildCopy.isEquivalentTo(lastChild));
+        lastChild = {};
+        expectEquals(SerializedDataArena::getNumAliveArenas().get(), numArenas);
+        expectEquals(lastChildCopy.getProperty("id").toString(), String("99"));
+
+        beginTest("Deferred nodes are loaded once when first accessed");
+
+        int numLoads = 0;
+        auto deferred = SerializedData::createDeferred("root", [&numLoads, tree]()
+        {
+            ++numLoads;
+            return readBack(tree);
+        });
+
+        SerializedData parent("parent");
+        parent.appendChild(deferred);
+
+        expect(deferred.isDeferred());
+        expect(parent.getChildWithName("root") == deferred);
+        expectEquals(numLoads, 0);
+
+        expectEquals(deferred.getNumChildren(), 100);
+        expect(!deferred.isDeferred());
+        expect(deferred.getParent() == parent);
+        expect(deferred.getChild(0).getParent() == deferred);
+        expect(deferred.isEquivalentTo(tree));
+        expectEquals(numLoads, 1);
+
+        beginTest("Deferred nodes are loaded independently");
+
+        // one node's loader waits for another node loaded on another thread
+        WaitableEvent otherLoaded;
+        const auto other = SerializedData::createDeferred(tree.getType(), [&otherLoaded, tree]()
+        {
+            const auto result = readBack(tree);
+            otherLoaded.signal();
+            return result;
+        });
+
+        bool hasLoadedOther = false;
+        const auto waiting = SerializedData::createDeferred(tree.getType(), [&]()
+        {
+            LoadingThread thread(other);
+            thread.startThread();
+            hasLoadedOther = otherLoaded.wait(5000);
+            thread.waitForThreadToExit(-1);
+            return readBack(tree);
+        });
+
+        expectEquals(waiting.getNumChildren(), 100);
+        expect(hasLoadedOther);
+        expect(!other.isDeferred());
+
+        beginTest("Deferred nodes keep their summaries until modified");
+
+        NamedValueSet summary;
+        summary.set("firstBeat", 1.5);
+        auto summarized = SerializedData::createDeferred(tree.getType(),
+            [tree]() { return readBack(tree); }, nullptr, summary);
+
+        expect(summarized.getDeferredSummary() == summary);
+        expect(summarized.isDeferred());
+        expectEquals(summarized.getNumChildren(), 100);
+        expect(summarized.getDeferredSummary() == summary);
+
+        summarized.setProperty("int", 43);
+        expect(summarized.getDeferredSummary().isEmpty());
+
+        beginTest("Deferred nodes report the failure to load");
+
+        const auto broken = SerializedData::createDeferred(tree.getType(),
+            []() { return SerializedData("unexpected"); }, nullptr, summary);
+
+        expect(!broken.hasFailedToLoad());
+        expectEquals(broken.getNumChildren(), 0);
+        expect(!broken.isDeferred());
+        expect(broken.hasFailedToLoad());
+        expect(broken.getDeferredSummary() == summary);
+        expect(!summarized.hasFailedToLoad());
     }
 
-    const auto numChildren = input.readCompressedInt();
-    v.data->children.ensureStorageAllocated(numChildren);
+private:
 
-    for (int i = 0; i < numChildren; ++i)
+    class LoadingThread final : public Thread
     {
-        const auto child = readFromStream(input);
+    public:
 
-        if (!child.isValid())
+        explicit LoadingThread(const SerializedData &node) :
+            Thread("Deferred loading"), node(node) {}
+
+        void run() override
         {
-            return v;
+            this->node.getNumChildren();
         }
 
-        v.data->children.add(child.data);
-        child.data->parent = v.data.get();
+    private:
+
+        const SerializedData node;
+    };
+
+    static SerializedData readBack(const SerializedData &tree)
+    {
+        MemoryOutputStream output;
+        tree.writeToStream(output);
+        return SerializedData::readFromData(output.getData(), output.getDataSize());
     }
+};
 
-    return v;
-}
+static SerializedDataTests serializedDataTests;
 
-SerializedData SerializedData::readFromData(const void *data, size_t numBytes)
-{
-    MemoryInputStream in(data, numBytes, false);
-    return readFromStream(in);
-}
+#endif
@@ -38,6 +38,42 @@ public:
 
     SerializedData createCopy() const;
 
+    // The objects identifying the contents of the deferred nodes (see below)
+    class ContentKey : public ReferenceCountedObject
+    {
+    public:
+        using Ptr = ReferenceCountedObjectPtr<ContentKey>;
+        ~ContentKey() override = default;
+    };
+
+    // Creates a node of the given type, whose properties and children
+    // are only produced by the loader when any of them is first accessed;
+    // the type is known upfront, so hasType() doesn't trigger loading;
+    // so is the optional summary, i.e. a few values describing the contents
+    // which the owners may need before that, like the range of the events
+    static SerializedData createDeferred(const Identifier &type,
+        Function<SerializedData()> loader,
+        ContentKey *contentKey = nullptr,
+        const NamedValueSet &summary = {});
+
+    // True for the deferred nodes not accessed yet
+    bool isDeferred() const noexcept;
+
+    // True for the deferred nodes whose loader has failed to produce
+    // the contents of the expected type, so they were left empty
+    bool hasFailedToLoad() const noexcept;
+
+    // The summary the deferred node was created with, which doesn't
+    // trigger loading; like the content key (see below), it is dropped
+    // once the node itself is modified
+    const NamedValueSet &getDeferredSummary() const noexcept;
+
+    // The object identifying the deferred node's contents, if any:
+    // the nodes created with the same key are known to be equivalent,
+    // so the serializers can reuse their previous output for them;
+    // the key is dropped once the node itself is modified
+    ContentKey *getContentKey() const noexcept;
+
     Identifier getType() const noexcept;
     bool hasType(const Identifier &type) const noexcept;
 
@@ -48,6 +84,7 @@ public:
     bool hasProperty(const Identifier &name) const noexcept;
     int getNumProperties() const noexcept;
     Identifier getPropertyName(int index) const noexcept;
+    const var &getPropertyValue(int index) const noexcept;
 
     int getNumChildren() const noexcept;
     SerializedData getChild(int index) const;
@@ -61,6 +98,12 @@ public:
     static SerializedData readFromXml(const XmlElement &xml);
 
     void writeToStream(OutputStream &output) const;
+
+    // The trees read from streams are placed in one arena per document,
+    // which is freed at once when the last of their nodes is gone;
+    // any node modified later moves its contents out of the arena,
+    // and any subtree kept after loading should be a createCopy(),
+    // so that it doesn't keep the whole document in memory
     static SerializedData readFromStream(InputStream &input);
     static SerializedData readFromData(const void *data, size_t numBytes);
 
@@ -174,7 +174,7 @@ SerializedData AutomationTrackNode::serialize() const
 
     this->serializeTrackProperties(tree);
 
-    tree.appendChild(this->sequence->serialize());
+    tree.appendChild(this->serializeSequence(Serialization::Midi::automation));
     tree.appendChild(this->pattern->serialize());
 
     TreeNodeSerializer::serializeChildren(*this, tree);
@@ -191,7 +191,7 @@ void AutomationTrackNode::deserialize(const SerializedData &data)
 
     forEachChildWithType(data, e, Serialization::Midi::automation)
     {
-        this->sequence->deserialize(e);
+        this->deserializeSequence(e);
     }
 
     forEachChildWithType(data, e, Serialization::Midi::pattern)
@@ -246,11 +246,11 @@ SerializedData AutomationTrackNode::serializeEventsDelta() const
 {
     SerializedData tree(Serialization::VCS::AutoSequenceDeltas::eventsAdded);
 
-    for (int i = 0; i < this->getSequence()->size(); ++i)
+    const auto snapshot = this->getSequence()->getSnapshot();
+    snapshot->forEachEvent([&tree](const MidiEvent &event)
     {
-        const MidiEvent *event = this->getSequence()->getUnchecked(i);
-        tree.appendChild(event->serialize());
-    }
+        tree.appendChild(event.serialize());
+    });
 
     return tree;
 }
@@ -171,6 +171,14 @@ void MidiTrackNode::setTrackInstrumentId(const String &val, bool sendNotificatio
     if (this->instrumentId != val)
     {
         this->instrumentId = val;
+
+        // the caches of the instrument links are versioned by the registry,
+        // and the checkouts change the instruments without notifications
+        if (this->lastFoundParent != nullptr)
+        {
+            this->lastFoundParent->invalidateTracksRegistry();
+        }
+
         if (sendNotifications)
         {
             this->dispatchChangeTrackProperties();
@@ -201,6 +209,11 @@ void MidiTrackNode::setTrackControllerNumber(int val, bool sendNotifications)
 
 MidiSequence *MidiTrackNode::getSequence() const noexcept
 {
+    if (this->hasDeferredSequence.get())
+    {
+        this->loadDeferredSequence();
+    }
+
     return this->sequence.get();
 }
 
@@ -209,6 +222,111 @@ Pattern *MidiTrackNode::getPattern() const noexcept
     return this->pattern.get();
 }
 
+Point<float> MidiTrackNode::getSequenceRangeInBeats() const
+{
+    {
+        const ScopedLock lock(this->deferredSequenceLock);
+        if (this->hasDeferredSequence.get())
+        {
+            const auto &summary = this->deferredSequence.getDeferredSummary();
+            const auto *firstBeat = summary.getVarPointer(Serialization::Midi::firstBeat);
+            const auto *lastBeat = summary.getVarPointer(Serialization::Midi::lastBeat);
+            if (firstBeat != nullptr && lastBeat != nullptr)
+            {
+                return { float(*firstBeat), float(*lastBeat) };
+            }
+        }
+    }
+
+    // no summary in the older files, or the sequence is already loaded
+    const auto *sequence = this->getSequence();
+    return { sequence->getFirstBeat(), sequence->getLastBeat() };
+}
+
+void MidiTrackNode::deserializeSequence(const SerializedData &data)
+{
+    const ScopedLock lock(this->deferredSequenceLock);
+
+    this->hasBrokenSequence = false;
+
+    if (data.isDeferred())
+    {
+        this->deferredSequence = data;
+        this->hasDeferredSequence = true;
+        return;
+    }
+
+    this->deferredSequence = {};
+    this->hasDeferredSequence = false;
+    this->sequence->deserialize(data);
+}
+
+SerializedData MidiTrackNode::serializeSequence(const Identifier &type) const
+{
+    {
+        const ScopedLock lock(this->deferredSequenceLock);
+        // still attached to the tree it was read from, or failed to load,
+        // in which case the original section is written as it was read
+        // (see BinarySerializer), unless the user has put something else
+        // into the track since then
+        if (this->deferredSequence.isValid() &&
+            (!this->hasBrokenSequence.get() || this->sequence->size() == 0))
+        {
+            const auto data = this->deferredSequence;
+            return SerializedData::createDeferred(data.getType(),
+                [data]() { return data.createCopy(); },
+                data.getContentKey(), data.getDeferredSummary());
+        }
+    }
+
+    // the range is saved along with the events, so that the next load
+    // can index the track's beat range without deserializing them
+    NamedValueSet summary;
+    summary.set(Serialization::Midi::firstBeat, this->sequence->getFirstBeat());
+    summary.set(Serialization::Midi::lastBeat, this->sequence->getLastBeat());
+    return this->sequence->serializeSnapshot(type, summary);
+}
+
+void MidiTrackNode::loadDeferredSequence() const
+{
+    const ScopedLock lock(this->deferredSequenceLock);
+    if (!this->hasDeferredSequence.get())
+    {
+        return; // just loaded by another thread
+    }
+
+    this->sequence->deserialize(this->deferredSequence);
+    this->hasDeferredSequence = false;
+
+    if (!this->deferredSequence.hasFailedToLoad())
+    {
+        this->deferredSequence = {};
+        return;
+    }
+
+    // the track stays empty, but its original data is kept, if there's
+    // the content key to write it back as is, so that saving the project
+    // doesn't lose the track which could still be recovered from the file
+    this->hasBrokenSequence = true;
+    if (this->deferredSequence.getContentKey() == nullptr)
+    {
+        this->deferredSequence = {};
+    }
+
+    const auto trackName = this->getTrackName();
+    DBG("Failed to load the sequence of track " + trackName);
+    MessageManager::callAsync([trackName]()
+    {
+        App::Layout().showTooltip("Failed to load track " + trackName,
+            MainLayout::TooltipType::Failure);
+    });
+}
+
+bool MidiTrackNode::hasFailedToLoadSequence() const noexcept
+{
+    return this->hasBrokenSequence.get();
+}
+
 //===----------------------------------------------------------------------===//
 // ProjectEventDispatcher
 //===----------------------------------------------------------------------===//
@@ -362,6 +480,31 @@ void MidiTrackNode::dispatchPostRemoveEvent(MidiSequence *const layer)
     }
 }
 
+void MidiTrackNode::dispatchAddEvents(const Array<const MidiEvent *> &events)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastAddEvents(events);
+    }
+}
+
+void MidiTrackNode::dispatchChangeEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastChangeEvents(oldEvents, newEvents);
+    }
+}
+
+void MidiTrackNode::dispatchRemoveEvents(const Array<const MidiEvent *> &events)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastRemoveEvents(events);
+    }
+}
+
 void MidiTrackNode::dispatchChangeTrackProperties()
 {
     if (this->lastFoundParent != nullptr)
@@ -437,6 +580,12 @@ void MidiTrackNode::onNodeAddedToTree(bool sendNotifications)
     const bool parentHasChanged = (this->lastFoundParent != newParent);
     this->lastFoundParent = newParent;
 
+    if (this->lastFoundParent != nullptr)
+    {
+        // added or moved, either way the tracks list has changed
+        this->lastFoundParent->invalidateTracksRegistry();
+    }
+
     if (parentHasChanged &&
         sendNotifications &&
         this->lastFoundParent != nullptr)
@@ -458,6 +607,7 @@ void MidiTrackNode::onNodeDeletedFromTree(bool sendNotifications)
 
         // Then disconnect from the tree
         this->removeNodeFromParent();
+        this->lastFoundParent->invalidateTracksRegistry();
         TrackGroupNode::removeAllEmptyGroupsInProject(this->lastFoundParent);
     }
 }
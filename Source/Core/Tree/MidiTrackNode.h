@@ -74,6 +74,14 @@ public:
     MidiSequence *getSequence() const noexcept override;
     Pattern *getPattern() const noexcept override;
 
+    // The sequence's first and last beats, which are taken from
+    // the saved summary while the sequence is not deserialized yet
+    Point<float> getSequenceRangeInBeats() const;
+
+    // True if the saved sequence data could not be read, so the track
+    // is left empty, and the data is kept to be saved back unchanged
+    bool hasFailedToLoadSequence() const noexcept;
+
     //===------------------------------------------------------------------===//
     // ProjectEventDispatcher
     //===------------------------------------------------------------------===//
@@ -83,6 +91,11 @@ public:
     void dispatchRemoveEvent(const MidiEvent &event) override;
     void dispatchPostRemoveEvent(MidiSequence *const layer) override;
 
+    void dispatchAddEvents(const Array<const MidiEvent *> &events) override;
+    void dispatchChangeEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void dispatchRemoveEvents(const Array<const MidiEvent *> &events) override;
+
     void dispatchAddClip(const Clip &clip) override;
     void dispatchChangeClip(const Clip &oldClip, const Clip &newClip) override;
     void dispatchRemoveClip(const Clip &clip) override;
@@ -122,6 +135,22 @@ protected:
 
     UniquePointer<MidiSequence> sequence;
     UniquePointer<Pattern> pattern;
+
+    // The sequence data read as a deferred node (see BinarySerializer)
+    // is only deserialized when the sequence is first requested,
+    // so that opening a project doesn't decode all tracks at once;
+    // in turn, the sequence is serialized as a deferred node as well,
+    // so that the autosaver can write it on a background thread
+    void deserializeSequence(const SerializedData &data);
+    SerializedData serializeSequence(const Identifier &type) const;
+
+private:
+
+    void loadDeferredSequence() const;
+    mutable SerializedData deferredSequence;
+    mutable Atomic<bool> hasDeferredSequence;
+    mutable Atomic<bool> hasBrokenSequence;
+    CriticalSection deferredSequenceLock;
     
 protected:
 
@@ -179,7 +179,7 @@ SerializedData PianoTrackNode::serialize() const
 
     this->serializeTrackProperties(tree);
 
-    tree.appendChild(this->sequence->serialize());
+    tree.appendChild(this->serializeSequence(Serialization::Midi::track));
     tree.appendChild(this->pattern->serialize());
 
     TreeNodeSerializer::serializeChildren(*this, tree);
@@ -196,7 +196,7 @@ void PianoTrackNode::deserialize(const SerializedData &data)
 
     forEachChildWithType(data, e, Serialization::Midi::track)
     {
-        this->sequence->deserialize(e);
+        this->deserializeSequence(e);
     }
 
     forEachChildWithType(data, e, Serialization::Midi::pattern)
@@ -240,11 +240,12 @@ SerializedData PianoTrackNode::serializeInstrumentDelta() const
 SerializedData PianoTrackNode::serializeEventsDelta() const
 {
     SerializedData tree(Serialization::VCS::PianoSequenceDeltas::notesAdded);
-    for (int i = 0; i < this->getSequence()->size(); ++i)
+    // the diff thread also gets here, so read the snapshot, not the live events
+    const auto snapshot = this->getSequence()->getSnapshot();
+    snapshot->forEachEvent([&tree](const MidiEvent &event)
     {
-        const MidiEvent *event = this->getSequence()->getUnchecked(i);
-        tree.appendChild(event->serialize());
-    }
+        tree.appendChild(event.serialize());
+    });
 
     return tree;
 }
@@ -0,0 +1,118 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ProjectChangeSet.h"
+#include "MidiSequence.h"
+#include "MidiTrack.h"
+#include "Pattern.h"
+
+template<typename IdType>
+static void foldAdded(ProjectChangeSet::Changes<IdType> &changes, IdType id)
+{
+    if (changes.removed.erase(id) > 0)
+    {
+        changes.changed.insert(id);
+    }
+    else
+    {
+        changes.added.insert(id);
+    }
+}
+
+template<typename IdType>
+static void foldChanged(ProjectChangeSet::Changes<IdType> &changes, IdType id)
+{
+    if (!changes.added.contains(id))
+    {
+        changes.changed.insert(id);
+    }
+}
+
+template<typename IdType>
+static void foldRemoved(ProjectChangeSet::Changes<IdType> &changes, IdType id)
+{
+    if (changes.added.erase(id) == 0)
+    {
+        changes.changed.erase(id);
+        changes.removed.insert(id);
+    }
+}
+
+void ProjectChangeSet::addEvent(const MidiEvent &event)
+{
+    foldAdded(this->tracks[event.getSequence()->getTrack()].events, event.getId());
+}
+
+void ProjectChangeSet::changeEvent(const MidiEvent &event)
+{
+    foldChanged(this->tracks[event.getSequence()->getTrack()].events, event.getId());
+}
+
+void ProjectChangeSet::removeEvent(const MidiEvent &event)
+{
+    foldRemoved(this->tracks[event.getSequence()->getTrack()].events, event.getId());
+}
+
+void ProjectChangeSet::addClip(const Clip &clip)
+{
+    foldAdded(this->tracks[clip.getPattern()->getTrack()].clips, clip.getId());
+}
+
+void ProjectChangeSet::changeClip(const Clip &clip)
+{
+    foldChanged(this->tracks[clip.getPattern()->getTrack()].clips, clip.getId());
+}
+
+void ProjectChangeSet::removeClip(const Clip &clip)
+{
+    foldRemoved(this->tracks[clip.getPattern()->getTrack()].clips, clip.getId());
+}
+
+void ProjectChangeSet::changeTrackProperties(const MidiTrack *track)
+{
+    this->tracks[track].propertiesChanged = true;
+}
+
+void ProjectChangeSet::addTrack(const MidiTrack *track)
+{
+    this->structuralChanges = true;
+}
+
+void ProjectChangeSet::removeTrack(const MidiTrack *track)
+{
+    // the track is about to be deleted, so don't keep the dangling pointer
+    this->tracks.erase(track);
+    this->structuralChanges = true;
+}
+
+void ProjectChangeSet::reloadContent()
+{
+    this->tracks.clear();
+    this->structuralChanges = true;
+}
+
+bool ProjectChangeSet::isEmpty() const noexcept
+{
+    return !this->structuralChanges && this->tracks.empty();
+}
+
+void ProjectChangeSet::clear()
+{
+    this->tracks.clear();
+    this->structuralChanges = false;
+}
@@ -0,0 +1,96 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiTrack;
+
+#include "MidiEvent.h"
+#include "Clip.h"
+
+// A compact record of what has changed in the project since the last commit:
+// the ids of added, changed and removed events and clips, per track.
+// The project accumulates these while broadcasting the per-event callbacks,
+// and commits them to listeners once per transaction (see ProjectNode's
+// ScopedChangeTransaction) or once per message loop tick, so that listeners
+// which only need to invalidate something can do that once per batch.
+
+// Changes to the same id are folded: adding and then removing an event
+// leaves no trace, removing and adding it back (as undo does) is a change.
+
+class ProjectChangeSet final
+{
+public:
+
+    ProjectChangeSet() = default;
+
+    ProjectChangeSet(ProjectChangeSet &&other) = default;
+    ProjectChangeSet &operator= (ProjectChangeSet &&other) = default;
+
+    template<typename IdType>
+    struct Changes final
+    {
+        FlatHashSet<IdType, IdHash> added;
+        FlatHashSet<IdType, IdHash> changed;
+        FlatHashSet<IdType, IdHash> removed;
+
+        bool isEmpty() const noexcept
+        {
+            return this->added.empty() && this->changed.empty() && this->removed.empty();
+        }
+    };
+
+    struct TrackChanges final
+    {
+        Changes<MidiEvent::Id> events;
+        Changes<Clip::Id> clips;
+        bool propertiesChanged = false;
+    };
+
+    void addEvent(const MidiEvent &event);
+    void changeEvent(const MidiEvent &event);
+    void removeEvent(const MidiEvent &event);
+
+    void addClip(const Clip &clip);
+    void changeClip(const Clip &clip);
+    void removeClip(const Clip &clip);
+
+    void changeTrackProperties(const MidiTrack *track);
+
+    // Tracks added or removed, or the whole content reloaded:
+    // the per-track records are not enough to tell what has changed,
+    // and the removed tracks' records are discarded
+    void addTrack(const MidiTrack *track);
+    void removeTrack(const MidiTrack *track);
+    void reloadContent();
+
+    inline bool hasStructuralChanges() const noexcept
+    { return this->structuralChanges; }
+
+    inline const FlatHashMap<const MidiTrack *, TrackChanges> &getTrackChanges() const noexcept
+    { return this->tracks; }
+
+    bool isEmpty() const noexcept;
+    void clear();
+
+private:
+
+    FlatHashMap<const MidiTrack *, TrackChanges> tracks;
+    bool structuralChanges = false;
+
+    JUCE_DECLARE_NON_COPYABLE(ProjectChangeSet)
+};
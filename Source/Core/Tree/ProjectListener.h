@@ -23,6 +23,7 @@ class MidiSequence;
 class Pattern;
 class Clip;
 class ProjectMetadata;
+class ProjectChangeSet;
 
 class ProjectListener
 {
@@ -36,6 +37,35 @@ public:
     virtual void onRemoveMidiEvent(const MidiEvent &event) = 0;
     virtual void onPostRemoveMidiEvent(MidiSequence *const layer) {}
 
+    // Sent by group operations instead of a series of the callbacks above;
+    // by default, these fall back to the per-event callbacks, so only the
+    // listeners which can handle the whole set at once need to override them
+    virtual void onAddMidiEvents(const Array<const MidiEvent *> &events)
+    {
+        for (const auto *event : events)
+        {
+            this->onAddMidiEvent(*event);
+        }
+    }
+
+    virtual void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents)
+    {
+        jassert(oldEvents.size() == newEvents.size());
+        for (int i = 0; i < newEvents.size(); ++i)
+        {
+            this->onChangeMidiEvent(*oldEvents.getUnchecked(i), *newEvents.getUnchecked(i));
+        }
+    }
+
+    virtual void onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+    {
+        for (const auto *event : events)
+        {
+            this->onRemoveMidiEvent(*event);
+        }
+    }
+
     virtual void onAddClip(const Clip &clip) = 0;
     virtual void onChangeClip(const Clip &oldClip, const Clip &newClip) = 0;
     virtual void onRemoveClip(const Clip &clip) = 0;
@@ -65,4 +95,9 @@ public:
     // Sent on midi import, reload or reset by VCS
     virtual void onReloadProjectContent(const Array<MidiTrack *> &tracks) = 0;
 
+    // Sent once per transaction or per message loop tick, after all the
+    // callbacks above, with the summary of what has changed: the listeners
+    // which only need to invalidate something can do it here once per batch
+    virtual void onCommitChangeSet(const ProjectChangeSet &changes) {}
+
 };
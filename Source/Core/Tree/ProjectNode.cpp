@@ -40,6 +40,7 @@
 #include "Pattern.h"
 #include "MidiTrack.h"
 #include "MidiEvent.h"
+#include "PianoSequence.h"
 #include "TrackedItem.h"
 #include "HybridRoll.h"
 #include "UndoStack.h"
@@ -88,6 +89,7 @@ void ProjectNode::initialize()
 {
     this->undoStack = makeUnique<UndoStack>(*this);
     this->autosaver = makeUnique<Autosaver>(*this);
+    this->savedSections = new PackedSectionsCache();
 
     auto &orchestra = App::Workspace().getAudioCore();
     auto &audioCoreSleepTimer = App::Workspace().getAudioCore(); // yup, the same
@@ -353,75 +355,65 @@ void ProjectNode::removeTrack(const MidiTrack &track)
 
 Array<MidiTrack *> ProjectNode::getTracks() const
 {
-    const ScopedReadLock lock(this->tracksListLock);
-    Array<MidiTrack *> tracks;
+    this->rebuildTracksRegistryIfNeeded();
+    return this->tracksRegistry.getTracks();
+}
 
-    // now get all layers inside a tree hierarchy
-    this->collectTracks(tracks);
-    
-    // and explicitly add the only non-tree-owned tracks
-    tracks.add(this->timeline->getAnnotations());
-    tracks.add(this->timeline->getKeySignatures());
-    tracks.add(this->timeline->getTimeSignatures());
+Array<PianoTrackNode *> ProjectNode::getPianoTracks() const
+{
+    this->rebuildTracksRegistryIfNeeded();
+    return this->tracksRegistry.getPianoTracks();
+}
 
-    return tracks;
+Array<AutomationTrackNode *> ProjectNode::getAutomationTracks() const
+{
+    this->rebuildTracksRegistryIfNeeded();
+    return this->tracksRegistry.getAutomationTracks();
 }
 
-void ProjectNode::collectTracks(Array<MidiTrack *> &resultArray, bool onlySelected /*= false*/) const
+void ProjectNode::invalidateTracksRegistry() noexcept
 {
-    const auto trackNodes = this->findChildrenOfType<MidiTrackNode>();
-    
-    for (int i = 0; i < trackNodes.size(); ++i)
-    {
-        if (trackNodes.getUnchecked(i)->isSelected() || !onlySelected)
-        {
-            resultArray.add(trackNodes.getUnchecked(i));
-        }
-    }
+    this->tracksRegistry.invalidate();
 }
 
-Point<float> ProjectNode::getProjectRangeInBeats() const
+uint32 ProjectNode::getTracksVersion() const
 {
-    float lastBeat = -FLT_MAX;
-    float firstBeat = FLT_MAX;
+    this->rebuildTracksRegistryIfNeeded();
+    return this->tracksRegistry.getVersion();
+}
 
-    this->rebuildTracksRefsCacheIfNeeded();
+static Point<float> getTrackRangeInBeats(const MidiTrack *track) noexcept
+{
+    // the tree's tracks know their ranges without loading the sequences
+    const auto *trackNode = dynamic_cast<const MidiTrackNode *>(track);
+    const auto sequenceRange = trackNode != nullptr ? trackNode->getSequenceRangeInBeats() :
+        Point<float>(track->getSequence()->getFirstBeat(), track->getSequence()->getLastBeat());
 
-    for (const auto &i : this->tracksRefsCache)
-    {
-        const auto *track = i.second.get();
-        const float sequenceFirstBeat = track->getSequence()->getFirstBeat();
-        const float sequenceLastBeat = track->getSequence()->getLastBeat();
-        const float patternFirstBeat = track->getPattern() ? track->getPattern()->getFirstBeat() : 0.f;
-        const float patternLastBeat = track->getPattern() ? track->getPattern()->getLastBeat() : 0.f;
-        firstBeat = jmin(firstBeat, sequenceFirstBeat + patternFirstBeat);
-        lastBeat = jmax(lastBeat, sequenceLastBeat + patternLastBeat);
-    }
-    
-    if (firstBeat == FLT_MAX)
-    {
-        firstBeat = 0;
-    }
-    else if (firstBeat > lastBeat)
-    {
-        firstBeat = lastBeat - PROJECT_DEFAULT_NUM_BEATS;
-    }
-    
-    if ((lastBeat - firstBeat) < PROJECT_DEFAULT_NUM_BEATS)
-    {
-        lastBeat = firstBeat + PROJECT_DEFAULT_NUM_BEATS;
-    }
+    const float sequenceFirstBeat = sequenceRange.getX();
+    const float sequenceLastBeat = sequenceRange.getY();
+    const float patternFirstBeat = track->getPattern() ? track->getPattern()->getFirstBeat() : 0.f;
+    const float patternLastBeat = track->getPattern() ? track->getPattern()->getLastBeat() : 0.f;
+    return { sequenceFirstBeat + patternFirstBeat, sequenceLastBeat + patternLastBeat };
+}
 
-    return { firstBeat, lastBeat };
+Point<float> ProjectNode::getProjectRangeInBeats() const
+{
+    this->rebuildBeatRangeIndexIfNeeded();
+
+    return this->beatRangeIndex.getRangeInBeats({
+        getTrackRangeInBeats(this->timeline->getAnnotations()),
+        getTrackRangeInBeats(this->timeline->getKeySignatures()),
+        getTrackRangeInBeats(this->timeline->getTimeSignatures())
+    });
 }
 
 StringArray ProjectNode::getAllTrackNames() const
 {
     StringArray names;
-    this->rebuildTracksRefsCacheIfNeeded();
-    for (const auto &i : this->tracksRefsCache)
+    this->rebuildTracksRegistryIfNeeded();
+    for (const auto *track : this->tracksRegistry.getTracks())
     {
-        names.add(i.second->getTrackName());
+        names.add(track->getTrackName());
     }
     return names;
 }
@@ -466,7 +458,7 @@ void ProjectNode::reset()
     TreeNode::reset();
 }
 
-SerializedData ProjectNode::save() const
+SerializedData ProjectNode::save(const File &file) const
 {
     SerializedData tree(Serialization::Core::project);
 
@@ -475,7 +467,7 @@ SerializedData ProjectNode::save() const
 
     tree.appendChild(this->metadata->serialize());
     tree.appendChild(this->timeline->serialize());
-    tree.appendChild(this->undoStack->serialize());
+    tree.appendChild(this->undoStack->serializeToJournal(UndoStack::getJournalFileFor(file)));
     tree.appendChild(this->transport->serialize());
     tree.appendChild(this->sequencerLayout->serialize());
 
@@ -618,7 +610,7 @@ void ProjectNode::importMidi(const File &file)
         this->timeline->getTimeSignatures()->getSequence()->importMidi(*importedTrack, timeFormat);
     }
     
-    this->isTracksCacheOutdated = true;
+    this->tracksRegistry.invalidate();
     this->broadcastReloadProjectContent();
     const auto range = this->broadcastChangeProjectBeatRange();
     this->broadcastChangeViewBeatRange(range.getX(), range.getY());
@@ -658,6 +650,8 @@ void ProjectNode::broadcastChangeEvent(const MidiEvent &oldEvent, const MidiEven
     //jassert(oldEvent.isValid()); // old event is allowed to be un-owned
     jassert(newEvent.isValid());
     this->changeListeners.call(&ProjectListener::onChangeMidiEvent, oldEvent, newEvent);
+    this->pendingChanges.changeEvent(newEvent);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
@@ -665,6 +659,8 @@ void ProjectNode::broadcastAddEvent(const MidiEvent &event)
 {
     jassert(event.isValid());
     this->changeListeners.call(&ProjectListener::onAddMidiEvent, event);
+    this->pendingChanges.addEvent(event);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
@@ -672,6 +668,8 @@ void ProjectNode::broadcastRemoveEvent(const MidiEvent &event)
 {
     jassert(event.isValid());
     this->changeListeners.call(&ProjectListener::onRemoveMidiEvent, event);
+    this->pendingChanges.removeEvent(event);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
@@ -681,9 +679,66 @@ void ProjectNode::broadcastPostRemoveEvent(MidiSequence *const layer)
     this->sendChangeMessage();
 }
 
+void ProjectNode::broadcastAddEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.isEmpty())
+    {
+        return;
+    }
+
+    this->changeListeners.call(&ProjectListener::onAddMidiEvents, events);
+
+    for (const auto *event : events)
+    {
+        this->pendingChanges.addEvent(*event);
+    }
+
+    this->scheduleChangeSet();
+    this->sendChangeMessage();
+}
+
+void ProjectNode::broadcastChangeEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    jassert(oldEvents.size() == newEvents.size());
+    if (newEvents.isEmpty())
+    {
+        return;
+    }
+
+    this->changeListeners.call(&ProjectListener::onChangeMidiEvents, oldEvents, newEvents);
+
+    for (const auto *event : newEvents)
+    {
+        this->pendingChanges.changeEvent(*event);
+    }
+
+    this->scheduleChangeSet();
+    this->sendChangeMessage();
+}
+
+void ProjectNode::broadcastRemoveEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.isEmpty())
+    {
+        return;
+    }
+
+    this->changeListeners.call(&ProjectListener::onRemoveMidiEvents, events);
+
+    for (const auto *event : events)
+    {
+        this->pendingChanges.removeEvent(*event);
+    }
+
+    this->scheduleChangeSet();
+    this->sendChangeMessage();
+}
+
 void ProjectNode::broadcastAddTrack(MidiTrack *const track)
 {
-    this->isTracksCacheOutdated = true;
+    this->tracksRegistry.invalidate();
+    this->updateTrackBeatRange(track);
 
     if (auto *tracked = dynamic_cast<VCS::TrackedItem *>(track))
     {
@@ -692,12 +747,15 @@ void ProjectNode::broadcastAddTrack(MidiTrack *const track)
     }
 
     this->changeListeners.call(&ProjectListener::onAddTrack, track);
+    this->pendingChanges.addTrack(track);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
 void ProjectNode::broadcastRemoveTrack(MidiTrack *const track)
 {
-    this->isTracksCacheOutdated = true;
+    this->tracksRegistry.invalidate();
+    this->removeTrackBeatRange(track);
 
     if (auto *tracked = dynamic_cast<VCS::TrackedItem *>(track))
     {
@@ -706,17 +764,22 @@ void ProjectNode::broadcastRemoveTrack(MidiTrack *const track)
     }
 
     this->changeListeners.call(&ProjectListener::onRemoveTrack, track);
+    this->pendingChanges.removeTrack(track);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
 void ProjectNode::broadcastChangeTrackProperties(MidiTrack *const track)
 {
     this->changeListeners.call(&ProjectListener::onChangeTrackProperties, track);
+    this->pendingChanges.changeTrackProperties(track);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
 void ProjectNode::broadcastChangeTrackBeatRange(MidiTrack *const track)
 {
+    this->updateTrackBeatRange(track);
     this->changeListeners.call(&ProjectListener::onChangeTrackBeatRange, track);
     this->sendChangeMessage();
 }
@@ -724,18 +787,24 @@ void ProjectNode::broadcastChangeTrackBeatRange(MidiTrack *const track)
 void ProjectNode::broadcastAddClip(const Clip &clip)
 {
     this->changeListeners.call(&ProjectListener::onAddClip, clip);
+    this->pendingChanges.addClip(clip);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
 void ProjectNode::broadcastChangeClip(const Clip &oldClip, const Clip &newClip)
 {
     this->changeListeners.call(&ProjectListener::onChangeClip, oldClip, newClip);
+    this->pendingChanges.changeClip(newClip);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
 void ProjectNode::broadcastRemoveClip(const Clip &clip)
 {
     this->changeListeners.call(&ProjectListener::onRemoveClip, clip);
+    this->pendingChanges.removeClip(clip);
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
@@ -777,7 +846,16 @@ Point<float> ProjectNode::broadcastChangeProjectBeatRange()
 
 void ProjectNode::broadcastReloadProjectContent()
 {
-    this->changeListeners.call(&ProjectListener::onReloadProjectContent, this->getTracks());
+    // the tracks might have been changed without notifications
+    this->isBeatRangeIndexOutdated = true;
+
+    // the transport keeps its instrument links, unless the tracks have changed
+    const auto tracks = this->getTracks();
+    this->transport->onReloadProjectContent(tracks, this->getTracksVersion());
+    this->changeListeners.callExcluding(this->transport.get(),
+        &ProjectListener::onReloadProjectContent, tracks);
+    this->pendingChanges.reloadContent();
+    this->scheduleChangeSet();
     this->sendChangeMessage();
 }
 
@@ -787,6 +865,64 @@ void ProjectNode::broadcastChangeViewBeatRange(float firstBeat, float lastBeat)
     // this->sendChangeMessage(); the project itself didn't change, so dont call this
 }
 
+//===----------------------------------------------------------------------===//
+// Change sets
+//===----------------------------------------------------------------------===//
+
+void ProjectNode::scheduleChangeSet()
+{
+    if (this->changeTransactionDepth == 0)
+    {
+        this->triggerAsyncUpdate();
+    }
+}
+
+void ProjectNode::commitChangeSet()
+{
+    this->cancelPendingUpdate();
+
+    if (this->pendingChanges.isEmpty())
+    {
+        return;
+    }
+
+    // listeners might change the project in response,
+    // and those changes will make up the next change set
+    const ProjectChangeSet changes(std::move(this->pendingChanges));
+    this->pendingChanges.clear();
+
+    // bring the sequences' snapshots up to date for the background
+    // readers (like the VCS diff thread), which can't do that themselves
+    if (changes.hasStructuralChanges())
+    {
+        this->rebuildTracksRegistryIfNeeded();
+        for (const auto *track : this->tracksRegistry.getTracks())
+        {
+            if (track->getSequence() != nullptr)
+            {
+                track->getSequence()->updateSnapshot();
+            }
+        }
+    }
+    else
+    {
+        for (const auto &i : changes.getTrackChanges())
+        {
+            if (!i.second.events.isEmpty() && i.first->getSequence() != nullptr)
+            {
+                i.first->getSequence()->updateSnapshot();
+            }
+        }
+    }
+
+    this->changeListeners.call(&ProjectListener::onCommitChangeSet, changes);
+}
+
+void ProjectNode::handleAsyncUpdate()
+{
+    this->commitChangeSet();
+}
+
 //===----------------------------------------------------------------------===//
 // DocumentOwner
 //===----------------------------------------------------------------------===//
@@ -799,6 +935,7 @@ bool ProjectNode::onDocumentLoad(File &file)
         if (tree.isValid())
         {
             this->load(tree);
+            this->undoStack->loadJournal(UndoStack::getJournalFileFor(file));
             return true;
         }
     }
@@ -815,11 +952,36 @@ void ProjectNode::onDocumentDidLoad(File &file)
 
 bool ProjectNode::onDocumentSave(File &file)
 {
-    const auto projectNode(this->save());
+    const auto saveSnapshot = this->onDocumentSnapshot(file);
+    return saveSnapshot();
+}
+
+void ProjectNode::onDocumentDidSave(File &file)
+{
+    // the undo journal's previous generations are not needed anymore
+    this->undoStack->onDocumentSaved();
+}
+
+Function<bool()> ProjectNode::onDocumentSnapshot(const File &file)
+{
+    // the costly parts of the document are only captured here as deferred
+    // nodes, and serialized by the writer: the tracks' events as the
+    // sequence snapshots (see MidiTrackNode::serializeSequence), unless
+    // written on the previous save, the timeline's events likewise,
+    // the version control history (see RevisionItem::serializeDeferred),
+    // and the undo history, which is appended to the journal, and then
+    // the document itself only refers to the journal's index; if that
+    // fails, the recent changes are written into the document instead,
+    // see UndoStack::serializeToJournal()
+    const auto projectNode(this->save(file));
+    const PackedSectionsCache::Ptr sectionsCache(this->savedSections);
+    return [file, projectNode, sectionsCache]()
+    {
 #if DEBUG
-    DocumentHelpers::save<XmlSerializer>(file.withFileExtension("xml"), projectNode);
+        DocumentHelpers::save<XmlSerializer>(file.withFileExtension("xml"), projectNode);
 #endif
-    return DocumentHelpers::save<BinarySerializer>(file, projectNode);
+        return DocumentHelpers::save(file, projectNode, BinarySerializer(false, sectionsCache));
+    };
 }
 
 void ProjectNode::onDocumentImport(File &file)
@@ -841,38 +1003,63 @@ bool ProjectNode::onDocumentExport(File &file)
     return false;
 }
 
-void ProjectNode::exportMidi(File &file) const
+// Each track's export only reads its own sequence and pattern, so the tracks
+// are exported concurrently; the message thread waits for all of them,
+// which means that nothing can change the tracks in the meantime
+class MidiTrackExportJob final : public ThreadPoolJob
 {
-    MidiFile tempFile;
-    static const double midiClock = 960.0;
-    tempFile.setTicksPerQuarterNote(int(midiClock));
-    static Clip noTransform;
+public:
 
-    // Solo flags won't be taken into account
-    // in midi export, as I believe they shouldn't:
-    const bool soloFlag = false;
+    MidiTrackExportJob(const MidiSequence &sequence,
+        const Pattern *pattern, double midiClock) :
+        ThreadPoolJob("Midi track export"),
+        trackSequence(sequence),
+        trackPattern(pattern),
+        midiClock(midiClock) {}
 
-    const auto &tracks = this->getTracks();
-    for (const auto *track : tracks)
+    JobStatus runJob() override
     {
-        MidiMessageSequence sequence;
+        static Clip noTransform;
+
+        // Solo flags won't be taken into account
+        // in midi export, as I believe they shouldn't:
+        const bool soloFlag = false;
+
         // todo add more meta events like track name
 
-        if (track->getPattern() != nullptr)
+        if (this->trackPattern != nullptr)
         {
-            for (const auto *clip : track->getPattern()->getClips())
+            for (const auto *clip : this->trackPattern->getClips())
             {
-                track->getSequence()->exportMidi(sequence, *clip, soloFlag, 0.0, midiClock);
+                this->trackSequence.exportMidi(this->sequence,
+                    *clip, soloFlag, 0.0, this->midiClock);
             }
         }
         else
         {
-            track->getSequence()->exportMidi(sequence, noTransform, soloFlag, 0.0, midiClock);
+            this->trackSequence.exportMidi(this->sequence,
+                noTransform, soloFlag, 0.0, this->midiClock);
         }
 
-        tempFile.addTrack(sequence);
+        return jobHasFinished;
     }
-    
+
+    MidiMessageSequence sequence;
+
+private:
+
+    const MidiSequence &trackSequence;
+    const Pattern *trackPattern;
+    const double midiClock;
+
+    JUCE_DECLARE_NON_COPYABLE(MidiTrackExportJob)
+};
+
+void ProjectNode::exportMidi(File &file) const
+{
+    MidiFile tempFile;
+    ProjectNode::exportMidiTracks(this->getTracks(), tempFile);
+
     if (file.exists())
     {
         file.deleteFile();
@@ -882,20 +1069,55 @@ void ProjectNode::exportMidi(File &file) const
     tempFile.writeTo(*out);
 }
 
+void ProjectNode::exportMidiTracks(const Array<MidiTrack *> &tracks, MidiFile &outFile)
+{
+    static const double midiClock = 960.0;
+    outFile.setTicksPerQuarterNote(int(midiClock));
+
+    OwnedArray<MidiTrackExportJob> jobs;
+    ThreadPool pool(jlimit(1, SystemStats::getNumCpus(), jmax(1, tracks.size())));
+
+    for (const auto *track : tracks)
+    {
+        // the lazy parts of the tracks are only ever built on the calling
+        // thread, so that the jobs don't race to build them: getSequence()
+        // decodes the deferred sequence data, and the piano sequences
+        // rebuild their note columns, which their export reads
+        const auto *sequence = track->getSequence();
+        jassert(sequence != nullptr);
+
+        if (const auto *pianoSequence = dynamic_cast<const PianoSequence *>(sequence))
+        {
+            pianoSequence->getColumns();
+        }
+
+        auto *job = jobs.add(new MidiTrackExportJob(*sequence,
+            track->getPattern(), midiClock));
+
+        pool.addJob(job, false);
+    }
+
+    // the tracks are added in their order, whichever finishes first:
+    for (auto *job : jobs)
+    {
+        pool.waitForJobToFinish(job, -1);
+        outFile.addTrack(job->sequence);
+    }
+}
+
 //===----------------------------------------------------------------------===//
 // MidiTrackSource
 //===----------------------------------------------------------------------===//
 
 MidiTrack *ProjectNode::getTrackById(const String &trackId)
 {
-    this->rebuildTracksRefsCacheIfNeeded();
-    return this->tracksRefsCache[trackId].get();
+    this->rebuildTracksRegistryIfNeeded();
+    return this->tracksRegistry.findTrackById(trackId);
 }
 
 Pattern *ProjectNode::getPatternByTrackId(const String &trackId)
 {
-    this->rebuildTracksRefsCacheIfNeeded();
-    if (auto track = this->tracksRefsCache[trackId].get())
+    if (auto *track = this->getTrackById(trackId))
     {
         return track->getPattern();
     }
@@ -905,8 +1127,7 @@ Pattern *ProjectNode::getPatternByTrackId(const String &trackId)
 
 MidiSequence *ProjectNode::getSequenceByTrackId(const String &trackId)
 {
-    this->rebuildTracksRefsCacheIfNeeded();
-    if (auto track = this->tracksRefsCache[trackId].get())
+    if (auto *track = this->getTrackById(trackId))
     {
         return track->getSequence();
     }
@@ -914,6 +1135,26 @@ MidiSequence *ProjectNode::getSequenceByTrackId(const String &trackId)
     return nullptr;
 }
 
+//===----------------------------------------------------------------------===//
+// UndoStackOwner
+//===----------------------------------------------------------------------===//
+
+MidiTrackSource &ProjectNode::getTrackSource() noexcept
+{
+    return *this;
+}
+
+TreeNode *ProjectNode::getTracksParent() noexcept
+{
+    return this;
+}
+
+void ProjectNode::performAsOneChangeSet(const Function<void()> &changes)
+{
+    const ScopedChangeTransaction changeTransaction(*this);
+    changes();
+}
+
 //===----------------------------------------------------------------------===//
 // VCS::TrackedItemsSource
 //===----------------------------------------------------------------------===//
@@ -949,7 +1190,8 @@ VCS::TrackedItem *ProjectNode::initTrackedItem(const Identifier &type,
         track->setVCSUuid(id);
         this->addChildNode(track, -1, false);
         // add explicitly, since we aren't going to receive a notification:
-        this->isTracksCacheOutdated = true;
+        this->tracksRegistry.invalidate();
+        this->isBeatRangeIndexOutdated = true;
         this->vcsItems.addIfNotAlreadyThere(track);
         track->resetStateTo(newState);
         return track;
@@ -959,7 +1201,8 @@ VCS::TrackedItem *ProjectNode::initTrackedItem(const Identifier &type,
         auto *track = new AutomationTrackNode("");
         track->setVCSUuid(id);
         this->addChildNode(track, -1, false);
-        this->isTracksCacheOutdated = true;
+        this->tracksRegistry.invalidate();
+        this->isBeatRangeIndexOutdated = true;
         this->vcsItems.addIfNotAlreadyThere(track);
         track->resetStateTo(newState);
         return track;
@@ -986,7 +1229,8 @@ bool ProjectNode::deleteTrackedItem(VCS::TrackedItem *item)
     {
         TreeNode::deleteNode(treeItem, false); // don't broadcastRemoveTrack
         this->vcsItems.removeAllInstancesOf(item);
-        this->isTracksCacheOutdated = true;
+        this->tracksRegistry.invalidate();
+        this->isBeatRangeIndexOutdated = true;
         return true;
     }
 
@@ -1030,29 +1274,182 @@ void ProjectNode::changeListenerCallback(ChangeBroadcaster *source)
     }
 }
 
-void ProjectNode::rebuildTracksRefsCacheIfNeeded() const
+void ProjectNode::rebuildBeatRangeIndexIfNeeded() const
 {
-    if (this->isTracksCacheOutdated)
+    if (!this->isBeatRangeIndexOutdated)
     {
-        this->tracksRefsCache.clear();
+        return;
+    }
 
-        this->tracksRefsCache[this->timeline->getAnnotations()->getTrackId()] =
-            this->timeline->getAnnotations();
+    this->beatRangeIndex.clear();
+    this->isBeatRangeIndexOutdated = false;
 
-        this->tracksRefsCache[this->timeline->getKeySignatures()->getTrackId()] =
-            this->timeline->getKeySignatures();
+    for (const auto *track : this->getTracks())
+    {
+        this->updateTrackBeatRange(track);
+    }
+}
+
+void ProjectNode::updateTrackBeatRange(const MidiTrack *track) const
+{
+    // will be rebuilt on the next request anyway
+    if (this->isBeatRangeIndexOutdated)
+    {
+        return;
+    }
+
+    // only the tree's tracks are indexed, see the comment in the header
+    if (dynamic_cast<const MidiTrackNode *>(track) == nullptr)
+    {
+        return;
+    }
+
+    const auto trackRange = getTrackRangeInBeats(track);
+    this->beatRangeIndex.updateTrack(track, trackRange.getX(), trackRange.getY());
+}
 
-        this->tracksRefsCache[this->timeline->getTimeSignatures()->getTrackId()] =
-            this->timeline->getTimeSignatures();
-        
-        const Array<MidiTrack *> children = this->findChildrenOfType<MidiTrack>();
-        
-        for (int i = 0; i < children.size(); ++i)
+void ProjectNode::removeTrackBeatRange(const MidiTrack *track) const
+{
+    this->beatRangeIndex.removeTrack(track);
+}
+
+void ProjectNode::rebuildTracksRegistryIfNeeded() const
+{
+    if (this->tracksRegistry.isOutdated())
+    {
+        this->tracksRegistry.rebuild(this->findChildrenOfType<MidiTrackNode>(), {
+            this->timeline->getAnnotations(),
+            this->timeline->getKeySignatures(),
+            this->timeline->getTimeSignatures()
+        });
+    }
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#define MIDI_EXPORT_TEST_NUM_TRACKS 16
+#define MIDI_EXPORT_TEST_NUM_NOTES 20000
+#define MIDI_EXPORT_TEST_NUM_ROUNDS 5
+#define MIDI_EXPORT_TEST_MIN_SPEEDUP 1.0
+#define MIDI_EXPORT_TEST_MIN_SINGLE_CORE_SPEEDUP 0.8
+
+class ProjectMidiExportTests final : public UnitTest
+{
+public:
+
+    ProjectMidiExportTests() :
+        UnitTest("Project midi export tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        // the project itself can't be created in the test runner,
+        // which has no workspace, so these are the standalone tracks
+        // exported the way the project exports its tracks
+        OwnedArray<TestPianoTrack> trackOwners;
+        Array<MidiTrack *> tracks;
+
+        Random random(42);
+        for (int i = 0; i < MIDI_EXPORT_TEST_NUM_TRACKS; ++i)
+        {
+            auto *track = trackOwners.add(new TestPianoTrack());
+
+            Array<Note> notes;
+            notes.ensureStorageAllocated(MIDI_EXPORT_TEST_NUM_NOTES);
+            for (int j = 0; j < MIDI_EXPORT_TEST_NUM_NOTES; ++j)
+            {
+                notes.add(Note(&track->sequence, random.nextInt(128),
+                    float(random.nextInt(MIDI_EXPORT_TEST_NUM_NOTES)) / 4.f,
+                    float(1 + random.nextInt(16)) / 4.f,
+                    random.nextFloat()));
+            }
+
+            // leaves the note columns outdated, as after any edit,
+            // so that the export has to rebuild them first
+            track->sequence.insertGroup(notes, false);
+            tracks.add(track);
+        }
+
+        beginTest("Concurrent midi export writes the same bytes as serial");
+
+        MidiFile serialFile;
+        this->exportSerially(tracks, serialFile);
+
+        MidiFile concurrentFile;
+        ProjectNode::exportMidiTracks(tracks, concurrentFile);
+
+        expectEquals(concurrentFile.getNumTracks(), MIDI_EXPORT_TEST_NUM_TRACKS);
+        expect(this->getBytes(serialFile) == this->getBytes(concurrentFile));
+
+        beginTest("Concurrent midi export timing");
+
+        double serialTime = 0.0;
+        double concurrentTime = 0.0;
+        for (int round = 0; round < MIDI_EXPORT_TEST_NUM_ROUNDS; ++round)
         {
-            MidiTrack *const track = children.getUnchecked(i);
-            this->tracksRefsCache[track->getTrackId()] = track;
+            auto startTicks = Time::getHighResolutionTicks();
+            {
+                MidiFile file;
+                this->exportSerially(tracks, file);
+            }
+            serialTime += this->getSecondsSince(startTicks);
+
+            startTicks = Time::getHighResolutionTicks();
+            {
+                MidiFile file;
+                ProjectNode::exportMidiTracks(tracks, file);
+            }
+            concurrentTime += this->getSecondsSince(startTicks);
         }
-        
-        this->isTracksCacheOutdated = false;
+
+        serialTime /= MIDI_EXPORT_TEST_NUM_ROUNDS;
+        concurrentTime /= MIDI_EXPORT_TEST_NUM_ROUNDS;
+
+        const auto speedup = serialTime / jmax(concurrentTime, 0.000001);
+        logMessage("Export of " + String(MIDI_EXPORT_TEST_NUM_TRACKS) + " tracks: serial " +
+            String(serialTime * 1000.0, 2) + " ms, concurrent " +
+            String(concurrentTime * 1000.0, 2) + " ms, speedup " +
+            String(speedup, 2) + "x");
+
+        // with a single core, the jobs can't run in parallel,
+        // so the concurrent export is only expected not to be much slower
+        expectGreaterThan(speedup, SystemStats::getNumCpus() > 1 ?
+            MIDI_EXPORT_TEST_MIN_SPEEDUP : MIDI_EXPORT_TEST_MIN_SINGLE_CORE_SPEEDUP);
     }
-}
+
+private:
+
+    // the reference export, as it used to be done track by track
+    void exportSerially(const Array<MidiTrack *> &tracks, MidiFile &outFile)
+    {
+        static Clip noTransform;
+        static const double midiClock = 960.0;
+        outFile.setTicksPerQuarterNote(int(midiClock));
+
+        for (const auto *track : tracks)
+        {
+            MidiMessageSequence sequence;
+            track->getSequence()->exportMidi(sequence, noTransform, false, 0.0, midiClock);
+            outFile.addTrack(sequence);
+        }
+    }
+
+    MemoryBlock getBytes(MidiFile &file)
+    {
+        MemoryOutputStream out;
+        file.writeTo(out);
+        return out.getMemoryBlock();
+    }
+
+    double getSecondsSince(int64 startTicks) const
+    {
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks);
+    }
+};
+
+static ProjectMidiExportTests projectMidiExportTests;
+
+#endif
@@ -18,6 +18,7 @@
 #pragma once
 
 class Autosaver;
+class PackedSectionsCache;
 class Document;
 class ProjectListener;
 class SequencerLayout;
@@ -33,6 +34,8 @@ class CommandPaletteTimelineEvents;
 class UndoStack;
 class Pattern;
 class MidiTrack;
+class PianoTrackNode;
+class AutomationTrackNode;
 class Clip;
 
 #include "TreeNode.h"
@@ -43,15 +46,21 @@ class Clip;
 #include "HybridRollEditMode.h"
 #include "MidiSequence.h"
 #include "MidiTrackSource.h"
+#include "UndoStackOwner.h"
 #include "CommandPaletteModel.h"
+#include "ProjectChangeSet.h"
+#include "TracksBeatRangeIndex.h"
+#include "TracksRegistry.h"
 
 class ProjectNode final :
     public TreeNode,
     public DocumentOwner,
     public MidiTrackSource,
+    public UndoStackOwner,
     public CommandPaletteModel,
     public VCS::TrackedItemsSource,  // vcs stuff
-    public ChangeListener // subscribed to VersionControl
+    public ChangeListener, // subscribed to VersionControl
+    private AsyncUpdater // commits the change sets
 {
 public:
 
@@ -60,7 +69,7 @@ public:
     explicit ProjectNode(const File &existingFile);
     ~ProjectNode() override;
     
-    String getId() const noexcept;
+    String getId() const noexcept override;
     String getStats() const;
 
     Transport &getTransport() const noexcept;
@@ -72,6 +81,9 @@ public:
     void importMidi(const File &file);
     void exportMidi(File &file) const;
 
+    // Exports the tracks concurrently, in their order; message thread only
+    static void exportMidiTracks(const Array<MidiTrack *> &tracks, MidiFile &outFile);
+
     Image getIcon() const noexcept override;
 
     void showPage() override;
@@ -110,9 +122,19 @@ public:
     //===------------------------------------------------------------------===//
 
     Array<MidiTrack *> getTracks() const;
+    Array<PianoTrackNode *> getPianoTracks() const;
+    Array<AutomationTrackNode *> getAutomationTracks() const;
     Point<float> getProjectRangeInBeats() const;
     StringArray getAllTrackNames() const;
 
+    // Called by the tracks when they are attached to, moved within,
+    // or detached from the tree, or re-linked to another instrument,
+    // with or without notifications
+    void invalidateTracksRegistry() noexcept;
+
+    // Changes whenever the above is called, see TracksRegistry
+    uint32 getTracksVersion() const;
+
     //===------------------------------------------------------------------===//
     // Serializable
     //===------------------------------------------------------------------===//
@@ -138,6 +160,11 @@ public:
     void broadcastRemoveEvent(const MidiEvent &event);
     void broadcastPostRemoveEvent(MidiSequence *const layer);
 
+    void broadcastAddEvents(const Array<const MidiEvent *> &events);
+    void broadcastChangeEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents);
+    void broadcastRemoveEvents(const Array<const MidiEvent *> &events);
+
     void broadcastAddTrack(MidiTrack *const track);
     void broadcastRemoveTrack(MidiTrack *const track);
     void broadcastChangeTrackProperties(MidiTrack *const track);
@@ -153,6 +180,40 @@ public:
     void broadcastReloadProjectContent();
     Point<float> broadcastChangeProjectBeatRange();
 
+    //===------------------------------------------------------------------===//
+    // Change sets
+    //===------------------------------------------------------------------===//
+
+    // All the changes broadcasted while any instance of this is alive are
+    // committed to listeners as one change set, when the outermost one is
+    // destroyed; outside of transactions, the changes are committed
+    // asynchronously, once per message loop tick
+    class ScopedChangeTransaction final
+    {
+    public:
+
+        explicit ScopedChangeTransaction(ProjectNode &project) noexcept :
+            project(project)
+        {
+            this->project.changeTransactionDepth++;
+        }
+
+        ~ScopedChangeTransaction()
+        {
+            jassert(this->project.changeTransactionDepth > 0);
+            if (--this->project.changeTransactionDepth == 0)
+            {
+                this->project.commitChangeSet();
+            }
+        }
+
+    private:
+
+        ProjectNode &project;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedChangeTransaction)
+    };
+
     //===------------------------------------------------------------------===//
     // VCS::TrackedItemsSource
     //===------------------------------------------------------------------===//
@@ -187,6 +248,8 @@ protected:
     bool onDocumentLoad(File &file) override;
     void onDocumentDidLoad(File &file) override;
     bool onDocumentSave(File &file) override;
+    void onDocumentDidSave(File &file) override;
+    Function<bool()> onDocumentSnapshot(const File &file) override;
     void onDocumentImport(File &file) override;
     bool onDocumentExport(File &file) override;
 
@@ -198,19 +261,30 @@ protected:
     Pattern *getPatternByTrackId(const String &trackId) override;
     MidiSequence *getSequenceByTrackId(const String &trackId) override;
 
-private:
+    //===------------------------------------------------------------------===//
+    // UndoStackOwner
+    //===------------------------------------------------------------------===//
+
+    MidiTrackSource &getTrackSource() noexcept override;
+    TreeNode *getTracksParent() noexcept override;
 
-    void collectTracks(Array<MidiTrack *> &resultArray, bool onlySelected = false) const;
+    // also used by the VCS::TrackedItemsSource for checkouts and resets
+    void performAsOneChangeSet(const Function<void()> &changes) override;
+
+private:
 
     UniquePointer<Autosaver> autosaver;
     UniquePointer<Transport> transport;
 
+    // the tracks' events as written on the last save,
+    // reused for the tracks which haven't changed since
+    ReferenceCountedObjectPtr<PackedSectionsCache> savedSections;
+
     UniquePointer<SequencerLayout> sequencerLayout;
     HybridRollEditMode rollEditMode;
 
     ListenerList<ProjectListener> changeListeners;
     UniquePointer<ProjectPage> projectPage;
-    ReadWriteLock tracksListLock;
 
     UniquePointer<ProjectMetadata> metadata;
     UniquePointer<ProjectTimeline> timeline;
@@ -222,7 +296,7 @@ private:
 private:
 
     void initialize();
-    SerializedData save() const;
+    SerializedData save(const File &file) const;
     void load(const SerializedData &tree);
 
 private:
@@ -237,8 +311,26 @@ private:
     mutable float firstBeatCache = 0.f;
     mutable float lastBeatCache = PROJECT_DEFAULT_NUM_BEATS;
 
-    mutable bool isTracksCacheOutdated = true;
-    mutable FlatHashMap<String, WeakReference<MidiTrack>, StringHash> tracksRefsCache;
-    void rebuildTracksRefsCacheIfNeeded() const;
+    mutable TracksRegistry tracksRegistry;
+    void rebuildTracksRegistryIfNeeded() const;
+
+    // The tree tracks' beat ranges; the timeline tracks are not here,
+    // as they don't report which of them has changed, so they are
+    // just checked on every request (there are 3)
+    mutable TracksBeatRangeIndex beatRangeIndex;
+    mutable bool isBeatRangeIndexOutdated = true;
+
+    void rebuildBeatRangeIndexIfNeeded() const;
+    void updateTrackBeatRange(const MidiTrack *track) const;
+    void removeTrackBeatRange(const MidiTrack *track) const;
+
+private:
+
+    ProjectChangeSet pendingChanges;
+    int changeTransactionDepth = 0;
+
+    void scheduleChangeSet();
+    void commitChangeSet();
+    void handleAsyncUpdate() override;
 
 };
@@ -286,6 +286,22 @@ void ProjectTimeline::dispatchPostRemoveEvent(MidiSequence *const layer)
     this->project.broadcastPostRemoveEvent(layer);
 }
 
+void ProjectTimeline::dispatchAddEvents(const Array<const MidiEvent *> &events)
+{
+    this->project.broadcastAddEvents(events);
+}
+
+void ProjectTimeline::dispatchChangeEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    this->project.broadcastChangeEvents(oldEvents, newEvents);
+}
+
+void ProjectTimeline::dispatchRemoveEvents(const Array<const MidiEvent *> &events)
+{
+    this->project.broadcastRemoveEvents(events);
+}
+
 void ProjectTimeline::dispatchChangeTrackProperties()
 {
     jassertfalse; // should never be called
@@ -340,9 +356,11 @@ SerializedData ProjectTimeline::serialize() const
     tree.setProperty(Serialization::Core::timeSignaturesTrackId,
         this->timeSignaturesTrackId);
 
-    tree.appendChild(this->annotationsSequence->serialize());
-    tree.appendChild(this->keySignaturesSequence->serialize());
-    tree.appendChild(this->timeSignaturesSequence->serialize());
+    // the events are only serialized when the document is written,
+    // which may happen on another thread, see MidiSequence::serializeSnapshot
+    tree.appendChild(this->annotationsSequence->serializeSnapshot(Serialization::Midi::annotations));
+    tree.appendChild(this->keySignaturesSequence->serializeSnapshot(Serialization::Midi::keySignatures));
+    tree.appendChild(this->timeSignaturesSequence->serializeSnapshot(Serialization::Midi::timeSignatures));
 
     return tree;
 }
@@ -403,11 +421,11 @@ SerializedData ProjectTimeline::serializeAnnotationsDelta() const
 {
     SerializedData tree(Serialization::VCS::ProjectTimelineDeltas::annotationsAdded);
 
-    for (int i = 0; i < this->annotationsSequence->size(); ++i)
+    const auto snapshot = this->annotationsSequence->getSnapshot();
+    snapshot->forEachEvent([&tree](const MidiEvent &event)
     {
-        const MidiEvent *event = this->annotationsSequence->getUnchecked(i);
-        tree.appendChild(event->serialize());
-    }
+        tree.appendChild(event.serialize());
+    });
 
     return tree;
 }
@@ -429,11 +447,11 @@ SerializedData ProjectTimeline::serializeTimeSignaturesDelta() const
 {
     SerializedData tree(Serialization::VCS::ProjectTimelineDeltas::timeSignaturesAdded);
 
-    for (int i = 0; i < this->timeSignaturesSequence->size(); ++i)
+    const auto snapshot = this->timeSignaturesSequence->getSnapshot();
+    snapshot->forEachEvent([&tree](const MidiEvent &event)
     {
-        const MidiEvent *event = this->timeSignaturesSequence->getUnchecked(i);
-        tree.appendChild(event->serialize());
-    }
+        tree.appendChild(event.serialize());
+    });
     
     return tree;
 }
@@ -455,11 +473,11 @@ SerializedData ProjectTimeline::serializeKeySignaturesDelta() const
 {
     SerializedData tree(Serialization::VCS::ProjectTimelineDeltas::keySignaturesAdded);
 
-    for (int i = 0; i < this->keySignaturesSequence->size(); ++i)
+    const auto snapshot = this->keySignaturesSequence->getSnapshot();
+    snapshot->forEachEvent([&tree](const MidiEvent &event)
     {
-        const MidiEvent *event = this->keySignaturesSequence->getUnchecked(i);
-        tree.appendChild(event->serialize());
-    }
+        tree.appendChild(event.serialize());
+    });
 
     return tree;
 }
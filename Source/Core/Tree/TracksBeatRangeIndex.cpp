@@ -0,0 +1,182 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "TracksBeatRangeIndex.h"
+
+void TracksBeatRangeIndex::updateTrack(const MidiTrack *track, float firstBeat, float lastBeat)
+{
+    const auto record = this->tracks.find(track);
+    if (record != this->tracks.end())
+    {
+        this->firstBeats.erase(record->second.firstBeat);
+        this->lastBeats.erase(record->second.lastBeat);
+    }
+
+    this->tracks[track] = {
+        this->firstBeats.insert(firstBeat),
+        this->lastBeats.insert(lastBeat)
+    };
+}
+
+void TracksBeatRangeIndex::removeTrack(const MidiTrack *track)
+{
+    const auto record = this->tracks.find(track);
+    if (record != this->tracks.end())
+    {
+        this->firstBeats.erase(record->second.firstBeat);
+        this->lastBeats.erase(record->second.lastBeat);
+        this->tracks.erase(record);
+    }
+}
+
+void TracksBeatRangeIndex::clear()
+{
+    this->firstBeats.clear();
+    this->lastBeats.clear();
+    this->tracks.clear();
+}
+
+bool TracksBeatRangeIndex::containsTrack(const MidiTrack *track) const noexcept
+{
+    return this->tracks.contains(track);
+}
+
+Point<float> TracksBeatRangeIndex::getRangeInBeats(std::initializer_list<Point<float>> otherRanges) const
+{
+    float firstBeat = this->firstBeats.empty() ? FLT_MAX : *this->firstBeats.begin();
+    float lastBeat = this->lastBeats.empty() ? -FLT_MAX : *this->lastBeats.rbegin();
+
+    for (const auto &range : otherRanges)
+    {
+        firstBeat = jmin(firstBeat, range.getX());
+        lastBeat = jmax(lastBeat, range.getY());
+    }
+
+    if (firstBeat == FLT_MAX)
+    {
+        firstBeat = 0;
+    }
+    else if (firstBeat > lastBeat)
+    {
+        firstBeat = lastBeat - PROJECT_DEFAULT_NUM_BEATS;
+    }
+
+    if ((lastBeat - firstBeat) < PROJECT_DEFAULT_NUM_BEATS)
+    {
+        lastBeat = firstBeat + PROJECT_DEFAULT_NUM_BEATS;
+    }
+
+    return { firstBeat, lastBeat };
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#include "PianoSequence.h"
+
+class TracksBeatRangeIndexTests final : public UnitTest
+{
+public:
+
+    TracksBeatRangeIndexTests() :
+        UnitTest("Tracks beat range index tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        // the tracks are only used as keys here
+        TestPianoTrack track1, track2, track3;
+        TracksBeatRangeIndex index;
+
+        beginTest("Empty project range");
+
+        expectRange(index.getRangeInBeats(), 0.f, float(PROJECT_DEFAULT_NUM_BEATS));
+
+        beginTest("Adding tracks");
+
+        index.updateTrack(&track1, 0.f, 100.f);
+        index.updateTrack(&track2, -8.f, 50.f);
+        index.updateTrack(&track3, 16.f, 200.f);
+        expectRange(index.getRangeInBeats(), -8.f, 200.f);
+
+        beginTest("Changing the track ranges");
+
+        index.updateTrack(&track3, 16.f, 64.f);
+        expectRange(index.getRangeInBeats(), -8.f, 100.f);
+
+        index.updateTrack(&track2, 4.f, 50.f);
+        expectRange(index.getRangeInBeats(), 0.f, 100.f);
+
+        // the same bounds in several tracks are all kept:
+        index.updateTrack(&track2, 0.f, 100.f);
+        index.updateTrack(&track1, 8.f, 32.f);
+        expectRange(index.getRangeInBeats(), 0.f, 100.f);
+
+        beginTest("Removing tracks");
+
+        index.removeTrack(&track2);
+        expect(!index.containsTrack(&track2));
+        expectRange(index.getRangeInBeats(), 8.f, 64.f);
+
+        // removing a track not indexed changes nothing
+        index.removeTrack(&track2);
+        expectRange(index.getRangeInBeats(), 8.f, 64.f);
+
+        index.removeTrack(&track1);
+        index.removeTrack(&track3);
+        expectRange(index.getRangeInBeats(), 0.f, float(PROJECT_DEFAULT_NUM_BEATS));
+
+        beginTest("Rebuilding after reload");
+
+        index.updateTrack(&track1, 1000.f, 2000.f);
+        index.clear();
+        expect(!index.containsTrack(&track1));
+
+        index.updateTrack(&track2, 32.f, 160.f);
+        index.updateTrack(&track3, 0.f, 96.f);
+        expectRange(index.getRangeInBeats(), 0.f, 160.f);
+
+        beginTest("Timeline tracks outside the index");
+
+        const Point<float> annotationsRange(-16.f, 10.f);
+        const Point<float> keySignaturesRange(0.f, 500.f);
+        expectRange(index.getRangeInBeats({ annotationsRange, keySignaturesRange }), -16.f, 500.f);
+
+        // an empty timeline track's range doesn't extend anything
+        const Point<float> emptyTrackRange(FLT_MAX, -FLT_MAX);
+        expectRange(index.getRangeInBeats({ emptyTrackRange }), 0.f, 160.f);
+
+        index.clear();
+        expectRange(index.getRangeInBeats({ annotationsRange }),
+            -16.f, -16.f + float(PROJECT_DEFAULT_NUM_BEATS));
+    }
+
+private:
+
+    void expectRange(const Point<float> &range, float firstBeat, float lastBeat)
+    {
+        expectEquals(range.getX(), firstBeat);
+        expectEquals(range.getY(), lastBeat);
+    }
+};
+
+static TracksBeatRangeIndexTests tracksBeatRangeIndexTests;
+
+#endif
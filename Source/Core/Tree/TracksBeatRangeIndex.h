@@ -0,0 +1,56 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiTrack;
+
+// All tracks' beat ranges, kept sorted, so that the project range is
+// always at hand, and each track's range change only takes O(log n).
+
+class TracksBeatRangeIndex final
+{
+public:
+
+    TracksBeatRangeIndex() = default;
+
+    // Adds the track's range, or replaces the one added before
+    void updateTrack(const MidiTrack *track, float firstBeat, float lastBeat);
+    void removeTrack(const MidiTrack *track);
+    void clear();
+
+    bool containsTrack(const MidiTrack *track) const noexcept;
+
+    // The range of all indexed tracks, also covering the given ranges
+    // of the tracks not indexed, and adjusted the way the project needs it:
+    // never shorter than PROJECT_DEFAULT_NUM_BEATS, starting from 0 if empty
+    Point<float> getRangeInBeats(std::initializer_list<Point<float>> otherRanges = {}) const;
+
+private:
+
+    struct TrackRange final
+    {
+        std::multiset<float>::iterator firstBeat;
+        std::multiset<float>::iterator lastBeat;
+    };
+
+    std::multiset<float> firstBeats;
+    std::multiset<float> lastBeats;
+    FlatHashMap<const MidiTrack *, TrackRange> tracks;
+
+    JUCE_DECLARE_NON_COPYABLE(TracksBeatRangeIndex)
+};
@@ -0,0 +1,188 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "TracksRegistry.h"
+#include "PianoTrackNode.h"
+#include "AutomationTrackNode.h"
+
+void TracksRegistry::invalidate() noexcept
+{
+    this->outdated = true;
+    this->version++;
+}
+
+bool TracksRegistry::isOutdated() const noexcept
+{
+    return this->outdated;
+}
+
+uint32 TracksRegistry::getVersion() const noexcept
+{
+    return this->version;
+}
+
+void TracksRegistry::rebuild(const Array<MidiTrackNode *> &treeTracks,
+    std::initializer_list<MidiTrack *> timelineTracks)
+{
+    this->tracks.clearQuick();
+    this->pianoTracks.clearQuick();
+    this->automationTracks.clearQuick();
+    this->tracksById.clear();
+
+    for (auto *track : treeTracks)
+    {
+        this->tracks.add(track);
+
+        if (auto *pianoTrack = dynamic_cast<PianoTrackNode *>(track))
+        {
+            this->pianoTracks.add(pianoTrack);
+        }
+        else if (auto *automationTrack = dynamic_cast<AutomationTrackNode *>(track))
+        {
+            this->automationTracks.add(automationTrack);
+        }
+    }
+
+    // the only non-tree-owned tracks
+    for (auto *track : timelineTracks)
+    {
+        this->tracks.add(track);
+    }
+
+    this->tracksById.reserve(this->tracks.size());
+    for (auto *track : this->tracks)
+    {
+        this->tracksById[track->getTrackId()] = track;
+    }
+
+    this->outdated = false;
+    this->version++;
+}
+
+const Array<MidiTrack *> &TracksRegistry::getTracks() const noexcept
+{
+    jassert(!this->outdated);
+    return this->tracks;
+}
+
+const Array<PianoTrackNode *> &TracksRegistry::getPianoTracks() const noexcept
+{
+    jassert(!this->outdated);
+    return this->pianoTracks;
+}
+
+const Array<AutomationTrackNode *> &TracksRegistry::getAutomationTracks() const noexcept
+{
+    jassert(!this->outdated);
+    return this->automationTracks;
+}
+
+MidiTrack *TracksRegistry::findTrackById(const String &trackId) const
+{
+    jassert(!this->outdated);
+    const auto found = this->tracksById.find(trackId);
+    return found != this->tracksById.end() ? found->second.get() : nullptr;
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class TracksRegistryTests final : public UnitTest
+{
+public:
+
+    TracksRegistryTests() : UnitTest("Tracks registry tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        // the project's tracks can't be created in the test runner,
+        // which has no workspace, so these are the detached nodes,
+        // and the rebuilds are called the way the project calls them
+        OwnedArray<MidiTrackNode> trackNodes;
+        MidiTrackNode *piano1 = trackNodes.add(new PianoTrackNode("piano 1"));
+        MidiTrackNode *automation = trackNodes.add(new AutomationTrackNode("automation"));
+        MidiTrackNode *piano2 = trackNodes.add(new PianoTrackNode("piano 2"));
+
+        EmptyMidiTrack timelineTrack;
+        timelineTrack.trackId = "timeline";
+
+        TracksRegistry registry;
+        expect(registry.isOutdated());
+
+        beginTest("Tracks are split by kind");
+
+        registry.rebuild({ piano1, automation }, { &timelineTrack });
+        expect(!registry.isOutdated());
+        const auto firstVersion = registry.getVersion();
+
+        this->expectTracks(registry.getTracks(), { piano1, automation, &timelineTrack });
+        this->expectTracks(registry.getPianoTracks(), { piano1 });
+        this->expectTracks(registry.getAutomationTracks(), { automation });
+
+        expect(registry.findTrackById(piano1->getTrackId()) == piano1);
+        expect(registry.findTrackById(automation->getTrackId()) == automation);
+        expect(registry.findTrackById("timeline") == &timelineTrack);
+        expect(registry.findTrackById(piano2->getTrackId()) == nullptr);
+
+        beginTest("Caches are invalidated on track add");
+
+        registry.invalidate();
+        expect(registry.isOutdated());
+        expect(registry.getVersion() != firstVersion);
+
+        registry.rebuild({ piano1, automation, piano2 }, { &timelineTrack });
+        const auto secondVersion = registry.getVersion();
+        expect(secondVersion != firstVersion);
+        this->expectTracks(registry.getTracks(), { piano1, automation, piano2, &timelineTrack });
+        this->expectTracks(registry.getPianoTracks(), { piano1, piano2 });
+        this->expectTracks(registry.getAutomationTracks(), { automation });
+        expect(registry.findTrackById(piano2->getTrackId()) == piano2);
+
+        beginTest("Caches are invalidated on track remove");
+
+        registry.invalidate();
+        registry.rebuild({ piano2 }, { &timelineTrack });
+        expect(registry.getVersion() != secondVersion);
+        this->expectTracks(registry.getTracks(), { piano2, &timelineTrack });
+        this->expectTracks(registry.getPianoTracks(), { piano2 });
+        this->expectTracks(registry.getAutomationTracks(), {});
+        expect(registry.findTrackById(piano1->getTrackId()) == nullptr);
+        expect(registry.findTrackById(automation->getTrackId()) == nullptr);
+    }
+
+private:
+
+    template<typename T>
+    void expectTracks(const Array<T *> &tracks, std::initializer_list<MidiTrack *> expected)
+    {
+        expectEquals(tracks.size(), int(expected.size()));
+
+        int index = 0;
+        for (auto *track : expected)
+        {
+            expect(static_cast<MidiTrack *>(tracks[index++]) == track);
+        }
+    }
+};
+
+static TracksRegistryTests tracksRegistryTests;
+
+#endif
@@ -0,0 +1,62 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiTrack;
+class MidiTrackNode;
+class PianoTrackNode;
+class AutomationTrackNode;
+
+// The project's tracks: all tracks in the tree order, followed by
+// the timeline tracks, the same split by kind, and indexed by id;
+// the project invalidates it after any structural change, and rebuilds
+// it in one tree traversal on the next request (see ProjectNode);
+// both bump the version, so that the caches built from the tracks
+// can tell whether they are still valid by comparing it
+
+class TracksRegistry final
+{
+public:
+
+    TracksRegistry() = default;
+
+    void invalidate() noexcept;
+    bool isOutdated() const noexcept;
+    uint32 getVersion() const noexcept;
+
+    void rebuild(const Array<MidiTrackNode *> &treeTracks,
+        std::initializer_list<MidiTrack *> timelineTracks);
+
+    const Array<MidiTrack *> &getTracks() const noexcept;
+    const Array<PianoTrackNode *> &getPianoTracks() const noexcept;
+    const Array<AutomationTrackNode *> &getAutomationTracks() const noexcept;
+
+    MidiTrack *findTrackById(const String &trackId) const;
+
+private:
+
+    bool outdated = true;
+    uint32 version = 0;
+
+    Array<MidiTrack *> tracks;
+    Array<PianoTrackNode *> pianoTracks;
+    Array<AutomationTrackNode *> automationTracks;
+    FlatHashMap<String, WeakReference<MidiTrack>, StringHash> tracksById;
+
+    JUCE_DECLARE_NON_COPYABLE(TracksRegistry)
+};
@@ -455,6 +455,36 @@ UndoAction *NotesGroupChangeAction::createCoalescedAction(UndoAction *nextAction
     return nullptr;
 }
 
+bool NotesGroupChangeAction::mergeGestureStep(UndoAction *nextAction)
+{
+    // each step of a gesture changes the notes the previous step left,
+    // so it only can be merged if it starts from this action's result;
+    // then the latest state is just swapped in, without copying,
+    // and the step's one gets deleted along with the step
+    if (auto *nextChanger = dynamic_cast<NotesGroupChangeAction *>(nextAction))
+    {
+        if (nextChanger->trackId != this->trackId ||
+            nextChanger->notesBefore.size() != this->notesAfter.size())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < this->notesAfter.size(); ++i)
+        {
+            if (this->notesAfter.getUnchecked(i).getId() !=
+                nextChanger->notesBefore.getUnchecked(i).getId())
+            {
+                return false;
+            }
+        }
+
+        this->notesAfter.swapWith(nextChanger->notesAfter);
+        return true;
+    }
+
+    return false;
+}
+
 //===----------------------------------------------------------------------===//
 // Serializable
 //===----------------------------------------------------------------------===//
@@ -194,6 +194,7 @@ public:
     bool undo() override;
     int getSizeInUnits() override;
     UndoAction *createCoalescedAction(UndoAction *nextAction) override;
+    bool mergeGestureStep(UndoAction *nextAction) override;
     
     SerializedData serialize() const override;
     void deserialize(const SerializedData &data) override;
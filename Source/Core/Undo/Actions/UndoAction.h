@@ -29,6 +29,7 @@ public:
     virtual bool perform() = 0;
     virtual bool undo() = 0;
 
+    // Roughly, how much memory the action takes, in bytes
     virtual int getSizeInUnits()
     {
         return 10;
@@ -39,9 +40,26 @@ public:
         (void) nextAction;
         return nullptr;
     }
+
+    // Continuous gestures, like dragging, perform a change on every step;
+    // while a gesture lasts, the stack offers each next step to the action
+    // of the same gesture, which can take the new state over in place
+    // and return true, so that the step is not stored at all
+    virtual bool mergeGestureStep(UndoAction *nextAction)
+    {
+        (void) nextAction;
+        return false;
+    }
     
 protected:
     
     MidiTrackSource &source;
 
+private:
+
+    // set by the stack to the gesture this action was performed in, or 0
+    int gestureId = 0;
+
+    friend class UndoStack;
+
 };
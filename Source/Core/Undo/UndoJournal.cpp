@@ -0,0 +1,283 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "UndoJournal.h"
+
+// Compression level tuned for speed rather than size,
+// since the records are written in the middle of editing
+#define UNDO_JOURNAL_COMPRESSION_LEVEL 1
+
+UndoJournal::UndoJournal(const File &file) : file(file) {}
+
+UndoJournal::~UndoJournal()
+{
+    this->output = nullptr;
+}
+
+bool UndoJournal::openForAppending()
+{
+    if (this->output != nullptr)
+    {
+        return true;
+    }
+
+    this->file.getParentDirectory().createDirectory();
+    this->output = makeUnique<FileOutputStream>(this->file);
+    if (this->output->failedToOpen())
+    {
+        this->output = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+int64 UndoJournal::append(const SerializedData &transaction)
+{
+    if (!this->openForAppending())
+    {
+        return -1;
+    }
+
+    MemoryOutputStream packed;
+
+    {
+        GZIPCompressorOutputStream compressor(packed, UNDO_JOURNAL_COMPRESSION_LEVEL);
+        transaction.writeToStream(compressor);
+        compressor.flush();
+    }
+
+    const auto position = this->output->getPosition();
+    if (!this->output->writeInt(int(packed.getDataSize())) ||
+        !this->output->write(packed.getData(), packed.getDataSize()))
+    {
+        return -1;
+    }
+
+    // so that the record can be read right away
+    this->output->flush();
+    return position;
+}
+
+SerializedData UndoJournal::read(int64 position) const
+{
+    FileInputStream input(this->file);
+    if (input.failedToOpen() || !input.setPosition(position))
+    {
+        return {};
+    }
+
+    const auto packedSize = input.readInt();
+    if (packedSize <= 0 || position + int64(sizeof(int)) + packedSize > input.getTotalLength())
+    {
+        jassertfalse;
+        return {};
+    }
+
+    MemoryBlock packed;
+    if (input.readIntoMemoryBlock(packed, packedSize) != size_t(packedSize))
+    {
+        return {};
+    }
+
+    MemoryInputStream packedInput(packed, false);
+    GZIPDecompressorInputStream decompressor(packedInput);
+    return SerializedData::readFromStream(decompressor);
+}
+
+bool UndoJournal::compact(const Array<int64 *> &positions)
+{
+    const auto compactedFile = this->file.getSiblingFile(this->file.getFileName() + ".tmp");
+
+    Array<int64> oldPositions;
+    for (const auto *position : positions)
+    {
+        oldPositions.add(*position);
+    }
+
+    if (!this->compactInto(compactedFile, positions))
+    {
+        compactedFile.deleteFile();
+        return false;
+    }
+
+    this->output = nullptr;
+    if (!compactedFile.moveFileTo(this->file))
+    {
+        compactedFile.deleteFile();
+        for (int i = 0; i < positions.size(); ++i)
+        {
+            *positions.getUnchecked(i) = oldPositions.getUnchecked(i);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+bool UndoJournal::compactInto(const File &targetFile, const Array<int64 *> &positions) const
+{
+    Array<int64> newPositions;
+    newPositions.ensureStorageAllocated(positions.size());
+
+    {
+        FileOutputStream compacted(targetFile);
+        if (compacted.failedToOpen())
+        {
+            return false;
+        }
+
+        compacted.setPosition(0);
+        compacted.truncate();
+
+        FileInputStream input(this->file);
+        if (input.failedToOpen())
+        {
+            return false;
+        }
+
+        MemoryBlock record;
+        for (const auto *position : positions)
+        {
+            input.setPosition(*position);
+            const auto packedSize = input.readInt();
+            record.setSize(0);
+            input.readIntoMemoryBlock(record, packedSize);
+
+            newPositions.add(compacted.getPosition());
+            if (!compacted.writeInt(packedSize) ||
+                !compacted.write(record.getData(), record.getSize()))
+            {
+                return false;
+            }
+        }
+
+        compacted.flush();
+        if (compacted.getStatus().failed())
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < positions.size(); ++i)
+    {
+        *positions.getUnchecked(i) = newPositions.getUnchecked(i);
+    }
+
+    return true;
+}
+
+void UndoJournal::clear()
+{
+    this->output = nullptr;
+    this->file.deleteFile();
+}
+
+int64 UndoJournal::getSize() const noexcept
+{
+    return this->output != nullptr ?
+        this->output->getPosition() : this->file.getSize();
+}
+
+const File &UndoJournal::getFile() const noexcept
+{
+    return this->file;
+}
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+class UndoJournalTests final : public UnitTest
+{
+public:
+
+    UndoJournalTests() : UnitTest("Undo journal tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        const TemporaryFile tempFile(".journal");
+        UndoJournal journal(tempFile.getFile());
+
+        beginTest("Reads back the appended records");
+
+        Array<int64> positions;
+        for (int i = 0; i < 10; ++i)
+        {
+            positions.add(journal.append(createTransaction(i)));
+            expect(positions.getLast() >= 0);
+        }
+
+        for (int i = 0; i < 10; ++i)
+        {
+            const auto data = journal.read(positions[i]);
+            expect(data.isValid());
+            expectEquals(data.getNumChildren(), i + 1);
+        }
+
+        beginTest("Keeps only the listed records after compaction");
+
+        const auto sizeBefore = journal.getSize();
+
+        Array<int64 *> positionsToKeep;
+        for (int i = 0; i < 10; i += 3)
+        {
+            positionsToKeep.add(&positions.getReference(i));
+        }
+
+        expect(journal.compact(positionsToKeep));
+        expect(journal.getSize() < sizeBefore);
+
+        for (int i = 0; i < 10; i += 3)
+        {
+            expectEquals(journal.read(positions[i]).getNumChildren(), i + 1);
+        }
+
+        // and still appends after the compacted ones
+        const auto position = journal.append(createTransaction(20));
+        expectEquals(journal.read(position).getNumChildren(), 21);
+
+        journal.clear();
+    }
+
+private:
+
+    static SerializedData createTransaction(int numActions)
+    {
+        static const Identifier transaction("transaction");
+        static const Identifier action("action");
+        static const Identifier value("value");
+
+        SerializedData data(transaction);
+        for (int i = 0; i <= numActions; ++i)
+        {
+            SerializedData child(action);
+            child.setProperty(value, i);
+            data.appendChild(child);
+        }
+
+        return data;
+    }
+};
+
+static UndoJournalTests undoJournalTests;
+
+#endif
@@ -0,0 +1,57 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// An append-only file of packed undo transactions:
+// each record is a serialized tree, usually a transaction's one, written
+// in the binary format and compressed, addressed by its position in the file.
+
+// Records are never updated in place; the ones no longer needed
+// are left as garbage until the journal is compacted, which rewrites
+// only the listed records into a new file and updates their positions;
+// that file either replaces the journal, or is left for the caller
+// to switch to, when the journal itself still has to stay intact.
+
+class UndoJournal final
+{
+public:
+
+    explicit UndoJournal(const File &file);
+    ~UndoJournal();
+
+    // Returns the record's position, or -1 if the write has failed
+    int64 append(const SerializedData &transaction);
+    SerializedData read(int64 position) const;
+
+    // Both only update the positions if all the records are copied
+    bool compact(const Array<int64 *> &positions);
+    bool compactInto(const File &targetFile, const Array<int64 *> &positions) const;
+    void clear();
+
+    int64 getSize() const noexcept;
+    const File &getFile() const noexcept;
+
+private:
+
+    const File file;
+    UniquePointer<FileOutputStream> output;
+
+    bool openForAppending();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UndoJournal)
+};
@@ -19,7 +19,9 @@
 #include "UndoStack.h"
 #include "UndoAction.h"
 #include "SerializationKeys.h"
-#include "ProjectNode.h"
+#include "MidiTrackSource.h"
+#include "TreeNode.h"
+#include "DocumentHelpers.h"
 
 #include "MidiTrackActions.h"
 #include "PianoTrackActions.h"
@@ -31,10 +33,15 @@
 #include "KeySignatureEventActions.h"
 #include "PatternActions.h"
 
+// The project's journal is only compacted when it's larger than that,
+// and when most of it is taken by the records not needed anymore
+#define UNDO_JOURNAL_MIN_SIZE_TO_COMPACT (4 * 1024 * 1024)
+
+// Only written into the document if the journal can't be saved
 #define MAX_TRANSACTIONS_TO_STORE 10
 
-UndoStack::Transaction::Transaction(ProjectNode &project, UndoActionId transactionId) :
-    project(project),
+UndoStack::Transaction::Transaction(UndoStackOwner &owner, UndoActionId transactionId) :
+    owner(owner),
     id(transactionId) {}
     
 bool UndoStack::Transaction::perform() const
@@ -63,9 +70,9 @@ bool UndoStack::Transaction::undo() const
     return true;
 }
     
-int UndoStack::Transaction::getTotalSize() const
+int64 UndoStack::Transaction::getTotalSize() const
 {
-    int total = 0;
+    int64 total = 0;
     for (int i = this->actions.size(); --i >= 0;)
     {
         total += this->actions.getUnchecked(i)->getSizeInUnits();
@@ -74,6 +81,43 @@ int UndoStack::Transaction::getTotalSize() const
     return total;
 }
     
+bool UndoStack::Transaction::spill(UndoJournal &journal)
+{
+    const auto position = journal.append(this->serialize());
+    if (position < 0)
+    {
+        return false;
+    }
+
+    this->spilledPosition = position;
+    this->spilledBytes = journal.getSize() - position;
+    this->actions.clear();
+    this->isLoaded = false;
+    return true;
+}
+
+void UndoStack::Transaction::unload()
+{
+    jassert(this->savedPosition >= 0);
+    this->actions.clear();
+    this->isLoaded = false;
+}
+
+bool UndoStack::Transaction::restore(const UndoJournal &journal, int64 position)
+{
+    const auto data = journal.read(position);
+    if (!data.isValid())
+    {
+        return false;
+    }
+
+    this->deserialize(data);
+    this->isLoaded = true;
+    this->spilledPosition = -1;
+    this->spilledBytes = 0;
+    return true;
+}
+
 SerializedData UndoStack::Transaction::serialize() const
 {
     SerializedData tree(Serialization::Undo::transaction);
@@ -108,67 +152,389 @@ void UndoStack::Transaction::reset()
 UndoAction *UndoStack::Transaction::createUndoActionByTag(const Identifier &tagName) const
 {
     using namespace Serialization;
+    auto &source = this->owner.getTrackSource();
+    auto *tracksParent = this->owner.getTracksParent();
 
-    if      (tagName == Undo::pianoTrackInsertAction)                { return new PianoTrackInsertAction(this->project, &this->project); }
-    else if (tagName == Undo::pianoTrackRemoveAction)                { return new PianoTrackRemoveAction(this->project, &this->project); }
-    else if (tagName == Undo::automationTrackInsertAction)           { return new AutomationTrackInsertAction(this->project, &this->project); }
-    else if (tagName == Undo::automationTrackRemoveAction)           { return new AutomationTrackRemoveAction(this->project, &this->project); }
-    else if (tagName == Undo::midiTrackRenameAction)                 { return new MidiTrackRenameAction(this->project); }
-    else if (tagName == Undo::midiTrackChangeColourAction)           { return new MidiTrackChangeColourAction(this->project); }
-    else if (tagName == Undo::midiTrackChangeInstrumentAction)       { return new MidiTrackChangeInstrumentAction(this->project); }
-    else if (tagName == Undo::clipInsertAction)                      { return new ClipInsertAction(this->project); }
-    else if (tagName == Undo::clipRemoveAction)                      { return new ClipRemoveAction(this->project); }
-    else if (tagName == Undo::clipChangeAction)                      { return new ClipChangeAction(this->project); }
-    else if (tagName == Undo::clipsGroupInsertAction)                { return new ClipsGroupInsertAction(this->project); }
-    else if (tagName == Undo::clipsGroupRemoveAction)                { return new ClipsGroupRemoveAction(this->project); }
-    else if (tagName == Undo::clipsGroupChangeAction)                { return new ClipsGroupChangeAction(this->project); }
-    else if (tagName == Undo::noteInsertAction)                      { return new NoteInsertAction(this->project); }
-    else if (tagName == Undo::noteRemoveAction)                      { return new NoteRemoveAction(this->project); }
-    else if (tagName == Undo::noteChangeAction)                      { return new NoteChangeAction(this->project); }
-    else if (tagName == Undo::notesGroupInsertAction)                { return new NotesGroupInsertAction(this->project); }
-    else if (tagName == Undo::notesGroupRemoveAction)                { return new NotesGroupRemoveAction(this->project); }
-    else if (tagName == Undo::notesGroupChangeAction)                { return new NotesGroupChangeAction(this->project); }
-    else if (tagName == Undo::annotationEventInsertAction)           { return new AnnotationEventInsertAction(this->project); }
-    else if (tagName == Undo::annotationEventRemoveAction)           { return new AnnotationEventRemoveAction(this->project); }
-    else if (tagName == Undo::annotationEventChangeAction)           { return new AnnotationEventChangeAction(this->project); }
-    else if (tagName == Undo::annotationEventsGroupInsertAction)     { return new AnnotationEventsGroupInsertAction(this->project); }
-    else if (tagName == Undo::annotationEventsGroupRemoveAction)     { return new AnnotationEventsGroupRemoveAction(this->project); }
-    else if (tagName == Undo::annotationEventsGroupChangeAction)     { return new AnnotationEventsGroupChangeAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventInsertAction)        { return new TimeSignatureEventInsertAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventRemoveAction)        { return new TimeSignatureEventRemoveAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventChangeAction)        { return new TimeSignatureEventChangeAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventsGroupInsertAction)  { return new TimeSignatureEventsGroupInsertAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventsGroupRemoveAction)  { return new TimeSignatureEventsGroupRemoveAction(this->project); }
-    else if (tagName == Undo::timeSignatureEventsGroupChangeAction)  { return new TimeSignatureEventsGroupChangeAction(this->project); }
-    else if (tagName == Undo::keySignatureEventInsertAction)         { return new KeySignatureEventInsertAction(this->project); }
-    else if (tagName == Undo::keySignatureEventRemoveAction)         { return new KeySignatureEventRemoveAction(this->project); }
-    else if (tagName == Undo::keySignatureEventChangeAction)         { return new KeySignatureEventChangeAction(this->project); }
-    else if (tagName == Undo::keySignatureEventsGroupInsertAction)   { return new KeySignatureEventsGroupInsertAction(this->project); }
-    else if (tagName == Undo::keySignatureEventsGroupRemoveAction)   { return new KeySignatureEventsGroupRemoveAction(this->project); }
-    else if (tagName == Undo::keySignatureEventsGroupChangeAction)   { return new KeySignatureEventsGroupChangeAction(this->project); }
-    else if (tagName == Undo::automationEventInsertAction)           { return new AutomationEventInsertAction(this->project); }
-    else if (tagName == Undo::automationEventRemoveAction)           { return new AutomationEventRemoveAction(this->project); }
-    else if (tagName == Undo::automationEventChangeAction)           { return new AutomationEventChangeAction(this->project); }
-    else if (tagName == Undo::automationEventsGroupInsertAction)     { return new AutomationEventsGroupInsertAction(this->project); }
-    else if (tagName == Undo::automationEventsGroupRemoveAction)     { return new AutomationEventsGroupRemoveAction(this->project); }
-    else if (tagName == Undo::automationEventsGroupChangeAction)     { return new AutomationEventsGroupChangeAction(this->project); }
+    if      (tagName == Undo::pianoTrackInsertAction)                { return new PianoTrackInsertAction(source, tracksParent); }
+    else if (tagName == Undo::pianoTrackRemoveAction)                { return new PianoTrackRemoveAction(source, tracksParent); }
+    else if (tagName == Undo::automationTrackInsertAction)           { return new AutomationTrackInsertAction(source, tracksParent); }
+    else if (tagName == Undo::automationTrackRemoveAction)           { return new AutomationTrackRemoveAction(source, tracksParent); }
+    else if (tagName == Undo::midiTrackRenameAction)                 { return new MidiTrackRenameAction(source); }
+    else if (tagName == Undo::midiTrackChangeColourAction)           { return new MidiTrackChangeColourAction(source); }
+    else if (tagName == Undo::midiTrackChangeInstrumentAction)       { return new MidiTrackChangeInstrumentAction(source); }
+    else if (tagName == Undo::clipInsertAction)                      { return new ClipInsertAction(source); }
+    else if (tagName == Undo::clipRemoveAction)                      { return new ClipRemoveAction(source); }
+    else if (tagName == Undo::clipChangeAction)                      { return new ClipChangeAction(source); }
+    else if (tagName == Undo::clipsGroupInsertAction)                { return new ClipsGroupInsertAction(source); }
+    else if (tagName == Undo::clipsGroupRemoveAction)                { return new ClipsGroupRemoveAction(source); }
+    else if (tagName == Undo::clipsGroupChangeAction)                { return new ClipsGroupChangeAction(source); }
+    else if (tagName == Undo::noteInsertAction)                      { return new NoteInsertAction(source); }
+    else if (tagName == Undo::noteRemoveAction)                      { return new NoteRemoveAction(source); }
+    else if (tagName == Undo::noteChangeAction)                      { return new NoteChangeAction(source); }
+    else if (tagName == Undo::notesGroupInsertAction)                { return new NotesGroupInsertAction(source); }
+    else if (tagName == Undo::notesGroupRemoveAction)                { return new NotesGroupRemoveAction(source); }
+    else if (tagName == Undo::notesGroupChangeAction)                { return new NotesGroupChangeAction(source); }
+    else if (tagName == Undo::annotationEventInsertAction)           { return new AnnotationEventInsertAction(source); }
+    else if (tagName == Undo::annotationEventRemoveAction)           { return new AnnotationEventRemoveAction(source); }
+    else if (tagName == Undo::annotationEventChangeAction)           { return new AnnotationEventChangeAction(source); }
+    else if (tagName == Undo::annotationEventsGroupInsertAction)     { return new AnnotationEventsGroupInsertAction(source); }
+    else if (tagName == Undo::annotationEventsGroupRemoveAction)     { return new AnnotationEventsGroupRemoveAction(source); }
+    else if (tagName == Undo::annotationEventsGroupChangeAction)     { return new AnnotationEventsGroupChangeAction(source); }
+    else if (tagName == Undo::timeSignatureEventInsertAction)        { return new TimeSignatureEventInsertAction(source); }
+    else if (tagName == Undo::timeSignatureEventRemoveAction)        { return new TimeSignatureEventRemoveAction(source); }
+    else if (tagName == Undo::timeSignatureEventChangeAction)        { return new TimeSignatureEventChangeAction(source); }
+    else if (tagName == Undo::timeSignatureEventsGroupInsertAction)  { return new TimeSignatureEventsGroupInsertAction(source); }
+    else if (tagName == Undo::timeSignatureEventsGroupRemoveAction)  { return new TimeSignatureEventsGroupRemoveAction(source); }
+    else if (tagName == Undo::timeSignatureEventsGroupChangeAction)  { return new TimeSignatureEventsGroupChangeAction(source); }
+    else if (tagName == Undo::keySignatureEventInsertAction)         { return new KeySignatureEventInsertAction(source); }
+    else if (tagName == Undo::keySignatureEventRemoveAction)         { return new KeySignatureEventRemoveAction(source); }
+    else if (tagName == Undo::keySignatureEventChangeAction)         { return new KeySignatureEventChangeAction(source); }
+    else if (tagName == Undo::keySignatureEventsGroupInsertAction)   { return new KeySignatureEventsGroupInsertAction(source); }
+    else if (tagName == Undo::keySignatureEventsGroupRemoveAction)   { return new KeySignatureEventsGroupRemoveAction(source); }
+    else if (tagName == Undo::keySignatureEventsGroupChangeAction)   { return new KeySignatureEventsGroupChangeAction(source); }
+    else if (tagName == Undo::automationEventInsertAction)           { return new AutomationEventInsertAction(source); }
+    else if (tagName == Undo::automationEventRemoveAction)           { return new AutomationEventRemoveAction(source); }
+    else if (tagName == Undo::automationEventChangeAction)           { return new AutomationEventChangeAction(source); }
+    else if (tagName == Undo::automationEventsGroupInsertAction)     { return new AutomationEventsGroupInsertAction(source); }
+    else if (tagName == Undo::automationEventsGroupRemoveAction)     { return new AutomationEventsGroupRemoveAction(source); }
+    else if (tagName == Undo::automationEventsGroupChangeAction)     { return new AutomationEventsGroupChangeAction(source); }
 
     // Here we could meet deprecated legacy actions
     return nullptr;
 }
 
-UndoStack::UndoStack(ProjectNode &parentProject,
-    int maxNumberOfUnitsToKeep,
-    int minimumTransactions) :
-    project(parentProject),
-    maxNumUnitsToKeep(maxNumberOfUnitsToKeep),
+//===----------------------------------------------------------------------===//
+// Journal writer
+//===----------------------------------------------------------------------===//
+
+// Everything the writer needs is captured when it's created, so that
+// it never touches the stack, which may be edited, or even deleted,
+// while the document is being written; the transactions only share
+// their records with it, and the stack takes them back when it's done
+class UndoStack::JournalWriter final : public ReferenceCountedObject
+{
+public:
+
+    using Ptr = ReferenceCountedObjectPtr<JournalWriter>;
+
+    JournalWriter(UndoStack &stack, const File &journalFile);
+
+    // Appends the changed transactions and the index, and returns
+    // the stack's node for the document, which only refers to the index,
+    // or keeps the most recent transactions, if the journal has failed
+    SerializedData write();
+
+    bool isWritten() const noexcept
+    {
+        return this->written.get();
+    }
+
+    bool hasSavedOk() const noexcept
+    {
+        return this->savedOk;
+    }
+
+private:
+
+    bool writeJournal();
+    SerializedData readTransaction(int index);
+
+    struct Entry final
+    {
+        SavedRecord::Ptr record;
+        // only captured for the transactions not saved yet
+        SerializedData data;
+        // in the previous journal, for the fallback, see write()
+        int64 previousPosition;
+    };
+
+    Array<Entry> entries;
+
+    const File baseFile;
+    File previousFile;
+    File targetFile;
+    int generation = 0;
+    int copiedGeneration = -1;
+    bool startsNewGeneration = false;
+
+    const String projectId;
+    const int currentTransaction;
+    const int firstStoredIndex;
+    const int64 previousIndexPosition;
+    bool needsFullIndex = false;
+    int numIndexEntriesSinceFullIndex = 0;
+
+    // the results, which are only read after the writer is done
+    int64 indexPosition = -1;
+    bool savedOk = false;
+    Atomic<bool> written;
+
+    friend class UndoStack;
+
+    JUCE_DECLARE_NON_COPYABLE(JournalWriter)
+};
+
+UndoStack::JournalWriter::JournalWriter(UndoStack &stack, const File &journalFile) :
+    baseFile(journalFile),
+    generation(stack.savedJournalGeneration),
+    projectId(stack.owner.getId()),
+    currentTransaction(stack.nextIndex),
+    firstStoredIndex(jmax(0, stack.nextIndex - MAX_TRANSACTIONS_TO_STORE)),
+    previousIndexPosition(stack.savedIndexPosition),
+    needsFullIndex(stack.needsFullIndex),
+    numIndexEntriesSinceFullIndex(stack.numIndexEntriesSinceFullIndex)
+{
+    if (stack.savedJournal != nullptr)
+    {
+        this->previousFile = stack.savedJournal->getFile();
+        if (this->previousFile != getJournalGenerationFile(journalFile, this->generation))
+        {
+            // the project has been saved elsewhere, so the journal follows it,
+            // keeping all records at their positions; it's copied, not moved,
+            // as the previous project file still refers to the previous journal
+            this->copiedGeneration = this->generation;
+        }
+    }
+    else
+    {
+        // none of the transactions are saved, but the document on disk
+        // may still refer to the current generation until saved
+        ++this->generation;
+        this->startsNewGeneration = true;
+        this->needsFullIndex = true;
+    }
+
+    this->targetFile = getJournalGenerationFile(journalFile, this->generation);
+
+    // only the new and changed transactions are to be appended, and they
+    // are serialized right away, as they can change in the meantime;
+    // the spilled ones are read back from the temporary journal
+    for (auto *transaction : stack.transactions)
+    {
+        SavedRecord::Ptr record(new SavedRecord());
+        record->position = transaction->savedPosition;
+        record->bytes = transaction->savedBytes;
+        transaction->pendingRecord = record;
+
+        const auto data = transaction->savedPosition < 0 ?
+            stack.readTransaction(transaction) : SerializedData();
+
+        this->entries.add({ record, data, transaction->savedPosition });
+    }
+}
+
+SerializedData UndoStack::JournalWriter::write()
+{
+    jassert(!this->written.get());
+
+    SerializedData tree(Serialization::Undo::undoStack);
+
+    this->savedOk = this->writeJournal();
+    if (this->savedOk)
+    {
+        tree.setProperty(Serialization::Undo::journalIndexPosition, this->indexPosition);
+        tree.setProperty(Serialization::Undo::journalGeneration, this->generation);
+    }
+    else
+    {
+        // as UndoStack::serialize() does when the journal fails
+        for (int i = this->firstStoredIndex; i < this->currentTransaction; ++i)
+        {
+            const auto transaction = this->readTransaction(i);
+            if (transaction.isValid())
+            {
+                tree.appendChild(transaction);
+            }
+        }
+    }
+
+    // the captured transactions are not needed anymore
+    this->entries.clear();
+    this->written = true;
+    return tree;
+}
+
+SerializedData UndoStack::JournalWriter::readTransaction(int index)
+{
+    const auto &entry = this->entries.getReference(index);
+    if (entry.data.isValid())
+    {
+        return entry.data;
+    }
+
+    if (entry.previousPosition >= 0 && this->previousFile != File())
+    {
+        return UndoJournal(this->previousFile).read(entry.previousPosition);
+    }
+
+    return {};
+}
+
+bool UndoStack::JournalWriter::writeJournal()
+{
+    if (this->copiedGeneration >= 0)
+    {
+        if (!this->previousFile.copyFileTo(this->targetFile))
+        {
+            return false;
+        }
+    }
+    else if (this->startsNewGeneration)
+    {
+        // no document refers to the generations after the committed one,
+        // so whatever is left in there from the previous sessions is garbage
+        this->targetFile.deleteFile();
+    }
+
+    auto journal = makeUnique<UndoJournal>(this->targetFile);
+
+    Array<int> appendedTransactions;
+    int64 savedBytesInUse = 0;
+    for (int i = 0; i < this->entries.size(); ++i)
+    {
+        auto &entry = this->entries.getReference(i);
+        if (entry.record->position < 0)
+        {
+            const auto position = entry.data.isValid() ? journal->append(entry.data) : -1;
+            if (position < 0)
+            {
+                // the previous indices don't know about
+                // the transactions appended so far
+                this->needsFullIndex = true;
+                return false;
+            }
+
+            entry.record->position = position;
+            entry.record->bytes = journal->getSize() - position;
+            appendedTransactions.add(i);
+        }
+
+        savedBytesInUse += entry.record->bytes;
+    }
+
+    // the records of the transactions changed or dropped since,
+    // and all previous indices, are garbage; once there's more of it
+    // than of the records in use, the journal is rewritten without it,
+    // so its size stays proportional to the history, and each compaction
+    // is paid for by at least as many bytes appended before it;
+    // the rewritten journal is the next generation, so that the current
+    // one stays intact while the document on disk still refers to it
+    if (journal->getSize() > UNDO_JOURNAL_MIN_SIZE_TO_COMPACT &&
+        journal->getSize() > savedBytesInUse * 2)
+    {
+        Array<int64 *> positions;
+        for (auto &entry : this->entries)
+        {
+            positions.add(&entry.record->position);
+        }
+
+        const auto compactedFile = getJournalGenerationFile(this->baseFile, this->generation + 1);
+        compactedFile.deleteFile();
+        if (journal->compactInto(compactedFile, positions))
+        {
+            journal = makeUnique<UndoJournal>(compactedFile);
+            this->targetFile = compactedFile;
+            ++this->generation;
+
+            // the previous indices are gone with the garbage
+            this->needsFullIndex = true;
+        }
+        else
+        {
+            DBG("Failed to compact the project's undo journal");
+            compactedFile.deleteFile();
+        }
+    }
+
+    // the chain of indices is only as long as the history,
+    // so that reading it back costs no more than a full index,
+    // and writing the full index is paid for by the short ones
+    this->numIndexEntriesSinceFullIndex += jmax(1, appendedTransactions.size());
+    const bool isFullIndex = this->needsFullIndex || this->previousIndexPosition < 0 ||
+        this->numIndexEntriesSinceFullIndex > this->entries.size();
+
+    MemoryOutputStream records;
+    const auto writeRecord = [this, &records](int i)
+    {
+        const auto &record = *this->entries.getReference(i).record;
+        records.writeInt(i);
+        records.writeInt64(record.position);
+        records.writeInt64(record.bytes);
+    };
+
+    if (isFullIndex)
+    {
+        for (int i = 0; i < this->entries.size(); ++i)
+        {
+            writeRecord(i);
+        }
+    }
+    else
+    {
+        for (const auto i : appendedTransactions)
+        {
+            writeRecord(i);
+        }
+    }
+
+    SerializedData index(Serialization::Undo::journalIndex);
+    index.setProperty(Serialization::Undo::projectId, this->projectId);
+    index.setProperty(Serialization::Undo::numTransactions, this->entries.size());
+    index.setProperty(Serialization::Undo::currentTransaction, this->currentTransaction);
+    index.setProperty(Serialization::Undo::journalRecords, records.getMemoryBlock());
+
+    if (!isFullIndex)
+    {
+        index.setProperty(Serialization::Undo::journalPreviousIndexPosition, this->previousIndexPosition);
+    }
+
+    this->indexPosition = journal->append(index);
+    if (this->indexPosition < 0)
+    {
+        this->needsFullIndex = true;
+        return false;
+    }
+
+    if (isFullIndex)
+    {
+        this->needsFullIndex = false;
+        this->numIndexEntriesSinceFullIndex = 0;
+    }
+
+    return true;
+}
+
+UndoStack::UndoStack(UndoStackOwner &owner,
+    int64 maxResidentBytesToKeep,
+    int minimumTransactions,
+    int64 maxSpilledBytesToKeep) :
+    owner(owner),
+    maxResidentBytes(maxResidentBytesToKeep),
+    maxSpilledBytes(maxSpilledBytesToKeep),
     minimumTransactionsToKeep(minimumTransactions) {}
 
+UndoStack::~UndoStack()
+{
+    if (this->journal != nullptr)
+    {
+        this->journal->clear();
+    }
+}
+
 void UndoStack::clearUndoHistory()
 {
     this->transactions.clear();
-    this->totalUnitsStored = 0;
+    this->residentBytes = 0;
+    this->spilledBytes = 0;
     this->nextIndex = 0;
+    this->needsFullIndex = true;
+    this->endGesture();
+
+    if (this->journal != nullptr)
+    {
+        this->journal->clear();
+    }
+
     this->sendChangeMessage();
 }
 
@@ -204,8 +570,17 @@ bool UndoStack::perform(UndoAction *const newAction)
         {
             auto *actionSet = this->getCurrentSet();
             
-            if (actionSet != nullptr && !this->hasNewEmptyTransaction)
+            if (actionSet != nullptr && !this->hasNewEmptyTransaction &&
+                this->restoreIfSpilled(actionSet))
             {
+                if (this->mergeGestureStep(actionSet, action.get()))
+                {
+                    actionSet->invalidateSavedRecord();
+                    this->clearFutureTransactions();
+                    this->sendChangeMessage();
+                    return true;
+                }
+
                 for (signed int i = (actionSet->actions.size() - 1); i >= 0; --i)
                 {
                     if (auto *lastAction = actionSet->actions[i])
@@ -213,7 +588,7 @@ bool UndoStack::perform(UndoAction *const newAction)
                         if (auto *coalescedAction = lastAction->createCoalescedAction(action.get()))
                         {
                             action.reset(coalescedAction);
-                            this->totalUnitsStored -= lastAction->getSizeInUnits();
+                            this->residentBytes -= lastAction->getSizeInUnits();
                             actionSet->actions.remove(i);
                             break;
                         }
@@ -222,12 +597,14 @@ bool UndoStack::perform(UndoAction *const newAction)
             }
             else
             {
-                actionSet = new Transaction(this->project, this->newUndoActionId);
+                actionSet = new Transaction(this->owner, this->newUndoActionId);
                 this->transactions.insert(nextIndex, actionSet);
                 ++this->nextIndex;
             }
             
-            this->totalUnitsStored += action->getSizeInUnits();
+            actionSet->invalidateSavedRecord();
+            action->gestureId = this->currentGestureId;
+            this->residentBytes += action->getSizeInUnits();
             actionSet->actions.add(action.release());
             this->hasNewEmptyTransaction = false;
             
@@ -240,26 +617,194 @@ bool UndoStack::perform(UndoAction *const newAction)
     return false;
 }
 
+bool UndoStack::mergeGestureStep(Transaction *transaction, UndoAction *action)
+{
+    if (this->currentGestureId == 0)
+    {
+        return false;
+    }
+
+    // one step may perform several actions, e.g. one per track,
+    // so look through all the latest actions of this gesture
+    for (int i = transaction->actions.size(); --i >= 0;)
+    {
+        auto *gestureAction = transaction->actions.getUnchecked(i);
+        if (gestureAction->gestureId != this->currentGestureId)
+        {
+            break;
+        }
+
+        const auto sizeBefore = gestureAction->getSizeInUnits();
+        if (gestureAction->mergeGestureStep(action))
+        {
+            this->residentBytes += gestureAction->getSizeInUnits() - sizeBefore;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void UndoStack::clearFutureTransactions()
 {
     while (this->nextIndex < this->transactions.size())
     {
-        this->totalUnitsStored -= transactions.getLast()->getTotalSize();
-        this->transactions.removeLast();
+        this->removeTransaction(this->transactions.size() - 1);
     }
     
-    while (this->nextIndex > 0
-           && this->totalUnitsStored > this->maxNumUnitsToKeep
-           && this->transactions.size() > this->minimumTransactionsToKeep)
+    this->spillOldTransactionsIfNeeded();
+}
+
+void UndoStack::removeTransaction(int index)
+{
+    const auto *transaction = this->transactions.getUnchecked(index);
+    if (transaction->isSpilled())
+    {
+        this->spilledBytes -= transaction->spilledBytes;
+    }
+    else
+    {
+        this->residentBytes -= transaction->getTotalSize();
+    }
+
+    // the saved indices refer to the transactions by their order
+    if (index < this->transactions.size() - 1)
+    {
+        this->needsFullIndex = true;
+    }
+
+    this->transactions.remove(index);
+
+    // if this fails, then some actions may not be returning
+    // consistent results from their getSizeInUnits() method
+    jassert(this->residentBytes >= 0 && this->spilledBytes >= 0);
+}
+
+//===----------------------------------------------------------------------===//
+// Spilling to disk
+//===----------------------------------------------------------------------===//
+
+UndoJournal &UndoStack::getJournal()
+{
+    if (this->journal == nullptr)
+    {
+        const File tempFolder(DocumentHelpers::getTemporaryFolder());
+        this->journal = makeUnique<UndoJournal>(tempFolder
+            .getNonexistentChildFile("undo-" + this->owner.getId(), ".journal", false));
+    }
+
+    return *this->journal;
+}
+
+void UndoStack::spillOldTransactionsIfNeeded()
+{
+    // the oldest transactions are spilled first,
+    // and the most recent ones always stay in memory
+    int i = 0;
+    while (i < (this->nextIndex - this->minimumTransactionsToKeep) &&
+        this->residentBytes > this->maxResidentBytes)
+    {
+        auto *transaction = this->transactions.getUnchecked(i);
+        if (transaction->isSpilled())
+        {
+            ++i;
+            continue;
+        }
+
+        const auto transactionBytes = transaction->getTotalSize();
+        if (transaction->savedPosition >= 0)
+        {
+            // unchanged since saved, so it can be read back
+            // from the project's journal, no need to spill it
+            transaction->unload();
+            this->residentBytes -= transactionBytes;
+            ++i;
+        }
+        else if (transaction->spill(this->getJournal()))
+        {
+            this->residentBytes -= transactionBytes;
+            this->spilledBytes += transaction->spilledBytes;
+            ++i;
+        }
+        else
+        {
+            // the journal is not writable, so the oldest history
+            // has to be dropped, as if there was no journal at all
+            this->removeTransaction(i);
+            --this->nextIndex;
+        }
+    }
+
+    if (this->journal != nullptr &&
+        this->journal->getSize() > this->maxSpilledBytes)
+    {
+        this->dropOldSpilledTransactions();
+    }
+}
+
+void UndoStack::dropOldSpilledTransactions()
+{
+    // forget the oldest history until the rest takes a half of the budget,
+    // so that this doesn't happen on every new transaction; the transactions
+    // only unloaded are read back from the project's journal, and take
+    // no space in this one, so dropping them would only lose the history:
+    // the ones spilled after them wait until the next save moves them there
+    int64 spilledBytesInUse = 0;
+    while (this->spilledBytes > this->maxSpilledBytes / 2 &&
+        !this->transactions.isEmpty() &&
+        this->transactions.getFirst()->spilledPosition >= 0)
     {
-        this->totalUnitsStored -= this->transactions.getFirst()->getTotalSize();
-        this->transactions.remove(0);
+        this->removeTransaction(0);
         --this->nextIndex;
-        
-        // if this fails, then some actions may not be returning
-        // consistent results from their getSizeInUnits() method
-        jassert(this->totalUnitsStored >= 0);
     }
+
+    Array<int64 *> positions;
+    for (auto *transaction : this->transactions)
+    {
+        if (transaction->spilledPosition >= 0)
+        {
+            positions.add(&transaction->spilledPosition);
+            spilledBytesInUse += transaction->spilledBytes;
+        }
+    }
+
+    // then the journal is rewritten without the records not needed anymore,
+    // unless most of it is still in use, which would only repeat the rewrite
+    // on every next transaction, until the history is saved
+    if (positions.isEmpty())
+    {
+        this->journal->clear();
+    }
+    else if (this->journal->getSize() > spilledBytesInUse * 2 &&
+        !this->journal->compact(positions))
+    {
+        DBG("Failed to compact the undo journal");
+    }
+}
+
+bool UndoStack::restoreIfSpilled(Transaction *transaction)
+{
+    if (!transaction->isSpilled())
+    {
+        return true;
+    }
+
+    const auto transactionSpilledBytes = transaction->spilledBytes;
+    const bool isInTemporaryJournal = transaction->spilledPosition >= 0;
+    const auto *source = isInTemporaryJournal ?
+        this->journal.get() : this->savedJournal.get();
+    const auto position = isInTemporaryJournal ?
+        transaction->spilledPosition : transaction->savedPosition;
+
+    jassert(source != nullptr);
+    if (source == nullptr || !transaction->restore(*source, position))
+    {
+        return false;
+    }
+
+    this->spilledBytes -= transactionSpilledBytes;
+    this->residentBytes += transaction->getTotalSize();
+    return true;
 }
 
 void UndoStack::beginNewTransaction() noexcept
@@ -271,6 +816,17 @@ void UndoStack::beginNewTransaction(UndoActionId transactionId) noexcept
 {
     this->hasNewEmptyTransaction = true;
     this->newUndoActionId = transactionId;
+    this->endGesture();
+}
+
+void UndoStack::beginGesture() noexcept
+{
+    this->currentGestureId = ++this->lastGestureId;
+}
+
+void UndoStack::endGesture() noexcept
+{
+    this->currentGestureId = 0;
 }
 
 void UndoStack::setCurrentUndoActionId(UndoActionId transactionId) noexcept
@@ -307,11 +863,24 @@ bool UndoStack::canRedo() const noexcept
 
 bool UndoStack::undo()
 {
-    if (const auto *s = this->getCurrentSet())
+    if (auto *s = this->getCurrentSet())
     {
+        if (!this->restoreIfSpilled(s))
+        {
+            this->clearUndoHistory();
+            return false;
+        }
+
         const ScopedValueSetter<bool> setter(this->reentrancyCheck, true);
+
+        // all actions of a transaction make up a single change set
+        bool isDone = false;
+        this->owner.performAsOneChangeSet([s, &isDone]()
+        {
+            isDone = s->undo();
+        });
         
-        if (s->undo())
+        if (isDone)
         {
             --nextIndex;
         }
@@ -330,11 +899,24 @@ bool UndoStack::undo()
 
 bool UndoStack::redo()
 {
-    if (const auto *s = this->getNextSet())
+    if (auto *s = this->getNextSet())
     {
-        const ScopedValueSetter<bool> setter(this->reentrancyCheck, true);
-        
-        if (s->perform())
+        if (!this->restoreIfSpilled(s))
+        {
+            this->clearUndoHistory();
+            return false;
+        }
+
+        const ScopedValueSetter<bool> setter(this->reentrancyCheck, true);
+
+        // all actions of a transaction make up a single change set
+        bool isDone = false;
+        this->owner.performAsOneChangeSet([s, &isDone]()
+        {
+            isDone = s->perform();
+        });
+        
+        if (isDone)
         {
             ++nextIndex;
         }
@@ -410,20 +992,25 @@ int UndoStack::getNumActionsInCurrentTransaction() const
 SerializedData UndoStack::serialize() const
 {
     SerializedData tree(Serialization::Undo::undoStack);
-    
-    int currentIndex = (this->nextIndex - 1);
-    int numStoredTransactions = 0;
-    
-    while (currentIndex >= 0 &&
-           numStoredTransactions < MAX_TRANSACTIONS_TO_STORE)
+
+    // the transactions themselves are in the journal, see saveJournal()
+    if (this->savedIndexPosition >= 0)
     {
-        if (Transaction *action = this->transactions[currentIndex])
+        tree.setProperty(Serialization::Undo::journalIndexPosition, this->savedIndexPosition);
+        tree.setProperty(Serialization::Undo::journalGeneration, this->savedJournalGeneration);
+        return tree;
+    }
+
+    // the journal has failed to save, so at least the most recent
+    // transactions are kept, as it used to be done before the journal
+    const int firstStoredIndex = jmax(0, this->nextIndex - MAX_TRANSACTIONS_TO_STORE);
+    for (int i = firstStoredIndex; i < this->nextIndex; ++i)
+    {
+        const auto transaction = this->readTransaction(this->transactions.getUnchecked(i));
+        if (transaction.isValid())
         {
-            tree.addChild(action->serialize(), 0);
+            tree.appendChild(transaction);
         }
-        
-        --currentIndex;
-        ++numStoredTransactions;
     }
     
     return tree;
@@ -438,11 +1025,20 @@ void UndoStack::deserialize(const SerializedData &data)
     { return; }
     
     this->reset();
-    
+
+    // whatever the previous writer has saved is not what's loaded now
+    this->journalWriter = nullptr;
+
+    this->savedIndexPosition = int64(root.getProperty(Serialization::Undo::journalIndexPosition, -1));
+    this->savedJournalGeneration = root.getProperty(Serialization::Undo::journalGeneration, 0);
+    this->committedJournalGeneration = this->savedJournalGeneration;
+
+    // legacy support: the last transactions stored in the document itself
     for (const auto &childTransaction : root)
     {
-        auto *actionSet = new Transaction(this->project, {});
+        auto *actionSet = new Transaction(this->owner, {});
         actionSet->deserialize(childTransaction);
+        this->residentBytes += actionSet->getTotalSize();
         this->transactions.insert(this->nextIndex, actionSet);
         ++this->nextIndex;
     }
@@ -453,6 +1049,270 @@ void UndoStack::reset()
     this->clearUndoHistory();
 }
 
+//===----------------------------------------------------------------------===//
+// Saving to the project's journal
+//===----------------------------------------------------------------------===//
+
+File UndoStack::getJournalFileFor(const File &projectFile)
+{
+    return projectFile.withFileExtension("undo");
+}
+
+File UndoStack::getJournalGenerationFile(const File &journalFile, int generation)
+{
+    return generation == 0 ? journalFile :
+        journalFile.withFileExtension(journalFile.getFileExtension() + "." + String(generation));
+}
+
+void UndoStack::onDocumentSaved()
+{
+    this->applyJournalWriter();
+
+    if (this->savedJournalBaseFile == File())
+    {
+        return;
+    }
+
+    // the saved document refers to the current generation only,
+    // or to none at all, if there's no history to save
+    const auto lastObsoleteGeneration = this->savedJournal != nullptr ?
+        this->savedJournalGeneration - 1 : this->savedJournalGeneration;
+
+    for (int i = this->committedJournalGeneration; i <= lastObsoleteGeneration; ++i)
+    {
+        getJournalGenerationFile(this->savedJournalBaseFile, i).deleteFile();
+    }
+
+    this->committedJournalGeneration = this->savedJournalGeneration;
+}
+
+SerializedData UndoStack::readTransaction(const Transaction *transaction) const
+{
+    if (!transaction->isSpilled())
+    {
+        return transaction->serialize();
+    }
+
+    if (transaction->spilledPosition >= 0 && this->journal != nullptr)
+    {
+        return this->journal->read(transaction->spilledPosition);
+    }
+
+    if (transaction->savedPosition >= 0 && this->savedJournal != nullptr)
+    {
+        return this->savedJournal->read(transaction->savedPosition);
+    }
+
+    return {};
+}
+
+bool UndoStack::saveJournal(const File &journalFile)
+{
+    if (!this->createJournalWriter(journalFile))
+    {
+        return true;
+    }
+
+    const JournalWriter::Ptr writer(this->journalWriter);
+    writer->write();
+    this->applyJournalWriter();
+    return writer->hasSavedOk();
+}
+
+SerializedData UndoStack::serializeToJournal(const File &journalFile)
+{
+    if (!this->createJournalWriter(journalFile))
+    {
+        return this->serialize();
+    }
+
+    const JournalWriter::Ptr writer(this->journalWriter);
+    return SerializedData::createDeferred(Serialization::Undo::undoStack,
+        [writer]() { return writer->write(); });
+}
+
+bool UndoStack::createJournalWriter(const File &journalFile)
+{
+    // the previous writer is done by now, as the documents
+    // only take the next snapshot when the previous one is written
+    this->applyJournalWriter();
+
+    if (this->transactions.isEmpty())
+    {
+        // the file is deleted when the document is saved without it
+        this->savedJournal = nullptr;
+        this->savedJournalBaseFile = journalFile;
+        this->savedIndexPosition = -1;
+        return false;
+    }
+
+    this->journalWriter = new JournalWriter(*this, journalFile);
+
+    // the history reordered from now on needs the full index next time,
+    // and until the writer is done, serialize() knows of no saved index
+    this->needsFullIndex = false;
+    this->savedIndexPosition = -1;
+    return true;
+}
+
+void UndoStack::applyJournalWriter()
+{
+    if (this->journalWriter == nullptr)
+    {
+        return;
+    }
+
+    const JournalWriter::Ptr writer(this->journalWriter);
+    this->journalWriter = nullptr;
+
+    // the writer may have never run, if the document has failed
+    // to save before getting to the undo stack's node
+    const bool savedOk = writer->isWritten() && writer->hasSavedOk();
+
+    for (auto *transaction : this->transactions)
+    {
+        if (transaction->pendingRecord == nullptr)
+        {
+            continue; // added or changed since the writer was created
+        }
+
+        if (savedOk)
+        {
+            transaction->savedPosition = transaction->pendingRecord->position;
+            transaction->savedBytes = transaction->pendingRecord->bytes;
+
+            if (transaction->spilledPosition >= 0)
+            {
+                // from now on, it will be read back from the saved record
+                this->spilledBytes -= transaction->spilledBytes;
+                transaction->spilledPosition = -1;
+                transaction->spilledBytes = 0;
+            }
+        }
+
+        transaction->pendingRecord = nullptr;
+    }
+
+    if (!savedOk)
+    {
+        // the previous indices don't know about
+        // the transactions appended so far, if any
+        this->needsFullIndex = true;
+        return;
+    }
+
+    if (writer->copiedGeneration >= 0)
+    {
+        // the copy is what the document saved elsewhere refers to
+        this->committedJournalGeneration = writer->copiedGeneration;
+    }
+
+    this->savedJournalBaseFile = writer->baseFile;
+    this->savedJournalGeneration = writer->generation;
+    if (this->savedJournal == nullptr ||
+        this->savedJournal->getFile() != writer->targetFile)
+    {
+        this->savedJournal = makeUnique<UndoJournal>(writer->targetFile);
+    }
+
+    this->savedIndexPosition = writer->indexPosition;
+    this->needsFullIndex = this->needsFullIndex || writer->needsFullIndex;
+    this->numIndexEntriesSinceFullIndex = writer->numIndexEntriesSinceFullIndex;
+}
+
+bool UndoStack::loadJournal(const File &journalFile)
+{
+    if (this->savedIndexPosition < 0 || !this->transactions.isEmpty())
+    {
+        return false;
+    }
+
+    const auto savedJournalFile = getJournalGenerationFile(journalFile, this->savedJournalGeneration);
+    auto loadedJournal = makeUnique<UndoJournal>(savedJournalFile);
+    auto index = savedJournalFile.existsAsFile() ?
+        loadedJournal->read(this->savedIndexPosition) : SerializedData();
+
+    // the journal might have been left from some other project
+    // with the same file name, or rewritten after the document was saved
+    if (!index.hasType(Serialization::Undo::journalIndex) ||
+        index.getProperty(Serialization::Undo::projectId).toString() != this->owner.getId())
+    {
+        this->savedIndexPosition = -1;
+        return false;
+    }
+
+    const int numTransactions = index.getProperty(Serialization::Undo::numTransactions, -1);
+    const int current = index.getProperty(Serialization::Undo::currentTransaction, 0);
+
+    // the latest index lists the latest records, so the records
+    // found in the previous indices are only used for the rest
+    for (int i = 0; i < numTransactions; ++i)
+    {
+        auto *transaction = new Transaction(this->owner, {});
+        transaction->isLoaded = false;
+        this->transactions.add(transaction);
+    }
+
+    int numTransactionsFound = 0;
+    while (index.hasType(Serialization::Undo::journalIndex) &&
+        numTransactionsFound < numTransactions)
+    {
+        if (const auto *records = index.getProperty(Serialization::Undo::journalRecords).getBinaryData())
+        {
+            MemoryInputStream recordsStream(*records, false);
+            while (!recordsStream.isExhausted())
+            {
+                const int i = recordsStream.readInt();
+                const auto position = recordsStream.readInt64();
+                const auto bytes = recordsStream.readInt64();
+
+                auto *transaction = this->transactions[i];
+                if (transaction != nullptr && transaction->savedPosition < 0)
+                {
+                    transaction->savedPosition = position;
+                    transaction->savedBytes = bytes;
+                    ++numTransactionsFound;
+                }
+            }
+        }
+
+        const auto previousIndexPosition =
+            int64(index.getProperty(Serialization::Undo::journalPreviousIndexPosition, -1));
+
+        index = previousIndexPosition >= 0 ?
+            loadedJournal->read(previousIndexPosition) : SerializedData();
+    }
+
+    if (numTransactionsFound != numTransactions || numTransactions < 0)
+    {
+        this->clearUndoHistory();
+        this->savedIndexPosition = -1;
+        return false;
+    }
+
+    this->nextIndex = jlimit(0, this->transactions.size(), current);
+    this->savedJournal = std::move(loadedJournal);
+    this->savedJournalBaseFile = journalFile;
+
+    // except the ones next to undo and redo, which are read right away
+    // to make sure the journal is readable; the others are read back
+    // when first needed, like the spilled ones, see restoreIfSpilled()
+    for (auto *transaction : { this->getCurrentSet(), this->getNextSet() })
+    {
+        if (transaction != nullptr && !this->restoreIfSpilled(transaction))
+        {
+            this->clearUndoHistory();
+            this->savedIndexPosition = -1;
+            return false;
+        }
+    }
+
+    // the chain is only extended within a session,
+    // so the first save writes the full index again
+    this->needsFullIndex = true;
+    return true;
+}
+
 bool UndoStack::mergeTransactionsUpTo(UndoActionId transactionId)
 {
     // make sure the transaction with that id exists
@@ -484,6 +1344,17 @@ bool UndoStack::mergeTransactionsUpTo(UndoActionId transactionId)
 
     DBG("Merging " + String(this->nextIndex - targetActionIndex) + " transactions");
 
+    for (int i = targetActionIndex; i < this->nextIndex; ++i)
+    {
+        if (!this->restoreIfSpilled(this->transactions.getUnchecked(i)))
+        {
+            return false;
+        }
+    }
+
+    targetTransaction->invalidateSavedRecord();
+    this->needsFullIndex = true;
+
     for (int i = targetActionIndex + 1; i < this->nextIndex;)
     {
         if (auto *t = this->transactions[i])
@@ -500,3 +1371,488 @@ bool UndoStack::mergeTransactionsUpTo(UndoActionId transactionId)
 
     return true;
 }
+
+//===----------------------------------------------------------------------===//
+// Tests
+//===----------------------------------------------------------------------===//
+
+#if JUCE_UNIT_TESTS
+
+#include "PianoSequence.h"
+
+// The project's undo stack side, with only one track in it
+class UndoStackTestOwner final : public UndoStackOwner, public MidiTrackSource
+{
+public:
+
+    explicit UndoStackTestOwner(const String &id = "undo test") :
+        id(id), sequence(track.sequence)
+    {
+        this->track.trackId = "undo test track";
+    }
+
+    String getId() const noexcept override { return this->id; }
+    MidiTrackSource &getTrackSource() noexcept override { return *this; }
+    TreeNode *getTracksParent() noexcept override { return nullptr; }
+
+    void performAsOneChangeSet(const Function<void()> &changes) override
+    {
+        changes();
+    }
+
+    const String id;
+    TestPianoTrack track;
+    PianoSequence &sequence;
+
+protected:
+
+    MidiTrack *getTrackById(const String &trackId) override
+    {
+        return trackId == this->track.trackId ? &this->track : nullptr;
+    }
+
+    Pattern *getPatternByTrackId(const String &trackId) override
+    {
+        return nullptr;
+    }
+
+    MidiSequence *getSequenceByTrackId(const String &trackId) override
+    {
+        return trackId == this->track.trackId ? &this->sequence : nullptr;
+    }
+};
+
+class UndoStackSpillingTests final : public UnitTest
+{
+public:
+
+    UndoStackSpillingTests() :
+        UnitTest("Undo stack spilling tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        UndoStackTestOwner owner;
+
+        // no memory budget: all but the last transaction are spilled
+        UndoStack stack(owner, 0, 1);
+
+        for (int key : { 60, 62, 64 })
+        {
+            stack.beginNewTransaction();
+            stack.perform(new NoteInsertAction(owner, owner.track.trackId,
+                Note(&owner.sequence, key, float(key - 60))));
+        }
+
+        this->expectKeys(owner, { 60, 62, 64 });
+
+        beginTest("Spilled transactions are undone and redone");
+
+        expect(stack.undo());
+        this->expectKeys(owner, { 60, 62 });
+
+        // the transaction next to undo is spilled
+        expect(stack.undoHas<NoteInsertAction>());
+        expect(!stack.undoHas<NoteRemoveAction>());
+        expect(stack.redoHas<NoteInsertAction>());
+
+        expect(stack.undo());
+        expect(stack.undo());
+        this->expectKeys(owner, {});
+        expect(!stack.canUndo());
+        expect(!stack.undoHas<NoteInsertAction>());
+        expect(stack.redoHas<NoteInsertAction>());
+
+        expect(stack.redo());
+        expect(stack.redo());
+        expect(stack.redo());
+        this->expectKeys(owner, { 60, 62, 64 });
+        expect(!stack.canRedo());
+        expect(!stack.redoHas<NoteInsertAction>());
+
+        beginTest("Saved transactions are restored from the journal");
+
+        const auto journalFile = File::createTempFile("undo");
+        expect(stack.saveJournal(journalFile));
+
+        UndoStack loadedStack(owner, 0, 1);
+        loadedStack.deserialize(stack.serialize());
+        expect(loadedStack.loadJournal(journalFile));
+
+        expect(loadedStack.canUndo());
+        expect(!loadedStack.canRedo());
+        expect(loadedStack.undoHas<NoteInsertAction>());
+
+        expect(loadedStack.undo());
+        this->expectKeys(owner, { 60, 62 });
+
+        // only read from the journal now
+        expect(loadedStack.undoHas<NoteInsertAction>());
+        expect(loadedStack.redoHas<NoteInsertAction>());
+
+        expect(loadedStack.undo());
+        expect(loadedStack.undo());
+        this->expectKeys(owner, {});
+
+        expect(loadedStack.redo());
+        expect(loadedStack.redo());
+        expect(loadedStack.redo());
+        this->expectKeys(owner, { 60, 62, 64 });
+
+        journalFile.deleteFile();
+    }
+
+private:
+
+    void expectKeys(const UndoStackTestOwner &owner, std::initializer_list<int> keys)
+    {
+        expectEquals(owner.sequence.size(), int(keys.size()));
+
+        int index = 0;
+        for (const int key : keys)
+        {
+            const auto *note = static_cast<const Note *>(owner.sequence.getUnchecked(index++));
+            expectEquals(note->getKey(), key);
+        }
+    }
+};
+
+static UndoStackSpillingTests undoStackSpillingTests;
+
+class UndoStackGestureTests final : public UnitTest
+{
+public:
+
+    UndoStackGestureTests() :
+        UnitTest("Undo stack gesture tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        UndoStackTestOwner owner;
+        UndoStack stack(owner);
+
+        Array<Note> origin;
+        origin.add(Note(&owner.sequence, 60, 0.f));
+        origin.add(Note(&owner.sequence, 64, 1.f));
+        owner.sequence.insertGroup(origin, false);
+
+        beginTest("Drag steps are merged into one undo action");
+
+        stack.beginNewTransaction();
+        stack.beginGesture();
+
+        Array<Note> group(origin);
+        for (int step = 0; step < 3; ++step)
+        {
+            Array<Note> groupAfter;
+            for (const auto &note : group)
+            {
+                groupAfter.add(note.withDeltaBeat(1.f));
+            }
+
+            stack.perform(new NotesGroupChangeAction(owner,
+                owner.track.trackId, group, groupAfter));
+
+            group = groupAfter;
+        }
+
+        stack.endGesture();
+        this->expectBeats(owner, { 3.f, 4.f });
+
+        expect(stack.undo());
+        this->expectBeats(owner, { 0.f, 1.f });
+        expect(!stack.canUndo());
+
+        expect(stack.redo());
+        this->expectBeats(owner, { 3.f, 4.f });
+        expect(stack.undo());
+
+        beginTest("Steps changing other notes are not merged");
+
+        // same size of the groups, but different notes
+        Array<Note> firstNote(origin.getFirst());
+        Array<Note> firstNoteMoved(origin.getFirst().withDeltaBeat(2.f));
+        Array<Note> lastNote(origin.getLast());
+        Array<Note> lastNoteMoved(origin.getLast().withDeltaBeat(2.f));
+
+        stack.beginNewTransaction();
+        stack.beginGesture();
+
+        stack.perform(new NotesGroupChangeAction(owner,
+            owner.track.trackId, firstNote, firstNoteMoved));
+
+        stack.perform(new NotesGroupChangeAction(owner,
+            owner.track.trackId, lastNote, lastNoteMoved));
+
+        stack.endGesture();
+        this->expectBeats(owner, { 2.f, 3.f });
+
+        // both steps are still in the same transaction
+        expect(stack.undo());
+        this->expectBeats(owner, { 0.f, 1.f });
+        expect(!stack.canUndo());
+    }
+
+private:
+
+    void expectBeats(const UndoStackTestOwner &owner, std::initializer_list<float> beats)
+    {
+        expectEquals(owner.sequence.size(), int(beats.size()));
+
+        int index = 0;
+        for (const float beat : beats)
+        {
+            expectEquals(owner.sequence.getUnchecked(index++)->getBeat(), beat);
+        }
+    }
+};
+
+static UndoStackGestureTests undoStackGestureTests;
+
+class UndoStackJournalTests final : public UnitTest
+{
+public:
+
+    UndoStackJournalTests() :
+        UnitTest("Undo stack journal tests", UnitTestCategories::helio) {}
+
+    void runTest() override
+    {
+        const auto journalFile = File::createTempFile("undo");
+
+        beginTest("History is saved and loaded back");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+
+            this->insertNotes(stack, owner, { 60, 62, 64 });
+            expect(stack.saveJournal(journalFile));
+
+            // the next saves only append the changes with a short index
+            this->insertNotes(stack, owner, { 65, 67 });
+            expect(stack.saveJournal(journalFile));
+            expect(stack.undo());
+            expect(stack.saveJournal(journalFile));
+
+            UndoStack loadedStack(owner);
+            loadedStack.deserialize(stack.serialize());
+            expect(loadedStack.loadJournal(journalFile));
+            expect(loadedStack.redoHas<NoteInsertAction>());
+
+            expect(loadedStack.redo());
+            this->expectKeys(owner, { 60, 62, 64, 65, 67 });
+            expect(!loadedStack.canRedo());
+
+            for (int i = 0; i < 5; ++i)
+            {
+                expect(loadedStack.undo());
+            }
+
+            this->expectKeys(owner, {});
+            expect(!loadedStack.canUndo());
+        }
+
+        beginTest("Recent history is kept in the document if the journal fails");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+            this->insertNotes(stack, owner, { 60, 62 });
+
+            // a file can't be a journal's folder
+            const auto blockingFile = File::createTempFile("undo");
+            expect(blockingFile.create().wasOk());
+            const auto unwritableJournal = blockingFile.getChildFile("project.undo");
+            expect(!stack.saveJournal(unwritableJournal));
+
+            const auto document = stack.serialize();
+            expectEquals(document.getNumChildren(), 2);
+
+            UndoStack loadedStack(owner);
+            loadedStack.deserialize(document);
+            expect(!loadedStack.loadJournal(unwritableJournal));
+            expect(loadedStack.undoHas<NoteInsertAction>());
+
+            expect(loadedStack.undo());
+            expect(loadedStack.undo());
+            this->expectKeys(owner, {});
+            expect(!loadedStack.canUndo());
+
+            blockingFile.deleteFile();
+        }
+
+        beginTest("Missing journal is ignored");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+            this->insertNotes(stack, owner, { 60, 62 });
+            expect(stack.saveJournal(journalFile));
+
+            const auto document = stack.serialize();
+            deleteJournalFiles(journalFile);
+
+            UndoStack loadedStack(owner);
+            loadedStack.deserialize(document);
+            expect(!loadedStack.loadJournal(journalFile));
+            expect(!loadedStack.canUndo());
+            expect(!loadedStack.canRedo());
+        }
+
+        beginTest("Journal of another project is ignored");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+            this->insertNotes(stack, owner, { 60, 62 });
+            expect(stack.saveJournal(journalFile));
+
+            UndoStackTestOwner otherOwner("another undo test");
+            UndoStack loadedStack(otherOwner);
+            loadedStack.deserialize(stack.serialize());
+            expect(!loadedStack.loadJournal(journalFile));
+            expect(!loadedStack.canUndo());
+            expect(!loadedStack.canRedo());
+        }
+
+        beginTest("Previous journal is kept until the document is saved");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+            this->insertNotes(stack, owner, { 60 });
+            expect(stack.saveJournal(journalFile));
+            stack.onDocumentSaved();
+
+            // each next save leaves the record of the previous,
+            // undone and replaced transaction as garbage,
+            // until the journal is compacted into a new file
+            Random random(1);
+            auto savedDocument = stack.serialize();
+            bool hasCompacted = false;
+            for (int i = 0; i < 100 && !hasCompacted; ++i)
+            {
+                Array<Note> notes;
+                for (int j = 0; j < 10000; ++j)
+                {
+                    notes.add(Note(&owner.sequence, random.nextInt(128),
+                        float(random.nextInt(10000)), 1.f + random.nextFloat()));
+                }
+
+                stack.beginNewTransaction();
+                stack.perform(new NotesGroupInsertAction(owner, owner.track.trackId, notes));
+                expect(stack.saveJournal(journalFile));
+
+                hasCompacted = findJournalFiles(journalFile).size() > 1;
+                if (!hasCompacted)
+                {
+                    savedDocument = stack.serialize();
+                    stack.onDocumentSaved();
+                    expect(stack.undo());
+                }
+            }
+
+            expect(hasCompacted);
+
+            // the document saved before still refers to the previous file
+            UndoStack previousStack(owner);
+            previousStack.deserialize(savedDocument);
+            expect(previousStack.loadJournal(journalFile));
+            expect(previousStack.undoHas<NoteInsertAction>());
+
+            stack.onDocumentSaved();
+            expectEquals(findJournalFiles(journalFile).size(), 1);
+
+            UndoStack compactedStack(owner);
+            compactedStack.deserialize(stack.serialize());
+            expect(compactedStack.loadJournal(journalFile));
+            expect(compactedStack.undoHas<NotesGroupInsertAction>());
+            expect(compactedStack.undo());
+            expect(compactedStack.undo());
+            this->expectKeys(owner, {});
+        }
+
+        deleteJournalFiles(journalFile);
+
+        beginTest("Journal is written along with the document, after further edits");
+
+        {
+            UndoStackTestOwner owner;
+            UndoStack stack(owner);
+            this->insertNotes(stack, owner, { 60, 62 });
+
+            const auto document = stack.serializeToJournal(journalFile);
+            expect(document.isDeferred());
+            expect(findJournalFiles(journalFile).isEmpty());
+
+            // edited before the document's writer gets to the node
+            this->insertNotes(stack, owner, { 64 });
+
+            expect(document.hasProperty(Serialization::Undo::journalIndexPosition));
+            stack.onDocumentSaved();
+
+            UndoStack loadedStack(owner);
+            loadedStack.deserialize(document);
+            expect(loadedStack.loadJournal(journalFile));
+            expect(loadedStack.undo());
+            expect(loadedStack.undo());
+            expect(!loadedStack.canUndo());
+            this->expectKeys(owner, { 64 });
+
+            // and the next save appends the rest
+            expect(stack.saveJournal(journalFile));
+
+            UndoStack nextStack(owner);
+            nextStack.deserialize(stack.serialize());
+            expect(nextStack.loadJournal(journalFile));
+            expect(nextStack.undoHas<NoteInsertAction>());
+            expect(nextStack.undo());
+            this->expectKeys(owner, {});
+        }
+
+        deleteJournalFiles(journalFile);
+    }
+
+private:
+
+    // all generations of the journal, see UndoStack::onDocumentSaved
+    static Array<File> findJournalFiles(const File &journalFile)
+    {
+        return journalFile.getParentDirectory().findChildFiles(File::findFiles,
+            false, journalFile.getFileName() + "*");
+    }
+
+    static void deleteJournalFiles(const File &journalFile)
+    {
+        for (const auto &file : findJournalFiles(journalFile))
+        {
+            file.deleteFile();
+        }
+    }
+
+    void insertNotes(UndoStack &stack, UndoStackTestOwner &owner, std::initializer_list<int> keys)
+    {
+        for (const int key : keys)
+        {
+            stack.beginNewTransaction();
+            stack.perform(new NoteInsertAction(owner, owner.track.trackId,
+                Note(&owner.sequence, key, float(key - 60))));
+        }
+    }
+
+    void expectKeys(const UndoStackTestOwner &owner, std::initializer_list<int> keys)
+    {
+        expectEquals(owner.sequence.size(), int(keys.size()));
+
+        int index = 0;
+        for (const int key : keys)
+        {
+            const auto *note = static_cast<const Note *>(owner.sequence.getUnchecked(index++));
+            expectEquals(note->getKey(), key);
+        }
+    }
+};
+
+static UndoStackJournalTests undoStackJournalTests;
+
+#endif
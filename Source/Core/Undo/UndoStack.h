@@ -17,18 +17,25 @@
 
 #pragma once
 
-class ProjectNode;
-
 #include "UndoAction.h"
 #include "UndoActionIDs.h"
+#include "UndoJournal.h"
+#include "UndoStackOwner.h"
 
 class UndoStack final : public ChangeBroadcaster, public Serializable
 {
 public:
 
-    explicit UndoStack(ProjectNode &parentProject,
-        int maxNumberOfUnitsToKeep = 30000,
-        int minimumTransactionsToKeep = 30);
+    // The most recent transactions are kept in memory, as well as
+    // the older ones until they take more than maxResidentBytesToKeep;
+    // the rest are packed and spilled to the journal on disk,
+    // from where the oldest are dropped beyond maxSpilledBytesToKeep
+    explicit UndoStack(UndoStackOwner &owner,
+        int64 maxResidentBytesToKeep = 64 * 1024 * 1024,
+        int minimumTransactionsToKeep = 30,
+        int64 maxSpilledBytesToKeep = 512 * 1024 * 1024);
+
+    ~UndoStack() override;
     
     void clearUndoHistory();
 
@@ -51,37 +58,96 @@ public:
     SerializedData serialize() const override;
     void deserialize(const SerializedData &data) override;
     void reset() override;
+
+    // The history is persisted in the journal next to the project file:
+    // each save only appends the transactions changed since the previous
+    // one, followed by a small index record, which is the only thing
+    // that serialize() then writes into the project document;
+    // if saving the journal fails, serialize() falls back to writing
+    // the most recent transactions into the document itself
+    static File getJournalFileFor(const File &projectFile);
+    bool saveJournal(const File &journalFile);
+
+    // The same, except that the journal is only written when the returned
+    // node is first accessed, which may happen on the document's writer
+    // thread; the changes to save are captured here, so the history can be
+    // edited in the meantime, and the stack picks up the written records
+    // on the next save, or when onDocumentSaved() is called
+    SerializedData serializeToJournal(const File &journalFile);
+
+    // The journal is never compacted in place, as the document on disk
+    // refers to its records until the next one is written: compaction
+    // starts the next generation of the journal in a new file, and
+    // the previous generations are only deleted when this is called
+    // after the document referring to the new one is saved
+    void onDocumentSaved();
+
+    // Reads the index the deserialized document refers to,
+    // leaving the transactions in the journal until needed
+    bool loadJournal(const File &journalFile);
     
+    // These read the transaction back into memory, if it was spilled
     template<typename T>
-    bool undoHas() const
+    bool undoHas()
     {
-        return UndoStack::transactionHas<T>(this->getCurrentSet());
+        return this->transactionHas<T>(this->getCurrentSet());
     }
 
     template<typename T>
-    bool redoHas() const
+    bool redoHas()
     {
-        return UndoStack::transactionHas<T>(this->getNextSet());
+        return this->transactionHas<T>(this->getNextSet());
     }
 
     // for multi-step interactive actions which might involve >1 checkpoints
     bool mergeTransactionsUpTo(UndoActionId transactionId);
 
+    // Continuous interactions, like dragging, call beginGesture() once
+    // after the checkpoint and endGesture() when done; in between,
+    // each next action is merged in place into the previous action
+    // of the same gesture, if that action supports it, see
+    // UndoAction::mergeGestureStep; a new transaction ends the gesture
+    void beginGesture() noexcept;
+    void endGesture() noexcept;
+
 private:
     
     void getActionsInCurrentTransaction(Array<const UndoAction *> &actionsFound) const;
     int getNumActionsInCurrentTransaction() const;
 
-    ProjectNode &project;
+    UndoStackOwner &owner;
     
+    struct SavedRecord final : public ReferenceCountedObject
+    {
+        using Ptr = ReferenceCountedObjectPtr<SavedRecord>;
+        int64 position = -1;
+        int64 bytes = 0;
+    };
+
     struct Transaction final : public Serializable
     {
-        explicit Transaction(ProjectNode &project,
+        explicit Transaction(UndoStackOwner &owner,
             UndoActionId transactionId = UndoActionIDs::None);
 
         bool perform() const;
         bool undo() const;
-        int getTotalSize() const;
+        int64 getTotalSize() const;
+
+        bool spill(UndoJournal &journal);
+        void unload();
+        bool restore(const UndoJournal &journal, int64 position);
+
+        inline bool isSpilled() const noexcept
+        {
+            return !this->isLoaded;
+        }
+
+        inline void invalidateSavedRecord() noexcept
+        {
+            this->savedPosition = -1;
+            this->savedBytes = 0;
+            this->pendingRecord = nullptr;
+        }
 
         SerializedData serialize() const;
         void deserialize(const SerializedData &data);
@@ -92,27 +158,50 @@ private:
         OwnedArray<UndoAction> actions;
         UndoActionId id;
 
-        ProjectNode &project;
+        // when the actions are not in memory, they are read back
+        // either from the temporary journal, if spilled there,
+        // or from the project's journal, if saved since the last change
+        bool isLoaded = true;
+
+        // the positions of the packed records in the temporary journal
+        // and in the project's journal, or -1 if there are none
+        int64 spilledPosition = -1;
+        int64 spilledBytes = 0;
+        int64 savedPosition = -1;
+        int64 savedBytes = 0;
+
+        // the record being written by the journal writer, if any,
+        // which is dropped as soon as the transaction changes
+        SavedRecord::Ptr pendingRecord;
+
+        UndoStackOwner &owner;
     };
     
     void setCurrentUndoActionId(UndoActionId transactionId) noexcept;
     OwnedArray<Transaction> transactions;
     UndoActionId newUndoActionId;
     
-    int totalUnitsStored = 0;
-    int maxNumUnitsToKeep = 0;
+    int64 residentBytes = 0;
+    int64 spilledBytes = 0;
+    int64 maxResidentBytes = 0;
+    int64 maxSpilledBytes = 0;
     int minimumTransactionsToKeep = 0;
     int nextIndex = 0;
     bool hasNewEmptyTransaction = true;
     bool reentrancyCheck = false;
+
+    int currentGestureId = 0;
+    int lastGestureId = 0;
+    bool mergeGestureStep(Transaction *transaction, UndoAction *action);
     
     Transaction *getCurrentSet() const noexcept;
     Transaction *getNextSet() const noexcept;
 
     template<typename T>
-    inline static bool transactionHas(Transaction *s)
+    inline bool transactionHas(Transaction *s)
     {
-        if (s != nullptr) // might be an empty set
+        // might be an empty set, or a spilled one which fails to load
+        if (s != nullptr && this->restoreIfSpilled(s))
         {
             for (int i = 0; i < s->actions.size(); ++i)
             {
@@ -127,6 +216,40 @@ private:
     }
 
     void clearFutureTransactions();
+
+    UniquePointer<UndoJournal> journal;
+    UndoJournal &getJournal();
+
+    // only read from on this side, the writer appends to it
+    UniquePointer<UndoJournal> savedJournal;
+    int64 savedIndexPosition = -1;
+
+    // the generation the saved journal is in, and the one
+    // the document on disk refers to, see onDocumentSaved()
+    File savedJournalBaseFile;
+    int savedJournalGeneration = 0;
+    int committedJournalGeneration = 0;
+    static File getJournalGenerationFile(const File &journalFile, int generation);
+
+    // captures the transactions to save, then does all the file I/O
+    // on any thread, and its results are applied on the message thread
+    class JournalWriter;
+    ReferenceCountedObjectPtr<JournalWriter> journalWriter;
+    bool createJournalWriter(const File &journalFile);
+    void applyJournalWriter();
+
+    // each index only lists the transactions appended with it, and refers
+    // to the previous index for the rest; the full index is written again
+    // when the history is reordered or when the chain grows too long
+    bool needsFullIndex = true;
+    int numIndexEntriesSinceFullIndex = 0;
+
+    SerializedData readTransaction(const Transaction *transaction) const;
+
+    void spillOldTransactionsIfNeeded();
+    void dropOldSpilledTransactions();
+    bool restoreIfSpilled(Transaction *transaction);
+    void removeTransaction(int index);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UndoStack)
 };
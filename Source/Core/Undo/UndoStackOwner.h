@@ -0,0 +1,43 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class TreeNode;
+class MidiTrackSource;
+
+// What the undo stack needs from the project it belongs to:
+// implemented by the project itself, and by the tests, which can't
+// create a whole project, as there's no workspace to run it in
+class UndoStackOwner
+{
+public:
+
+    virtual ~UndoStackOwner() {}
+
+    // Tells the undo journals of different projects apart
+    virtual String getId() const noexcept = 0;
+
+    // Where the restored actions look for their tracks,
+    // and where the restored track actions add the tracks
+    virtual MidiTrackSource &getTrackSource() noexcept = 0;
+    virtual TreeNode *getTracksParent() noexcept = 0;
+
+    // Commits all the changes made by the callback as one change set
+    virtual void performAsOneChangeSet(const Function<void()> &changes) = 0;
+
+};
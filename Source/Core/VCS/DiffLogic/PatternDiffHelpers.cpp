@@ -88,7 +88,7 @@ SerializedData PatternDiffHelpers::mergeClipsAdded(const SerializedData &state,
     Array<Clip> result;
     result.addArray(stateClips);
 
-    FlatHashSet<Clip::Id> stateIDs;
+    FlatHashSet<Clip::Id, IdHash> stateIDs;
 
     for (int j = 0; j < stateClips.size(); ++j)
     {
@@ -118,7 +118,7 @@ SerializedData PatternDiffHelpers::mergeClipsRemoved(const SerializedData &state
     deserializePatternChanges(state, changes, stateClips, changesClips);
 
     Array<Clip> result;
-    FlatHashSet<Clip::Id> changesIDs;
+    FlatHashSet<Clip::Id, IdHash> changesIDs;
 
     for (int j = 0; j < changesClips.size(); ++j)
     {
@@ -150,7 +150,7 @@ SerializedData PatternDiffHelpers::mergeClipsChanged(const SerializedData &state
     Array<Clip> result;
     result.addArray(stateClips);
 
-    FlatHashMap<Clip::Id, Clip> changesIDs;
+    FlatHashMap<Clip::Id, Clip, IdHash> changesIDs;
 
     for (int j = 0; j < changesClips.size(); ++j)
     {
@@ -330,7 +330,7 @@ SerializedData mergeNotesAdded(const SerializedData &state, const SerializedData
     result.addArray(stateNotes);
 
     // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    FlatHashSet<MidiEvent::Id> stateIDs;
+    FlatHashSet<MidiEvent::Id, IdHash> stateIDs;
     
     for (int j = 0; j < stateNotes.size(); ++j)
     {
@@ -363,7 +363,7 @@ SerializedData mergeNotesRemoved(const SerializedData &state, const SerializedDa
     Array<const MidiEvent *> result;
 
     // добавляем все ноты из состояния, которых нет в изменениях
-    FlatHashSet<MidiEvent::Id> changesIDs;
+    FlatHashSet<MidiEvent::Id, IdHash> changesIDs;
 
     for (int j = 0; j < changesNotes.size(); ++j)
     {
@@ -397,7 +397,7 @@ SerializedData mergeNotesChanged(const SerializedData &state, const SerializedDa
     result.addArray(stateNotes);
 
     // снова ищем по id и заменяем
-    FlatHashMap<MidiEvent::Id, const Note *> changesIDs;
+    FlatHashMap<MidiEvent::Id, const Note *, IdHash> changesIDs;
     
     for (int j = 0; j < changesNotes.size(); ++j)
     {
@@ -275,33 +275,37 @@ void Head::checkout()
     if (this->state == nullptr)
     { return; }
 
-    // clear all tracked items
+    // all the resulting changes make up a single change set
+    this->targetVcsItemsSource.performAsOneChangeSet([this]()
     {
-        Array<TrackedItem *> itemsToClear;
-
-        for (int i = 0; i < this->targetVcsItemsSource.getNumTrackedItems(); ++i)
+        // clear all tracked items
         {
-            TrackedItem *ti = this->targetVcsItemsSource.getTrackedItem(i);
+            Array<TrackedItem *> itemsToClear;
+
+            for (int i = 0; i < this->targetVcsItemsSource.getNumTrackedItems(); ++i)
+            {
+                TrackedItem *ti = this->targetVcsItemsSource.getTrackedItem(i);
+
+                if (this->state->getItemWithUuid(ti->getUuid()) != nullptr)
+                {
+                    itemsToClear.add(ti);
+                }
+            }
 
-            if (this->state->getItemWithUuid(ti->getUuid()) != nullptr)
+            for (auto i : itemsToClear)
             {
-                itemsToClear.add(ti);
+                this->targetVcsItemsSource.deleteTrackedItem(i);
             }
         }
 
-        for (auto i : itemsToClear)
+        for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
         {
-            this->targetVcsItemsSource.deleteTrackedItem(i);
+            RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
+            this->checkoutItem(stateItem);
         }
-    }
-
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
-    {
-        RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-        this->checkoutItem(stateItem);
-    }
 
-    this->targetVcsItemsSource.onResetState();
+        this->targetVcsItemsSource.onResetState();
+    });
 }
 
 void Head::cherryPick(const Array<Uuid> uuids)
@@ -309,22 +313,25 @@ void Head::cherryPick(const Array<Uuid> uuids)
     if (this->state == nullptr)
     { return; }
 
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+    this->targetVcsItemsSource.performAsOneChangeSet([this, &uuids]()
     {
-        RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-
-        // если этот айтем состояния выбран юзером, то чекаут.
-        for (int j = 0; j < uuids.size(); ++j)
+        for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
         {
-            if (stateItem->getUuid() == uuids.getUnchecked(j))
+            RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
+
+            // если этот айтем состояния выбран юзером, то чекаут.
+            for (int j = 0; j < uuids.size(); ++j)
             {
-                this->checkoutItem(stateItem);
-                break;
+                if (stateItem->getUuid() == uuids.getUnchecked(j))
+                {
+                    this->checkoutItem(stateItem);
+                    break;
+                }
             }
         }
-    }
 
-    this->targetVcsItemsSource.onResetState();
+        this->targetVcsItemsSource.onResetState();
+    });
 }
 
 void Head::cherryPickAll()
@@ -332,13 +339,16 @@ void Head::cherryPickAll()
     if (this->state == nullptr)
     { return; }
     
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+    this->targetVcsItemsSource.performAsOneChangeSet([this]()
     {
-        RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-        this->checkoutItem(stateItem);
-    }
+        for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+        {
+            RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
+            this->checkoutItem(stateItem);
+        }
 
-    this->targetVcsItemsSource.onResetState();
+        this->targetVcsItemsSource.onResetState();
+    });
 }
 
 bool Head::resetChanges(const Array<RevisionItem::Ptr> &changes)
@@ -346,12 +356,16 @@ bool Head::resetChanges(const Array<RevisionItem::Ptr> &changes)
     if (this->state == nullptr)
     { return false; }
 
-    for (const auto &item : changes)
+    this->targetVcsItemsSource.performAsOneChangeSet([this, &changes]()
     {
-        this->resetChangedItemToState(item);
-    }
+        for (const auto &item : changes)
+        {
+            this->resetChangedItemToState(item);
+        }
+
+        this->targetVcsItemsSource.onResetState();
+    });
 
-    this->targetVcsItemsSource.onResetState();
     return true;
 }
 
@@ -440,8 +454,7 @@ SerializedData Head::serialize() const
         for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
         {
             const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-            const auto serializedItem = stateItem->serialize();
-            snapshotNode.appendChild(serializedItem);
+            snapshotNode.appendChild(RevisionItem::serializeDeferred(stateItem));
         }
     }
     
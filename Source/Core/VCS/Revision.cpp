@@ -161,9 +161,9 @@ SerializedData Revision::serialize() const
     tree.setProperty(Serialization::VCS::commitMessage, this->message);
     tree.setProperty(Serialization::VCS::commitTimeStamp, this->timestamp);
 
-    for (const auto *revItem : this->deltas)
+    for (const auto &revItem : this->deltas)
     {
-        tree.appendChild(revItem->serialize());
+        tree.appendChild(RevisionItem::serializeDeferred(revItem));
     }
 
     for (const auto *child : this->children)
@@ -128,6 +128,12 @@ SerializedData RevisionItem::serialize() const
     return tree;
 }
 
+SerializedData RevisionItem::serializeDeferred(const RevisionItem::Ptr &item)
+{
+    return SerializedData::createDeferred(Serialization::VCS::revisionItem,
+        [item]() { return item->serialize(); });
+}
+
 void RevisionItem::deserialize(const SerializedData &data)
 {
     this->reset();
@@ -157,7 +163,9 @@ void RevisionItem::deserialize(const SerializedData &data)
         jassert(e.getNumChildren() == 1);
         if (e.getNumChildren() == 1)
         {
-            this->deltasData.add(e.getChild(0));
+            // copied out of the tree it was read from, which would
+            // otherwise be kept in memory along with its whole arena
+            this->deltasData.add(e.getChild(0).createCopy());
         }
 
         this->deltas.add(delta.release());
@@ -63,6 +63,11 @@ namespace VCS
 
         using Ptr = ReferenceCountedObjectPtr<RevisionItem>;
 
+        // The node which only serializes the item when accessed, so that
+        // the history can be captured for saving quickly, and written on
+        // whatever thread, which is safe, as the items never change
+        static SerializedData serializeDeferred(const RevisionItem::Ptr &item);
+
     private:
 
         OwnedArray<Delta> deltas;
@@ -53,6 +53,13 @@ namespace VCS
             }
         }
 
+        // Applies all the changes made by the callback at once,
+        // e.g. the project commits them to its listeners as one change set
+        virtual void performAsOneChangeSet(const Function<void()> &changes)
+        {
+            changes();
+        }
+
         // Called after checkout / reset to / etc
         virtual void onResetState() = 0;
 
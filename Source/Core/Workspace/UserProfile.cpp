@@ -23,6 +23,7 @@
 #include "ResourceSyncService.h"
 #include "Network.h"
 #include "Config.h"
+#include "UndoStack.h"
 
 static UserSessionInfo kSessionsSort;
 static RecentProjectInfo kProjectsSort;
@@ -231,6 +232,7 @@ void UserProfile::deleteProjectLocally(const String &id)
         if (project->hasLocalCopy())
         {
             project->getLocalFile().deleteFile();
+            UndoStack::getJournalFileFor(project->getLocalFile()).deleteFile();
             this->onProjectLocalInfoReset(id);
         }
     }
@@ -25,6 +25,7 @@
 #include "PianoTrackActions.h"
 #include "AutomationTrackActions.h"
 #include "Note.h"
+#include "PianoSequence.h"
 #include "AutomationEvent.h"
 #include "Clip.h"
 #include "ClipComponent.h"
@@ -211,15 +212,12 @@ void PatternOperations::cutClip(ProjectNode &project, const Clip &clip,
         Array<Note> intersectedEvents;
         Array<float> intersectionPoints;
         auto *sequence = static_cast<PianoSequence *>(track->getSequence());
-        for (int i = 0; i < sequence->size(); ++i)
+        const auto &columns = sequence->getColumns();
+        columns.findNotesOverlapping(cutBeat, cutBeat, [&](int index)
         {
-            auto *note = static_cast<Note *>(sequence->getUnchecked(i));
-            if (note->getBeat() < cutBeat && (note->getBeat() + note->getLength()) > cutBeat)
-            {
-                intersectedEvents.add(*note);
-                intersectionPoints.add(cutBeat - note->getBeat());
-            }
-        }
+            intersectedEvents.add(columns.getNote(index));
+            intersectionPoints.add(cutBeat - columns.getBeat(index));
+        });
 
         // assumes that any changes will be done anyway, i.e. too simple check, but ok for now
         if (shouldCheckpoint)
@@ -262,6 +262,65 @@ bool applyAnnotationInsertions(const AnnotationChangeGroup &group, bool &didChec
 bool applyAutoInsertions(const AutoChangeGroup &group, bool &didCheckpoint)
 { return applyInsertions<AutomationEvent, AutomationSequence, AutoChangeGroup, AutoChangeGroupsPerLayer>(group, didCheckpoint); }
 
+//===----------------------------------------------------------------------===//
+// Change sets
+//===----------------------------------------------------------------------===//
+
+// Makes the project commit all the changes of a group edit to its listeners
+// as one change set, right when the edit is done, even if it spans many tracks
+class ScopedGroupChangeSet final
+{
+public:
+
+    explicit ScopedGroupChangeSet(ProjectNode *project)
+    {
+        if (project != nullptr)
+        {
+            this->transaction = makeUnique<ProjectNode::ScopedChangeTransaction>(*project);
+        }
+    }
+
+    explicit ScopedGroupChangeSet(const Lasso &selection) :
+        ScopedGroupChangeSet(findProject(selection)) {}
+
+    explicit ScopedGroupChangeSet(const Array<MidiTrack *> &tracks) :
+        ScopedGroupChangeSet(findProject(tracks)) {}
+
+private:
+
+    static ProjectNode *findProject(const Lasso &selection)
+    {
+        if (selection.getNumSelected() == 0)
+        {
+            return nullptr;
+        }
+
+        if (const auto *nc = dynamic_cast<NoteComponent *>(selection.getSelectedItem(0)))
+        {
+            return nc->getNote().getSequence()->getProject();
+        }
+
+        return nullptr;
+    }
+
+    static ProjectNode *findProject(const Array<MidiTrack *> &tracks)
+    {
+        for (const auto *track : tracks)
+        {
+            if (track->getSequence() != nullptr)
+            {
+                return track->getSequence()->getProject();
+            }
+        }
+
+        return nullptr;
+    }
+
+    UniquePointer<ProjectNode::ScopedChangeTransaction> transaction;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedGroupChangeSet)
+};
+
 //===----------------------------------------------------------------------===//
 // More helpers
 //===----------------------------------------------------------------------===//
@@ -377,6 +436,7 @@ void SequencerOperations::wipeSpace(Array<MidiTrack *> tracks,
     // отложенно удалить все из массива 1
     // и добавить все из массива 2
 
+    const ScopedGroupChangeSet changeSet(tracks);
     bool didCheckpoint = !shouldCheckpoint;
     
     PianoChangeGroup pianoRemoveGroup;
@@ -391,9 +451,10 @@ void SequencerOperations::wipeSpace(Array<MidiTrack *> tracks,
 
         if (auto *pianoSequence = dynamic_cast<PianoSequence *>(sequence))
         {
-            for (int j = 0; j < pianoSequence->size(); ++j)
+            const auto &columns = pianoSequence->getColumns();
+            const auto wipeNote = [&](int index)
             {
-                Note *note = static_cast<Note *>(pianoSequence->getUnchecked(j));
+                const Note *note = &columns.getNote(index);
                 const float noteStartBeat = note->getBeat();
                 const float noteEndBeat = note->getBeat() + note->getLength();
                 
@@ -422,6 +483,18 @@ void SequencerOperations::wipeSpace(Array<MidiTrack *> tracks,
                         pianoInsertGroup.add(note->withBeat(endBeat).withLength(noteEndBeat - endBeat).copyWithNewId());
                     }
                 }
+            };
+
+            // only these notes are affected: the ones sounding at startBeat
+            // which started before it, and all the ones starting within
+            // the range, including the zero-length notes at startBeat,
+            // which an overlap query alone would miss
+            columns.findNotesOverlapping(startBeat, startBeat, wipeNote);
+
+            const auto notesWithin = columns.findNotesStartingWithin(startBeat, endBeat);
+            for (int j = notesWithin.getStart(); j < notesWithin.getEnd(); ++j)
+            {
+                wipeNote(j);
             }
         }
         else if (auto *textSequence = dynamic_cast<AnnotationsSequence *>(sequence))
@@ -464,6 +537,7 @@ void SequencerOperations::wipeSpace(Array<MidiTrack *> tracks,
 
 void SequencerOperations::shiftEventsToTheLeft(Array<MidiTrack *> tracks, float targetBeat, float beatOffset, bool shouldCheckpoint /*= true*/)
 {
+    const ScopedGroupChangeSet changeSet(tracks);
     bool didCheckpoint = !shouldCheckpoint;
     
     PianoChangeGroup pianoGroupBefore;
@@ -527,6 +601,7 @@ void SequencerOperations::shiftEventsToTheLeft(Array<MidiTrack *> tracks, float
 
 void SequencerOperations::shiftEventsToTheRight(Array<MidiTrack *> tracks, float targetBeat, float beatOffset, bool shouldCheckpoint /*= true*/)
 {
+    const ScopedGroupChangeSet changeSet(tracks);
     bool didCheckpoint = !shouldCheckpoint;
     
     PianoChangeGroup groupBefore;
@@ -596,6 +671,7 @@ void SequencerOperations::snapSelection(Lasso &selection, float snapsPerBeat, bo
         return;
     }
     
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     
     PianoChangeGroup groupBefore, groupAfter;
@@ -630,6 +706,7 @@ void SequencerOperations::cleanupOverlaps(Lasso &selection, bool shouldCheckpoin
         return;
     }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     // 1 convert this
@@ -796,8 +873,8 @@ void SequencerOperations::cleanupOverlaps(Lasso &selection, bool shouldCheckpoin
     
     // remove duplicates
     
-    FlatHashMap<MidiEvent::Id, Note> deferredRemoval;
-    FlatHashMap<MidiEvent::Id, Note> unremovableNotes;
+    FlatHashMap<MidiEvent::Id, Note, IdHash> deferredRemoval;
+    FlatHashMap<MidiEvent::Id, Note, IdHash> unremovableNotes;
     
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
@@ -852,6 +929,7 @@ void SequencerOperations::retrograde(Lasso &selection, bool shouldCheckpoint /*=
         return;
     }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     // 1. sort selection
@@ -895,6 +973,7 @@ void SequencerOperations::melodicInversion(Lasso &selection, bool shouldCheckpoi
         return;
     }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     // 1. sort selection
@@ -934,9 +1013,10 @@ void SequencerOperations::removeDuplicates(Lasso &selection, bool shouldCheckpoi
     if (selection.getNumSelected() == 0)
     { return; }
     
-    FlatHashMap<MidiEvent::Id, Note> deferredRemoval;
-    FlatHashMap<MidiEvent::Id, Note> unremovableNotes;
+    FlatHashMap<MidiEvent::Id, Note, IdHash> deferredRemoval;
+    FlatHashMap<MidiEvent::Id, Note, IdHash> unremovableNotes;
     
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     for (int i = 0; i < selection.getNumSelected(); ++i)
@@ -991,6 +1071,7 @@ void SequencerOperations::moveToLayer(Lasso &selection, MidiSequence *layer, boo
     PianoSequence *targetLayer = dynamic_cast<PianoSequence *>(layer);
     jassert(targetLayer != nullptr);
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     PianoChangeGroupsPerLayer deferredRemovals;
     PianoChangeGroupProxy::Ptr insertionsForTargetLayer(new PianoChangeGroupProxy());
@@ -1076,6 +1157,7 @@ bool SequencerOperations::arpeggiate(Lasso &selection,
         return false;
     }
     
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     Array<Note> sortedRemovals;
     Array<Note> insertions;
@@ -1206,6 +1288,7 @@ void SequencerOperations::randomizeVolume(Lasso &selection, float factor, bool s
         return;
     }
     
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     Random random(Time::currentTimeMillis());
 
@@ -1240,6 +1323,7 @@ void SequencerOperations::fadeOutVolume(Lasso &selection, float factor, bool sho
     
     float minBeat = FLT_MAX;
     float maxBeat = -FLT_MAX;
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     PianoChangeGroup groupBefore, groupAfter;
     
@@ -1293,6 +1377,8 @@ void SequencerOperations::changeVolumeLinear(Lasso &selection, float volumeDelta
     if (selection.getNumSelected() == 0)
     { return; }
 
+    const ScopedGroupChangeSet changeSet(selection);
+
     for (const auto &s : selection.getGroupedSelections())
     {
         const auto trackSelection(s.second);
@@ -1317,6 +1403,8 @@ void SequencerOperations::changeVolumeMultiplied(Lasso &selection, float volumeF
     if (selection.getNumSelected() == 0)
     { return; }
 
+    const ScopedGroupChangeSet changeSet(selection);
+
     for (const auto &s : selection.getGroupedSelections())
     {
         const auto trackSelection(s.second);
@@ -1342,6 +1430,8 @@ void SequencerOperations::changeVolumeSine(Lasso &selection, float volumeFactor)
 {
     if (selection.getNumSelected() == 0)
     { return; }
+
+    const ScopedGroupChangeSet changeSet(selection);
     
     const float numSines = 2;
     float midline = 0.f;
@@ -1441,6 +1531,7 @@ void SequencerOperations::pasteFromClipboard(Clipboard &clipboard, ProjectNode &
 
     if (!root.isValid()) { return; }
 
+    const ScopedGroupChangeSet changeSet(&project);
     bool didCheckpoint = !shouldCheckpoint;
 
     const float targetBeat = roundf(targetBeatPosition * 1000.f) / 1000.f;
@@ -1584,6 +1675,7 @@ void SequencerOperations::deleteSelection(const Lasso &selection, bool shouldChe
         arrayToAddTo->add(note);
     }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     for (int i = 0; i < selectionsByTrack.size(); ++i)
@@ -1610,6 +1702,7 @@ void SequencerOperations::shiftKeyRelative(Lasso &selection,
     const auto transactionId = selection.generateLassoTransactionId(operationId);
     const bool repeatsLastAction = sequence->getLastUndoActionId() == transactionId;
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint || repeatsLastAction;
     
     for (const auto &s : selection.getGroupedSelections())
@@ -1659,6 +1752,7 @@ void SequencerOperations::shiftBeatRelative(Lasso &selection, float deltaBeat, b
     const auto transactionId = selection.generateLassoTransactionId(operationId);
     const bool repeatsLastAction = sequence->getLastUndoActionId() == transactionId;
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint || repeatsLastAction;
 
     for (const auto &s : selection.getGroupedSelections())
@@ -1698,6 +1792,7 @@ void SequencerOperations::shiftLengthRelative(Lasso &selection, float deltaLengt
     const auto transactionId = selection.generateLassoTransactionId(operationId);
     const bool repeatsLastAction = sequence->getLastUndoActionId() == transactionId;
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint || repeatsLastAction;
 
     for (const auto &s : selection.getGroupedSelections())
@@ -1734,6 +1829,7 @@ void SequencerOperations::invertChord(Lasso &selection,
     if (selection.getNumSelected() == 0)
     { return; }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
     
     for (const auto &s : selection.getGroupedSelections())
@@ -1921,9 +2017,10 @@ bool SequencerOperations::rescale(const ProjectNode &project, float startBeat, f
     Note::Key rootKey, Scale::Ptr scaleA, Scale::Ptr scaleB, bool shouldCheckpoint /*= true*/)
 {
     bool hasMadeChanges = false;
+    const ScopedGroupChangeSet changeSet(const_cast<ProjectNode *>(&project));
     bool didCheckpoint = !shouldCheckpoint;
 
-    const auto pianoTracks = project.findChildrenOfType<PianoTrackNode>();
+    const auto pianoTracks = project.getPianoTracks();
     for (const auto *track : pianoTracks)
     {
         auto *sequence = static_cast<PianoSequence *>(track->getSequence());
@@ -1933,7 +2030,7 @@ bool SequencerOperations::rescale(const ProjectNode &project, float startBeat, f
         // find events in between (only consider events of one clip!),
         // skipping clips of the same track if already processed any other:
 
-        FlatHashSet<MidiEvent::Id, StringHash> usedClips;
+        FlatHashSet<Clip::Id, IdHash> usedClips;
 
         for (int i = 0; i < sequence->size(); ++i)
         {
@@ -2055,6 +2152,7 @@ void SequencerOperations::duplicateSelection(const Lasso &selection, bool should
         arrayToAddTo->add(note.copyWithNewId());
     }
 
+    const ScopedGroupChangeSet changeSet(selection);
     bool didCheckpoint = !shouldCheckpoint;
 
     for (int i = 0; i < selectionsByTrack.size(); ++i)
@@ -2076,6 +2174,7 @@ Array<Note> SequencerOperations::cutEvents(const Array<Note> &notes,
 {
     if (notes.isEmpty()) { return {}; }
 
+    const ScopedGroupChangeSet changeSet(notes.getReference(0).getSequence()->getProject());
     bool didCheckpoint = !shouldCheckpoint;
 
     Array<Note> newEventsToTheRight;
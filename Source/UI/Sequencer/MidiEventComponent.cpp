@@ -118,5 +118,9 @@ int MidiEventComponent::compareElements(MidiEventComponent *first, MidiEventComp
     if (first == second) { return 0; }
     const float diff = first->getBeat() - second->getBeat();
     const int diffResult = (diff > 0.f) - (diff < 0.f);
-    return (diffResult != 0) ? diffResult : (first->getId().compare(second->getId()));
+    if (diffResult != 0) { return diffResult; }
+
+    const auto firstId = first->getId();
+    const auto secondId = second->getId();
+    return (firstId > secondId) - (firstId < secondId);
 }
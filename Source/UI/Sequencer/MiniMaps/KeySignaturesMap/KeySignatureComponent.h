@@ -52,7 +52,9 @@ public:
         const int diffResult = (diff > 0.f) - (diff < 0.f);
         if (diffResult != 0) { return diffResult; }
 
-        return first->event.getId().compare(second->event.getId());
+        const auto firstId = first->event.getId();
+        const auto secondId = second->event.getId();
+        return (firstId > secondId) - (firstId < secondId);
     }
 
 protected:
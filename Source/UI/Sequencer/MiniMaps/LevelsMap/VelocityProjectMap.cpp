@@ -496,6 +496,114 @@ void VelocityProjectMap::onRemoveMidiEvent(const MidiEvent &event)
     }
 }
 
+void VelocityProjectMap::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    jassert(oldEvents.size() == newEvents.size());
+
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+
+    for (int i = 0; i < newEvents.size(); ++i)
+    {
+        if (oldEvents.getUnchecked(i)->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*oldEvents.getUnchecked(i));
+            const Note &newNote = static_cast<const Note &>(*newEvents.getUnchecked(i));
+            this->findSequenceMapsOfTrack(newNote.getSequence()->getTrack(), lastTrack, trackMaps);
+
+            for (const auto &trackMap : trackMaps)
+            {
+                auto &sequenceMap = *trackMap.second;
+                const auto found = sequenceMap.find(note);
+                if (found != sequenceMap.end())
+                {
+                    auto *component = found->second.release();
+                    sequenceMap.erase(found);
+                    sequenceMap[newNote] = UniquePointer<VelocityMapNoteComponent>(component);
+                    this->batchRepaintList.add(component);
+                }
+            }
+        }
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void VelocityProjectMap::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+
+    VELOCITY_MAP_BULK_REPAINT_START
+
+    for (const auto *event : events)
+    {
+        if (event->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*event);
+            this->findSequenceMapsOfTrack(note.getSequence()->getTrack(), lastTrack, trackMaps);
+
+            for (const auto &trackMap : trackMaps)
+            {
+                auto *component = new VelocityMapNoteComponent(note, *trackMap.first);
+                (*trackMap.second)[note] = UniquePointer<VelocityMapNoteComponent>(component);
+                this->addAndMakeVisible(component);
+                this->batchRepaintList.add(component);
+            }
+        }
+    }
+
+    VELOCITY_MAP_BULK_REPAINT_END
+
+    this->triggerAsyncUpdate();
+}
+
+void VelocityProjectMap::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+
+    VELOCITY_MAP_BULK_REPAINT_START
+
+    for (const auto *event : events)
+    {
+        if (event->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*event);
+            this->findSequenceMapsOfTrack(note.getSequence()->getTrack(), lastTrack, trackMaps);
+
+            for (const auto &trackMap : trackMaps)
+            {
+                trackMap.second->erase(note);
+            }
+        }
+    }
+
+    VELOCITY_MAP_BULK_REPAINT_END
+}
+
+void VelocityProjectMap::findSequenceMapsOfTrack(const MidiTrack *track,
+    const MidiTrack *&lastTrack, Array<TrackSequenceMap> &result)
+{
+    if (track == lastTrack)
+    {
+        return;
+    }
+
+    lastTrack = track;
+    result.clearQuick();
+
+    forEachSequenceMapOfGivenTrack(this->patternMap, c, track)
+    {
+        const int i = track->getPattern()->indexOfSorted(&c.first);
+        jassert(i >= 0);
+
+        const Clip *clip = track->getPattern()->getUnchecked(i);
+        result.add(TrackSequenceMap(clip, c.second.get()));
+    }
+}
+
 void VelocityProjectMap::onAddClip(const Clip &clip)
 {
     const SequenceMap *referenceMap = nullptr;
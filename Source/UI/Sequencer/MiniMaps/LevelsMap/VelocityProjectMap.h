@@ -59,6 +59,11 @@ public:
     void onChangeMidiEvent(const MidiEvent &e1, const MidiEvent &e2) override;
     void onRemoveMidiEvent(const MidiEvent &event) override;
 
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
     void onAddClip(const Clip &clip) override;
     void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
     void onRemoveClip(const Clip &clip) override;
@@ -95,6 +100,12 @@ private:
     using PatternMap = FlatHashMap<Clip, UniquePointer<SequenceMap>, ClipHash>;
     PatternMap patternMap;
 
+    // the group operations send the notes of one track at once,
+    // so its sequence maps are only looked up when the track changes
+    using TrackSequenceMap = std::pair<const Clip *, SequenceMap *>;
+    void findSequenceMapsOfTrack(const MidiTrack *track,
+        const MidiTrack *&lastTrack, Array<TrackSequenceMap> &result);
+
     UniquePointer<VelocityLevelDraggingHelper> dragHelper;
     FlatHashMap<Note, float, MidiEventHash> dragIntersections;
     Array<Note> dragChangedNotes, dragChanges;
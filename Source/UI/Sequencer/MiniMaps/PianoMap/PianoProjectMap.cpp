@@ -154,6 +154,96 @@ void PianoProjectMap::onRemoveMidiEvent(const MidiEvent &event)
     }
 }
 
+void PianoProjectMap::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<SequenceSet *> trackSets;
+
+    for (const auto *event : events)
+    {
+        if (event->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*event);
+            this->findSequenceSetsOfTrack(note.getSequence()->getTrack(), lastTrack, trackSets);
+
+            for (auto *sequenceSet : trackSets)
+            {
+                sequenceSet->insert(note);
+            }
+        }
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PianoProjectMap::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    jassert(oldEvents.size() == newEvents.size());
+
+    const MidiTrack *lastTrack = nullptr;
+    Array<SequenceSet *> trackSets;
+
+    for (int i = 0; i < newEvents.size(); ++i)
+    {
+        if (oldEvents.getUnchecked(i)->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*oldEvents.getUnchecked(i));
+            const Note &newNote = static_cast<const Note &>(*newEvents.getUnchecked(i));
+            this->findSequenceSetsOfTrack(newNote.getSequence()->getTrack(), lastTrack, trackSets);
+
+            for (auto *sequenceSet : trackSets)
+            {
+                if (sequenceSet->erase(note) > 0)
+                {
+                    sequenceSet->insert(newNote);
+                }
+            }
+        }
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PianoProjectMap::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<SequenceSet *> trackSets;
+
+    for (const auto *event : events)
+    {
+        if (event->isTypeOf(MidiEvent::Type::Note))
+        {
+            const Note &note = static_cast<const Note &>(*event);
+            this->findSequenceSetsOfTrack(note.getSequence()->getTrack(), lastTrack, trackSets);
+
+            for (auto *sequenceSet : trackSets)
+            {
+                sequenceSet->erase(note);
+            }
+        }
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PianoProjectMap::findSequenceSetsOfTrack(const MidiTrack *track,
+    const MidiTrack *&lastTrack, Array<SequenceSet *> &result)
+{
+    if (track == lastTrack)
+    {
+        return;
+    }
+
+    lastTrack = track;
+    result.clearQuick();
+
+    forEachSequenceMapOfGivenTrack(this->patternMap, c, track)
+    {
+        result.add(c.second.get());
+    }
+}
+
 void PianoProjectMap::onAddClip(const Clip &clip)
 {
     const SequenceSet *referenceMap = nullptr;
@@ -50,6 +50,11 @@ public:
     void onChangeMidiEvent(const MidiEvent &e1, const MidiEvent &e2) override;
     void onRemoveMidiEvent(const MidiEvent &event) override;
 
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
     void onAddClip(const Clip &clip) override;
     void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
     void onRemoveClip(const Clip &clip) override;
@@ -86,6 +91,11 @@ private:
     using PatternMap = FlatHashMap<Clip, UniquePointer<SequenceSet>, ClipHash>;
     PatternMap patternMap;
 
+    // the group operations send the notes of one track at once,
+    // so its sequence sets are only looked up when the track changes
+    void findSequenceSetsOfTrack(const MidiTrack *track,
+        const MidiTrack *&lastTrack, Array<SequenceSet *> &result);
+
     void handleAsyncUpdate() override;
 
     JUCE_LEAK_DETECTOR(PianoProjectMap)
@@ -267,5 +267,7 @@ int AutomationCurveEventComponent::compareElements(const AutomationCurveEventCom
     const int cvResult = (cvDiff > 0.f) - (cvDiff < 0.f); // sorted by cv, if beats are the same
     if (cvResult != 0) { return cvResult; }
 
-    return first->event.getId().compare(second->event.getId());
+    const auto firstId = first->event.getId();
+    const auto secondId = second->event.getId();
+    return (firstId > secondId) - (firstId < secondId);
 }
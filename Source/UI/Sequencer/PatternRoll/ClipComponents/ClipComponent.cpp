@@ -90,7 +90,7 @@ const String &ClipComponent::getSelectionGroupId() const noexcept
     return this->clip.getPattern()->getTrackId();
 }
 
-const String &ClipComponent::getId() const noexcept
+MidiEvent::Id ClipComponent::getId() const noexcept
 {
     return this->clip.getId();
 }
@@ -321,7 +321,11 @@ int ClipComponent::compareElements(ClipComponent *first, ClipComponent *second)
     if (first == second) { return 0; }
     const float diff = first->getBeat() - second->getBeat();
     const int diffResult = (diff > 0.f) - (diff < 0.f);
-    return (diffResult != 0) ? diffResult : (first->clip.getId().compare(second->clip.getId()));
+    if (diffResult != 0) { return diffResult; }
+
+    const auto firstId = first->clip.getId();
+    const auto secondId = second->clip.getId();
+    return (firstId > secondId) - (firstId < secondId);
 }
 
 void ClipComponent::checkpointIfNeeded()
@@ -20,6 +20,7 @@
 #include "PianoSequence.h"
 #include "PianoRoll.h"
 #include "ProjectNode.h"
+#include "UndoStack.h"
 #include "MidiSequence.h"
 #include "MidiTrack.h"
 #include "Note.h"
@@ -525,6 +526,7 @@ void NoteComponent::mouseUp(const MouseEvent &e)
     }
     
     this->getRoll().hideAllGhostNotes();
+    this->getRoll().getProject().getUndoStack()->endGesture();
 
 #if HELIO_MOBILE
     const bool shouldSendMidi = false;
@@ -1090,6 +1092,7 @@ void NoteComponent::checkpointIfNeeded()
     if (!this->firstChangeDone)
     {
         this->note.getSequence()->checkpoint();
+        this->getRoll().getProject().getUndoStack()->beginGesture();
         this->firstChangeDone = true;
     }
 }
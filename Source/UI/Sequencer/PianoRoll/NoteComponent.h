@@ -64,7 +64,7 @@ public:
 
     void setSelected(bool selected) override;
     const String &getSelectionGroupId() const noexcept override;
-    const String &getId() const noexcept override { return this->note.getId(); }
+    MidiEvent::Id getId() const noexcept override { return this->note.getId(); }
     float getBeat() const noexcept override { return this->note.getBeat(); }
 
     //===------------------------------------------------------------------===//
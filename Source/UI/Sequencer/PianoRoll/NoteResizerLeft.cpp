@@ -25,6 +25,8 @@
 #include "HybridRoll.h"
 #include "PianoRoll.h"
 #include "PianoSequence.h"
+#include "ProjectNode.h"
+#include "UndoStack.h"
 #include "NoteComponent.h"
 #include "SequencerOperations.h"
 //[/MiscUserDefs]
@@ -191,6 +193,8 @@ void NoteResizerLeft::mouseUp (const MouseEvent& e)
         nc->getRoll().hideAllGhostNotes();
         nc->endGroupScalingLeft();
     }
+
+    this->roll.getProject().getUndoStack()->endGesture();
     //[/UserCode_mouseUp]
 }
 
@@ -25,6 +25,8 @@
 #include "HybridRoll.h"
 #include "PianoRoll.h"
 #include "PianoSequence.h"
+#include "ProjectNode.h"
+#include "UndoStack.h"
 #include "SequencerOperations.h"
 #include "NoteComponent.h"
 //[/MiscUserDefs]
@@ -192,6 +194,8 @@ void NoteResizerRight::mouseUp (const MouseEvent& e)
         nc->getRoll().hideAllGhostNotes();
         nc->endGroupScalingLeft();
     }
+
+    this->roll.getProject().getUndoStack()->endGesture();
     //[/UserCode_mouseUp]
 }
 
@@ -578,6 +578,163 @@ void PianoRoll::onRemoveMidiEvent(const MidiEvent &event)
     HybridRoll::onRemoveMidiEvent(event);
 }
 
+void PianoRoll::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    jassert(oldEvents.size() == newEvents.size());
+
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+    bool hasChangedNotes = false;
+
+    for (int i = 0; i < newEvents.size(); ++i)
+    {
+        const auto &oldEvent = *oldEvents.getUnchecked(i);
+        const auto &newEvent = *newEvents.getUnchecked(i);
+        if (!oldEvent.isTypeOf(MidiEvent::Type::Note))
+        {
+            this->onChangeMidiEvent(oldEvent, newEvent);
+            continue;
+        }
+
+        const auto &note = static_cast<const Note &>(oldEvent);
+        const auto &newNote = static_cast<const Note &>(newEvent);
+        this->findSequenceMapsOfTrack(newEvent.getSequence()->getTrack(), lastTrack, trackMaps);
+
+        for (const auto &trackMap : trackMaps)
+        {
+            auto &sequenceMap = *trackMap.second;
+            const auto found = sequenceMap.find(note);
+            if (found != sequenceMap.end())
+            {
+                auto *component = found->second.release();
+                sequenceMap.erase(found);
+                jassert(!sequenceMap.contains(newNote));
+                sequenceMap[newNote] = UniquePointer<NoteComponent>(component);
+                this->batchRepaintList.add(component);
+            }
+        }
+
+        hasChangedNotes = true;
+    }
+
+    if (hasChangedNotes)
+    {
+        // see the comment in onChangeMidiEvent
+        this->noteNameGuides->syncWithSelection(&this->selection);
+        this->triggerAsyncUpdate();
+    }
+}
+
+void PianoRoll::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+    bool hasAddedNotes = false;
+
+    // the new note mode only applies to a single note added by mouse,
+    // so unlike onAddMidiEvent, this only needs to care about selection
+    const bool isCurrentlyDraggingNote = this->draggingHelper->isVisible();
+
+    for (const auto *event : events)
+    {
+        if (!event->isTypeOf(MidiEvent::Type::Note))
+        {
+            this->onAddMidiEvent(*event);
+            continue;
+        }
+
+        const auto &note = static_cast<const Note &>(*event);
+        this->findSequenceMapsOfTrack(note.getSequence()->getTrack(), lastTrack, trackMaps);
+
+        for (const auto &trackMap : trackMaps)
+        {
+            auto *component = new NoteComponent(*this, note, *trackMap.first);
+            (*trackMap.second)[note] = UniquePointer<NoteComponent>(component);
+            this->addAndMakeVisible(component);
+
+            this->fader.fadeIn(component, 150);
+
+            const bool isActive = component->belongsTo(this->activeTrack, this->activeClip);
+            component->setActive(isActive, true);
+
+            this->batchRepaintList.add(component);
+
+            if (isActive && !isCurrentlyDraggingNote)
+            {
+                this->selectEvent(component, false);
+            }
+        }
+
+        hasAddedNotes = true;
+    }
+
+    if (hasAddedNotes)
+    {
+        this->triggerAsyncUpdate();
+    }
+}
+
+void PianoRoll::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    const MidiTrack *lastTrack = nullptr;
+    Array<TrackSequenceMap> trackMaps;
+    bool hasHiddenHelpers = false;
+
+    for (const auto *event : events)
+    {
+        if (!event->isTypeOf(MidiEvent::Type::Note))
+        {
+            this->onRemoveMidiEvent(*event);
+            continue;
+        }
+
+        if (!hasHiddenHelpers)
+        {
+            this->hideDragHelpers();
+            this->hideAllGhostNotes(); // Avoids crash
+            hasHiddenHelpers = true;
+        }
+
+        const auto &note = static_cast<const Note &>(*event);
+        this->findSequenceMapsOfTrack(note.getSequence()->getTrack(), lastTrack, trackMaps);
+
+        for (const auto &trackMap : trackMaps)
+        {
+            auto &sequenceMap = *trackMap.second;
+            const auto found = sequenceMap.find(note);
+            if (found != sequenceMap.end())
+            {
+                auto *deletedComponent = found->second.get();
+                this->fader.fadeOut(deletedComponent, 150);
+                this->selection.deselect(deletedComponent);
+                sequenceMap.erase(found);
+            }
+        }
+    }
+}
+
+void PianoRoll::findSequenceMapsOfTrack(const MidiTrack *track,
+    const MidiTrack *&lastTrack, Array<TrackSequenceMap> &result)
+{
+    if (track == lastTrack)
+    {
+        return;
+    }
+
+    lastTrack = track;
+    result.clearQuick();
+
+    forEachSequenceMapOfGivenTrack(this->patternMap, c, track)
+    {
+        const int i = track->getPattern()->indexOfSorted(&c.first);
+        jassert(i >= 0);
+
+        const Clip *realClip = track->getPattern()->getUnchecked(i);
+        result.add(TrackSequenceMap(realClip, c.second.get()));
+    }
+}
+
 void PianoRoll::onAddClip(const Clip &clip)
 {
     const SequenceMap *referenceMap = nullptr;
@@ -838,15 +995,37 @@ void PianoRoll::findLassoItemsInArea(Array<SelectableComponent *> &itemsFound, c
         component->setSelected(true);
     }
     
-    forEachEventComponent(this->patternMap, e)
-    {
-        auto *component = e.second.get();
-        if (rectangle.intersects(component->getBounds()) && component->isActive())
+    // only the notes within the lasso's beat range can intersect it,
+    // so instead of checking all components, this finds those notes
+    // in each sequence's columns; the range is a bit wider, since
+    // the components' bounds are rounded to whole pixels
+    const float lassoStartBeat = this->getBeatByXPosition(float(rectangle.getX() - 2));
+    const float lassoEndBeat = this->getBeatByXPosition(float(rectangle.getRight() + 2));
+
+    for (const auto &c : this->patternMap)
+    {
+        const auto &clip = c.first;
+        const auto &sequenceMap = *c.second.get();
+        const auto *sequence = static_cast<PianoSequence *>(clip.getPattern()->getTrack()->getSequence());
+        const auto &columns = sequence->getColumns();
+
+        columns.findNotesOverlapping(lassoStartBeat - clip.getBeat(),
+            lassoEndBeat - clip.getBeat(), [&](int index)
         {
-            component->setSelected(true);
-            jassert(!itemsFound.contains(component));
-            itemsFound.add(component);
-        }
+            const auto found = sequenceMap.find(columns.getNote(index));
+            if (found == sequenceMap.end())
+            {
+                return;
+            }
+
+            auto *component = found->second.get();
+            if (rectangle.intersects(component->getBounds()) && component->isActive())
+            {
+                component->setSelected(true);
+                jassert(!itemsFound.contains(component));
+                itemsFound.add(component);
+            }
+        });
     }
 }
 
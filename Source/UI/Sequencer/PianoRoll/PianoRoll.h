@@ -120,6 +120,11 @@ public:
     void onAddMidiEvent(const MidiEvent &event) override;
     void onRemoveMidiEvent(const MidiEvent &event) override;
 
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
     void onAddClip(const Clip &clip) override;
     void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
     void onRemoveClip(const Clip &clip) override;
@@ -298,5 +303,11 @@ private:
     using PatternMap = FlatHashMap<Clip, UniquePointer<SequenceMap>, ClipHash>;
     PatternMap patternMap;
 
+    // the group operations send the notes of one track at once,
+    // so its sequence maps are only looked up when the track changes
+    using TrackSequenceMap = std::pair<const Clip *, SequenceMap *>;
+    void findSequenceMapsOfTrack(const MidiTrack *track,
+        const MidiTrack *&lastTrack, Array<TrackSequenceMap> &result);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PianoRoll);
 };